@@ -50,7 +50,9 @@ CREATE TABLE IF NOT EXISTS attributes (
     geoLineString GEOGRAPHY(LINESTRINGZ, 4326),
     geoMultiLineString GEOGRAPHY(MULTILINESTRINGZ, 4326),
     ts TIMESTAMP NOT NULL,
-    CONSTRAINT attributes_pkey PRIMARY KEY (instanceId,datasetId,ts));
+    CONSTRAINT attributes_pkey PRIMARY KEY (instanceId,datasetId,ts)) PARTITION BY RANGE (ts);
+
+CREATE TABLE IF NOT EXISTS attributes_default PARTITION OF attributes DEFAULT;
 
 CREATE TABLE IF NOT EXISTS subAttributes (
     instanceId TEXT NOT NULL,
@@ -73,6 +75,8 @@ CREATE TABLE IF NOT EXISTS subAttributes (
     geoLineString GEOGRAPHY(LINESTRINGZ, 4326),
     geoMultiLineString GEOGRAPHY(MULTILINESTRINGZ, 4326),
     ts TIMESTAMP NOT NULL,
-    CONSTRAINT subattributes_pkey PRIMARY KEY (instanceId,ts));
+    CONSTRAINT subattributes_pkey PRIMARY KEY (instanceId,ts)) PARTITION BY RANGE (ts);
+
+CREATE TABLE IF NOT EXISTS subAttributes_default PARTITION OF subAttributes DEFAULT;
 
 CREATE INDEX subattributes_attributeid_index ON subAttributes (attrInstanceId,attrDatasetId);
@@ -131,6 +131,8 @@
 #include "serviceRoutinesV2/semStateTreat.h"
 #include "serviceRoutinesV2/getMetrics.h"
 #include "serviceRoutinesV2/deleteMetrics.h"
+#include "serviceRoutinesV2/getLatencyMetrics.h"
+#include "serviceRoutinesV2/deleteLatencyMetrics.h"
 #include "serviceRoutinesV2/optionsGetOnly.h"
 #include "serviceRoutinesV2/optionsGetPostOnly.h"
 #include "serviceRoutinesV2/optionsGetDeleteOnly.h"
@@ -216,6 +218,7 @@ static RestService getServiceV[] =
   { LogLevelRequest,                               2, { "admin", "log"                                                                 },  getLogLevel                                      },
   { SemStateRequest,                               2, { "admin", "sem"                                                                 },  semStateTreat                                    },
   { MetricsRequest,                                2, { "admin", "metrics"                                                             },  getMetrics                                       },
+  { MetricsRequest,                                3, { "admin", "metrics", "latency"                                                  },  getLatencyMetrics                                },
 
   { ExitRequest,                                   2, { "exit", "*"                                                                    },  exitTreat                                        },
   { ExitRequest,                                   1, { "exit"                                                                         },  exitTreat                                        },
@@ -391,6 +394,7 @@ static RestService deleteServiceV[] =
   { StatisticsRequest,                             2, { "cache", "statistics"                                                        }, statisticsCacheTreat                                },
   { StatisticsRequest,                             4, { "v1", "admin", "cache", "statistics"                                         }, statisticsCacheTreat                                },
   { MetricsRequest,                                2, { "admin", "metrics"                                                           }, deleteMetrics                                       },
+  { MetricsRequest,                                3, { "admin", "metrics", "latency"                                                }, deleteLatencyMetrics                                },
 
   ORION_REST_SERVICE_END
 };
@@ -499,6 +503,7 @@ static RestService badVerbV[] =
   { LogLevelRequest,                               2, { "admin", "log"                                                                 }, badVerbPutOnly            },
   { SemStateRequest,                               2, { "admin", "sem"                                                                 }, badVerbGetOnly            },
   { MetricsRequest,                                2, { "admin", "metrics"                                                             }, badVerbGetDeleteOnly      },
+  { MetricsRequest,                                3, { "admin", "metrics", "latency"                                                  }, badVerbGetDeleteOnly      },
   { UpdateContext,                                 2, { "ngsi10",  "updateContext"                                                     }, badVerbPostOnly           },
   { QueryContext,                                  2, { "ngsi10",  "queryContext"                                                      }, badVerbPostOnly           },
   { SubscribeContext,                              2, { "ngsi10",  "subscribeContext"                                                  }, badVerbPostOnly           },
@@ -101,6 +101,7 @@ extern "C"
 #include "orionTypes/EntityTypeVectorResponse.h"
 #include "ngsi/ParseData.h"
 #include "ngsiNotify/QueueNotifier.h"
+#include "ngsiNotify/MultiNotifier.h"
 #include "ngsiNotify/QueueWorkers.h"
 #include "ngsiNotify/senderThread.h"
 
@@ -114,10 +115,21 @@ extern "C"
 #include "orionld/common/tenantList.h"                        // tenantList, tenant0
 #include "orionld/common/branchName.h"                        // ORIONLD_BRANCH
 #include "orionld/contextCache/orionldContextCacheRelease.h"  // orionldContextCacheRelease
+#include "orionld/contextCache/orionldInlineContextCache.h"   // orionldInlineContextCacheInit, orionldInlineContextCacheRelease
+#include "orionld/context/orionldContextFromUrl.h"            // contextDownloadListInit, contextDownloadListRelease
+#include "orionld/common/orionldConnectionPool.h"             // orionldConnectionPoolInit, orionldConnectionPoolRelease
+#include "orionld/notifications/orionldNotificationQueue.h"   // orionldNotificationQueueInit, orionldNotificationQueueRelease
 #include "orionld/rest/orionldServiceInit.h"                  // orionldServiceInit
+#include "orionld/rest/latencyMetrics.h"                      // latencyMetricsInit
+#include "orionld/mongoCppLegacy/mongoCppLegacyBsonDecodeBenchmark.h"  // mongoCppLegacyBsonDecodeBenchmark
 #include "orionld/db/dbInit.h"                                // dbInit
+#include "orionld/db/dbGeoIndexBuilder.h"                     // dbGeoIndexBuilderStart, dbGeoIndexBuilderStop
+#include "orionld/db/dbGeoIndexRegistry.h"                    // dbGeoIndexRegistryRelease
+#include "mongoBackend/mongoEntityTypeCatalog.h"              // mongoEntityTypeCatalogInit, mongoEntityTypeCatalogRelease
+#include "mongoBackend/mongoRegistrationCache.h"              // mongoRegistrationCacheInit, mongoRegistrationCacheRelease
 #include "orionld/mqtt/mqttRelease.h"                         // mqttRelease
 #include "orionld/troe/troeInit.h"                            // troeInit
+#include "orionld/troe/troeQueue.h"                           // troeQueueInit, troeQueueRelease
 
 #include "orionld/version.h"
 #include "orionld/orionRestServices.h"
@@ -127,15 +139,12 @@ extern "C"
 #include "orionld/socketService/socketServiceRun.h"           // socketServiceRun
 #include "orionld/troe/pgConnectionPoolsFree.h"               // pgConnectionPoolsFree
 #include "orionld/troe/pgConnectionPoolsPresent.h"            // pgConnectionPoolsPresent
+#include "orionld/troe/pgConnectionPoolCheck.h"               // pgConnectionPoolCheckStop
+#include "orionld/troe/pgPartitionMaintenance.h"              // pgPartitionMaintenanceStart, pgPartitionMaintenanceStop
 
 using namespace orion;
 
 
-extern void contextDownloadListInit(void);     // FIXME PR: include header ...
-extern void contextDownloadListRelease(void);  // FIXME PR: include header ...
-
-
-
 /* ****************************************************************************
 *
 * DB_NAME_MAX_LEN - max length of database name
@@ -184,6 +193,7 @@ int             subCacheInterval;
 char            notificationMode[64];
 int             notificationQueueSize;
 int             notificationThreadNum;
+int             notificationEndpointConcurrency;
 bool            noCache;
 unsigned int    connectionMemory;
 unsigned int    maxConnections;
@@ -199,6 +209,7 @@ bool            strictIdv1;
 bool            disableCusNotif;
 bool            logForHumans;
 bool            disableMetrics;
+bool            latencyMetrics;
 int             reqTimeout;
 bool            insecureNotif;
 bool            ngsiv1Autocast;
@@ -206,17 +217,36 @@ int             contextDownloadAttempts;
 int             contextDownloadTimeout;
 bool            troe;
 bool            disableFileLog;
+int             logBuffer;
 bool            lmtmp;
 char            troeHost[64];
 unsigned short  troePort;
 char            troeUser[64];
 char            troePwd[64];
 int             troePoolSize;
+int             troePoolWait;
+int             troePoolCheck;
+int             troePartitionDays;
+int             troeRetention;
 bool            socketService;
 unsigned short  socketServicePort;
 bool            forwarding;
+int             notifPoolSize;
+int             notifIdleTimeout;
+int             notifWorkers;
+int             notifQueueSize;
+char            notifDropPolicy[16];
+int             troeWriters;
+int             troeQueueSize;
+int             troeBatchSize;
+int             troeFlushIval;
+char            troeSpoolDir[256];
 bool            idIndex;
 bool            noswap;
+int             bsonDecodeBench;
+int             inlineContextCache;
+bool            entityTypeCatalog;
+int             regCacheInterval;
 
 
 
@@ -257,7 +287,7 @@ bool            noswap;
 #define WRITE_CONCERN_DESC     "db write concern (0:unacknowledged, 1:acknowledged)"
 #define CPR_FORWARD_LIMIT_DESC "maximum number of forwarded requests to Context Providers for a single client request"
 #define SUB_CACHE_IVAL_DESC    "interval in seconds between calls to Subscription Cache refresh (0: no refresh)"
-#define NOTIFICATION_MODE_DESC "notification mode (persistent|transient|threadpool:q:n)"
+#define NOTIFICATION_MODE_DESC "notification mode (persistent|transient|threadpool:q:n|multi:q:n:c)"
 #define NO_CACHE               "disable subscription cache for lookups"
 #define CONN_MEMORY_DESC       "maximum memory size per connection (in kilobytes)"
 #define MAX_CONN_DESC          "maximum number of simultaneous connections"
@@ -274,22 +304,42 @@ bool            noswap;
 #define LOG_TO_SCREEN_DESC     "log to screen"
 #define LOG_FOR_HUMANS_DESC    "human readible log to screen"
 #define METRICS_DESC           "turn off the 'metrics' feature"
+#define LATENCY_METRICS_DESC   "enable latency histograms per NGSI-LD service and request phase (GET /admin/metrics/latency)"
 #define REQ_TMO_DESC           "connection timeout for REST requests (in seconds)"
 #define INSECURE_NOTIF         "allow HTTPS notifications to peers which certificate cannot be authenticated with known CA certificates"
 #define NGSIV1_AUTOCAST        "automatic cast for number, booleans and dates in NGSIv1 update/create attribute operations"
 #define TROE_DESC              "enable TRoE - temporal representation of entities"
 #define DISABLE_FILE_LOG       "disable logging into file"
+#define LOG_BUFFER_DESC        "size in kilobytes of the ring buffer for asynchronous logging (0: synchronous logging)"
 #define TMPTRACES_DESC         "disable LM_TMP traces"
 #define TROE_HOST_DESC         "host for troe database db server"
 #define TROE_PORT_DESC         "port for troe database db server"
 #define TROE_HOST_USER         "username for troe database db server"
 #define TROE_HOST_PWD          "password for troe database db server"
 #define TROE_POOL_DESC         "size of the connection pool for TRoE Postgres database connections"
+#define TROE_POOL_WAIT_DESC    "max time in milliseconds to await a free TRoE Postgres connection (0: no limit)"
+#define TROE_POOL_CHECK_DESC   "interval in seconds of the health check of idle TRoE Postgres connections (0: no check)"
+#define TROE_PARTITION_DAYS_DESC  "size in days of the time partitions of the TRoE tables (0: no partition maintenance)"
+#define TROE_RETENTION_DESC    "days to keep TRoE data - older time partitions are dropped (0: keep forever)"
+#define TROE_WRITERS_DESC      "number of TRoE writer threads (0: TRoE is written by the request thread)"
+#define TROE_QUEUE_SIZE_DESC   "max number of statements in the TRoE writer queue (the overflow is spooled to file)"
+#define TROE_BATCH_SIZE_DESC   "max number of statements that a TRoE writer flushes in one transaction"
+#define TROE_FLUSH_IVAL_DESC   "max time in milliseconds that a statement waits in the TRoE writer queue"
+#define TROE_SPOOL_DIR_DESC    "directory for the TRoE spool file"
 #define SOCKET_SERVICE_DESC    "enable the socket service - accept connections via a normal TCP socket"
 #define SOCKET_SERVICE_PORT_DESC  "port to receive new socket service connections"
 #define FORWARDING_DESC        "turn on forwarding"
+#define NOTIF_POOL_SIZE_DESC   "max number of idle keep-alive connections per NGSI-LD notification endpoint (0: no keep-alive)"
+#define NOTIF_IDLE_TMO_DESC    "idle timeout in seconds for keep-alive NGSI-LD notification connections"
+#define NOTIF_WORKERS_DESC     "number of NGSI-LD notification sender threads (0: notifications are sent by the request thread)"
+#define NOTIF_QUEUE_SIZE_DESC  "max number of queued NGSI-LD notifications"
+#define NOTIF_DROP_DESC        "notification to drop when the NGSI-LD notification queue is full (incoming|oldest)"
+#define INLINE_CTX_CACHE_DESC  "max number of inline @context objects kept with their hash tables built (0: no cache)"
+#define TYPE_CATALOG_DESC      "keep a catalog of the entity types and their attributes, updated on each entity write, for GET /ngsi-ld/v1/types"
+#define REG_CACHE_IVAL_DESC    "interval in seconds between resyncs of the registration cache used by forwarding (0: no registration cache)"
 #define ID_INDEX_DESC          "automatic mongo index on _id.id"
 #define NOSWAP_DESC            "no swapping - for testing only!!!"
+#define BSON_DECODE_BENCH_DESC "run the BSON decode benchmark with this number of iterations, then exit - for testing only!!!"
 
 
 
@@ -348,7 +398,9 @@ PaArgument paArgs[] =
   { "-disableCustomNotifications",  &disableCusNotif,   "DISABLE_CUSTOM_NOTIF",      PaBool,    PaOpt,  false,           false,  true,             DISABLE_CUSTOM_NOTIF     },
   { "-logForHumans",          &logForHumans,            "LOG_FOR_HUMANS",            PaBool,    PaOpt,  false,           false,  true,             LOG_FOR_HUMANS_DESC      },
   { "-disableFileLog",        &disableFileLog,          "DISABLE_FILE_LOG",          PaBool,    PaOpt,  false,           false,  true,             DISABLE_FILE_LOG         },
+  { "-logBuffer",             &logBuffer,               "LOG_BUFFER",                PaInt,     PaOpt,  0,               0,      1048576,          LOG_BUFFER_DESC          },
   { "-disableMetrics",        &disableMetrics,          "DISABLE_METRICS",           PaBool,    PaOpt,  false,           false,  true,             METRICS_DESC             },
+  { "-latencyMetrics",        &latencyMetrics,          "LATENCY_METRICS",           PaBool,    PaOpt,  false,           false,  true,             LATENCY_METRICS_DESC     },
   { "-insecureNotif",         &insecureNotif,           "INSECURE_NOTIF",            PaBool,    PaOpt,  false,           false,  true,             INSECURE_NOTIF           },
   { "-ngsiv1Autocast",        &ngsiv1Autocast,          "NGSIV1_AUTOCAST",           PaBool,    PaOpt,  false,           false,  true,             NGSIV1_AUTOCAST          },
   { "-ctxTimeout",            &contextDownloadTimeout,  "CONTEXT_DOWNLOAD_TIMEOUT",  PaInt,     PaOpt,  5000,            0,      20000,            CTX_TMO_DESC             },
@@ -361,8 +413,26 @@ PaArgument paArgs[] =
   { "-troeUser",              troeUser,                 "TROE_USER",                 PaString,  PaOpt,  _i "postgres",   PaNL,   PaNL,             TROE_HOST_USER           },
   { "-troePwd",               troePwd,                  "TROE_PWD",                  PaString,  PaOpt,  _i "password",   PaNL,   PaNL,             TROE_HOST_PWD            },
   { "-troePoolSize",          &troePoolSize,            "TROE_POOL_SIZE",            PaInt,     PaOpt,  10,              0,      1000,             TROE_POOL_DESC           },
+  { "-troePoolWait",          &troePoolWait,            "TROE_POOL_WAIT",            PaInt,     PaOpt,  10000,           0,      3600000,          TROE_POOL_WAIT_DESC      },
+  { "-troePoolCheck",         &troePoolCheck,           "TROE_POOL_CHECK",           PaInt,     PaOpt,  60,              0,      86400,            TROE_POOL_CHECK_DESC     },
+  { "-troePartitionDays",     &troePartitionDays,       "TROE_PARTITION_DAYS",       PaInt,     PaOpt,  7,               0,      365,              TROE_PARTITION_DAYS_DESC },
+  { "-troeRetention",         &troeRetention,           "TROE_RETENTION",            PaInt,     PaOpt,  0,               0,      36500,            TROE_RETENTION_DESC      },
+  { "-troeWriters",           &troeWriters,             "TROE_WRITERS",              PaInt,     PaOpt,  0,               0,      100,              TROE_WRITERS_DESC        },
+  { "-troeQueueSize",         &troeQueueSize,           "TROE_QUEUE_SIZE",           PaInt,     PaOpt,  100000,          1,      10000000,         TROE_QUEUE_SIZE_DESC     },
+  { "-troeBatchSize",         &troeBatchSize,           "TROE_BATCH_SIZE",           PaInt,     PaOpt,  1000,            1,      100000,           TROE_BATCH_SIZE_DESC     },
+  { "-troeFlushIval",         &troeFlushIval,           "TROE_FLUSH_IVAL",           PaInt,     PaOpt,  100,             1,      60000,            TROE_FLUSH_IVAL_DESC     },
+  { "-troeSpoolDir",          troeSpoolDir,             "TROE_SPOOL_DIR",            PaString,  PaOpt,  _i "/tmp",       PaNL,   PaNL,             TROE_SPOOL_DIR_DESC      },
   { "-ssPort",                &socketServicePort,       "SOCKET_SERVICE_PORT",       PaUShort,  PaHid,  1027,            PaNL,   PaNL,             SOCKET_SERVICE_PORT_DESC },
   { "-forwarding",            &forwarding,              "FORWARDING",                PaBool,    PaOpt,  false,           false,  true,             FORWARDING_DESC          },
+  { "-notifPoolSize",         &notifPoolSize,           "NOTIF_POOL_SIZE",           PaInt,     PaOpt,  10,              0,      1000,             NOTIF_POOL_SIZE_DESC     },
+  { "-notifIdleTimeout",      &notifIdleTimeout,        "NOTIF_IDLE_TIMEOUT",        PaInt,     PaOpt,  30,              1,      3600,             NOTIF_IDLE_TMO_DESC      },
+  { "-notifWorkers",          &notifWorkers,            "NOTIF_WORKERS",             PaInt,     PaOpt,  0,               0,      1000,             NOTIF_WORKERS_DESC       },
+  { "-notifQueueSize",        &notifQueueSize,          "NOTIF_QUEUE_SIZE",          PaInt,     PaOpt,  10000,           1,      10000000,         NOTIF_QUEUE_SIZE_DESC    },
+  { "-notifDropPolicy",       notifDropPolicy,          "NOTIF_DROP_POLICY",         PaString,  PaOpt,  _i "incoming",   PaNL,   PaNL,             NOTIF_DROP_DESC          },
+  { "-inlineContextCache",    &inlineContextCache,      "INLINE_CONTEXT_CACHE",      PaInt,     PaOpt,  100,             0,      100000,           INLINE_CTX_CACHE_DESC    },
+  { "-entityTypeCatalog",     &entityTypeCatalog,       "ENTITY_TYPE_CATALOG",       PaBool,    PaOpt,  false,           false,  true,             TYPE_CATALOG_DESC        },
+  { "-regCacheIval",          &regCacheInterval,        "REG_CACHE_IVAL",            PaInt,     PaOpt,  0,               0,      86400,            REG_CACHE_IVAL_DESC      },
+  { "-bsonDecodeBench",       &bsonDecodeBench,         "BSON_DECODE_BENCH",         PaInt,     PaHid,  0,               0,      10000000,         BSON_DECODE_BENCH_DESC   },
 
   PA_END_OF_ARGS
 };
@@ -531,10 +601,25 @@ void exitFunc(void)
   // Free up the context download list, if needed
   contextDownloadListRelease();
 
+  // Stop the notification sender threads and close the idle notification connections
+  orionldNotificationQueueRelease();
+  orionldConnectionPoolRelease();
+
+  // Stop the geo-index builder (after the ongoing build, if any) and free the geo-index registry
+  dbGeoIndexBuilderStop();
+  dbGeoIndexRegistryRelease();
+
   //
   // Contexts that have been cloned must be freed
   //
   orionldContextCacheRelease();
+  orionldInlineContextCacheRelease();
+  mongoEntityTypeCatalogRelease();
+  mongoRegistrationCacheRelease();
+
+  // The TRoE partition maintenance thread walks the tenant list - must be stopped before the list is freed
+  if (troe)
+    pgPartitionMaintenanceStop();
 
   // Free the tenant list
   OrionldTenant* tenantP = tenantList;
@@ -558,6 +643,8 @@ void exitFunc(void)
   //
   if (troe)
   {
+    troeQueueRelease();  // Flushes what's left in the queue - before the connection pools are freed
+    pgConnectionPoolCheckStop();
     pgConnectionPoolsPresent();
     pgConnectionPoolsFree();
   }
@@ -602,6 +689,18 @@ static void contextBrokerInit(std::string dbPrefix, bool multitenant)
 
     pNotifier = pQNotifier;
   }
+  else if (strcmp(notificationMode, "multi") == 0)
+  {
+    MultiNotifier*  pMNotifier = new MultiNotifier(notificationQueueSize, notificationThreadNum, notificationEndpointConcurrency);
+    int             rc         = pMNotifier->start();
+
+    if (rc != 0)
+    {
+      LM_X(1,("Runtime Error starting notification multi workers (%d)", rc));
+    }
+
+    pNotifier = pMNotifier;
+  }
   else
   {
     pNotifier = new Notifier();
@@ -701,7 +800,7 @@ static SemOpType policyGet(std::string mutexPolicy)
 *
 * notificationModeParse -
 */
-static void notificationModeParse(char *notifModeArg, int *pQueueSize, int *pNumThreads)
+static void notificationModeParse(char *notifModeArg, int *pQueueSize, int *pNumThreads, int *pEndpointConcurrency)
 {
   char* mode;
   char* first_colon;
@@ -709,7 +808,7 @@ static void notificationModeParse(char *notifModeArg, int *pQueueSize, int *pNum
   errno = 0;
   // notifModeArg is a char[64], pretty sure not a huge input to break sscanf
   // cppcheck-suppress invalidscanf
-  flds_num = sscanf(notifModeArg, "%m[^:]:%d:%d", &mode, pQueueSize, pNumThreads);
+  flds_num = sscanf(notifModeArg, "%m[^:]:%d:%d:%d", &mode, pQueueSize, pNumThreads, pEndpointConcurrency);
   if (errno != 0)
   {
     LM_X(1, ("Fatal Error parsing notification mode: sscanf (%s)", strerror(errno)));
@@ -730,6 +829,31 @@ static void notificationModeParse(char *notifModeArg, int *pQueueSize, int *pNum
     *pQueueSize = DEFAULT_NOTIF_QS;
     *pNumThreads = DEFAULT_NOTIF_TN;
   }
+  else if (flds_num >= 3 && strcmp(mode, "multi") == 0)
+  {
+    if (flds_num == 3)
+    {
+      *pEndpointConcurrency = DEFAULT_MULTI_EC;
+    }
+    if (*pQueueSize <= 0)
+    {
+      LM_X(1, ("Fatal Error parsing notification mode: invalid queue size (%d)", *pQueueSize));
+    }
+    if (*pNumThreads <= 0)
+    {
+      LM_X(1, ("Fatal Error parsing notification mode: invalid number of threads (%d)",*pNumThreads));
+    }
+    if (*pEndpointConcurrency <= 0)
+    {
+      LM_X(1, ("Fatal Error parsing notification mode: invalid number of concurrent notifications per receiver (%d)", *pEndpointConcurrency));
+    }
+  }
+  else if (flds_num == 1 && strcmp(mode, "multi") == 0)
+  {
+    *pQueueSize           = DEFAULT_MULTI_QS;
+    *pNumThreads          = DEFAULT_MULTI_TN;
+    *pEndpointConcurrency = DEFAULT_MULTI_EC;
+  }
   else if (!(
              flds_num == 1 &&
              (strcmp(mode, "transient") == 0 || strcmp(mode, "persistent") == 0)
@@ -923,7 +1047,7 @@ int main(int argC, char* argV[])
     }
   }
 
-  notificationModeParse(notificationMode, &notificationQueueSize, &notificationThreadNum); // This should be called before contextBrokerInit()
+  notificationModeParse(notificationMode, &notificationQueueSize, &notificationThreadNum, &notificationEndpointConcurrency); // This should be called before contextBrokerInit()
 
   LM_I(("Orion Context Broker is running"));
 
@@ -934,6 +1058,17 @@ int main(int argC, char* argV[])
     daemonize();
   }
 
+  //
+  // Asynchronous logging - the writer thread is started after daemonize, as threads don't survive a fork
+  //
+  if (logBuffer > 0)
+  {
+    LmStatus s = lmAsyncStart(logBuffer * 1024);
+
+    if (s != LmsOk)
+      LM_X(1, ("Fatal Error (unable to start asynchronous logging with a buffer of %d kilobytes: %s)", logBuffer, lmStrerror(s)));
+  }
+
 
   IpVersion ipVersion = IPDUAL;
 
@@ -999,8 +1134,28 @@ int main(int argC, char* argV[])
   // Initialize orionld
   //
   contextDownloadListInit();
+  orionldInlineContextCacheInit(inlineContextCache);
+  mongoEntityTypeCatalogInit(entityTypeCatalog);
+
+  if (forwarding == true)
+    mongoRegistrationCacheInit(regCacheInterval);
+
+  orionldConnectionPoolInit(notifPoolSize, notifIdleTimeout);
+
+  if (orionldNotificationQueueInit(notifWorkers, notifQueueSize, notifDropPolicy) == false)
+    LM_X(1, ("Fatal Error (unable to initialize the NGSI-LD notification queue)"));
+
   orionldServiceInit(restServiceVV, 9, getenv("ORIONLD_CACHED_CONTEXT_DIRECTORY"));
 
+  if ((latencyMetrics == true) && (latencyMetricsInit() == false))
+    LM_X(1, ("Fatal Error (unable to initialize the latency metrics)"));
+
+  if (bsonDecodeBench > 0)
+  {
+    mongoCppLegacyBsonDecodeBenchmark(bsonDecodeBench);
+    exit(0);
+  }
+
   //
   // The database for Temporal Representation of Entities must be initialized before mongodb
   // as callbacks to create tenants (== postgres databases) and their tables are called from the
@@ -1013,10 +1168,17 @@ int main(int argC, char* argV[])
 
     if (troeInit() == false)
       LM_X(1, ("Database Error (unable to initialize the layer for Temporal Representation of Entities)"));
+
+    if ((troeWriters > 0) && (troeQueueInit(troeWriters, troeQueueSize, troeBatchSize, troeFlushIval, troeSpoolDir) == false))
+      LM_X(1, ("Internal Error (unable to start the TRoE writer threads)"));
   }
 
   dbInit(dbHost, dbName);
 
+  // The geo-indexes found in the database are registered by dbInit - the builder takes care of the new ones
+  if (dbGeoIndexBuilderStart() == false)
+    LM_X(1, ("Internal Error (unable to start the geo-index builder thread)"));
+
   //
   // Given that contextBrokerInit() may create thread (in the threadpool notification mode,
   // it has to be done before curl_global_init(), see https://curl.haxx.se/libcurl/c/threaded-ssl.html
@@ -1024,6 +1186,12 @@ int main(int argC, char* argV[])
   //
   contextBrokerInit(dbName, multitenancy);
 
+  //
+  // The TRoE partition maintenance needs the tenants - they're loaded from mongo by dbInit
+  //
+  if ((troe == true) && (troePartitionDays > 0) && (pgPartitionMaintenanceStart(troePartitionDays, troeRetention) == false))
+    LM_X(1, ("Internal Error (unable to start the TRoE partition maintenance thread)"));
+
   if (https)
   {
     char* httpsPrivateServerKey = (char*) malloc(2048);
@@ -27,6 +27,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
 
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
@@ -234,6 +235,63 @@ bool             subCacheMultitenant = false;
 
 
 
+/* ****************************************************************************
+*
+* SubCacheSubList -
+*/
+typedef std::vector<CachedSubscription*>            SubCacheSubList;
+typedef std::map<std::string, SubCacheSubList>     SubCacheSubListMap;
+
+
+
+/* ****************************************************************************
+*
+* SubCacheBucket - the subscriptions of one entity type
+*
+* Subscriptions with an exact entity id are kept in 'byId', under the entity id.
+* Subscriptions with an idPattern are kept in 'patternsByAttr', under each of their condition
+* attributes, or in 'patterns', if they have no condition attributes (they match any attribute).
+*/
+typedef struct SubCacheBucket
+{
+  SubCacheSubListMap  byId;
+  SubCacheSubListMap  patternsByAttr;
+  SubCacheSubList     patterns;
+} SubCacheBucket;
+
+
+
+/* ****************************************************************************
+*
+* SubCacheTenantIndex - the subscriptions of one tenant
+*
+* Subscriptions with an exact entity type are kept in 'byType', under the entity type.
+* Subscriptions with a typePattern, or with no type, are kept in 'anyType'.
+*/
+typedef struct SubCacheTenantIndex
+{
+  std::map<std::string, SubCacheBucket>  byType;
+  SubCacheBucket                         anyType;
+} SubCacheTenantIndex;
+
+
+
+/* ****************************************************************************
+*
+* subCacheIndex - index of the subscription cache, per tenant
+*
+* The index is a pre-filter - subMatch still decides whether a candidate matches.
+* A subscription is in the index (once per EntityInfo) from subCacheItemInsert until subCacheItemRemove.
+* As the cache, the index is protected by the cache semaphore.
+*
+* Without -multiservice, all subscriptions are indexed under the tenant "".
+*/
+static std::map<std::string, SubCacheTenantIndex>  subCacheIndex;
+static uint64_t                                    subCacheInsertNo   = 0;
+static uint64_t                                    subCacheMatchStamp = 0;
+
+
+
 /* ****************************************************************************
 *
 * subCacheInit -
@@ -397,8 +455,8 @@ static bool subMatch
   CachedSubscription*              cSubP,
   const char*                      tenant,
   const char*                      servicePath,
-  const char*                      entityId,
-  const char*                      entityType,
+  const std::string&               entityId,
+  const std::string&               entityType,
   const std::vector<std::string>&  attrV
 )
 {
@@ -465,32 +523,218 @@ static bool subMatch
 
 /* ****************************************************************************
 *
-* subCacheMatch -
+* subCacheIndexTenant - the key of a tenant in subCacheIndex
 */
-void subCacheMatch
+static const char* subCacheIndexTenant(const char* tenant)
+{
+  if ((subCacheMultitenant == false) || (tenant == NULL))
+  {
+    return "";
+  }
+
+  return tenant;
+}
+
+
+
+/* ****************************************************************************
+*
+* subListRemove -
+*/
+static void subListRemove(SubCacheSubList* listP, CachedSubscription* cSubP)
+{
+  listP->erase(std::remove(listP->begin(), listP->end(), cSubP), listP->end());
+}
+
+
+
+/* ****************************************************************************
+*
+* subListMapRemove - remove a sub from the list 'key' of a map, and the list itself, if it's left empty
+*/
+static void subListMapRemove(SubCacheSubListMap* mapP, const std::string& key, CachedSubscription* cSubP)
+{
+  SubCacheSubListMap::iterator it = mapP->find(key);
+
+  if (it == mapP->end())
+  {
+    return;
+  }
+
+  subListRemove(&it->second, cSubP);
+
+  if (it->second.empty())
+  {
+    mapP->erase(it);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheIndexBucket - the bucket of the index for an EntityInfo of a subscription
+*/
+static SubCacheBucket* subCacheIndexBucket(SubCacheTenantIndex* tenantIndexP, EntityInfo* eiP)
+{
+  if ((eiP->isTypePattern == true) || (eiP->entityType == ""))
+  {
+    return &tenantIndexP->anyType;
+  }
+
+  return &tenantIndexP->byType[eiP->entityType];
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheIndexInsert -
+*/
+static void subCacheIndexInsert(CachedSubscription* cSubP)
+{
+  SubCacheTenantIndex* tenantIndexP = &subCacheIndex[subCacheIndexTenant(cSubP->tenant)];
+
+  for (unsigned int ix = 0; ix < cSubP->entityIdInfos.size(); ++ix)
+  {
+    EntityInfo*     eiP     = cSubP->entityIdInfos[ix];
+    SubCacheBucket* bucketP = subCacheIndexBucket(tenantIndexP, eiP);
+
+    if (eiP->isPattern == false)
+    {
+      bucketP->byId[eiP->entityId].push_back(cSubP);
+    }
+    else if (cSubP->notifyConditionV.size() == 0)
+    {
+      bucketP->patterns.push_back(cSubP);
+    }
+    else
+    {
+      for (unsigned int aIx = 0; aIx < cSubP->notifyConditionV.size(); ++aIx)
+      {
+        bucketP->patternsByAttr[cSubP->notifyConditionV[aIx]].push_back(cSubP);
+      }
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheIndexRemove -
+*/
+static void subCacheIndexRemove(CachedSubscription* cSubP)
+{
+  std::map<std::string, SubCacheTenantIndex>::iterator tIter = subCacheIndex.find(subCacheIndexTenant(cSubP->tenant));
+
+  if (tIter == subCacheIndex.end())
+  {
+    return;
+  }
+
+  SubCacheTenantIndex* tenantIndexP = &tIter->second;
+
+  for (unsigned int ix = 0; ix < cSubP->entityIdInfos.size(); ++ix)
+  {
+    EntityInfo*     eiP     = cSubP->entityIdInfos[ix];
+    SubCacheBucket* bucketP = subCacheIndexBucket(tenantIndexP, eiP);
+
+    if (eiP->isPattern == false)
+    {
+      subListMapRemove(&bucketP->byId, eiP->entityId, cSubP);
+    }
+    else if (cSubP->notifyConditionV.size() == 0)
+    {
+      subListRemove(&bucketP->patterns, cSubP);
+    }
+    else
+    {
+      for (unsigned int aIx = 0; aIx < cSubP->notifyConditionV.size(); ++aIx)
+      {
+        subListMapRemove(&bucketP->patternsByAttr, cSubP->notifyConditionV[aIx], cSubP);
+      }
+    }
+
+    if ((bucketP != &tenantIndexP->anyType) && bucketP->byId.empty() && bucketP->patternsByAttr.empty() && bucketP->patterns.empty())
+    {
+      tenantIndexP->byType.erase(eiP->entityType);
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subListMatch - add the matching subs of a list of candidates to subVecP
+*/
+static void subListMatch
 (
+  const SubCacheSubList&             candidates,
   const char*                        tenant,
   const char*                        servicePath,
-  const char*                        entityId,
-  const char*                        entityType,
-  const char*                        attr,
+  const std::string&                 entityId,
+  const std::string&                 entityType,
+  const std::vector<std::string>&    attrV,
   std::vector<CachedSubscription*>*  subVecP
 )
 {
-  CachedSubscription* cSubP = subCache.head;
-
-  while (cSubP != NULL)
+  for (unsigned int ix = 0; ix < candidates.size(); ++ix)
   {
-    std::vector<std::string> attrV;
+    CachedSubscription* cSubP = candidates[ix];
 
-    attrV.push_back(attr);
+    // Already visited during this match (found via another EntityInfo or condition attribute)?
+    if (cSubP->matchStamp == subCacheMatchStamp)
+    {
+      continue;
+    }
+    cSubP->matchStamp = subCacheMatchStamp;
 
     if (subMatch(cSubP, tenant, servicePath, entityId, entityType, attrV))
     {
       subVecP->push_back(cSubP);
     }
+  }
+}
 
-    cSubP = cSubP->next;
+
+
+/* ****************************************************************************
+*
+* subBucketMatch - add the matching subs of a bucket to subVecP
+*/
+static void subBucketMatch
+(
+  const SubCacheBucket&              bucket,
+  const char*                        tenant,
+  const char*                        servicePath,
+  const std::string&                 entityId,
+  const std::string&                 entityType,
+  const std::vector<std::string>&    attrV,
+  std::vector<CachedSubscription*>*  subVecP
+)
+{
+  SubCacheSubListMap::const_iterator it = bucket.byId.find(entityId);
+
+  if (it != bucket.byId.end())
+  {
+    subListMatch(it->second, tenant, servicePath, entityId, entityType, attrV, subVecP);
+  }
+
+  subListMatch(bucket.patterns, tenant, servicePath, entityId, entityType, attrV, subVecP);
+
+  if (bucket.patternsByAttr.empty() == false)
+  {
+    for (unsigned int aIx = 0; aIx < attrV.size(); ++aIx)
+    {
+      it = bucket.patternsByAttr.find(attrV[aIx]);
+
+      if (it != bucket.patternsByAttr.end())
+      {
+        subListMatch(it->second, tenant, servicePath, entityId, entityType, attrV, subVecP);
+      }
+    }
   }
 }
 
@@ -498,29 +742,115 @@ void subCacheMatch
 
 /* ****************************************************************************
 *
-* subCacheMatch -
+* insertOrder - to sort matching subs in the order they were inserted in the cache
 */
-void subCacheMatch
+static bool insertOrder(const CachedSubscription* cSub1P, const CachedSubscription* cSub2P)
+{
+  return cSub1P->insertNo < cSub2P->insertNo;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheIndexMatch -
+*
+* Only the buckets of the entity type of the entity (and the bucket for "any type") are visited, and
+* inside them, only the subs for the entity id and the pattern subs of the modified attributes.
+* An empty entity type matches subscriptions of all types, so, in that case, all buckets are visited.
+*
+* The matching subs are returned in the order they were inserted in the cache, like a full scan
+* of the cache would return them.
+*/
+static void subCacheIndexMatch
 (
   const char*                        tenant,
   const char*                        servicePath,
-  const char*                        entityId,
-  const char*                        entityType,
+  const std::string&                 entityId,
+  const std::string&                 entityType,
   const std::vector<std::string>&    attrV,
   std::vector<CachedSubscription*>*  subVecP
 )
 {
-  CachedSubscription* cSubP = subCache.head;
+  std::map<std::string, SubCacheTenantIndex>::const_iterator tIter = subCacheIndex.find(subCacheIndexTenant(tenant));
 
-  while (cSubP != NULL)
+  if (tIter == subCacheIndex.end())
   {
-    if (subMatch(cSubP, tenant, servicePath, entityId, entityType, attrV))
+    return;
+  }
+
+  const SubCacheTenantIndex* tenantIndexP = &tIter->second;
+  unsigned int               matchesBefore = subVecP->size();
+
+  ++subCacheMatchStamp;
+
+  if (entityType != "")
+  {
+    std::map<std::string, SubCacheBucket>::const_iterator bIter = tenantIndexP->byType.find(entityType);
+
+    if (bIter != tenantIndexP->byType.end())
     {
-      subVecP->push_back(cSubP);
+      subBucketMatch(bIter->second, tenant, servicePath, entityId, entityType, attrV, subVecP);
     }
+  }
+  else
+  {
+    std::map<std::string, SubCacheBucket>::const_iterator bIter;
 
-    cSubP = cSubP->next;
+    for (bIter = tenantIndexP->byType.begin(); bIter != tenantIndexP->byType.end(); ++bIter)
+    {
+      subBucketMatch(bIter->second, tenant, servicePath, entityId, entityType, attrV, subVecP);
+    }
   }
+
+  subBucketMatch(tenantIndexP->anyType, tenant, servicePath, entityId, entityType, attrV, subVecP);
+
+  if (subVecP->size() - matchesBefore > 1)
+  {
+    std::sort(subVecP->begin() + matchesBefore, subVecP->end(), insertOrder);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheMatch -
+*/
+void subCacheMatch
+(
+  const char*                        tenant,
+  const char*                        servicePath,
+  const char*                        entityId,
+  const char*                        entityType,
+  const char*                        attr,
+  std::vector<CachedSubscription*>*  subVecP
+)
+{
+  std::vector<std::string> attrV;
+
+  attrV.push_back(attr);
+
+  subCacheIndexMatch(tenant, servicePath, entityId, entityType, attrV, subVecP);
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheMatch -
+*/
+void subCacheMatch
+(
+  const char*                        tenant,
+  const char*                        servicePath,
+  const char*                        entityId,
+  const char*                        entityType,
+  const std::vector<std::string>&    attrV,
+  std::vector<CachedSubscription*>*  subVecP
+)
+{
+  subCacheIndexMatch(tenant, servicePath, entityId, entityType, attrV, subVecP);
 }
 
 
@@ -595,6 +925,8 @@ void subCacheDestroy(void)
 
   subCache.head  = NULL;
   subCache.tail  = NULL;
+
+  subCacheIndex.clear();
 }
 
 
@@ -685,7 +1017,16 @@ void subCacheUpdateStatisticsIncrement(void)
 */
 void subCacheItemInsert(CachedSubscription* cSubP)
 {
-  cSubP->next = NULL;
+  cSubP->next       = NULL;
+  cSubP->insertNo   = ++subCacheInsertNo;
+  cSubP->matchStamp = 0;
+
+  // The sub has just been read from or written to DB - its timestamps are in sync with DB
+  cSubP->dbLastNotificationTime = cSubP->lastNotificationTime;
+  cSubP->dbLastFailure          = cSubP->lastFailure;
+  cSubP->dbLastSuccess          = cSubP->lastSuccess;
+
+  subCacheIndexInsert(cSubP);
 
   ++subCache.noOfInserts;
 
@@ -786,6 +1127,7 @@ void subCacheItemInsert
   cSubP->notifyConditionV       = conditionAttrs;
   cSubP->attributes             = attributes;
   cSubP->metadata               = metadata;
+  cSubP->modifiedAt             = orionldState.requestTime;  // Same as 'modifiedAt' of the newly created sub in DB
 
   //
   // String filters
@@ -962,6 +1304,7 @@ int subCacheItemRemove(CachedSubscription* cSubP)
 
       ++subCache.noOfRemoves;
 
+      subCacheIndexRemove(cSubP);
       subCacheItemDestroy(cSubP);
       delete cSubP;
 
@@ -1017,15 +1360,33 @@ void subCacheRefresh(void)
 
 /* ****************************************************************************
 *
-* CachedSubSaved -
+* subCacheCountersFlush - write the counters and timestamps of the cached subscriptions to DB
+*
+* Only the subscriptions that have notified (or failed to) since the last flush are written:
+* - 'count' is the number of notifications since the last flush ($inc in DB), and is reset to zero
+* - the timestamps are written only if newer than the last ones written to (or read from) DB
 */
-typedef struct CachedSubSaved
+static void subCacheCountersFlush(void)
 {
-  double   lastNotificationTime;
-  int64_t  count;
-  double   lastFailure;
-  double   lastSuccess;
-} CachedSubSaved;
+  for (CachedSubscription* cSubP = subCache.head; cSubP != NULL; cSubP = cSubP->next)
+  {
+    double lastNotificationTime = (cSubP->lastNotificationTime > cSubP->dbLastNotificationTime)? cSubP->lastNotificationTime : 0;
+    double lastFailure          = (cSubP->lastFailure          > cSubP->dbLastFailure)?          cSubP->lastFailure          : 0;
+    double lastSuccess          = (cSubP->lastSuccess          > cSubP->dbLastSuccess)?          cSubP->lastSuccess          : 0;
+
+    if ((cSubP->count == 0) && (lastNotificationTime == 0) && (lastFailure == 0) && (lastSuccess == 0))
+      continue;
+
+    std::string tenant = (cSubP->tenant == NULL)? "" : cSubP->tenant;  // Use char* !!!
+
+    mongoSubCountersUpdate(tenant, cSubP->subscriptionId, cSubP->count, lastNotificationTime, lastFailure, lastSuccess);
+
+    cSubP->count                  = 0;
+    cSubP->dbLastNotificationTime = cSubP->lastNotificationTime;
+    cSubP->dbLastFailure          = cSubP->lastFailure;
+    cSubP->dbLastSuccess          = cSubP->lastSuccess;
+  }
+}
 
 
 
@@ -1033,24 +1394,22 @@ typedef struct CachedSubSaved
 *
 * subCacheSync -
 *
-* 1. Save subscriptionId, lastNotificationTime, count, lastFailure, and lastSuccess for all items in cache (savedSubV)
-* 2. Refresh cache (count set to 0)
-* 3. Compare lastNotificationTime/lastFailure/lastSuccess in savedSubV with the new cache-contents and:
-*    3.1 Update cache-items where 'saved lastNotificationTime' > 'cached lastNotificationTime'
-*    3.2 Remember this more correct lastNotificationTime (must be flushed to mongo) -
-*        by clearing out (set to 0) those lastNotificationTimes that are newer in cache
-*    Same same with lastFailure and lastSuccess.
-* 4. Update 'count' for each item in savedSubV where non-zero
-* 5. Update 'lastNotificationTime/lastFailure/lastSuccess' for each item in savedSubV where non-zero
-* 6. Free the vector created in step 1 - savedSubV
+* 1. Flush the counters and timestamps of the cached subscriptions that have changed since the last sync
+* 2. Group the cached subscriptions by tenant (and subscription id)
+* 3. Synchronize the cached subscriptions of each tenant with its database (see mongoSubCacheSync):
+*    new and modified subscriptions are (re-)read, deleted ones are removed and the rest are kept as is
+* 4. Remove the cached subscriptions of tenants that no longer have a database
+*
+* Unlike subCacheRefresh, the cache is not emptied and all subscriptions aren't read from DB - only what has
+* changed is applied to the cache.
 *
 * NOTE
-*   This function runs in a separate thread and it allocates temporal objects (in savedSubV).
+*   This function runs in a separate thread and it allocates temporal objects (the maps of step 2).
 *   If the broker dies when this function is executing, all these temporal objects will be reported
 *   as memory leaks.
 *   We see this in our valgrind tests, where we force the broker to die.
 *   This is of course not a real leak, we only see this as a leak as the function hasn't finished to
-*   execute until the point where the temporal objects are deleted (See '6. Free the vector savedSubV').
+*   execute until the point where the temporal objects are deleted.
 *   To fix this little problem, we have created a variable 'subCacheState' that is set to ScsSynchronizing while
 *   the sub-cache synchronization is working.
 *   In serviceRoutines/exitTreat.cpp this variable is checked and if iot is set to ScsSynchronizing, then a
@@ -1058,118 +1417,85 @@ typedef struct CachedSubSaved
 */
 void subCacheSync(void)
 {
-  std::map<std::string, CachedSubSaved*> savedSubV;
+  std::map<std::string, std::map<std::string, CachedSubscription*> >  tenantMap;
+  std::vector<CachedSubscription*>                                    duplicates;
+  std::vector<std::string>                                            databases;
+  int                                                                 changes = 0;
 
   cacheSemTake(__FUNCTION__, "Synchronizing subscription cache");
   subCacheState = ScsSynchronizing;
 
 
   //
-  // 1. Save subscriptionId, lastNotificationTime, count, lastFailure, and lastSuccess for all items in cache
+  // 1. Flush the counters
   //
-  CachedSubscription* cSubP = subCache.head;
+  subCacheCountersFlush();
 
-  while (cSubP != NULL)
+
+  //
+  // 2. Group the cached subscriptions by tenant
+  //
+  for (CachedSubscription* cSubP = subCache.head; cSubP != NULL; cSubP = cSubP->next)
   {
+    std::map<std::string, CachedSubscription*>* subMapP = &tenantMap[(cSubP->tenant == NULL)? "" : cSubP->tenant];
+
     //
     // FIXME P7: For some reason, sometimes the same subscription is found twice in the cache (Issue 2216)
     //           Once the issue 2216 is fixed, this if-block must be removed.
     //
-    if (savedSubV[cSubP->subscriptionId] != NULL)
+    if (subMapP->find(cSubP->subscriptionId) != subMapP->end())
     {
-      cSubP = cSubP->next;
+      duplicates.push_back(cSubP);
       continue;
     }
 
-    CachedSubSaved* cssP       = new CachedSubSaved();
-
-    cssP->lastNotificationTime = cSubP->lastNotificationTime;
-    cssP->count                = cSubP->count;
-    cssP->lastFailure          = cSubP->lastFailure;
-    cssP->lastSuccess          = cSubP->lastSuccess;
-
-    savedSubV[cSubP->subscriptionId] = cssP;
-    cSubP = cSubP->next;
+    (*subMapP)[cSubP->subscriptionId] = cSubP;
   }
 
-
-  //
-  // 2. Refresh cache (count set to 0)
-  //
-  subCacheRefresh();
+  for (unsigned int ix = 0; ix < duplicates.size(); ++ix)
+  {
+    subCacheItemRemove(duplicates[ix]);
+  }
 
 
   //
-  // 3. Compare lastNotificationTime/lastFailure/lastSuccess in savedSubV with the new cache-contents
+  // 3. Synchronize tenant by tenant
   //
-  cSubP = subCache.head;
-  while (cSubP != NULL)
+  if (mongoMultitenant())
   {
-    CachedSubSaved* cssP = savedSubV[cSubP->subscriptionId];
+    getOrionDatabases(&databases);
+  }
 
-    if (cssP != NULL)
-    {
-      if (cssP->lastNotificationTime <= cSubP->lastNotificationTime)
-      {
-        // cssP->lastNotificationTime is older than what's currently in DB => throw away
-        cssP->lastNotificationTime = 0;
-      }
+  // Add the 'default tenant'
+  databases.push_back(getDbPrefix());
 
-      if (cssP->lastFailure < cSubP->lastFailure)
-      {
-        // cssP->lastFailure is older than what's currently in DB => throw away
-        cssP->lastFailure = 0;
-      }
+  for (unsigned int ix = 0; ix < databases.size(); ++ix)
+  {
+    const char*  tenant = tenantFromDb(databases[ix].c_str());
+    std::string  key    = (tenant == NULL)? "" : tenant;
 
-      if (cssP->lastSuccess < cSubP->lastSuccess)
-      {
-        // cssP->lastSuccess is older than what's currently in DB => throw away
-        cssP->lastSuccess = 0;
-      }
-    }
+    mongoSubCacheSync(databases[ix], &tenantMap[key], &changes);
 
-    cSubP = cSubP->next;
+    // On DB error, the cached subscriptions of the tenant are kept as they are
+    tenantMap.erase(key);
   }
 
 
   //
-  // 4. Update 'count' for each item in savedSubV where non-zero
-  // 5. Update 'lastNotificationTime/lastFailure/lastSuccess' for each item in savedSubV where non-zero
+  // 4. Tenants without database
   //
-  cSubP = subCache.head;
-  while (cSubP != NULL)
+  for (std::map<std::string, std::map<std::string, CachedSubscription*> >::iterator tIt = tenantMap.begin(); tIt != tenantMap.end(); ++tIt)
   {
-    CachedSubSaved* cssP = savedSubV[cSubP->subscriptionId];
-
-    if (cssP != NULL)
+    for (std::map<std::string, CachedSubscription*>::iterator sIt = tIt->second.begin(); sIt != tIt->second.end(); ++sIt)
     {
-      std::string tenant = (cSubP->tenant == NULL)? "" : cSubP->tenant;  // Use char* !!!
-
-      mongoSubCountersUpdate(tenant,
-                             cSubP->subscriptionId,
-                             cssP->count,
-                             cssP->lastNotificationTime,
-                             cssP->lastFailure,
-                             cssP->lastSuccess);
-
-      // Keeping lastFailure and lastSuccess in sub cache
-      cSubP->lastFailure = cssP->lastFailure;
-      cSubP->lastSuccess = cssP->lastSuccess;
+      subCacheItemRemove(sIt->second);
+      ++changes;
     }
-
-    cSubP = cSubP->next;
   }
 
+  ++subCache.noOfRefreshes;
 
-  //
-  // 6. Free the vector savedSubV
-  //
-  for (std::map<std::string, CachedSubSaved*>::iterator it = savedSubV.begin(); it != savedSubV.end(); ++it)
-  {
-    delete it->second;
-  }
-  savedSubV.clear();
-
+  LM_T(LmtSubCache, ("Synchronized subscription cache: %d changes", changes));
 
   subCacheState = ScsIdle;
   cacheSemGive(__FUNCTION__, "Synchronizing subscription cache");
@@ -115,6 +115,12 @@ struct CachedSubscription
   ngsiv2::HttpInfo            httpInfo;
   double                      lastFailure;  // timestamp of last notification failure
   double                      lastSuccess;  // timestamp of last successful notification
+  uint64_t                    insertNo;     // order of insertion in the cache - subCacheMatch returns matches in this order
+  uint64_t                    matchStamp;   // last subCacheMatch that visited the sub (to visit each sub only once per match)
+  double                      modifiedAt;   // 'modifiedAt' of the sub in DB - subCacheSync re-reads the sub if it differs
+  double                      dbLastNotificationTime;  // lastNotificationTime/lastFailure/lastSuccess as last written to (or read from) DB -
+  double                      dbLastFailure;           // subCacheSync only flushes the timestamps that are newer
+  double                      dbLastSuccess;
   struct CachedSubscription*  next;
 };
 
@@ -48,6 +48,7 @@ public:
     SyncQOverflow(size_t sz): max_size(sz) {}
     bool try_push(Data element);
     Data pop();
+    bool try_pop(Data* elementP);
     size_t size() const;
 };
 
@@ -88,6 +89,23 @@ Data SyncQOverflow<Data>::pop()
   return element;
 }
 
+/* ****************************************************************************
+*
+* SyncQOverflow<Data>::try_pop - like pop, but returns false instead of waiting if the queue is empty
+*/
+template <typename Data>
+bool SyncQOverflow<Data>::try_pop(Data* elementP)
+{
+  boost::mutex::scoped_lock lock(mtx);
+  if (queue.empty())
+  {
+    return false;
+  }
+  *elementP = queue.front();
+  queue.pop();
+  return true;
+}
+
 /* ****************************************************************************
 *
 * SyncQOverflow<Data>::size -
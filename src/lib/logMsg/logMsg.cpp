@@ -25,6 +25,7 @@
 #define F_OK 0
 
 #include <semaphore.h>          /* sem_init, sem_wait, sem_post              */
+#include <pthread.h>            /* pthread_create, pthread_cond_timedwait    */
 #include <errno.h>
 #include <sys/types.h>          /* types needed for other includes           */
 #include <stdio.h>              /*                                           */
@@ -45,6 +46,7 @@
 #include <sys/time.h>           /* gettimeofday                              */
 #include <time.h>               /* time, gmtime_r, ...                       */
 #include <sys/timeb.h>          /* timeb, ftime, ...                         */
+#include <sys/uio.h>            /* writev                                    */
 
 #undef NDEBUG
 #include <assert.h>
@@ -2264,6 +2266,522 @@ LmStatus lmPathRegister
 
 
 
+/* ****************************************************************************
+*
+* Asynchronous mode - lmAsyncStart
+*
+* In asynchronous mode, lmOut formats the line and copies it into a ring buffer, without taking
+* the log semaphore. A writer thread empties the ring buffer, writing the lines of each log file
+* with one writev call per batch.
+*
+* The ring buffer is a bounded multi-producer/single-consumer queue of chunks of LM_ASYNC_CHUNK_SIZE bytes.
+* A line takes as many consecutive chunks as it needs (a line may wrap around the end of the buffer).
+* Each chunk has a sequence number that tells its state, for ticket 't' (t % chunks == chunk index):
+*   seq == t                 the chunk is free
+*   seq == t + 1             the line starting in the chunk is complete (only the first chunk of a line)
+*   seq == t + chunks        the chunk has been written to file and is free for the next lap
+* A producer reserves its chunks by moving lmAsyncHead forward with a CAS, after checking that the last
+* of the chunks is free (the writer frees the chunks in order, so then all of them are free).
+*
+* If the buffer is full, the line is dropped and lmAsyncOverflows is incremented - the request threads never wait.
+* Lines of type 'X' (LM_X) are never dropped: if they don't fit, they're written directly and
+* the ring buffer is flushed before exiting.
+*/
+#define LM_ASYNC_CHUNK_SIZE    256
+#define LM_ASYNC_BATCH_MAX     64         /* max number of lines in one writev */
+#define LM_ASYNC_FLUSH_TMO     2000       /* max wait in milliseconds for a flush */
+
+
+
+/* ****************************************************************************
+*
+* LmAsyncChunk - the header of a chunk of the ring buffer
+*/
+typedef struct LmAsyncChunk
+{
+  uint64_t  seq;      /* state of the chunk (see above)                    */
+  int       len;      /* length of the line (first chunk of a line only)   */
+  int       fdIndex;  /* index in fds (first chunk of a line only)         */
+} LmAsyncChunk;
+
+
+
+/* ****************************************************************************
+*
+* Asynchronous mode - state
+*
+* lmAsyncHead is only modified by producers (lmAsyncPush), lmAsyncTail only by the writer thread.
+*/
+static bool             lmAsyncOn              = false;
+static LmAsyncChunk*    lmAsyncChunkV          = NULL;
+static char*            lmAsyncData            = NULL;
+static uint64_t         lmAsyncChunks          = 0;
+static uint64_t         lmAsyncHead            = 0;
+static uint64_t         lmAsyncTail            = 0;
+static int64_t          lmAsyncLines           = 0;
+static int64_t          lmAsyncOverflows       = 0;
+static bool             lmAsyncSleeping        = false;
+static int              lmAsyncFlushWaiters    = 0;
+static pthread_t        lmAsyncThread;
+static pthread_mutex_t  lmAsyncMutex           = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   lmAsyncWakeup          = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   lmAsyncFlushed         = PTHREAD_COND_INITIALIZER;
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncWake - wake up the writer thread, if it sleeps
+*/
+static void lmAsyncWake(void)
+{
+  if (__atomic_load_n(&lmAsyncSleeping, __ATOMIC_SEQ_CST) == true)
+  {
+    pthread_mutex_lock(&lmAsyncMutex);
+    __atomic_store_n(&lmAsyncSleeping, false, __ATOMIC_SEQ_CST);
+    pthread_cond_signal(&lmAsyncWakeup);
+    pthread_mutex_unlock(&lmAsyncMutex);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncPush - copy a formatted line into the ring buffer
+*
+* Returns false if the buffer is full (the line is not queued).
+*/
+static bool lmAsyncPush(int fdIndex, const char* line, int len)
+{
+  uint64_t  chunks = (len + LM_ASYNC_CHUNK_SIZE - 1) / LM_ASYNC_CHUNK_SIZE;
+  uint64_t  mask   = lmAsyncChunks - 1;
+  uint64_t  pos    = __atomic_load_n(&lmAsyncHead, __ATOMIC_RELAXED);
+
+  if (chunks == 0)
+  {
+    return true;
+  }
+
+  while (true)
+  {
+    uint64_t  last = pos + chunks - 1;
+    uint64_t  seq  = __atomic_load_n(&lmAsyncChunkV[last & mask].seq, __ATOMIC_ACQUIRE);
+    int64_t   diff = (int64_t) seq - (int64_t) last;
+
+    if (diff == 0)
+    {
+      if (__atomic_compare_exchange_n(&lmAsyncHead, &pos, pos + chunks, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      {
+        break;
+      }
+      // pos has been updated by the failed CAS
+    }
+    else if (diff < 0)
+    {
+      __atomic_add_fetch(&lmAsyncOverflows, 1, __ATOMIC_RELAXED);
+      return false;
+    }
+    else
+    {
+      pos = __atomic_load_n(&lmAsyncHead, __ATOMIC_RELAXED);
+    }
+  }
+
+  //
+  // The chunks pos .. pos + chunks - 1 are ours - copy the line (in two parts if it wraps around)
+  //
+  uint64_t  offset = (pos & mask) * LM_ASYNC_CHUNK_SIZE;
+  uint64_t  room   = lmAsyncChunks * LM_ASYNC_CHUNK_SIZE - offset;
+
+  if ((uint64_t) len <= room)
+  {
+    memcpy(&lmAsyncData[offset], line, len);
+  }
+  else
+  {
+    memcpy(&lmAsyncData[offset], line, room);
+    memcpy(lmAsyncData, &line[room], len - room);
+  }
+
+  LmAsyncChunk* chunkP = &lmAsyncChunkV[pos & mask];
+
+  chunkP->len     = len;
+  chunkP->fdIndex = fdIndex;
+  __atomic_store_n(&chunkP->seq, pos + 1, __ATOMIC_SEQ_CST);
+
+  lmAsyncWake();
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncWritev - writev all of 'iov', continuing after partial writes
+*/
+static void lmAsyncWritev(int fd, struct iovec* iov, int iovs)
+{
+  while (iovs > 0)
+  {
+    ssize_t nb = writev(fd, iov, iovs);
+
+    if (nb == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      printf("LOG error: writev(%d): %s\n", fd, strerror(errno));
+      return;
+    }
+
+    while ((iovs > 0) && ((size_t) nb >= iov->iov_len))
+    {
+      nb -= iov->iov_len;
+      ++iov;
+      --iovs;
+    }
+
+    if (iovs > 0)
+    {
+      iov->iov_base  = (char*) iov->iov_base + nb;
+      iov->iov_len  -= nb;
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncBatch - write all complete lines at the tail of the ring buffer, at most LM_ASYNC_BATCH_MAX per file
+*
+* Returns the number of lines written.
+*/
+static int lmAsyncBatch(void)
+{
+  struct iovec  iov[FDS_MAX][LM_ASYNC_BATCH_MAX * 2];  // a line that wraps around needs two iovecs
+  int           iovs[FDS_MAX];
+  int           lines  = 0;
+  uint64_t      mask   = lmAsyncChunks - 1;
+  uint64_t      size   = lmAsyncChunks * LM_ASYNC_CHUNK_SIZE;
+  uint64_t      start  = lmAsyncTail;
+  uint64_t      tail   = start;
+
+  for (int ix = 0; ix < FDS_MAX; ix++)
+  {
+    iovs[ix] = 0;
+  }
+
+  while (lines < LM_ASYNC_BATCH_MAX)
+  {
+    LmAsyncChunk* chunkP = &lmAsyncChunkV[tail & mask];
+
+    if (__atomic_load_n(&chunkP->seq, __ATOMIC_ACQUIRE) != tail + 1)
+    {
+      break;
+    }
+
+    uint64_t  offset  = (tail & mask) * LM_ASYNC_CHUNK_SIZE;
+    uint64_t  len     = chunkP->len;
+    int       fdIndex = chunkP->fdIndex;
+
+    if (offset + len <= size)
+    {
+      iov[fdIndex][iovs[fdIndex]].iov_base = &lmAsyncData[offset];
+      iov[fdIndex][iovs[fdIndex]].iov_len  = len;
+      ++iovs[fdIndex];
+    }
+    else
+    {
+      iov[fdIndex][iovs[fdIndex]].iov_base = &lmAsyncData[offset];
+      iov[fdIndex][iovs[fdIndex]].iov_len  = size - offset;
+      ++iovs[fdIndex];
+      iov[fdIndex][iovs[fdIndex]].iov_base = lmAsyncData;
+      iov[fdIndex][iovs[fdIndex]].iov_len  = len - (size - offset);
+      ++iovs[fdIndex];
+    }
+
+    tail += (len + LM_ASYNC_CHUNK_SIZE - 1) / LM_ASYNC_CHUNK_SIZE;
+    ++lines;
+  }
+
+  if (lines == 0)
+  {
+    return 0;
+  }
+
+  //
+  // The semaphore protects fds[].fd, that lmClear and lmReopen replace
+  //
+  semTake();
+  for (int ix = 0; ix < FDS_MAX; ix++)
+  {
+    if ((iovs[ix] == 0) || (fds[ix].state != Occupied))
+    {
+      continue;
+    }
+
+    if (fds[ix].type == Fichero)
+    {
+      lseek(fds[ix].fd, 0, SEEK_END);
+    }
+
+    lmAsyncWritev(fds[ix].fd, iov[ix], iovs[ix]);
+  }
+  semGive();
+
+  //
+  // Free the chunks for the next lap, in order
+  //
+  for (uint64_t ticket = start; ticket < tail; ticket++)
+  {
+    __atomic_store_n(&lmAsyncChunkV[ticket & mask].seq, ticket + lmAsyncChunks, __ATOMIC_RELEASE);
+  }
+
+  __atomic_store_n(&lmAsyncTail, tail, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&lmAsyncLines, lines, __ATOMIC_RELAXED);
+
+  if (__atomic_load_n(&lmAsyncFlushWaiters, __ATOMIC_ACQUIRE) > 0)
+  {
+    pthread_mutex_lock(&lmAsyncMutex);
+    pthread_cond_broadcast(&lmAsyncFlushed);
+    pthread_mutex_unlock(&lmAsyncMutex);
+  }
+
+  return lines;
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncWriter - the writer thread
+*
+* When the ring buffer is empty, the thread sleeps until a producer wakes it up (lmAsyncWake).
+* The sleeping flag is set before checking the buffer one last time and a producer checks the flag
+* after publishing its line, so one of the two always sees the other.
+* The timed wait is only a safety net.
+*/
+static void* lmAsyncWriter(void* vP)
+{
+  uint64_t mask = lmAsyncChunks - 1;
+
+  while (true)
+  {
+    if (lmAsyncBatch() > 0)
+    {
+      continue;
+    }
+
+    __atomic_store_n(&lmAsyncSleeping, true, __ATOMIC_SEQ_CST);
+
+    uint64_t tail = lmAsyncTail;
+    if (__atomic_load_n(&lmAsyncChunkV[tail & mask].seq, __ATOMIC_SEQ_CST) == tail + 1)
+    {
+      __atomic_store_n(&lmAsyncSleeping, false, __ATOMIC_SEQ_CST);
+      continue;
+    }
+
+    struct timespec  until;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += 100 * 1000000;
+    if (until.tv_nsec >= 1000000000)
+    {
+      until.tv_sec  += 1;
+      until.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&lmAsyncMutex);
+    while (__atomic_load_n(&lmAsyncSleeping, __ATOMIC_SEQ_CST) == true)
+    {
+      if (pthread_cond_timedwait(&lmAsyncWakeup, &lmAsyncMutex, &until) == ETIMEDOUT)
+      {
+        break;
+      }
+    }
+    __atomic_store_n(&lmAsyncSleeping, false, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&lmAsyncMutex);
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncFlush - wait until all lines queued before the call have been written
+*
+* Lines whose producers haven't finished copying them into the buffer may delay the flush,
+* so the wait is limited to LM_ASYNC_FLUSH_TMO milliseconds.
+*/
+void lmAsyncFlush(void)
+{
+  if (lmAsyncOn == false)
+  {
+    return;
+  }
+
+  uint64_t         target = __atomic_load_n(&lmAsyncHead, __ATOMIC_ACQUIRE);
+  struct timespec  until;
+
+  clock_gettime(CLOCK_REALTIME, &until);
+  until.tv_sec  += LM_ASYNC_FLUSH_TMO / 1000;
+  until.tv_nsec += (LM_ASYNC_FLUSH_TMO % 1000) * 1000000;
+  if (until.tv_nsec >= 1000000000)
+  {
+    until.tv_sec  += 1;
+    until.tv_nsec -= 1000000000;
+  }
+
+  __atomic_add_fetch(&lmAsyncFlushWaiters, 1, __ATOMIC_SEQ_CST);
+
+  pthread_mutex_lock(&lmAsyncMutex);
+  __atomic_store_n(&lmAsyncSleeping, false, __ATOMIC_SEQ_CST);
+  pthread_cond_signal(&lmAsyncWakeup);
+
+  while (__atomic_load_n(&lmAsyncTail, __ATOMIC_ACQUIRE) < target)
+  {
+    if (pthread_cond_timedwait(&lmAsyncFlushed, &lmAsyncMutex, &until) == ETIMEDOUT)
+    {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&lmAsyncMutex);
+
+  __atomic_sub_fetch(&lmAsyncFlushWaiters, 1, __ATOMIC_SEQ_CST);
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncExit - flush the ring buffer at exit, and write whatever is logged after that directly
+*/
+static void lmAsyncExit(void)
+{
+  lmAsyncFlush();
+  lmAsyncOn = false;
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncStart - turn on the asynchronous mode, with a ring buffer of 'bufSize' bytes
+*
+* Must be called after lmInit and after forking (the writer thread doesn't survive a fork).
+* The buffer size is rounded up to a power of two chunks, and must at least fit two lines of max size.
+*
+* Not compatible with alternative write functions (lmWriteFunction) nor with clearing of the
+* log file (lmClearAt) - the clearing is skipped in asynchronous mode.
+*/
+LmStatus lmAsyncStart(int bufSize)
+{
+  INIT_CHECK();
+
+  if (lmAsyncOn == true)
+  {
+    return LmsInitAlreadyDone;
+  }
+
+  if (bufSize < 2 * LM_LINE_MAX)
+  {
+    return LmsBadSize;
+  }
+
+  for (int ix = 0; ix < FDS_MAX; ix++)
+  {
+    if ((fds[ix].state == Occupied) && (fds[ix].write != NULL))
+    {
+      return LmsBadParams;
+    }
+  }
+
+  uint64_t chunks = 1;
+  while (chunks * LM_ASYNC_CHUNK_SIZE < (uint64_t) bufSize)
+  {
+    chunks *= 2;
+  }
+
+  lmAsyncChunkV = (LmAsyncChunk*) calloc(chunks, sizeof(LmAsyncChunk));
+  lmAsyncData   = (char*) malloc(chunks * LM_ASYNC_CHUNK_SIZE);
+
+  if ((lmAsyncChunkV == NULL) || (lmAsyncData == NULL))
+  {
+    free(lmAsyncChunkV);
+    free(lmAsyncData);
+    lmAsyncChunkV = NULL;
+    lmAsyncData   = NULL;
+    return LmsMalloc;
+  }
+
+  for (uint64_t ix = 0; ix < chunks; ix++)
+  {
+    lmAsyncChunkV[ix].seq = ix;
+  }
+
+  lmAsyncChunks = chunks;
+  lmAsyncHead   = 0;
+  lmAsyncTail   = 0;
+
+  if (pthread_create(&lmAsyncThread, NULL, lmAsyncWriter, NULL) != 0)
+  {
+    free(lmAsyncChunkV);
+    free(lmAsyncData);
+    lmAsyncChunkV = NULL;
+    lmAsyncData   = NULL;
+    return LmsInitNotDone;
+  }
+
+  pthread_detach(lmAsyncThread);
+  atexit(lmAsyncExit);
+
+  __atomic_store_n(&lmAsyncOn, true, __ATOMIC_RELEASE);
+
+  return LmsOk;
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncStatisticsGet - number of lines written by the writer thread and number of lines dropped
+*
+* Returns false if the asynchronous mode is off.
+*/
+bool lmAsyncStatisticsGet(int64_t* linesP, int64_t* overflowsP)
+{
+  if (lmAsyncOn == false)
+  {
+    return false;
+  }
+
+  *linesP     = __atomic_load_n(&lmAsyncLines, __ATOMIC_RELAXED);
+  *overflowsP = __atomic_load_n(&lmAsyncOverflows, __ATOMIC_RELAXED);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncStatisticsReset -
+*/
+void lmAsyncStatisticsReset(void)
+{
+  __atomic_store_n(&lmAsyncLines,     0, __ATOMIC_RELAXED);
+  __atomic_store_n(&lmAsyncOverflows, 0, __ATOMIC_RELAXED);
+}
+
+
+
 /* ****************************************************************************
 *
 * lmOut -
@@ -2314,7 +2832,17 @@ LmStatus lmOut
 
   memset(format, 0, FORMAT_LEN + 1);
 
-  semTake();
+  //
+  // In asynchronous mode, the lines are queued in the ring buffer, and the semaphore is
+  // only needed to serialize the calls to the hook
+  //
+  bool async  = __atomic_load_n(&lmAsyncOn, __ATOMIC_ACQUIRE);
+  bool locked = (async == false) || ((type != 'H') && (lmOutHook != NULL) && (lmOutHookActive == true));
+
+  if (locked)
+  {
+    semTake();
+  }
 
   if ((type != 'H') && lmOutHook && lmOutHookActive == true)
   {
@@ -2385,10 +2913,16 @@ LmStatus lmOut
     {
       fds[i].write(line);
     }
-    else
+    else if ((async == false) || (lmAsyncPush(i, line, sz) == false))
     {
       int nb;
 
+      // Ring buffer full - the line is dropped (and counted as overflow), unless it's an LM_X
+      if ((async == true) && (type != 'X') && (type != 'x'))
+      {
+        continue;
+      }
+
       lseek(fds[i].fd, 0, SEEK_END);
       nb = write(fds[i].fd, line, sz);
 
@@ -2403,7 +2937,7 @@ LmStatus lmOut
     }
   }
 
-  ++logLines;
+  __atomic_add_fetch(&logLines, 1, __ATOMIC_RELAXED);
   LOG_OUT(("logLines: %d", logLines));
 
   if (type == 'W')
@@ -2425,7 +2959,15 @@ LmStatus lmOut
   }
   else if ((type == 'X') || (type == 'x'))
   {
-    semGive();
+    if (locked)
+    {
+      semGive();
+    }
+
+    if (async)
+    {
+      lmAsyncFlush();
+    }
 
     if (exitFunction != NULL)
     {
@@ -2443,7 +2985,7 @@ LmStatus lmOut
     exit(tLev);
   }
 
-  if ((doClear == true) && (logLines >= atLines))
+  if ((doClear == true) && (async == false) && (logLines >= atLines))
   {
     int i;
 
@@ -2471,7 +3013,12 @@ LmStatus lmOut
 
   free(line);
   free(format);
-  semGive();
+
+  if (locked)
+  {
+    semGive();
+  }
+
   return LmsOk;
 }
 
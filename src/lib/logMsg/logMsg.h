@@ -1692,6 +1692,38 @@ extern LmStatus lmReopen(int index);
 
 
 
+/* ****************************************************************************
+*
+* lmAsyncStart - turn on asynchronous logging, via a ring buffer of 'bufSize' bytes and a writer thread
+*/
+extern LmStatus lmAsyncStart(int bufSize);
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncFlush - wait until the lines in the ring buffer have been written
+*/
+extern void lmAsyncFlush(void);
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncStatisticsGet -
+*/
+extern bool lmAsyncStatisticsGet(int64_t* linesP, int64_t* overflowsP);
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncStatisticsReset -
+*/
+extern void lmAsyncStatisticsReset(void);
+
+
+
 /* ****************************************************************************
 *
 * lmOnlyErrors
@@ -23,10 +23,14 @@
 * Author: Ken Zangelin
 */
 #include <stdint.h>   // int64_t et al
+#include <stdlib.h>   // calloc, free
+#include <string.h>   // strcmp, strdup
+#include <pthread.h>
 #include <sys/time.h>
 
 #include <utility>
 #include <string>
+#include <vector>
 #include <map>
 
 #include "logMsg/logMsg.h"
@@ -48,12 +52,57 @@
 
 
 
+/* ****************************************************************************
+*
+* METRICS_KEY_CACHE_MAX - max number of entries in the key cache of a shard
+*
+* Requests with lots of different (raw) service paths would otherwise make the cache grow forever.
+* When the limit is reached, the cache is simply cleared - the entries are found again in the
+* interned keys of the manager.
+*/
+#define METRICS_KEY_CACHE_MAX   1024
+
+
+
+/* ****************************************************************************
+*
+* METRICS_PAGE_SIZE - number of counters in a page
+*/
+#define METRICS_PAGE_SIZE       (METRICS_KEYS_PER_PAGE * METRICS_MAX)
+
+
+
 /* ****************************************************************************
 *
 * MetricsManager::MetricsManager -
 */
-MetricsManager::MetricsManager(): on(false), semWaitStatistics(false), semWaitTime(0)
+MetricsManager::MetricsManager(): on(false), semWaitStatistics(false), semWaitTime(0), shardList(NULL), metricCount(0)
 {
+  for (int ix = 0; ix < METRICS_MAX; ix++)
+  {
+    metricNameV[ix] = NULL;
+  }
+
+  for (int ix = 0; ix < METRICS_PAGES; ix++)
+  {
+    baseline[ix] = NULL;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* shardRelease - destructor of the thread-specific shard pointer
+*
+* The shard isn't freed, its counters are still part of the totals.
+* It is only marked as free, to be reused by the next thread that needs a shard.
+*/
+static void shardRelease(void* vP)
+{
+  MetricsShard* shardP = (MetricsShard*) vP;
+
+  __atomic_store_n(&shardP->inUse, false, __ATOMIC_RELEASE);
 }
 
 
@@ -114,6 +163,13 @@ bool MetricsManager::init(bool _on, bool _semWaitStatistics)
     return false;
   }
 
+  int r = pthread_key_create(&shardKey, shardRelease);
+  if (r != 0)
+  {
+    LM_E(("Runtime Error (error creating the thread key for the 'metrics mgr' shards: %s)", strerror(r)));
+    return false;
+  }
+
   return true;
 }
 
@@ -231,69 +287,297 @@ bool MetricsManager::servicePathForMetrics(const std::string& spathIn, std::stri
 
 
 
+/* ****************************************************************************
+*
+* MetricsManager::shardGet -
+*
+* Returns the shard of the calling thread - on the first call of a thread, a free shard is
+* taken from the shard list or, if none is free, a new shard is allocated and linked in.
+*/
+MetricsShard* MetricsManager::shardGet(void)
+{
+  MetricsShard* shardP = (MetricsShard*) pthread_getspecific(shardKey);
+
+  if (shardP != NULL)
+  {
+    return shardP;
+  }
+
+  semTake();
+
+  for (shardP = shardList; shardP != NULL; shardP = shardP->next)
+  {
+    if (__atomic_load_n(&shardP->inUse, __ATOMIC_ACQUIRE) == false)
+    {
+      break;
+    }
+  }
+
+  if (shardP == NULL)
+  {
+    shardP = new MetricsShard();
+
+    for (int ix = 0; ix < METRICS_PAGES; ix++)
+    {
+      shardP->page[ix] = NULL;
+    }
+
+    shardP->next = shardList;
+    shardList    = shardP;
+  }
+
+  shardP->inUse = true;
+
+  semGive();
+
+  pthread_setspecific(shardKey, shardP);
+
+  return shardP;
+}
+
+
+
+/* ****************************************************************************
+*
+* MetricsManager::keyLookup -
+*
+* Returns the interned key id of the service/sub-service pair, or -1 if the pair isn't valid for metrics.
+*
+* The shard caches the key ids by service and service-path as received, so the validity checks
+* and the normalization of the service path are only done the first time a thread sees a pair.
+* That also takes care of the FIXME P4 on the validity checks (github issue #2781).
+*/
+int MetricsManager::keyLookup(MetricsShard* shardP, const char* srv, const char* subServ)
+{
+  std::string                          cacheKey = std::string(srv) + '\0' + subServ;
+  std::map<std::string, int>::iterator it       = shardP->keyCache.find(cacheKey);
+
+  if (it != shardP->keyCache.end())
+  {
+    return it->second;
+  }
+
+  std::string  subService = "not-set";
+  int          keyId      = -1;
+
+  if ((serviceValid(srv) == true) && (servicePathForMetrics(subServ, &subService) == true))
+  {
+    std::string internKey = std::string(srv) + '\0' + subService;
+
+    semTake();
+
+    std::map<std::string, int>::iterator kIt = keyMap.find(internKey);
+
+    if (kIt != keyMap.end())
+    {
+      keyId = kIt->second;
+    }
+    else if (keyV.size() < METRICS_PAGES * METRICS_KEYS_PER_PAGE)
+    {
+      MetricsKey* keyP = new MetricsKey();
+
+      keyP->service    = srv;
+      keyP->subService = subService;
+      keyId            = keyV.size();
+
+      keyV.push_back(keyP);
+      keyMap[internKey] = keyId;
+    }
+    else
+    {
+      semGive();
+      LM_W(("Metrics: too many service/sub-service pairs - metrics for '%s' / '%s' are skipped", srv, subService.c_str()));
+      return -1;  // Not cached - the pair is valid, the store is just full
+    }
+
+    semGive();
+  }
+
+  if (shardP->keyCache.size() >= METRICS_KEY_CACHE_MAX)
+  {
+    shardP->keyCache.clear();
+  }
+
+  shardP->keyCache[cacheKey] = keyId;
+
+  return keyId;
+}
+
+
+
+/* ****************************************************************************
+*
+* MetricsManager::metricLookup -
+*
+* Returns the index of the metric in metricNameV, adding it if not found.
+*
+* The metric names are compile-time constants (see the METRIC_* macros), so the first loop, without
+* the semaphore, finds them in all but the very first call for each metric. A new name is written
+* to metricNameV before metricCount is incremented, so readers never see a half-added metric.
+*/
+int MetricsManager::metricLookup(const char* metric)
+{
+  int count = __atomic_load_n(&metricCount, __ATOMIC_ACQUIRE);
+
+  for (int ix = 0; ix < count; ix++)
+  {
+    if ((metricNameV[ix] == metric) || (strcmp(metricNameV[ix], metric) == 0))
+    {
+      return ix;
+    }
+  }
+
+  semTake();
+
+  for (int ix = count; ix < metricCount; ix++)
+  {
+    if (strcmp(metricNameV[ix], metric) == 0)
+    {
+      semGive();
+      return ix;
+    }
+  }
+
+  int metricId = -1;
+
+  if (metricCount < METRICS_MAX)
+  {
+    metricId              = metricCount;
+    metricNameV[metricId] = strdup(metric);
+    __atomic_store_n(&metricCount, metricCount + 1, __ATOMIC_RELEASE);
+  }
+  else
+  {
+    LM_W(("Metrics: too many metrics - '%s' is skipped", metric));
+  }
+
+  semGive();
+
+  return metricId;
+}
+
+
+
 /* ****************************************************************************
 *
 * MetricsManager::add -
 *
-* FIXME P4: About the calls to serviceValid and subServiceValid:
-*   we check that 'srv' and 'subServ' are legal names, and if not, metrics are skipped.
-*   Doing this each time add() is called is not optimal for performance.
-*   The github issue #2781 is about better solutions for this.
-*   Note that the call to subServiceValid is inside servicePathForMetrics()
+* Only the calling thread writes to the counters of its shard, so no semaphore is needed, neither
+* is an atomic read-modify-write. The atomic load/store only makes sure that toJson(), reading the
+* counter from another thread, never sees a torn value.
 */
 void MetricsManager::add(const char* srvCanBeNull, const char* subServ, const char* metric, uint64_t value)
 {
-  std::string  subService = "not-set";
-  const char*  srv        = (srvCanBeNull == NULL)? "" : srvCanBeNull;
+  const char*  srv = (srvCanBeNull == NULL)? "" : srvCanBeNull;  // NULL tenant is VALID
 
   if (on == false)
   {
     return;
   }
 
-  if ((srv != NULL) && (serviceValid(srv) == false))  // NULL tenant is VALID
+  MetricsShard*  shardP   = shardGet();
+  int            keyId    = keyLookup(shardP, srv, (subServ == NULL)? "" : subServ);
+  int            metricId;
+
+  if (keyId == -1)
   {
     return;
   }
 
-  if (servicePathForMetrics(subServ, &subService) == false)
+  if ((metricId = metricLookup(metric)) == -1)
   {
     return;
   }
 
-  semTake();
-
+  int        pageNo = keyId / METRICS_KEYS_PER_PAGE;
+  uint64_t*  page   = shardP->page[pageNo];
 
-  // Do we have the service in the map?
-  if (metrics.find(srv) == metrics.end())
+  if (page == NULL)
   {
-    // not found: create it
-    metrics[srv] = new std::map<std::string, std::map<std::string, uint64_t>*>;
+    page = (uint64_t*) calloc(METRICS_PAGE_SIZE, sizeof(uint64_t));
+    if (page == NULL)
+    {
+      LM_E(("Runtime Error (out of memory allocating a page of metrics counters)"));
+      return;
+    }
+
+    __atomic_store_n(&shardP->page[pageNo], page, __ATOMIC_RELEASE);
   }
 
-  // Do we have the subservice in the map?
-  if (metrics[srv]->find(subService) == metrics[srv]->end())
+  uint64_t* counterP = &page[(keyId % METRICS_KEYS_PER_PAGE) * METRICS_MAX + metricId];
+
+  __atomic_store_n(counterP, __atomic_load_n(counterP, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+
+
+/* ****************************************************************************
+*
+* MetricsManager::totalsGet -
+*
+* Sums up the counters of all shards, page by page, into 'totals' (METRICS_PAGES items).
+* Pages that no shard uses are left NULL.
+* Returns the number of pages in use.
+*
+* NOTE
+*   The semaphore must be taken by the caller
+*/
+int MetricsManager::totalsGet(uint64_t** totals)
+{
+  int pages = (keyV.size() + METRICS_KEYS_PER_PAGE - 1) / METRICS_KEYS_PER_PAGE;
+
+  for (int pageNo = 0; pageNo < METRICS_PAGES; pageNo++)
   {
-    //
-    // Not Found: create it
-    //
-    metrics[srv]->insert(std::pair<std::string, std::map<std::string, uint64_t>*>
-                         (subService,
-                          new std::map<std::string, uint64_t>));
+    totals[pageNo] = NULL;
   }
 
-  // Do we have the metric in the map?
-  if (metrics[srv]->at(subService)->find(metric) == metrics[srv]->at(subService)->end())
+  for (MetricsShard* shardP = shardList; shardP != NULL; shardP = shardP->next)
   {
-    //
-    // Not Found: create it
-    //
-    metrics[srv]->at(subService)->insert(std::pair<std::string, uint64_t>(metric, 0));
+    for (int pageNo = 0; pageNo < pages; pageNo++)
+    {
+      uint64_t* page = __atomic_load_n(&shardP->page[pageNo], __ATOMIC_ACQUIRE);
+
+      if (page == NULL)
+      {
+        continue;
+      }
+
+      if (totals[pageNo] == NULL)
+      {
+        totals[pageNo] = (uint64_t*) calloc(METRICS_PAGE_SIZE, sizeof(uint64_t));
+        if (totals[pageNo] == NULL)
+        {
+          LM_E(("Runtime Error (out of memory allocating a page of metrics totals)"));
+          continue;
+        }
+      }
+
+      for (int ix = 0; ix < METRICS_PAGE_SIZE; ix++)
+      {
+        totals[pageNo][ix] += __atomic_load_n(&page[ix], __ATOMIC_RELAXED);
+      }
+    }
   }
 
-  metrics[srv]->at(subService)->at(metric) += value;
+  return pages;
+}
+
 
-  semGive();
+
+/* ****************************************************************************
+*
+* MetricsManager::totalsRelease -
+*/
+void MetricsManager::totalsRelease(uint64_t** totals, int pages)
+{
+  for (int pageNo = 0; pageNo < pages; pageNo++)
+  {
+    if (totals[pageNo] != NULL)
+    {
+      free(totals[pageNo]);
+      totals[pageNo] = NULL;
+    }
+  }
 }
 
 
@@ -301,32 +585,33 @@ void MetricsManager::add(const char* srvCanBeNull, const char* subServ, const ch
 /* ****************************************************************************
 *
 * MetricsManager::_reset -
+*
+* The counters of the shards belong to their threads and can't be zeroed from here.
+* Instead, the current totals are saved as baseline, and subtracted in _toJson().
+*
+* NOTE
+*   The semaphore must be taken by the caller
 */
-void MetricsManager::_reset(void)
+void MetricsManager::_reset(uint64_t** totals)
 {
-  //
-  // Three iterators needed to iterate over the 'triple-map' metrics:
-  //   serviceIter      to iterate over all services
-  //   subServiceIter   to iterate over all sub-services of a service
-  //   metricIter       to iterate over all metrics of a sub-service
-  //
-  std::map<std::string, std::map<std::string, std::map<std::string, uint64_t>*>*>::iterator  serviceIter;
-  std::map<std::string, std::map<std::string, uint64_t>*>::iterator                          subServiceIter;
-  std::map<std::string, uint64_t>::iterator                                                  metricIter;
-
-  for (serviceIter = metrics.begin(); serviceIter != metrics.end(); ++serviceIter)
+  for (int pageNo = 0; pageNo < METRICS_PAGES; pageNo++)
   {
-    std::map<std::string, std::map<std::string, uint64_t>*>* servMap  = serviceIter->second;
-
-    for (subServiceIter = servMap->begin(); subServiceIter != servMap->end(); ++subServiceIter)
+    if (totals[pageNo] == NULL)
     {
-      std::map<std::string, uint64_t>* metricMap  = subServiceIter->second;
+      continue;
+    }
 
-      for (metricIter = metricMap->begin(); metricIter != metricMap->end(); ++metricIter)
+    if (baseline[pageNo] == NULL)
+    {
+      baseline[pageNo] = (uint64_t*) calloc(METRICS_PAGE_SIZE, sizeof(uint64_t));
+      if (baseline[pageNo] == NULL)
       {
-        metricIter->second = 0;
+        LM_E(("Runtime Error (out of memory allocating a page of metrics baseline)"));
+        continue;
       }
     }
+
+    memcpy(baseline[pageNo], totals[pageNo], METRICS_PAGE_SIZE * sizeof(uint64_t));
   }
 }
 
@@ -383,18 +668,55 @@ static std::string metricsRender(std::map<std::string, uint64_t>* metricsMap)
 /* ****************************************************************************
 *
 * MetricsManager::_toJson -
+*
+* The totals (minus the baseline of the last reset) are first gathered in a 'triple-map', like the one
+* the metrics used to be kept in, so that the output keeps its order (alphabetical service, sub-service
+* and metric names) and format.
+* Only counters that differ from zero are added, as the rendering skips zeros anyway.
+*
+* NOTE
+*   The semaphore must be taken by the caller
 */
-std::string MetricsManager::_toJson(void)
+std::string MetricsManager::_toJson(uint64_t** totals)
 {
+  typedef std::map<std::string, uint64_t>         MetricMap;
+  typedef std::map<std::string, MetricMap>        SubServiceMap;
+  typedef std::map<std::string, SubServiceMap>    ServiceMap;
+
+  ServiceMap  metrics;
+  int         keys = keyV.size();
+
+  for (int keyId = 0; keyId < keys; keyId++)
+  {
+    int        pageNo = keyId / METRICS_KEYS_PER_PAGE;
+    uint64_t*  page   = totals[pageNo];
+
+    if (page == NULL)
+    {
+      continue;
+    }
+
+    for (int metricId = 0; metricId < metricCount; metricId++)
+    {
+      int       ix    = (keyId % METRICS_KEYS_PER_PAGE) * METRICS_MAX + metricId;
+      uint64_t  value = page[ix] - ((baseline[pageNo] != NULL)? baseline[pageNo][ix] : 0);
+
+      if (value != 0)
+      {
+        metrics[keyV[keyId]->service][keyV[keyId]->subService][metricNameV[metricId]] = value;
+      }
+    }
+  }
+
   //
   // Three iterators needed to iterate over the 'triple-map' metrics:
   //   serviceIter      to iterate over all services
   //   subServiceIter   to iterate over all sub-services of a service
   //   metricIter       to iterate over all metrics of a sub-service
   //
-  std::map<std::string, std::map<std::string, std::map<std::string, uint64_t>*>*>::iterator  serviceIter;
-  std::map<std::string, std::map<std::string, uint64_t>*>::iterator                          subServiceIter;
-  std::map<std::string, uint64_t>::iterator                                                  metricIter;
+  ServiceMap::iterator                                                                       serviceIter;
+  SubServiceMap::iterator                                                                    subServiceIter;
+  MetricMap::iterator                                                                        metricIter;
   JsonHelper                                                                                 top;
   JsonHelper                                                                                 services;
   std::map<std::string, uint64_t>                                                            sum;
@@ -405,14 +727,14 @@ std::string MetricsManager::_toJson(void)
     JsonHelper                                                subServiceTop;
     JsonHelper                                                jhSubService;
     std::string                                               service        = serviceIter->first;
-    std::map<std::string, std::map<std::string, uint64_t>*>*  servMap        = serviceIter->second;
+    SubServiceMap*                                            servMap        = &serviceIter->second;
     std::map<std::string, uint64_t>                           serviceSum;
 
     for (subServiceIter = servMap->begin(); subServiceIter != servMap->end(); ++subServiceIter)
     {
       JsonHelper                        jhMetrics;
       std::string                       subService           = subServiceIter->first;
-      std::map<std::string, uint64_t>*  metricMap            = subServiceIter->second;
+      std::map<std::string, uint64_t>*  metricMap            = &subServiceIter->second;
 
       for (metricIter = metricMap->begin(); metricIter != metricMap->end(); ++metricIter)
       {
@@ -560,28 +882,27 @@ void MetricsManager::release(void)
   semTake();
 
   //
-  // Two iterators needed to iterate over metrics, clearing all maps:
-  //   serviceIter      to iterate over all services
-  //   subServiceIter   to iterate over all sub-services of a service
+  // The shards stay linked to their threads, and a thread may be inside add(), past the check of 'on',
+  // so the shards and their counters are left alone (still reachable via shardList).
+  // Only the interned keys and the baseline are freed.
   //
-  std::map<std::string, std::map<std::string, std::map<std::string, uint64_t>*>*>::iterator  serviceIter;
-  std::map<std::string, std::map<std::string, uint64_t>*>::iterator                          subServiceIter;
+  on = false;
 
-  for (serviceIter = metrics.begin(); serviceIter != metrics.end(); ++serviceIter)
+  for (unsigned int ix = 0; ix < keyV.size(); ix++)
   {
-    std::map<std::string, std::map<std::string, uint64_t>*>* servMap  = serviceIter->second;
+    delete keyV[ix];
+  }
+  keyV.clear();
+  keyMap.clear();
 
-    for (subServiceIter = servMap->begin(); subServiceIter != servMap->end(); ++subServiceIter)
+  for (int pageNo = 0; pageNo < METRICS_PAGES; pageNo++)
+  {
+    if (baseline[pageNo] != NULL)
     {
-      std::map<std::string, uint64_t>*  metricMap  = subServiceIter->second;
-
-      metricMap->clear();
-      delete metricMap;
+      free(baseline[pageNo]);
+      baseline[pageNo] = NULL;
     }
-    servMap->clear();
-    delete servMap;
   }
-  metrics.clear();
 
   semGive();
 }
@@ -599,8 +920,15 @@ void MetricsManager::reset(void)
     return;
   }
 
+  uint64_t*  totals[METRICS_PAGES];
+
   semTake();
-  _reset();
+
+  int pages = totalsGet(totals);
+
+  _reset(totals);
+  totalsRelease(totals, pages);
+
   semGive();
 }
 
@@ -617,15 +945,20 @@ std::string MetricsManager::toJson(bool doReset)
     return "";
   }
 
+  uint64_t*  totals[METRICS_PAGES];
+
   semTake();
 
-  std::string  s = _toJson();
+  int          pages = totalsGet(totals);
+  std::string  s     = _toJson(totals);
 
   if (doReset)
   {
-    _reset();
+    _reset(totals);
   }
 
+  totalsRelease(totals, pages);
+
   semGive();
 
   return s;
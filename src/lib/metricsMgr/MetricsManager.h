@@ -27,9 +27,11 @@
 */
 #include <stdint.h>   // int64_t et al
 #include <semaphore.h>
+#include <pthread.h>
 
 #include <utility>
 #include <string>
+#include <vector>
 #include <map>
 
 
@@ -101,6 +103,54 @@
 
 
 
+/* ****************************************************************************
+*
+* Capacity of the metrics store
+*
+* METRICS_MAX             max number of different metrics (names)
+* METRICS_KEYS_PER_PAGE   number of service/sub-service keys in each page of counters
+* METRICS_PAGES           max number of pages - METRICS_PAGES * METRICS_KEYS_PER_PAGE keys in total
+*/
+#define METRICS_MAX               32
+#define METRICS_KEYS_PER_PAGE     256
+#define METRICS_PAGES             256
+
+
+
+/* ****************************************************************************
+*
+* MetricsKey - an interned service/sub-service pair
+*/
+typedef struct MetricsKey
+{
+  std::string  service;
+  std::string  subService;
+} MetricsKey;
+
+
+
+/* ****************************************************************************
+*
+* MetricsShard - the counters of one thread
+*
+* Only the owning thread writes the counters of a shard, so add() needs no lock.
+* The counters of key 'keyId' and metric 'metricId' are found at
+*   page[keyId / METRICS_KEYS_PER_PAGE][(keyId % METRICS_KEYS_PER_PAGE) * METRICS_MAX + metricId]
+* and the pages are allocated the first time the thread uses a key in them.
+*
+* When a thread ends, its shard is kept (its counters are still part of the totals) and it is
+* reused by the next thread that needs a shard (see shardRelease in MetricsManager.cpp).
+*/
+typedef struct MetricsShard
+{
+  uint64_t*                    page[METRICS_PAGES];
+  std::map<std::string, int>   keyCache;   // "service\0service-path" as received => key id (-1: not valid for metrics)
+  bool                         inUse;
+  struct MetricsShard*         next;
+} MetricsShard;
+
+
+
 /* ****************************************************************************
 *
 * MetricsManager -
@@ -117,23 +167,38 @@
 *     for metrics
 * 11. Try to come up with better solution for metrics for requests using invalid service-path / tenant?
 *
+* The counters are sharded per thread (see MetricsShard) and aggregated only in toJson().
+* The semaphore protects the shard list, the interned keys and the baseline of the last reset,
+* so it is taken only by toJson(), reset() and the first time a thread sees a new key or a new metric.
 */
 class MetricsManager
 {
  private:
-  std::map<std::string, std::map<std::string, std::map<std::string, uint64_t>*>*>  metrics;
-  bool            on;
-  sem_t           sem;
-  bool            semWaitStatistics;
-  int64_t         semWaitTime;        // measured in microseconds
+  bool                         on;
+  sem_t                        sem;
+  bool                         semWaitStatistics;
+  int64_t                      semWaitTime;        // measured in microseconds
+
+  pthread_key_t                shardKey;
+  MetricsShard*                shardList;
+  std::vector<MetricsKey*>     keyV;
+  std::map<std::string, int>   keyMap;             // "service\0subService" => key id
+  const char*                  metricNameV[METRICS_MAX];
+  int                          metricCount;
+  uint64_t*                    baseline[METRICS_PAGES];  // totals at the time of the last reset
 
   void            semTake(void);
   void            semGive(void);
-  void            _reset(void);
-  std::string     _toJson(void);
+  void            _reset(uint64_t** totals);
+  std::string     _toJson(uint64_t** totals);
   bool            serviceValid(const char* srv);
   bool            subServiceValid(const std::string& subsrv);
   bool            servicePathForMetrics(const std::string& spath, std::string* subServiceP);
+  MetricsShard*   shardGet(void);
+  int             keyLookup(MetricsShard* shardP, const char* srv, const char* subServ);
+  int             metricLookup(const char* metric);
+  int             totalsGet(uint64_t** totals);
+  void            totalsRelease(uint64_t** totals, int pages);
 
  public:
   MetricsManager();
@@ -47,6 +47,7 @@
 #include "mongoBackend/connectionOperations.h"
 #include "mongoBackend/safeMongo.h"
 #include "mongoBackend/dbConstants.h"
+#include "mongoBackend/mongoRegistrationCache.h"
 #include "mongoBackend/MongoCommonRegister.h"
 
 
@@ -440,6 +441,8 @@ HttpStatusCode processRegisterContext
     return SccOk;
   }
 
+  mongoRegistrationCacheInvalidate(tenantP);
+
   //
   // Send notifications for each one of the subscriptions accumulated by
   // previous addTriggeredSubscriptions() invocations
@@ -73,6 +73,7 @@ extern "C"
 #include "mongoBackend/location.h"
 #include "mongoBackend/dateExpiration.h"
 #include "mongoBackend/compoundValueBson.h"
+#include "mongoBackend/mongoEntityTypeCatalog.h"
 #include "mongoBackend/MongoCommonUpdate.h"
 
 
@@ -1621,19 +1622,8 @@ static bool addTriggeredSubscriptions_noCache
           }
           else
           {
-            std::string errorString;
-
-            if (!trigs->stringFilterSet(stringFilterP, &errorString))
-            {
-              delete stringFilterP;
-              delete bgP;
-
-              LM_E(("Runtime Error (error setting string filter: %s)", errorString.c_str()));
-              releaseMongoConnection(connection);
-              return false;
-            }
-
-            delete stringFilterP;
+            // The filter has been parsed for this triggered subscription only - no need to clone it
+            trigs->stringFilterP = stringFilterP;
           }
         }
 
@@ -1653,19 +1643,8 @@ static bool addTriggeredSubscriptions_noCache
           }
           else
           {
-            std::string errorString;
-
-            if (!trigs->mdStringFilterSet(mdStringFilterP, &errorString))
-            {
-              delete mdStringFilterP;
-              delete bgP;
-
-              LM_E(("Runtime Error (error setting string filter: %s)", errorString.c_str()));
-              releaseMongoConnection(connection);
-              return false;
-            }
-
-            delete mdStringFilterP;
+            // The filter has been parsed for this triggered subscription only - no need to clone it
+            trigs->mdStringFilterP = mdStringFilterP;
           }
         }
       }
@@ -2963,7 +2942,8 @@ static bool createEntity
   const std::vector<std::string>&  servicePathV,
   ApiVersion                       apiVersion,
   const std::string&               fiwareCorrelator,
-  OrionError*                      oeP
+  OrionError*                      oeP,
+  EntityBulkWrite*                 bulkP
 )
 {
   /* Actually we don't know if this is the first entity (thus, the collection is being created) or not. However, we can
@@ -3138,13 +3118,30 @@ static bool createEntity
   }
 
 
-  if (!collectionInsert(tenantP->entities, insertedDoc.obj(), errDetail))
+  if (bulkP != NULL)
+  {
+    EntityBulkWriteItem* itemP = new EntityBulkWriteItem();
+
+    itemP->insert     = true;
+    itemP->doc        = insertedDoc.obj();
+    itemP->cerP       = NULL;
+    itemP->notifyCerP = NULL;
+
+    bulkP->items.push_back(itemP);
+    return true;
+  }
+
+  BSONObj insertedDocObj = insertedDoc.obj();
+
+  if (!collectionInsert(tenantP->entities, insertedDocObj, errDetail))
   {
     LM_E(("Internal Error (%s)", errDetail->c_str()));
     oeP->fill(SccReceiverInternalError, *errDetail, "InternalError");
     return false;
   }
 
+  mongoEntityTypeCatalogEntityAdd(tenantP, insertedDocObj);
+
   return true;
 }
 
@@ -3316,7 +3313,8 @@ static void updateEntity
   std::string*                    attributeAlreadyExistsList,
   ApiVersion                      apiVersion,
   const std::string&              fiwareCorrelator,
-  const std::string&              ngsiV2AttrsFormat
+  const std::string&              ngsiV2AttrsFormat,
+  EntityBulkWrite*                bulkP
 )
 {
   // Used to accumulate error response information
@@ -3341,7 +3339,11 @@ static void updateEntity
   /* If the vector of Context Attributes is empty and the operation was DELETE, then delete the entity */
   if ((action == ActionTypeDelete) && (ceP->contextAttributeVector.size() == 0))
   {
-    removeEntity(entityId, entityType, cerP, tenantP, entitySPath, &(responseP->oe));
+    if (removeEntity(entityId, entityType, cerP, tenantP, entitySPath, &(responseP->oe)) == true)
+    {
+      mongoEntityTypeCatalogEntityRemove(tenantP, *bobP);
+    }
+
     responseP->contextElementResponseVector.push_back(cerP);
     return;
   }
@@ -3619,6 +3621,30 @@ static void updateEntity
   // Service Path
   query.append(servicePathString, fillQueryServicePath(servicePathV));
 
+  //
+  // Bulk write: the update is sent to mongo, and the notifications are sent, by entityBulkFlush()
+  //
+  if (bulkP != NULL)
+  {
+    EntityBulkWriteItem* itemP = new EntityBulkWriteItem();
+
+    itemP->insert       = false;
+    itemP->query        = query.obj();
+    itemP->doc          = updatedEntityObj;
+    itemP->prevDoc      = bobP->getOwned();
+    itemP->cerP         = cerP;
+    itemP->subsToNotify = subsToNotify;
+    itemP->notifyCerP   = notifyCerP;
+
+    bulkP->items.push_back(itemP);
+
+    if (cerP->statusCode.code == SccNone)
+      cerP->statusCode.fill(SccOk);
+
+    responseP->contextElementResponseVector.push_back(cerP);
+    return;
+  }
+
   std::string err;
   if (!collectionUpdate(tenantP->entities, query.obj(), updatedEntityObj, false, &err))
   {
@@ -3635,6 +3661,8 @@ static void updateEntity
     return;
   }
 
+  mongoEntityTypeCatalogEntityUpdate(tenantP, *bobP, updatedEntityObj);
+
   /* Send notifications for each one of the ONCHANGE subscriptions accumulated by
    * previous addTriggeredSubscriptions() invocations */
   processSubscriptions(subsToNotify, notifyCerP, &err, tenantP, xauthToken, fiwareCorrelator);
@@ -3791,7 +3819,8 @@ void processContextElement
   const std::string&                   fiwareCorrelator,
   const std::string&                   ngsiV2AttrsFormat,
   ApiVersion                           apiVersion,
-  Ngsiv2Flavour                        ngsiv2Flavour
+  Ngsiv2Flavour                        ngsiv2Flavour,
+  EntityBulkWrite*                     bulkP
 )
 {
   /* Check preconditions */
@@ -3873,69 +3902,94 @@ void processContextElement
     }
   }
 
-  std::string err;
-
-  TIME_STAT_MONGO_READ_WAIT_START();
-  DBClientBase* connection = getMongoConnection();
-
-  if (!collectionQuery(connection, tenantP->entities, query, &cursor, &err))
-  {
-    releaseMongoConnection(connection);
-    TIME_STAT_MONGO_READ_WAIT_STOP();
-    buildGeneralErrorResponse(ceP, NULL, responseP, SccReceiverInternalError, err);
-    responseP->oe.fill(SccReceiverInternalError, err, "InternalServerError");
-
-    return;
-  }
-  TIME_STAT_MONGO_READ_WAIT_STOP();
+  std::string           err;
+  std::vector<BSONObj>  results;
 
   //
-  // Going through the list of found entities.
-  // As ServicePath cannot be modified, inside this loop nothing will be done
-  // about ServicePath (The ServicePath was present in the mongo query to obtain the list)
+  // Bulk write: the entities have already been looked up, by entityBulkPrefetch()
   //
-  // FIXME P6: Once we allow for ServicePath to be modified, this loop must be looked at.
-  //
-
-  std::vector<BSONObj> results;
-  unsigned int         docs = 0;
-
-  while (moreSafe(cursor))
+  if (bulkP != NULL)
   {
-    BSONObj r;
+    std::map<std::string, std::vector<BSONObj> >::iterator it = bulkP->dbEntities.find(enP->id);
 
-    if (!nextSafeOrErrorF(cursor, &r, &err))
+    if (it != bulkP->dbEntities.end())
     {
-      LM_E(("Runtime Error (exception in nextSafe(): %s - query: %s)", err.c_str(), query.toString().c_str()));
-      continue;
+      for (unsigned int ix = 0; ix < it->second.size(); ix++)
+      {
+        BSONObj idField;
+
+        getObjectFieldF(&idField, &it->second[ix], "_id");
+
+        if ((enP->type == "") || (enP->type == getStringFieldF(&idField, ENT_ENTITY_TYPE)))
+        {
+          results.push_back(it->second[ix]);
+        }
+      }
     }
+  }
+  else
+  {
+    TIME_STAT_MONGO_READ_WAIT_START();
+    DBClientBase* connection = getMongoConnection();
 
-    docs++;
+    if (!collectionQuery(connection, tenantP->entities, query, &cursor, &err))
+    {
+      releaseMongoConnection(connection);
+      TIME_STAT_MONGO_READ_WAIT_STOP();
+      buildGeneralErrorResponse(ceP, NULL, responseP, SccReceiverInternalError, err);
+      responseP->oe.fill(SccReceiverInternalError, err, "InternalServerError");
 
-    BSONElement idField = getFieldF(&r, "_id");
+      return;
+    }
+    TIME_STAT_MONGO_READ_WAIT_STOP();
 
     //
-    // BSONElement::eoo returns true if 'not found', i.e. the field "_id" doesn't exist in 'sub'
+    // Going through the list of found entities.
+    // As ServicePath cannot be modified, inside this loop nothing will be done
+    // about ServicePath (The ServicePath was present in the mongo query to obtain the list)
     //
-    // Now, if 'getFieldF(r, "_id")' is not found, if we continue, calling embeddedObject() on it, then we get
-    // an exception and the broker crashes.
+    // FIXME P6: Once we allow for ServicePath to be modified, this loop must be looked at.
     //
-    if (idField.eoo() == true)
+
+    unsigned int docs = 0;
+
+    while (moreSafe(cursor))
     {
-      std::string details = std::string("error retrieving _id field in doc: '") + r.toString() + "'";
-      alarmMgr.dbError(details);
-      continue;
+      BSONObj r;
+
+      if (!nextSafeOrErrorF(cursor, &r, &err))
+      {
+        LM_E(("Runtime Error (exception in nextSafe(): %s - query: %s)", err.c_str(), query.toString().c_str()));
+        continue;
+      }
+
+      docs++;
+
+      BSONElement idField = getFieldF(&r, "_id");
+
+      //
+      // BSONElement::eoo returns true if 'not found', i.e. the field "_id" doesn't exist in 'sub'
+      //
+      // Now, if 'getFieldF(r, "_id")' is not found, if we continue, calling embeddedObject() on it, then we get
+      // an exception and the broker crashes.
+      //
+      if (idField.eoo() == true)
+      {
+        std::string details = std::string("error retrieving _id field in doc: '") + r.toString() + "'";
+        alarmMgr.dbError(details);
+        continue;
+      }
+
+      //
+      // We need to use getOwned() here, otherwise we have empirically found that bad things may happen with long BSONObjs
+      // (see http://stackoverflow.com/questions/36917731/context-broker-crashing-with-certain-update-queries)
+      //
+      results.push_back(r.getOwned());
     }
 
-    //
-    // We need to use getOwned() here, otherwise we have empirically found that bad things may happen with long BSONObjs
-    // (see http://stackoverflow.com/questions/36917731/context-broker-crashing-with-certain-update-queries)
-    //
-    results.push_back(r.getOwned());
+    releaseMongoConnection(connection);
   }
 
-  releaseMongoConnection(connection);
-
   // Used to accumulate error response information, checked at the end
   bool         attributeAlreadyExistsError = false;
   std::string  attributeAlreadyExistsList  = "[ ";
@@ -3955,7 +4009,8 @@ void processContextElement
                  &attributeAlreadyExistsList,
                  apiVersion,
                  fiwareCorrelator,
-                 ngsiV2AttrsFormat);
+                 ngsiV2AttrsFormat,
+                 bulkP);
   }
 
   /*
@@ -4027,7 +4082,7 @@ void processContextElement
       std::string  errReason;
       std::string  errDetail;
 
-      if (!createEntity(enP, ceP->contextAttributeVector, orionldState.requestTime, &errDetail, tenantP, servicePathV, apiVersion, fiwareCorrelator, &(responseP->oe)))
+      if (!createEntity(enP, ceP->contextAttributeVector, orionldState.requestTime, &errDetail, tenantP, servicePathV, apiVersion, fiwareCorrelator, &(responseP->oe), bulkP))
       {
         LM_E(("Internal Error (createEntity failed)"));
         cerP->statusCode.fill(SccInvalidParameter, errDetail);
@@ -4058,6 +4113,13 @@ void processContextElement
           cerP->statusCode.fill(SccReceiverInternalError, err);
           responseP->oe.fill(SccReceiverInternalError, err, "InternalError");
 
+          if (bulkP != NULL)
+          {
+            // createEntity() queued the insert - the entity is reported as failed, so it must not be written
+            delete bulkP->items.back();
+            bulkP->items.pop_back();
+          }
+
           responseP->contextElementResponseVector.push_back(cerP);
           return;  // Error already in responseP
         }
@@ -4083,11 +4145,24 @@ void processContextElement
         }
 
         notifyCerP->contextElement.entityId.servicePath = servicePathV.size() > 0? servicePathV[0] : "";
-        processSubscriptions(subsToNotify, notifyCerP, &errReason, tenantP, xauthToken, fiwareCorrelator);
 
-        notifyCerP->release();
-        delete notifyCerP;
-        releaseTriggeredSubscriptions(&subsToNotify);
+        if (bulkP != NULL)
+        {
+          // The notifications are sent by entityBulkFlush(), once the entity has been inserted
+          EntityBulkWriteItem* itemP = bulkP->items.back();
+
+          itemP->cerP         = cerP;
+          itemP->subsToNotify = subsToNotify;
+          itemP->notifyCerP   = notifyCerP;
+        }
+        else
+        {
+          processSubscriptions(subsToNotify, notifyCerP, &errReason, tenantP, xauthToken, fiwareCorrelator);
+
+          notifyCerP->release();
+          delete notifyCerP;
+          releaseTriggeredSubscriptions(&subsToNotify);
+        }
       }
 
       responseP->contextElementResponseVector.push_back(cerP);
@@ -4103,3 +4178,376 @@ void processContextElement
 
   // Response in responseP
 }
+
+
+
+/* ****************************************************************************
+*
+* entityBulkWriteApplies -
+*
+* Only NGSI-LD batches of more than one entity are written in bulk (no forwarding to context providers
+* in NGSI-LD), and only if no entity id is repeated in the batch - a repeated entity would have to see
+* the result of the previous write, which is not in mongo until the bulk is flushed.
+*/
+bool entityBulkWriteApplies(UpdateContextRequest* requestP)
+{
+  if (orionldState.apiVersion != NGSI_LD_V1)
+  {
+    return false;
+  }
+
+  if (requestP->contextElementVector.size() < 2)
+  {
+    return false;
+  }
+
+  if ((requestP->updateActionType != ActionTypeAppend)       &&
+      (requestP->updateActionType != ActionTypeAppendStrict) &&
+      (requestP->updateActionType != ActionTypeUpdate)       &&
+      (requestP->updateActionType != ActionTypeReplace))
+  {
+    return false;
+  }
+
+  std::set<std::string> entityIds;
+
+  for (unsigned int ix = 0; ix < requestP->contextElementVector.size(); ++ix)
+  {
+    EntityId* enP = &requestP->contextElementVector[ix]->entityId;
+
+    if ((enP->isPattern == "true") || (entityIds.insert(enP->id).second == false))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityBulkPrefetch -
+*/
+bool entityBulkPrefetch
+(
+  EntityBulkWrite*                 bulkP,
+  UpdateContextRequest*            requestP,
+  OrionldTenant*                   tenantP,
+  const std::vector<std::string>&  servicePathV
+)
+{
+  BSONArrayBuilder  idArray;
+  BSONObjBuilder    bob;
+
+  for (unsigned int ix = 0; ix < requestP->contextElementVector.size(); ++ix)
+  {
+    idArray.append(requestP->contextElementVector[ix]->entityId.id);
+  }
+
+  bob.append("_id." ENT_ENTITY_ID, BSON("$in" << idArray.arr()));
+  bob.append("_id." ENT_SERVICE_PATH, fillQueryServicePath(servicePathV));
+
+  BSONObj                        query = bob.obj();
+  std::auto_ptr<DBClientCursor>  cursor;
+  std::string                    err;
+
+  TIME_STAT_MONGO_READ_WAIT_START();
+  DBClientBase* connection = getMongoConnection();
+
+  if (!collectionQuery(connection, tenantP->entities, query, &cursor, &err))
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_READ_WAIT_STOP();
+    LM_E(("Database Error (%s)", err.c_str()));
+    return false;
+  }
+  TIME_STAT_MONGO_READ_WAIT_STOP();
+
+  while (moreSafe(cursor))
+  {
+    BSONObj r;
+
+    if (!nextSafeOrErrorF(cursor, &r, &err))
+    {
+      LM_E(("Runtime Error (exception in nextSafe(): %s - query: %s)", err.c_str(), query.toString().c_str()));
+      continue;
+    }
+
+    BSONObj idField;
+    if (getObjectFieldF(&idField, &r, "_id") == false)
+    {
+      std::string details = std::string("error retrieving _id field in doc: '") + r.toString() + "'";
+      alarmMgr.dbError(details);
+      continue;
+    }
+
+    bulkP->dbEntities[getStringFieldF(&idField, ENT_ENTITY_ID)].push_back(r.getOwned());
+  }
+
+  releaseMongoConnection(connection);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityBulkFlush -
+*
+* The bulk operation is unordered - a failing write doesn't stop the others.
+* The context element response of a failed write is flagged with the error of mongo, and its notifications are not sent.
+*
+* If the writes have already been done (bulkP->written, see entityPatchWrite), only the notifications are sent.
+*/
+void entityBulkFlush
+(
+  EntityBulkWrite*        bulkP,
+  UpdateContextResponse*  responseP,
+  OrionldTenant*          tenantP,
+  const std::string&      xauthToken,
+  const std::string&      fiwareCorrelator
+)
+{
+  std::vector<std::string>  errorV(bulkP->items.size());
+  std::string               bulkError;
+
+  if ((bulkP->items.size() > 0) && (bulkP->written == false))
+  {
+    TIME_STAT_MONGO_WRITE_WAIT_START();
+    DBClientBase* connection = getMongoConnection();
+
+    if (connection == NULL)
+    {
+      TIME_STAT_MONGO_WRITE_WAIT_STOP();
+      LM_E(("Fatal Error (null DB connection)"));
+      bulkError = "null DB connection";
+    }
+    else
+    {
+      mongo::BulkOperationBuilder  bulk = connection->initializeUnorderedBulkOp(tenantP->entities);
+      mongo::WriteResult           writeResult;
+
+      for (unsigned int ix = 0; ix < bulkP->items.size(); ix++)
+      {
+        EntityBulkWriteItem* itemP = bulkP->items[ix];
+
+        if (itemP->insert == true)
+        {
+          bulk.insert(itemP->doc);
+        }
+        else
+        {
+          bulk.find(itemP->query).updateOne(itemP->doc);
+        }
+      }
+
+      LM_T(LmtMongo, ("bulk write of %d entities in collection '%s'", (int) bulkP->items.size(), tenantP->entities));
+
+      try
+      {
+        bulk.execute(&connection->getWriteConcern(), &writeResult);
+      }
+      catch (const std::exception& e)
+      {
+        // Write errors of individual items are reported in writeResult
+        if (writeResult.writeErrors().size() == 0)
+        {
+          bulkError = std::string("Database Error (collection: ") + tenantP->entities + " - bulk write - exception: " + e.what() + ")";
+        }
+      }
+      catch (...)
+      {
+        bulkError = std::string("Database Error (collection: ") + tenantP->entities + " - bulk write - exception: generic)";
+      }
+
+      releaseMongoConnection(connection);
+      TIME_STAT_MONGO_WRITE_WAIT_STOP();
+
+      const std::vector<BSONObj>& writeErrors = writeResult.writeErrors();
+
+      for (unsigned int ix = 0; ix < writeErrors.size(); ix++)
+      {
+        int index = writeErrors[ix].getIntField("index");
+
+        if ((index >= 0) && (index < (int) errorV.size()))
+        {
+          errorV[index] = std::string("Database Error (") + writeErrors[ix].getStringField("errmsg") + ")";
+        }
+      }
+    }
+
+    if (bulkError != "")
+    {
+      alarmMgr.dbError(bulkError);
+    }
+    else
+    {
+      alarmMgr.dbErrorReset();
+    }
+  }
+
+  for (unsigned int ix = 0; ix < bulkP->items.size(); ix++)
+  {
+    EntityBulkWriteItem*  itemP = bulkP->items[ix];
+    const std::string&    err   = (bulkError != "")? bulkError : errorV[ix];
+
+    if (err != "")
+    {
+      LM_E(("Internal Error (%s)", err.c_str()));
+
+      if (itemP->cerP != NULL)
+      {
+        itemP->cerP->statusCode.fill(SccReceiverInternalError, err);
+      }
+
+      responseP->oe.fill(SccReceiverInternalError, err, "InternalServerError");
+    }
+    else
+    {
+      if (itemP->insert == true)
+      {
+        mongoEntityTypeCatalogEntityAdd(tenantP, itemP->doc);
+      }
+      else
+      {
+        mongoEntityTypeCatalogEntityUpdate(tenantP, itemP->prevDoc, itemP->doc);
+      }
+
+      if (itemP->notifyCerP != NULL)
+      {
+        std::string notifyErr;
+
+        processSubscriptions(itemP->subsToNotify, itemP->notifyCerP, &notifyErr, tenantP, xauthToken, fiwareCorrelator);
+      }
+    }
+
+    if (itemP->notifyCerP != NULL)
+    {
+      itemP->notifyCerP->release();
+      delete itemP->notifyCerP;
+    }
+
+    releaseTriggeredSubscriptions(&itemP->subsToNotify);
+    delete itemP;
+  }
+
+  bulkP->items.clear();
+}
+
+
+
+/* ****************************************************************************
+*
+* entityPatchWrite -
+*
+* PATCH of existing attributes of an NGSI-LD entity, with a single findAndModify: the members of each attribute
+* of 'ceP' are $set one by one (so the creation date of the attribute is kept), together with the modification
+* date of the entity, and mongo returns the entity as it was before the update.
+*
+* That pre-image is stored in bulkP->dbEntities, for processContextElement to find the subscriptions to notify
+* exactly as if it had looked the entity up itself - entityBulkFlush then sends the notifications, without writing.
+*
+* Nothing is written unless the entity has all the attributes of 'ceP' and none of them is, or becomes, the
+* geo-location of the entity - false is returned, with an empty 'errP', and the caller takes the usual path.
+*/
+bool entityPatchWrite
+(
+  EntityBulkWrite*                 bulkP,
+  ContextElement*                  ceP,
+  OrionldTenant*                   tenantP,
+  const std::vector<std::string>&  servicePathV,
+  const std::string&               fiwareCorrelator,
+  std::string*                     errP
+)
+{
+  BSONObjBuilder    toSet;
+  BSONObjBuilder    toUnset;
+  BSONArrayBuilder  attrNamesBuilder;
+
+  *errP = "";
+
+  for (unsigned int ix = 0; ix < ceP->contextAttributeVector.size(); ++ix)
+  {
+    ContextAttribute*  caP = ceP->contextAttributeVector[ix];
+    char               effectiveName[512];
+
+    if (caP->type == "GeoProperty")
+    {
+      return false;
+    }
+
+    strncpy(effectiveName, caP->name.c_str(), sizeof(effectiveName) - 1);
+    effectiveName[sizeof(effectiveName) - 1] = 0;
+    dotForEq(effectiveName);
+
+    const std::string  prefix = std::string(ENT_ATTRS) + "." + effectiveName + ".";
+    BSONObjBuilder     valueBuilder;
+    BSONObj            md;
+    BSONArray          mdNames;
+
+    caP->valueBson(valueBuilder, caP->type, false);
+
+    BSONObj value = valueBuilder.obj();
+
+    toSet.append(prefix + ENT_ATTRS_TYPE, caP->type);
+    if (value.hasField(ENT_ATTRS_VALUE))
+    {
+      toSet.appendAs(value.getField(ENT_ATTRS_VALUE), prefix + ENT_ATTRS_VALUE);
+    }
+
+    if (contextAttributeCustomMetadataToBson(&md, &mdNames, caP, false))
+    {
+      toSet.append(prefix + ENT_ATTRS_MD, md);
+    }
+    else
+    {
+      toUnset.append(prefix + ENT_ATTRS_MD, 1);
+    }
+
+    toSet.append(prefix + ENT_ATTRS_MDNAMES, mdNames);
+    toSet.append(prefix + ENT_ATTRS_MODIFICATION_DATE, orionldState.requestTime);
+
+    attrNamesBuilder.append(caP->name);
+  }
+
+  toSet.append(ENT_MODIFICATION_DATE, orionldState.requestTime);
+  toSet.append(ENT_LAST_CORRELATOR, fiwareCorrelator);
+
+  BSONObjBuilder  update;
+  BSONObj         toUnsetObj = toUnset.obj();
+
+  update.append("$set", toSet.obj());
+  if (toUnsetObj.nFields() > 0)
+  {
+    update.append("$unset", toUnsetObj);
+  }
+
+  BSONArray       attrNames = attrNamesBuilder.arr();
+  BSONObjBuilder  query;
+
+  query.append("_id." ENT_ENTITY_ID, ceP->entityId.id);
+  query.append("_id." ENT_SERVICE_PATH, fillQueryServicePath(servicePathV));
+  query.append(ENT_ATTRNAMES, BSON("$all" << attrNames));
+  query.append(ENT_LOCATION "." ENT_LOCATION_ATTRNAME, BSON("$nin" << attrNames));
+
+  BSONObj prevDoc;
+
+  if (collectionFindAndModify(tenantP->entities, query.obj(), update.obj(), &prevDoc, errP) == false)
+  {
+    return false;
+  }
+
+  if (prevDoc.isEmpty())
+  {
+    LM_T(LmtMongo, ("PATCH of entity '%s': no single-operation update possible", ceP->entityId.id.c_str()));
+    return false;
+  }
+
+  bulkP->dbEntities[ceP->entityId.id].push_back(prevDoc);
+  bulkP->written = true;
+
+  return true;
+}
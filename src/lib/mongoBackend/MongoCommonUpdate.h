@@ -33,7 +33,98 @@
 
 #include "orionld/types/OrionldTenant.h"                           // OrionldTenant
 #include "orionTypes/UpdateActionType.h"
+#include "ngsi10/UpdateContextRequest.h"
 #include "ngsi10/UpdateContextResponse.h"
+#include "mongoBackend/TriggeredSubscription.h"
+
+
+
+/* ****************************************************************************
+*
+* EntityBulkWriteItem - one write of an EntityBulkWrite
+*
+* The notifications of the item are sent once the write has succeeded.
+*/
+typedef struct EntityBulkWriteItem
+{
+  bool                                           insert;          // insert of 'doc' or update of 'query' with 'doc'
+  mongo::BSONObj                                 query;
+  mongo::BSONObj                                 doc;
+  mongo::BSONObj                                 prevDoc;         // update: the entity before the update (for the entity type catalog)
+  ContextElementResponse*                        cerP;            // response item, flagged if the write fails
+  std::map<std::string, TriggeredSubscription*>  subsToNotify;
+  ContextElementResponse*                        notifyCerP;
+} EntityBulkWriteItem;
+
+
+
+/* ****************************************************************************
+*
+* EntityBulkWrite - the database writes of a batch of context elements
+*
+* The entities of the batch are looked up with a single query (entityBulkPrefetch) and
+* the inserts/updates are accumulated and sent to mongo in a single unordered bulk
+* operation (entityBulkFlush), instead of one query and one write per entity.
+*/
+typedef struct EntityBulkWrite
+{
+  std::map<std::string, std::vector<mongo::BSONObj> >  dbEntities;  // Existing entities, per entity id
+  std::vector<EntityBulkWriteItem*>                    items;
+  bool                                                 written;     // The writes are already done (entityPatchWrite)
+} EntityBulkWrite;
+
+
+
+/* ****************************************************************************
+*
+* entityBulkWriteApplies - can the context elements of the request be written in bulk?
+*/
+extern bool entityBulkWriteApplies(UpdateContextRequest* requestP);
+
+
+
+/* ****************************************************************************
+*
+* entityBulkPrefetch - lookup all the entities of the request with a single query
+*/
+extern bool entityBulkPrefetch
+(
+  EntityBulkWrite*                 bulkP,
+  UpdateContextRequest*            requestP,
+  OrionldTenant*                   tenantP,
+  const std::vector<std::string>&  servicePathV
+);
+
+
+
+/* ****************************************************************************
+*
+* entityBulkFlush - send the accumulated writes to mongo and the notifications of the successful ones
+*/
+extern void entityBulkFlush
+(
+  EntityBulkWrite*        bulkP,
+  UpdateContextResponse*  responseP,
+  OrionldTenant*          tenantP,
+  const std::string&      xauthToken,
+  const std::string&      fiwareCorrelator
+);
+
+
+
+/* ****************************************************************************
+*
+* entityPatchWrite - PATCH of existing attributes of an NGSI-LD entity in a single database operation
+*/
+extern bool entityPatchWrite
+(
+  EntityBulkWrite*                 bulkP,
+  ContextElement*                  ceP,
+  OrionldTenant*                   tenantP,
+  const std::vector<std::string>&  servicePathV,
+  const std::string&               fiwareCorrelator,
+  std::string*                     errP
+);
 
 
 
@@ -53,7 +144,8 @@ extern void processContextElement
   const std::string&                   fiwareCorrelator,
   const std::string&                   ngsiV2AttrsFormat,
   ApiVersion                           apiVersion       = V1,
-  Ngsiv2Flavour                        ngsiV2Flavour    = NGSIV2_NO_FLAVOUR
+  Ngsiv2Flavour                        ngsiV2Flavour    = NGSIV2_NO_FLAVOUR,
+  EntityBulkWrite*                     bulkP            = NULL
 );
 
 #endif  // SRC_LIB_MONGOBACKEND_MONGOCOMMONUPDATE_H_
@@ -491,6 +491,82 @@ bool collectionUpdate
 
 
 
+/* ****************************************************************************
+*
+* collectionFindAndModify -
+*
+* Update of the first document matching 'q', returning the document as it was before the update
+* in 'prevDocP' - an empty BSONObj if no document matched (and nothing was updated).
+*/
+bool collectionFindAndModify
+(
+  const char*         col,
+  const BSONObj&      q,
+  const BSONObj&      doc,
+  BSONObj*            prevDocP,
+  std::string*        err
+)
+{
+  TIME_STAT_MONGO_WRITE_WAIT_START();
+  DBClientBase* connection = getMongoConnection();
+
+  if (connection == NULL)
+  {
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+
+    LM_E(("Fatal Error (null DB connection)"));
+    *err = "null DB connection";
+
+    return false;
+  }
+
+  LM_T(LmtMongo, ("findAndModify() in '%s' collection: query='%s' doc='%s'",
+                  col,
+                  q.toString().c_str(),
+                  doc.toString().c_str()));
+
+  try
+  {
+    *prevDocP = connection->findAndModify(col, q, doc, false, false).getOwned();
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+  }
+  catch (const std::exception& e)
+  {
+    LM_E(("Database Error: %s", e.what()));
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+
+    std::string msg = std::string("collection: ") + col +
+      " - findAndModify(): <" + q.toString() + "," + doc.toString() + ">" +
+      " - exception: " + e.what();
+
+    *err = "Database Error (" + msg + ")";
+    alarmMgr.dbError(msg);
+
+    return false;
+  }
+  catch (...)
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+
+    std::string msg = std::string("collection: ") + col +
+      " - findAndModify(): <" + q.toString() + "," + doc.toString() + ">" +
+      " - exception: generic";
+
+    *err = "Database Error (" + msg + ")";
+    alarmMgr.dbError(msg);
+
+    return false;
+  }
+  alarmMgr.dbErrorReset();
+
+  return true;
+}
+
+
+
 /* ****************************************************************************
 *
 * collectionRemove -
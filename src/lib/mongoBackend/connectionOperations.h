@@ -120,6 +120,21 @@ extern bool collectionUpdate
 
 
 
+/* ****************************************************************************
+*
+* collectionFindAndModify -
+*/
+extern bool collectionFindAndModify
+(
+  const char*            col,
+  const mongo::BSONObj&  q,
+  const mongo::BSONObj&  doc,
+  mongo::BSONObj*        prevDocP,
+  std::string*           err
+);
+
+
+
 /* ****************************************************************************
 *
 * collectionRemove -
@@ -125,6 +125,7 @@
 #define CSUB_BLACKLIST               "blacklist"
 #define CSUB_LASTFAILURE             "lastFailure"
 #define CSUB_LASTSUCCESS             "lastSuccess"
+#define CSUB_MODIFIEDAT              "modifiedAt"
 
 #ifdef ORIONLD
 #define CSUB_LDCONTEXT               "ldContext"
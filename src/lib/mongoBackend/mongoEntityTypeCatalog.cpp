@@ -0,0 +1,878 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdint.h>                                              // int64_t, uint64_t
+#include <string.h>                                              // strncmp
+#include <pthread.h>                                             // pthread_mutex_t
+
+#include <string>
+#include <map>
+
+#include "mongo/client/dbclient.h"                               // MongoDB C++ Client Legacy Driver
+
+extern "C"
+{
+#include "kalloc/kaStrdup.h"                                     // kaStrdup
+#include "kjson/KjNode.h"                                        // KjNode
+#include "kjson/kjBuilder.h"                                     // kjArray, kjObject, kjString, kjChildAdd
+#include "kjson/kjLookup.h"                                      // kjLookup
+}
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/common/orionldState.h"                         // orionldState
+#include "orionld/types/OrionldTenant.h"                         // OrionldTenant
+#include "orionld/kjTree/kjEntityIdLookupInEntityArray.h"        // kjEntityIdLookupInEntityArray
+
+#include "mongoBackend/dbConstants.h"                            // ENT_*
+#include "mongoBackend/MongoGlobal.h"                            // getMongoConnection, releaseMongoConnection
+#include "mongoBackend/mongoEntityTypeCatalog.h"                 // Own interface
+
+
+
+/* ****************************************************************************
+*
+* EntityAttrs - attribute name (with dots) => attribute type, of one entity
+*/
+typedef std::map<std::string, std::string> EntityAttrs;
+
+
+
+/* ****************************************************************************
+*
+* AttrTypeCount - attribute type => number of entities having the attribute with that type
+*/
+typedef std::map<std::string, int64_t> AttrTypeCount;
+
+
+
+/* ****************************************************************************
+*
+* EntityTypeInfo - the catalog item of one entity type
+*
+* 'changes' is incremented by every update of the item. A recount of the type, done
+* without the catalog semaphore, is only stored if no update came in meanwhile.
+*/
+typedef struct EntityTypeInfo
+{
+  int64_t                               entities;
+  std::map<std::string, AttrTypeCount>  attrs;
+  bool                                  attrsStale;   // 'attrs' is not exact - recount before use
+  uint64_t                              changes;
+
+  EntityTypeInfo(): entities(0), attrsStale(false), changes(0) {}
+} EntityTypeInfo;
+
+typedef std::map<std::string, EntityTypeInfo> TypeCatalog;
+
+
+
+/* ****************************************************************************
+*
+* TenantTypeCatalog - the entity type catalog of a tenant
+*/
+typedef struct TenantTypeCatalog
+{
+  bool         valid;      // false until the catalog has been loaded from the database
+  uint64_t     changes;    // entity writes seen - a load is only stored if no write came in meanwhile
+  TypeCatalog  types;
+
+  TenantTypeCatalog(): valid(false), changes(0) {}
+} TenantTypeCatalog;
+
+
+
+/* ****************************************************************************
+*
+* Module variables -
+*/
+static bool                                          catalogOn    = false;
+static pthread_mutex_t                               catalogMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<OrionldTenant*, TenantTypeCatalog*>  catalogMap;
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogInit -
+*/
+void mongoEntityTypeCatalogInit(bool on)
+{
+  catalogOn = on;
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogActive -
+*/
+bool mongoEntityTypeCatalogActive(void)
+{
+  return catalogOn;
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogRelease -
+*/
+void mongoEntityTypeCatalogRelease(void)
+{
+  pthread_mutex_lock(&catalogMutex);
+
+  for (std::map<OrionldTenant*, TenantTypeCatalog*>::iterator it = catalogMap.begin(); it != catalogMap.end(); ++it)
+  {
+    delete it->second;
+  }
+  catalogMap.clear();
+
+  pthread_mutex_unlock(&catalogMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantCatalog - lookup/create the catalog of a tenant - catalogMutex must be taken
+*/
+static TenantTypeCatalog* tenantCatalog(OrionldTenant* tenantP)
+{
+  std::map<OrionldTenant*, TenantTypeCatalog*>::iterator it = catalogMap.find(tenantP);
+
+  if (it != catalogMap.end())
+  {
+    return it->second;
+  }
+
+  TenantTypeCatalog* catalogP = new TenantTypeCatalog();
+
+  catalogMap[tenantP] = catalogP;
+  return catalogP;
+}
+
+
+
+/* ****************************************************************************
+*
+* attrNameFromDb - the names of the 'attrs' field of an entity in DB have '=' instead of '.'
+*/
+static std::string attrNameFromDb(const char* dbName)
+{
+  std::string name(dbName);
+
+  for (unsigned int ix = 0; ix < name.size(); ++ix)
+  {
+    if (name[ix] == '=')
+    {
+      name[ix] = '.';
+    }
+  }
+
+  return name;
+}
+
+
+
+/* ****************************************************************************
+*
+* attrsFromBson - extract name and type of the attributes in an 'attrs' object
+*/
+static void attrsFromBson(const mongo::BSONObj& attrs, EntityAttrs* attrsP)
+{
+  mongo::BSONObjIterator it(attrs);
+
+  while (it.more())
+  {
+    mongo::BSONElement attr = it.next();
+
+    if (attr.type() != mongo::Object)
+    {
+      continue;
+    }
+
+    mongo::BSONElement attrType = attr.embeddedObject().getField(ENT_ATTRS_TYPE);
+
+    (*attrsP)[attrNameFromDb(attr.fieldName())] = (attrType.type() == mongo::String)? attrType.valuestr() : "";
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* entityFromBson - type and attributes of an entity in DB
+*
+* Entities without type are not part of the catalog.
+*/
+static bool entityFromBson(const mongo::BSONObj& doc, std::string* typeP, EntityAttrs* attrsP)
+{
+  mongo::BSONElement idField = doc.getField("_id");
+
+  if (idField.type() != mongo::Object)
+  {
+    return false;
+  }
+
+  mongo::BSONElement typeField = idField.embeddedObject().getField(ENT_ENTITY_TYPE);
+
+  if ((typeField.type() != mongo::String) || (typeField.valuestr()[0] == 0))
+  {
+    return false;
+  }
+
+  *typeP = typeField.valuestr();
+
+  if (attrsP != NULL)
+  {
+    mongo::BSONElement attrsField = doc.getField(ENT_ATTRS);
+
+    if (attrsField.type() == mongo::Object)
+    {
+      attrsFromBson(attrsField.embeddedObject(), attrsP);
+    }
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityAdd -
+*/
+static void entityAdd(TypeCatalog* typesP, const std::string& type, const EntityAttrs& attrs)
+{
+  EntityTypeInfo& info = (*typesP)[type];
+
+  info.entities += 1;
+  info.changes  += 1;
+
+  for (EntityAttrs::const_iterator it = attrs.begin(); it != attrs.end(); ++it)
+  {
+    info.attrs[it->first][it->second] += 1;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* entityRemove -
+*
+* When the last entity of a type is removed, the type is removed from the catalog.
+* The attributes of a type with stale attributes may not be there - no problem.
+*/
+static void entityRemove(TypeCatalog* typesP, const std::string& type, const EntityAttrs* attrsP)
+{
+  TypeCatalog::iterator typeIt = typesP->find(type);
+
+  if (typeIt == typesP->end())
+  {
+    return;
+  }
+
+  EntityTypeInfo& info = typeIt->second;
+
+  info.entities -= 1;
+  info.changes  += 1;
+
+  if (info.entities <= 0)
+  {
+    typesP->erase(typeIt);
+    return;
+  }
+
+  if (attrsP == NULL)
+  {
+    info.attrsStale = true;
+    return;
+  }
+
+  for (EntityAttrs::const_iterator it = attrsP->begin(); it != attrsP->end(); ++it)
+  {
+    std::map<std::string, AttrTypeCount>::iterator attrIt = info.attrs.find(it->first);
+
+    if (attrIt == info.attrs.end())
+    {
+      continue;
+    }
+
+    AttrTypeCount::iterator countIt = attrIt->second.find(it->second);
+
+    if (countIt == attrIt->second.end())
+    {
+      continue;
+    }
+
+    if (--countIt->second <= 0)
+    {
+      attrIt->second.erase(countIt);
+
+      if (attrIt->second.size() == 0)
+      {
+        info.attrs.erase(attrIt);
+      }
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* catalogLoad - load the catalog of a tenant (or only of one type) from the database
+*/
+static bool catalogLoad(OrionldTenant* tenantP, const char* type, TypeCatalog* typesP)
+{
+  mongo::BSONObjBuilder  filter;
+  mongo::BSONObjBuilder  fields;
+
+  if (type != NULL)
+  {
+    filter.append("_id." ENT_ENTITY_TYPE, type);
+  }
+
+  fields.append("_id." ENT_ENTITY_TYPE, 1);
+  fields.append(ENT_ATTRS, 1);
+
+  mongo::Query           query(filter.obj());
+  mongo::BSONObj         fieldsToReturn = fields.obj();
+  mongo::DBClientBase*   connectionP    = getMongoConnection();
+  int                    entities       = 0;
+
+  if (connectionP == NULL)
+  {
+    LM_E(("Database Error (null DB connection)"));
+    return false;
+  }
+
+  try
+  {
+    std::auto_ptr<mongo::DBClientCursor> cursorP = connectionP->query(tenantP->entities, query, 0, 0, &fieldsToReturn);
+
+    while (cursorP->more())
+    {
+      mongo::BSONObj  doc = cursorP->nextSafe();
+      std::string     entityType;
+      EntityAttrs     attrs;
+
+      if (entityFromBson(doc, &entityType, &attrs) == true)
+      {
+        entityAdd(typesP, entityType, attrs);
+        ++entities;
+      }
+    }
+  }
+  catch (const std::exception& e)
+  {
+    releaseMongoConnection(connectionP);
+    LM_E(("Database Error (collection: %s - loading the entity type catalog - exception: %s)", tenantP->entities, e.what()));
+    return false;
+  }
+  catch (...)
+  {
+    releaseMongoConnection(connectionP);
+    LM_E(("Database Error (collection: %s - loading the entity type catalog - exception: generic)", tenantP->entities));
+    return false;
+  }
+
+  releaseMongoConnection(connectionP);
+
+  LM_T(LmtMongo, ("entity type catalog of '%s' (type: %s): %d entities", tenantP->entities, (type != NULL)? type : "all", entities));
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* catalogSnapshot - copy the catalog of a tenant (or one type of it)
+*
+* The catalog is loaded from the database if not valid. If entities are written while
+* loading, the loaded catalog can't be trusted and it isn't stored, but it's still good
+* enough for the current request.
+* If 'attrs' is set, the attributes of types with stale attributes are recounted.
+*/
+static bool catalogSnapshot(OrionldTenant* tenantP, const char* type, bool attrs, TypeCatalog* snapshotP)
+{
+  pthread_mutex_lock(&catalogMutex);
+
+  TenantTypeCatalog* catalogP = tenantCatalog(tenantP);
+
+  if (catalogP->valid == false)
+  {
+    uint64_t     changes = catalogP->changes;
+    TypeCatalog  loaded;
+
+    pthread_mutex_unlock(&catalogMutex);
+
+    if (catalogLoad(tenantP, NULL, &loaded) == false)
+    {
+      return false;
+    }
+
+    pthread_mutex_lock(&catalogMutex);
+
+    if ((catalogP->valid == false) && (catalogP->changes == changes))
+    {
+      for (TypeCatalog::iterator it = loaded.begin(); it != loaded.end(); ++it)
+      {
+        it->second.changes = 0;
+      }
+
+      catalogP->types.swap(loaded);
+      catalogP->valid = true;
+    }
+    else if (catalogP->valid == false)
+    {
+      pthread_mutex_unlock(&catalogMutex);
+
+      LM_T(LmtMongo, ("entity type catalog of '%s' modified while loading - not stored", tenantP->entities));
+
+      if (type == NULL)
+      {
+        snapshotP->swap(loaded);
+      }
+      else if (loaded.find(type) != loaded.end())
+      {
+        (*snapshotP)[type] = loaded[type];
+      }
+
+      return true;
+    }
+  }
+
+  //
+  // Copy what's needed - the attributes only if asked for
+  //
+  TypeCatalog::iterator catalogIt  = (type != NULL)? catalogP->types.find(type) : catalogP->types.begin();
+  TypeCatalog::iterator catalogEnd = catalogP->types.end();
+
+  if ((type != NULL) && (catalogIt != catalogEnd))
+  {
+    catalogEnd = catalogIt;
+    ++catalogEnd;
+  }
+
+  for (; catalogIt != catalogEnd; ++catalogIt)
+  {
+    EntityTypeInfo& info = (*snapshotP)[catalogIt->first];
+
+    info.entities = catalogIt->second.entities;
+    info.changes  = catalogIt->second.changes;
+
+    if (attrs == true)
+    {
+      info.attrs      = catalogIt->second.attrs;
+      info.attrsStale = catalogIt->second.attrsStale;
+    }
+  }
+
+  pthread_mutex_unlock(&catalogMutex);
+
+  if (attrs == false)
+  {
+    return true;
+  }
+
+  //
+  // Recount the types whose attributes are stale
+  //
+  for (TypeCatalog::iterator it = snapshotP->begin(); it != snapshotP->end(); ++it)
+  {
+    if (it->second.attrsStale == false)
+    {
+      continue;
+    }
+
+    TypeCatalog recount;
+
+    if (catalogLoad(tenantP, it->first.c_str(), &recount) == false)
+    {
+      return false;
+    }
+
+    EntityTypeInfo  empty;
+    EntityTypeInfo& counted = (recount.size() == 0)? empty : recount.begin()->second;
+
+    pthread_mutex_lock(&catalogMutex);
+
+    TypeCatalog::iterator storedIt = catalogP->types.find(it->first);
+
+    if ((storedIt != catalogP->types.end()) && (storedIt->second.changes == it->second.changes))
+    {
+      if (counted.entities == 0)
+      {
+        catalogP->types.erase(storedIt);
+      }
+      else
+      {
+        storedIt->second.entities   = counted.entities;
+        storedIt->second.attrs      = counted.attrs;
+        storedIt->second.attrsStale = false;
+      }
+    }
+
+    pthread_mutex_unlock(&catalogMutex);
+
+    it->second.entities   = counted.entities;
+    it->second.attrs      = counted.attrs;
+    it->second.attrsStale = false;
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogEntityAdd -
+*/
+void mongoEntityTypeCatalogEntityAdd(OrionldTenant* tenantP, const mongo::BSONObj& doc)
+{
+  if (catalogOn == false)
+  {
+    return;
+  }
+
+  std::string  type;
+  EntityAttrs  attrs;
+
+  if (entityFromBson(doc, &type, &attrs) == false)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&catalogMutex);
+
+  TenantTypeCatalog* catalogP = tenantCatalog(tenantP);
+
+  catalogP->changes += 1;
+
+  if (catalogP->valid == true)
+  {
+    entityAdd(&catalogP->types, type, attrs);
+  }
+
+  pthread_mutex_unlock(&catalogMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogEntityRemove -
+*/
+void mongoEntityTypeCatalogEntityRemove(OrionldTenant* tenantP, const mongo::BSONObj& doc)
+{
+  if (catalogOn == false)
+  {
+    return;
+  }
+
+  std::string  type;
+  EntityAttrs  attrs;
+
+  if (entityFromBson(doc, &type, &attrs) == false)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&catalogMutex);
+
+  TenantTypeCatalog* catalogP = tenantCatalog(tenantP);
+
+  catalogP->changes += 1;
+
+  if (catalogP->valid == true)
+  {
+    entityRemove(&catalogP->types, type, &attrs);
+  }
+
+  pthread_mutex_unlock(&catalogMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogEntityUpdate -
+*
+* The update document is either (ActionTypeReplace):
+*   { $set: { attrs: { A1: {...}, A2: {...} }, ... }, $unset: { ... } }
+* or:
+*   { $set: { attrs.A1: {...}, ... }, $unset: { attrs.A2: 1, ... }, ... }
+*/
+void mongoEntityTypeCatalogEntityUpdate(OrionldTenant* tenantP, const mongo::BSONObj& prevDoc, const mongo::BSONObj& update)
+{
+  if (catalogOn == false)
+  {
+    return;
+  }
+
+  std::string     type;
+  EntityAttrs     prevAttrs;
+  EntityAttrs     attrs;
+  mongo::BSONObj  set   = update.getObjectField("$set");
+  mongo::BSONObj  unset = update.getObjectField("$unset");
+  const int       attrsPrefixLen = sizeof(ENT_ATTRS ".") - 1;
+
+  if (entityFromBson(prevDoc, &type, &prevAttrs) == false)
+  {
+    return;
+  }
+
+  mongo::BSONElement attrsField = set.getField(ENT_ATTRS);
+
+  if (attrsField.type() == mongo::Object)
+  {
+    attrsFromBson(attrsField.embeddedObject(), &attrs);
+  }
+  else
+  {
+    attrs = prevAttrs;
+
+    mongo::BSONObjIterator setIt(set);
+
+    while (setIt.more())
+    {
+      mongo::BSONElement field = setIt.next();
+
+      if ((field.type() == mongo::Object) && (strncmp(field.fieldName(), ENT_ATTRS ".", attrsPrefixLen) == 0))
+      {
+        mongo::BSONElement attrType = field.embeddedObject().getField(ENT_ATTRS_TYPE);
+
+        attrs[attrNameFromDb(&field.fieldName()[attrsPrefixLen])] = (attrType.type() == mongo::String)? attrType.valuestr() : "";
+      }
+    }
+
+    mongo::BSONObjIterator unsetIt(unset);
+
+    while (unsetIt.more())
+    {
+      mongo::BSONElement field = unsetIt.next();
+
+      if (strncmp(field.fieldName(), ENT_ATTRS ".", attrsPrefixLen) == 0)
+      {
+        attrs.erase(attrNameFromDb(&field.fieldName()[attrsPrefixLen]));
+      }
+    }
+  }
+
+  pthread_mutex_lock(&catalogMutex);
+
+  TenantTypeCatalog* catalogP = tenantCatalog(tenantP);
+
+  catalogP->changes += 1;
+
+  if (catalogP->valid == true)
+  {
+    entityRemove(&catalogP->types, type, &prevAttrs);
+    entityAdd(&catalogP->types, type, attrs);
+  }
+
+  pthread_mutex_unlock(&catalogMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogEntityRemoved -
+*/
+void mongoEntityTypeCatalogEntityRemoved(OrionldTenant* tenantP, const char* type)
+{
+  if ((catalogOn == false) || (type == NULL) || (type[0] == 0))
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&catalogMutex);
+
+  TenantTypeCatalog* catalogP = tenantCatalog(tenantP);
+
+  catalogP->changes += 1;
+
+  if (catalogP->valid == true)
+  {
+    entityRemove(&catalogP->types, type, NULL);
+  }
+
+  pthread_mutex_unlock(&catalogMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogEntitiesRemoved -
+*/
+void mongoEntityTypeCatalogEntitiesRemoved(OrionldTenant* tenantP, KjNode* idArray, KjNode* dbEntityArray)
+{
+  if ((catalogOn == false) || (idArray == NULL))
+  {
+    return;
+  }
+
+  for (KjNode* idP = idArray->value.firstChildP; idP != NULL; idP = idP->next)
+  {
+    if (idP->type != KjString)
+    {
+      continue;
+    }
+
+    KjNode* dbEntityP = kjEntityIdLookupInEntityArray(dbEntityArray, idP->value.s);
+    KjNode* typeP     = (dbEntityP != NULL)? kjLookup(dbEntityP, "type") : NULL;
+
+    if ((typeP != NULL) && (typeP->type == KjString))
+    {
+      mongoEntityTypeCatalogEntityRemoved(tenantP, typeP->value.s);
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogAttrsInvalidate -
+*/
+void mongoEntityTypeCatalogAttrsInvalidate(OrionldTenant* tenantP, const char* type)
+{
+  if (catalogOn == false)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&catalogMutex);
+
+  TenantTypeCatalog* catalogP = tenantCatalog(tenantP);
+
+  catalogP->changes += 1;
+
+  for (TypeCatalog::iterator it = catalogP->types.begin(); it != catalogP->types.end(); ++it)
+  {
+    if ((type == NULL) || (it->first == type))
+    {
+      it->second.attrsStale  = true;
+      it->second.changes    += 1;
+    }
+  }
+
+  pthread_mutex_unlock(&catalogMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogTypesGet -
+*/
+KjNode* mongoEntityTypeCatalogTypesGet(OrionldTenant* tenantP, bool details)
+{
+  TypeCatalog snapshot;
+
+  if (catalogSnapshot(tenantP, NULL, details, &snapshot) == false)
+  {
+    return NULL;
+  }
+
+  KjNode* typeArray = kjArray(orionldState.kjsonP, NULL);
+
+  for (TypeCatalog::iterator it = snapshot.begin(); it != snapshot.end(); ++it)
+  {
+    KjNode* entityP = kjObject(orionldState.kjsonP, NULL);
+    KjNode* idP     = kjObject(orionldState.kjsonP, "_id");
+    KjNode* typeP   = kjString(orionldState.kjsonP, ENT_ENTITY_TYPE, kaStrdup(&orionldState.kalloc, it->first.c_str()));
+
+    kjChildAdd(idP, typeP);
+    kjChildAdd(entityP, idP);
+
+    if (details == true)
+    {
+      KjNode* attrNamesP = kjArray(orionldState.kjsonP, ENT_ATTRNAMES);
+
+      for (std::map<std::string, AttrTypeCount>::iterator attrIt = it->second.attrs.begin(); attrIt != it->second.attrs.end(); ++attrIt)
+      {
+        KjNode* attrNameP = kjString(orionldState.kjsonP, NULL, kaStrdup(&orionldState.kalloc, attrIt->first.c_str()));
+        kjChildAdd(attrNamesP, attrNameP);
+      }
+
+      kjChildAdd(entityP, attrNamesP);
+    }
+
+    kjChildAdd(typeArray, entityP);
+  }
+
+  return typeArray;
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogTypeGet -
+*/
+KjNode* mongoEntityTypeCatalogTypeGet(OrionldTenant* tenantP, const char* type, int* entitiesP)
+{
+  TypeCatalog snapshot;
+
+  if (catalogSnapshot(tenantP, type, true, &snapshot) == false)
+  {
+    return NULL;
+  }
+
+  KjNode*               outArray = kjArray(orionldState.kjsonP, NULL);
+  TypeCatalog::iterator typeIt   = snapshot.find(type);
+
+  *entitiesP = 0;
+
+  if (typeIt == snapshot.end())
+  {
+    return outArray;
+  }
+
+  KjNode* attrsP = kjObject(orionldState.kjsonP, NULL);
+
+  for (std::map<std::string, AttrTypeCount>::iterator attrIt = typeIt->second.attrs.begin(); attrIt != typeIt->second.attrs.end(); ++attrIt)
+  {
+    char* attrName = kaStrdup(&orionldState.kalloc, attrIt->first.c_str());
+
+    for (AttrTypeCount::iterator countIt = attrIt->second.begin(); countIt != attrIt->second.end(); ++countIt)
+    {
+      KjNode* attrP = kjString(orionldState.kjsonP, attrName, kaStrdup(&orionldState.kalloc, countIt->first.c_str()));
+      kjChildAdd(attrsP, attrP);
+    }
+  }
+
+  kjChildAdd(outArray, attrsP);
+  *entitiesP = (int) typeIt->second.entities;
+
+  return outArray;
+}
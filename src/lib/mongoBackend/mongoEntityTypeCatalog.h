@@ -0,0 +1,157 @@
+#ifndef SRC_LIB_MONGOBACKEND_MONGOENTITYTYPECATALOG_H_
+#define SRC_LIB_MONGOBACKEND_MONGOENTITYTYPECATALOG_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include "mongo/client/dbclient.h"                               // MongoDB C++ Client Legacy Driver
+
+extern "C"
+{
+#include "kjson/KjNode.h"                                        // KjNode
+}
+
+#include "orionld/types/OrionldTenant.h"                         // OrionldTenant
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogInit - turn the entity type catalog on/off
+*
+* The catalog keeps, per tenant, the number of entities of each entity type and the
+* attribute names (with their attribute types) in use by the entities of each type.
+* It is built from the database the first time it is used for a tenant and from then
+* on it is updated by the entity create/update/delete operations of the broker.
+*/
+extern void mongoEntityTypeCatalogInit(bool on);
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogActive -
+*/
+extern bool mongoEntityTypeCatalogActive(void);
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogRelease -
+*/
+extern void mongoEntityTypeCatalogRelease(void);
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogEntityAdd - an entity (the entire DB document) has been inserted
+*/
+extern void mongoEntityTypeCatalogEntityAdd(OrionldTenant* tenantP, const mongo::BSONObj& doc);
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogEntityRemove - an entity (the entire DB document) has been removed
+*/
+extern void mongoEntityTypeCatalogEntityRemove(OrionldTenant* tenantP, const mongo::BSONObj& doc);
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogEntityUpdate - an entity has been updated
+*
+* 'prevDoc' is the entire DB document before the update and 'update' the update document
+* ($set/$unset of 'attrs' or of 'attrs.X') that was sent to mongo.
+*/
+extern void mongoEntityTypeCatalogEntityUpdate(OrionldTenant* tenantP, const mongo::BSONObj& prevDoc, const mongo::BSONObj& update);
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogEntityRemoved - an entity of type 'type' has been removed
+*
+* For when the attributes of the removed entity aren't known - the attributes of the type
+* are recounted the next time they're needed.
+*/
+extern void mongoEntityTypeCatalogEntityRemoved(OrionldTenant* tenantP, const char* type);
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogEntitiesRemoved - the entities in 'idArray' have been removed
+*
+* The types of the entities are taken from 'dbEntityArray', an array of { "id": "", "type": "" }
+* objects, as given by dbEntityListLookupWithIdTypeCreDate().
+*/
+extern void mongoEntityTypeCatalogEntitiesRemoved(OrionldTenant* tenantP, KjNode* idArray, KjNode* dbEntityArray);
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogAttrsInvalidate - attributes of an entity of type 'type' have been modified
+*
+* type == NULL: the type of the entity is unknown - all types are invalidated.
+*/
+extern void mongoEntityTypeCatalogAttrsInvalidate(OrionldTenant* tenantP, const char* type);
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogTypesGet - all entity types of the tenant
+*
+* The output has the same layout as dbEntitiesGet() for the fields "_id" and "attrNames":
+* [
+*   { "_id": { "type": "T1" }, "attrNames": [ "A1", "A2" ] },
+*   ...
+* ]
+* "attrNames" is only present if 'details' is set.
+*
+* Returns NULL on database error.
+*/
+extern KjNode* mongoEntityTypeCatalogTypesGet(OrionldTenant* tenantP, bool details);
+
+
+
+/* ****************************************************************************
+*
+* mongoEntityTypeCatalogTypeGet - attributes and number of entities of one entity type
+*
+* The output has the same layout as dbEntityTypeGet():
+* [
+*   { "A1": "Property", "A2": "Relationship", ... }
+* ]
+*
+* Returns NULL on database error.
+*/
+extern KjNode* mongoEntityTypeCatalogTypeGet(OrionldTenant* tenantP, const char* type, int* entitiesP);
+
+#endif  // SRC_LIB_MONGOBACKEND_MONGOENTITYTYPECATALOG_H_
@@ -0,0 +1,694 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdint.h>                                              // uint64_t
+#include <unistd.h>                                              // sleep
+#include <pthread.h>                                             // pthread_mutex_t, pthread_create
+
+#include <string>
+#include <set>
+#include <map>
+#include <vector>
+
+#include "mongo/client/dbclient.h"                               // MongoDB C++ Client Legacy Driver
+
+extern "C"
+{
+#include "kjson/KjNode.h"                                        // KjNode
+#include "kjson/kjBuilder.h"                                     // kjArray, kjChildAdd
+}
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/common/orionldState.h"                         // orionldState
+#include "orionld/types/OrionldTenant.h"                         // OrionldTenant
+#include "orionld/db/dbConfiguration.h"                          // dbDataToKjTree
+
+#include "mongoBackend/dbConstants.h"                            // REG_*
+#include "mongoBackend/MongoGlobal.h"                            // getMongoConnection, releaseMongoConnection
+#include "mongoBackend/mongoRegistrationCache.h"                 // Own interface
+
+
+
+/* ****************************************************************************
+*
+* CachedRegistration - a registration, as stored in the database, plus what's needed to match it
+*
+* The match is the same as the one of the query of mongoCppLegacyRegistrationLookup():
+*   - some contextRegistration has an entity with the entity id, and
+*   - some contextRegistration has an empty "attrs" or an attribute with the attribute name
+*/
+typedef struct CachedRegistration
+{
+  mongo::BSONObj         doc;
+  uint64_t               order;       // Insertion order - the order of the database query
+  std::set<std::string>  entityIds;
+  std::set<std::string>  attrs;
+  bool                   allAttrs;    // Some contextRegistration has an empty "attrs" - all attributes match
+
+  CachedRegistration(): order(0), allAttrs(false) {}
+} CachedRegistration;
+
+typedef std::map<std::string, CachedRegistration*>       RegistrationMap;   // Registration id => registration
+typedef std::multimap<std::string, CachedRegistration*>  EntityIdIndex;     // Entity id => registrations
+
+
+
+/* ****************************************************************************
+*
+* TenantRegCache - the registration cache of a tenant
+*/
+typedef struct TenantRegCache
+{
+  bool             valid;       // false until the cache has been loaded from the database
+  uint64_t         changes;     // registration writes seen - a load is only stored if no write came in meanwhile
+  uint64_t         order;
+  RegistrationMap  regs;
+  EntityIdIndex    byEntityId;
+
+  TenantRegCache(): valid(false), changes(0), order(0) {}
+
+  ~TenantRegCache()
+  {
+    for (RegistrationMap::iterator it = regs.begin(); it != regs.end(); ++it)
+    {
+      delete it->second;
+    }
+  }
+} TenantRegCache;
+
+
+
+/* ****************************************************************************
+*
+* Module variables -
+*/
+static int                                        resyncInterval = 0;
+static pthread_mutex_t                            regCacheMutex  = PTHREAD_MUTEX_INITIALIZER;
+static std::map<OrionldTenant*, TenantRegCache*>  regCacheMap;
+
+
+
+/* ****************************************************************************
+*
+* tenantRegCache - lookup/create the cache of a tenant - regCacheMutex must be taken
+*/
+static TenantRegCache* tenantRegCache(OrionldTenant* tenantP)
+{
+  std::map<OrionldTenant*, TenantRegCache*>::iterator it = regCacheMap.find(tenantP);
+
+  if (it != regCacheMap.end())
+  {
+    return it->second;
+  }
+
+  TenantRegCache* cacheP = new TenantRegCache();
+
+  regCacheMap[tenantP] = cacheP;
+  return cacheP;
+}
+
+
+
+/* ****************************************************************************
+*
+* registrationId - the _id of a registration is a string in NGSI-LD and an OID in NGSIv1/v2
+*/
+static bool registrationId(const mongo::BSONObj& doc, std::string* idP)
+{
+  mongo::BSONElement idE = doc.getField("_id");
+
+  if (idE.type() == mongo::String)
+  {
+    *idP = idE.String();
+    return true;
+  }
+  else if (idE.type() == mongo::jstOID)
+  {
+    *idP = idE.OID().toString();
+    return true;
+  }
+
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* registrationFromBson -
+*/
+static CachedRegistration* registrationFromBson(const mongo::BSONObj& doc)
+{
+  CachedRegistration*  regP = new CachedRegistration();
+  mongo::BSONElement   crE  = doc.getField(REG_CONTEXT_REGISTRATION);
+
+  regP->doc = doc.getOwned();
+
+  if (crE.type() != mongo::Array)
+  {
+    return regP;  // Matches nothing
+  }
+
+  mongo::BSONObjIterator crIt(crE.embeddedObject());
+
+  while (crIt.more())
+  {
+    mongo::BSONElement cr = crIt.next();
+
+    if (cr.type() != mongo::Object)
+    {
+      continue;
+    }
+
+    mongo::BSONObj      crObj     = cr.embeddedObject();
+    mongo::BSONElement  entitiesE = crObj.getField(REG_ENTITIES);
+    mongo::BSONElement  attrsE    = crObj.getField(REG_ATTRS);
+
+    if (entitiesE.type() == mongo::Array)
+    {
+      mongo::BSONObjIterator entityIt(entitiesE.embeddedObject());
+
+      while (entityIt.more())
+      {
+        mongo::BSONElement entity = entityIt.next();
+
+        if ((entity.type() == mongo::Object) && (entity.embeddedObject().getField(REG_ENTITY_ID).type() == mongo::String))
+        {
+          regP->entityIds.insert(entity.embeddedObject().getField(REG_ENTITY_ID).String());
+        }
+      }
+    }
+
+    if (attrsE.type() == mongo::Array)
+    {
+      mongo::BSONObj attrs = attrsE.embeddedObject();
+
+      if (attrs.isEmpty())
+      {
+        regP->allAttrs = true;
+      }
+
+      mongo::BSONObjIterator attrIt(attrs);
+
+      while (attrIt.more())
+      {
+        mongo::BSONElement attr = attrIt.next();
+
+        if ((attr.type() == mongo::Object) && (attr.embeddedObject().getField(REG_ATTRS_NAME).type() == mongo::String))
+        {
+          regP->attrs.insert(attr.embeddedObject().getField(REG_ATTRS_NAME).String());
+        }
+      }
+    }
+  }
+
+  return regP;
+}
+
+
+
+/* ****************************************************************************
+*
+* registrationRemove - remove a registration from the cache of a tenant, and return it
+*/
+static CachedRegistration* registrationRemove(TenantRegCache* cacheP, const std::string& regId)
+{
+  RegistrationMap::iterator regIt = cacheP->regs.find(regId);
+
+  if (regIt == cacheP->regs.end())
+  {
+    return NULL;
+  }
+
+  CachedRegistration* regP = regIt->second;
+
+  for (std::set<std::string>::iterator idIt = regP->entityIds.begin(); idIt != regP->entityIds.end(); ++idIt)
+  {
+    std::pair<EntityIdIndex::iterator, EntityIdIndex::iterator> range = cacheP->byEntityId.equal_range(*idIt);
+
+    for (EntityIdIndex::iterator indexIt = range.first; indexIt != range.second; ++indexIt)
+    {
+      if (indexIt->second == regP)
+      {
+        cacheP->byEntityId.erase(indexIt);
+        break;
+      }
+    }
+  }
+
+  cacheP->regs.erase(regIt);
+  return regP;
+}
+
+
+
+/* ****************************************************************************
+*
+* registrationAdd - add (or replace) a registration to the cache of a tenant
+*
+* A replaced registration keeps its place in the insertion order, as it does in the database.
+*/
+static void registrationAdd(TenantRegCache* cacheP, const std::string& regId, CachedRegistration* regP)
+{
+  CachedRegistration* oldP = registrationRemove(cacheP, regId);
+
+  if (oldP != NULL)
+  {
+    regP->order = oldP->order;
+    delete oldP;
+  }
+  else
+  {
+    regP->order = ++cacheP->order;
+  }
+
+  cacheP->regs[regId] = regP;
+
+  for (std::set<std::string>::iterator idIt = regP->entityIds.begin(); idIt != regP->entityIds.end(); ++idIt)
+  {
+    cacheP->byEntityId.insert(std::pair<std::string, CachedRegistration*>(*idIt, regP));
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* cacheLoad - load all the registrations of a tenant from the database
+*/
+static bool cacheLoad(OrionldTenant* tenantP, TenantRegCache* cacheP)
+{
+  mongo::DBClientBase*  connectionP   = getMongoConnection();
+  int                   registrations = 0;
+
+  if (connectionP == NULL)
+  {
+    LM_E(("Database Error (null DB connection)"));
+    return false;
+  }
+
+  try
+  {
+    std::auto_ptr<mongo::DBClientCursor> cursorP = connectionP->query(tenantP->registrations, mongo::Query());
+
+    while (cursorP->more())
+    {
+      mongo::BSONObj  doc = cursorP->nextSafe();
+      std::string     regId;
+
+      if (registrationId(doc, &regId) == false)
+      {
+        LM_W(("Invalid registration in database (no _id) - not cached"));
+        continue;
+      }
+
+      registrationAdd(cacheP, regId, registrationFromBson(doc));
+      ++registrations;
+    }
+  }
+  catch (const std::exception& e)
+  {
+    releaseMongoConnection(connectionP);
+    LM_E(("Database Error (collection: %s - loading the registration cache - exception: %s)", tenantP->registrations, e.what()));
+    return false;
+  }
+  catch (...)
+  {
+    releaseMongoConnection(connectionP);
+    LM_E(("Database Error (collection: %s - loading the registration cache - exception: generic)", tenantP->registrations));
+    return false;
+  }
+
+  releaseMongoConnection(connectionP);
+
+  LM_T(LmtMongo, ("registration cache of '%s': %d registrations", tenantP->registrations, registrations));
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* cacheStore - replace the contents of the cache of a tenant with a fresh load - regCacheMutex must be taken
+*
+* The previous contents are left in 'loadedP', for the caller to delete (outside the mutex).
+*/
+static void cacheStore(TenantRegCache* cacheP, TenantRegCache* loadedP)
+{
+  cacheP->regs.swap(loadedP->regs);
+  cacheP->byEntityId.swap(loadedP->byEntityId);
+
+  uint64_t order = cacheP->order;
+
+  cacheP->order   = loadedP->order;
+  loadedP->order  = order;
+  cacheP->valid   = true;
+}
+
+
+
+/* ****************************************************************************
+*
+* cacheMatch - the registrations of a tenant that match an entity id (and attribute)
+*
+* The matching documents are copied to 'matchesP', sorted by insertion order.
+* Copying a BSONObj only copies a reference to its (reference counted) buffer.
+*/
+static void cacheMatch(TenantRegCache* cacheP, const char* entityId, const char* attribute, std::map<uint64_t, mongo::BSONObj>* matchesP)
+{
+  std::pair<EntityIdIndex::iterator, EntityIdIndex::iterator> range = cacheP->byEntityId.equal_range(entityId);
+
+  for (EntityIdIndex::iterator it = range.first; it != range.second; ++it)
+  {
+    CachedRegistration* regP = it->second;
+
+    if ((attribute != NULL) && (regP->allAttrs == false) && (regP->attrs.find(attribute) == regP->attrs.end()))
+    {
+      continue;
+    }
+
+    (*matchesP)[regP->order] = regP->doc;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* regCacheResync - reload the cache of every tenant from the database
+*
+* A tenant whose registrations are modified while its cache is reloaded keeps its current
+* cache (updated by the modifications) and is resynchronized the next time.
+*/
+static void regCacheResync(void)
+{
+  std::vector<OrionldTenant*> tenants;
+
+  pthread_mutex_lock(&regCacheMutex);
+
+  for (std::map<OrionldTenant*, TenantRegCache*>::iterator it = regCacheMap.begin(); it != regCacheMap.end(); ++it)
+  {
+    tenants.push_back(it->first);
+  }
+
+  pthread_mutex_unlock(&regCacheMutex);
+
+  for (unsigned int ix = 0; ix < tenants.size(); ++ix)
+  {
+    OrionldTenant*  tenantP = tenants[ix];
+    TenantRegCache* loadedP = new TenantRegCache();
+    uint64_t        changes;
+
+    pthread_mutex_lock(&regCacheMutex);
+    changes = tenantRegCache(tenantP)->changes;
+    pthread_mutex_unlock(&regCacheMutex);
+
+    if (cacheLoad(tenantP, loadedP) == true)
+    {
+      pthread_mutex_lock(&regCacheMutex);
+
+      std::map<OrionldTenant*, TenantRegCache*>::iterator it = regCacheMap.find(tenantP);
+
+      if ((it != regCacheMap.end()) && (it->second->changes == changes))
+      {
+        cacheStore(it->second, loadedP);
+      }
+      else
+      {
+        LM_T(LmtMongo, ("registration cache of '%s' modified while resynchronizing - not stored", tenantP->registrations));
+      }
+
+      pthread_mutex_unlock(&regCacheMutex);
+    }
+
+    delete loadedP;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* regCacheResyncThread -
+*/
+static void* regCacheResyncThread(void* vP)
+{
+  while (1)
+  {
+    sleep(resyncInterval);
+    regCacheResync();
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheInit -
+*/
+void mongoRegistrationCacheInit(int _resyncInterval)
+{
+  pthread_t  tid;
+  int        ret;
+
+  resyncInterval = _resyncInterval;
+
+  if (resyncInterval == 0)
+  {
+    return;
+  }
+
+  ret = pthread_create(&tid, NULL, regCacheResyncThread, NULL);
+
+  if (ret != 0)
+  {
+    LM_E(("Runtime Error (error creating registration cache resync thread: %d) - registration cache turned off", ret));
+    resyncInterval = 0;
+    return;
+  }
+
+  pthread_detach(tid);
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheActive -
+*/
+bool mongoRegistrationCacheActive(void)
+{
+  return (resyncInterval != 0);
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheRelease -
+*/
+void mongoRegistrationCacheRelease(void)
+{
+  pthread_mutex_lock(&regCacheMutex);
+
+  for (std::map<OrionldTenant*, TenantRegCache*>::iterator it = regCacheMap.begin(); it != regCacheMap.end(); ++it)
+  {
+    delete it->second;
+  }
+  regCacheMap.clear();
+
+  pthread_mutex_unlock(&regCacheMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheInsert -
+*/
+void mongoRegistrationCacheInsert(OrionldTenant* tenantP, const char* regId, const mongo::BSONObj& doc)
+{
+  if (resyncInterval == 0)
+  {
+    return;
+  }
+
+  CachedRegistration* regP = registrationFromBson(doc);
+
+  pthread_mutex_lock(&regCacheMutex);
+
+  TenantRegCache* cacheP = tenantRegCache(tenantP);
+
+  ++cacheP->changes;
+
+  if (cacheP->valid == true)
+  {
+    registrationAdd(cacheP, regId, regP);
+    regP = NULL;
+  }
+
+  pthread_mutex_unlock(&regCacheMutex);
+
+  delete regP;  // Not stored if the cache isn't loaded
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheRemove -
+*/
+void mongoRegistrationCacheRemove(OrionldTenant* tenantP, const char* regId)
+{
+  if (resyncInterval == 0)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&regCacheMutex);
+
+  TenantRegCache*     cacheP = tenantRegCache(tenantP);
+  CachedRegistration* regP   = registrationRemove(cacheP, regId);
+
+  ++cacheP->changes;
+
+  pthread_mutex_unlock(&regCacheMutex);
+
+  delete regP;
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheInvalidate -
+*/
+void mongoRegistrationCacheInvalidate(OrionldTenant* tenantP)
+{
+  if (resyncInterval == 0)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&regCacheMutex);
+
+  TenantRegCache* cacheP = tenantRegCache(tenantP);
+
+  ++cacheP->changes;
+  cacheP->valid = false;
+
+  pthread_mutex_unlock(&regCacheMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheLookup -
+*
+* The cache of the tenant is loaded from the database if not valid. If registrations are
+* written while loading, the loaded cache can't be trusted and it isn't stored, but it's
+* still good enough for the current request.
+*/
+KjNode* mongoRegistrationCacheLookup(OrionldTenant* tenantP, const char* entityId, const char* attribute, int* noOfRegsP)
+{
+  std::map<uint64_t, mongo::BSONObj>  matches;
+  TenantRegCache*                     loadedP = NULL;
+
+  //
+  // Same value as given by mongoCppLegacyRegistrationLookup()
+  //
+  if (noOfRegsP != NULL)
+  {
+    *noOfRegsP = (attribute != NULL)? 1 : 0;
+  }
+
+  pthread_mutex_lock(&regCacheMutex);
+
+  TenantRegCache* cacheP = tenantRegCache(tenantP);
+
+  if (cacheP->valid == false)
+  {
+    uint64_t changes = cacheP->changes;
+
+    pthread_mutex_unlock(&regCacheMutex);
+
+    loadedP = new TenantRegCache();
+
+    if (cacheLoad(tenantP, loadedP) == false)
+    {
+      delete loadedP;
+      return NULL;
+    }
+
+    pthread_mutex_lock(&regCacheMutex);
+
+    if ((cacheP->valid == false) && (cacheP->changes == changes))
+    {
+      cacheStore(cacheP, loadedP);
+    }
+    else if (cacheP->valid == false)
+    {
+      LM_T(LmtMongo, ("registration cache of '%s' modified while loading - not stored", tenantP->registrations));
+      cacheP = loadedP;
+    }
+  }
+
+  cacheMatch(cacheP, entityId, attribute, &matches);
+
+  pthread_mutex_unlock(&regCacheMutex);
+
+  delete loadedP;
+
+  //
+  // The matching registrations, as mongoCppLegacyRegistrationLookup() gives them
+  //
+  KjNode* kjRegArray = NULL;
+
+  for (std::map<uint64_t, mongo::BSONObj>::iterator it = matches.begin(); it != matches.end(); ++it)
+  {
+    char*    title;
+    char*    details;
+    KjNode*  kjTree = dbDataToKjTree(&it->second, false, &title, &details);
+
+    if (kjTree == NULL)
+    {
+      LM_E(("%s: %s", title, details));
+      continue;
+    }
+
+    if (kjRegArray == NULL)
+    {
+      kjRegArray = kjArray(orionldState.kjsonP, NULL);
+    }
+
+    kjChildAdd(kjRegArray, kjTree);
+  }
+
+  return kjRegArray;
+}
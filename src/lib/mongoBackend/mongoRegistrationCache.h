@@ -0,0 +1,108 @@
+#ifndef SRC_LIB_MONGOBACKEND_MONGOREGISTRATIONCACHE_H_
+#define SRC_LIB_MONGOBACKEND_MONGOREGISTRATIONCACHE_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include "mongo/client/dbclient.h"                               // MongoDB C++ Client Legacy Driver
+
+extern "C"
+{
+#include "kjson/KjNode.h"                                        // KjNode
+}
+
+#include "orionld/types/OrionldTenant.h"                         // OrionldTenant
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheInit - turn the registration cache on/off
+*
+* The cache keeps, per tenant, a copy of the 'registrations' collection, indexed by entity id,
+* so that the context sources of a request can be found without querying the database.
+* It is loaded from the database the first time it is used for a tenant, it is updated by the
+* registration create/update/delete operations of the broker and it is resynchronized with the
+* database every 'resyncInterval' seconds, by a thread of its own.
+*
+* resyncInterval == 0 turns the cache off
+*/
+extern void mongoRegistrationCacheInit(int resyncInterval);
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheActive -
+*/
+extern bool mongoRegistrationCacheActive(void);
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheRelease -
+*/
+extern void mongoRegistrationCacheRelease(void);
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheInsert - a registration (the entire DB document) has been inserted or replaced
+*/
+extern void mongoRegistrationCacheInsert(OrionldTenant* tenantP, const char* regId, const mongo::BSONObj& doc);
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheRemove - a registration has been removed
+*/
+extern void mongoRegistrationCacheRemove(OrionldTenant* tenantP, const char* regId);
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheInvalidate - the registrations of a tenant have been modified
+*
+* For when the modified registration document isn't at hand - the cache of the tenant is
+* loaded again from the database the next time it is needed.
+*/
+extern void mongoRegistrationCacheInvalidate(OrionldTenant* tenantP);
+
+
+
+/* ****************************************************************************
+*
+* mongoRegistrationCacheLookup - registrations matching an entity id (and attribute)
+*
+* Same output as mongoCppLegacyRegistrationLookup() - an array of the matching registrations
+* (as stored in the database), in the order they were inserted.
+* NULL if no registration matches.
+*/
+extern KjNode* mongoRegistrationCacheLookup(OrionldTenant* tenantP, const char* entityId, const char* attribute, int* noOfRegsP);
+
+#endif  // SRC_LIB_MONGOBACKEND_MONGOREGISTRATIONCACHE_H_
@@ -43,6 +43,7 @@
 #include "mongoBackend/safeMongo.h"
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/connectionOperations.h"
+#include "mongoBackend/mongoRegistrationCache.h"
 #include "mongoBackend/mongoRegistrationCreate.h"
 
 
@@ -362,5 +363,7 @@ void mongoRegistrationCreate
 
   reqSemGive(__FUNCTION__, "Mongo Create Registration", reqSemTaken);
 
+  mongoRegistrationCacheInsert(tenantP, (orionldState.apiVersion == NGSI_LD_V1)? regP->id.c_str() : regIdP->c_str(), doc);
+
   oeP->fill(SccOk, "");
 }
@@ -42,6 +42,7 @@
 #include "mongoBackend/safeMongo.h"
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/connectionOperations.h"
+#include "mongoBackend/mongoRegistrationCache.h"
 #include "mongoBackend/mongoRegistrationDelete.h"
 
 
@@ -129,6 +130,8 @@ void mongoRegistrationDelete
       oeP->fill(SccReceiverInternalError, std::string("exception in collectionRemove(): ") + err.c_str());
       return;
     }
+
+    mongoRegistrationCacheRemove(tenantP, regId.c_str());
   }
   else
   {
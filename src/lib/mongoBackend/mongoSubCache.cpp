@@ -25,6 +25,7 @@
 #include <regex.h>
 #include <string>
 #include <vector>
+#include <map>
 
 #include "mongo/client/dbclient.h"
 
@@ -174,6 +175,7 @@ int mongoSubCacheItemInsert(const char* tenant, const BSONObj& sub)
   cSubP->blacklist             = sub.hasField(CSUB_BLACKLIST)?        getBoolFieldF(&sub, CSUB_BLACKLIST)                  : false;
   cSubP->lastFailure           = sub.hasField(CSUB_LASTFAILURE)?      getNumberFieldAsDoubleF(&sub, CSUB_LASTFAILURE)      : -1;
   cSubP->lastSuccess           = sub.hasField(CSUB_LASTSUCCESS)?      getNumberFieldAsDoubleF(&sub, CSUB_LASTSUCCESS)      : -1;
+  cSubP->modifiedAt            = sub.hasField(CSUB_MODIFIEDAT)?       getNumberFieldAsDoubleF(&sub, CSUB_MODIFIEDAT)       : 0;
   cSubP->count                 = 0;
   cSubP->next                  = NULL;
 
@@ -432,6 +434,7 @@ int mongoSubCacheItemInsert
   cSubP->expression.georel     = georel;
   cSubP->next                  = NULL;
   cSubP->blacklist             = sub.hasField(CSUB_BLACKLIST)? getBoolFieldF(&sub, CSUB_BLACKLIST) : false;
+  cSubP->modifiedAt            = sub.hasField(CSUB_MODIFIEDAT)? getNumberFieldAsDoubleF(&sub, CSUB_MODIFIEDAT) : 0;
 
   //
   // httpInfo
@@ -574,6 +577,196 @@ void mongoSubCacheRefresh(const std::string& database)
 
 
 
+/* ****************************************************************************
+*
+* subscriptionIdGet - the subscription id of a DB subscription, whether an OID or a string
+*/
+static bool subscriptionIdGet(const BSONObj& sub, std::string* subIdP)
+{
+  BSONElement _id = sub.getField("_id");
+
+  if (_id.type() == mongo::String)
+    *subIdP = _id.String();
+  else if (_id.type() == mongo::jstOID)
+    *subIdP = _id.OID().toString();
+  else
+    return false;
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoSubCacheSync - incremental synchronization of the cached subscriptions of one database (tenant)
+*
+* Instead of emptying the cache and inserting all subscriptions again (mongoSubCacheRefresh), only what has
+* changed in the database since the last synchronization is applied to the cache:
+*
+* 1. All subscriptions of the database are scanned, retrieving only _id, modifiedAt and the notification timestamps
+* 2. Subscriptions not in the cache, and those whose modifiedAt differs from that of the cached subscription,
+*    are read entirely (all of them in one single query) and inserted in the cache, replacing the cached subscription
+* 3. For the rest, the notification timestamps of the database are taken if newer than those of the cache
+*    (notifications sent by other brokers working on the same database)
+* 4. Cached subscriptions that are no longer in the database are removed from the cache
+*
+* 'cachedP' contains the cached subscriptions of the tenant, by subscription id, and it is emptied by this function.
+* The sub-cache semaphore must be taken and the counters of the cached subscriptions must have been flushed to the
+* database (the replaced subscriptions are re-read from the database) before this function is called.
+*
+* Returns false on database error, leaving the rest of the cached subscriptions of the tenant untouched.
+*/
+bool mongoSubCacheSync(const std::string& database, std::map<std::string, CachedSubscription*>* cachedP, int* changesP)
+{
+  char*                    tenant  = tenantFromDb(database.c_str());
+  int                      reloads = 0;
+  mongo::BSONObjBuilder    fields;
+  mongo::BSONArrayBuilder  reloadIds;
+  char                     collectionPath[80];
+
+  snprintf(collectionPath, sizeof(collectionPath), "%s.csubs", database.c_str());
+
+  fields.append("_id",                 1);
+  fields.append(CSUB_MODIFIEDAT,       1);
+  fields.append(CSUB_LASTNOTIFICATION, 1);
+  fields.append(CSUB_LASTFAILURE,      1);
+  fields.append(CSUB_LASTSUCCESS,      1);
+
+  BSONObj        fieldsToReturn = fields.obj();
+  DBClientBase*  connectionP    = getMongoConnection();
+
+  if (connectionP == NULL)
+  {
+    LM_E(("Database Error (null DB connection)"));
+    return false;
+  }
+
+  try
+  {
+    //
+    // 1. Scan the subscriptions of the database
+    //
+    std::auto_ptr<DBClientCursor> cursorP = connectionP->query(collectionPath, mongo::Query(), 0, 0, &fieldsToReturn);
+
+    while (cursorP->more())
+    {
+      BSONObj      sub = cursorP->nextSafe();
+      std::string  subId;
+
+      if (subscriptionIdGet(sub, &subId) == false)
+        continue;
+
+      double                                               modifiedAt = sub.hasField(CSUB_MODIFIEDAT)? getNumberFieldAsDoubleF(&sub, CSUB_MODIFIEDAT) : 0;
+      std::map<std::string, CachedSubscription*>::iterator it         = cachedP->find(subId);
+
+      //
+      // 2. New or modified - to be read entirely
+      //
+      if ((it == cachedP->end()) || (it->second->modifiedAt != modifiedAt))
+      {
+        reloadIds.append(sub.getField("_id"));
+        ++reloads;
+        continue;
+      }
+
+      //
+      // 3. Unmodified - only the notification timestamps may have changed
+      //
+      CachedSubscription* cSubP = it->second;
+
+      if (sub.hasField(CSUB_LASTNOTIFICATION))
+      {
+        double lastNotificationTime = getNumberFieldAsDoubleF(&sub, CSUB_LASTNOTIFICATION);
+
+        cSubP->dbLastNotificationTime = lastNotificationTime;
+        if (lastNotificationTime > cSubP->lastNotificationTime)
+          cSubP->lastNotificationTime = lastNotificationTime;
+      }
+
+      if (sub.hasField(CSUB_LASTFAILURE))
+      {
+        double lastFailure = getNumberFieldAsDoubleF(&sub, CSUB_LASTFAILURE);
+
+        cSubP->dbLastFailure = lastFailure;
+        if (lastFailure > cSubP->lastFailure)
+          cSubP->lastFailure = lastFailure;
+      }
+
+      if (sub.hasField(CSUB_LASTSUCCESS))
+      {
+        double lastSuccess = getNumberFieldAsDoubleF(&sub, CSUB_LASTSUCCESS);
+
+        cSubP->dbLastSuccess = lastSuccess;
+        if (lastSuccess > cSubP->lastSuccess)
+          cSubP->lastSuccess = lastSuccess;
+      }
+
+      cachedP->erase(it);
+    }
+
+    //
+    // 2. Read the new and modified subscriptions and insert them in the cache
+    //
+    if (reloads > 0)
+    {
+      BSONObj query = BSON("_id" << BSON("$in" << reloadIds.arr()));
+
+      cursorP = connectionP->query(collectionPath, query);
+
+      while (cursorP->more())
+      {
+        BSONObj      sub = cursorP->nextSafe();
+        std::string  subId;
+
+        if (subscriptionIdGet(sub, &subId) == false)
+          continue;
+
+        std::map<std::string, CachedSubscription*>::iterator it = cachedP->find(subId);
+
+        if (it != cachedP->end())
+        {
+          subCacheItemRemove(it->second);
+          cachedP->erase(it);
+        }
+
+        mongoSubCacheItemInsert(tenant, sub);
+        *changesP += 1;
+      }
+    }
+  }
+  catch (const std::exception& e)
+  {
+    releaseMongoConnection(connectionP);
+    LM_E(("Database Error (collection: %s - synchronizing the subscription cache - exception: %s)", collectionPath, e.what()));
+    return false;
+  }
+  catch (...)
+  {
+    releaseMongoConnection(connectionP);
+    LM_E(("Database Error (collection: %s - synchronizing the subscription cache - exception: generic)", collectionPath));
+    return false;
+  }
+
+  releaseMongoConnection(connectionP);
+
+  //
+  // 4. Whatever is left in 'cachedP' is no longer in the database
+  //
+  for (std::map<std::string, CachedSubscription*>::iterator it = cachedP->begin(); it != cachedP->end(); ++it)
+  {
+    subCacheItemRemove(it->second);
+    *changesP += 1;
+  }
+  cachedP->clear();
+
+  LM_T(LmtSubCache, ("Synchronized subscription cache for database '%s': %d subscriptions re-read", database.c_str(), reloads));
+
+  return true;
+}
+
+
+
 /* ****************************************************************************
 *
 * mongoSubCountersUpdateCount -
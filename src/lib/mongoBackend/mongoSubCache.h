@@ -29,10 +29,12 @@
 
 #include <string>
 #include <vector>
+#include <map>
 
 #include "mongo/client/dbclient.h"
 #include "common/RenderFormat.h"
 #include "rest/StringFilter.h"
+#include "cache/subCache.h"
 
 
 
@@ -79,6 +81,31 @@ extern void mongoSubCacheRefresh(const std::string& database);
 
 
 
+/* ****************************************************************************
+*
+* tenantFromDb - extract the tenant of a database name (NULL for the default tenant)
+*/
+extern char* tenantFromDb(const char* db);
+
+
+
+/* ****************************************************************************
+*
+* mongoSubCacheSync - incremental synchronization of the cached subscriptions of one database
+*
+* 'cachedP' holds the cached subscriptions of the tenant of the database, by subscription id.
+* The new and modified subscriptions are (re-)read from the database and the deleted ones are removed
+* from the cache. 'changesP' is incremented for every sub-cache item inserted, replaced or removed.
+*/
+extern bool mongoSubCacheSync
+(
+  const std::string&                            database,
+  std::map<std::string, CachedSubscription*>*   cachedP,
+  int*                                          changesP
+);
+
+
+
 /* ****************************************************************************
 *
 * mongoSubCountersUpdate - 
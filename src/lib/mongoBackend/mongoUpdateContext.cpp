@@ -80,6 +80,19 @@ HttpStatusCode mongoUpdateContext
   }
   else
   {
+    //
+    // NGSI-LD batches: one query for all entities and one bulk write, instead of one query and one write per entity
+    //
+    EntityBulkWrite   bulk;
+    EntityBulkWrite*  bulkP = NULL;
+
+    bulk.written = false;
+
+    if ((entityBulkWriteApplies(requestP) == true) && (entityBulkPrefetch(&bulk, requestP, tenantP, servicePathV) == true))
+    {
+      bulkP = &bulk;
+    }
+
     /* Process each ContextElement */
     for (unsigned int ix = 0; ix < requestP->contextElementVector.size(); ++ix)
     {
@@ -93,7 +106,13 @@ HttpStatusCode mongoUpdateContext
                             fiwareCorrelator,
                             ngsiV2AttrsFormat,
                             apiVersion,
-                            ngsiv2Flavour);
+                            ngsiv2Flavour,
+                            bulkP);
+    }
+
+    if (bulkP != NULL)
+    {
+      entityBulkFlush(bulkP, responseP, tenantP, xauthToken, fiwareCorrelator);
     }
 
     /* Note that although individual processContextElements() invocations return ConnectionError, this
@@ -106,3 +125,69 @@ HttpStatusCode mongoUpdateContext
   reqSemGive(__FUNCTION__, "ngsi10 update request", reqSemTaken);
   return SccOk;
 }
+
+
+
+/* ****************************************************************************
+*
+* mongoPatchEntity -
+*
+* PATCH of existing attributes of an NGSI-LD entity (the only context element of requestP),
+* in one database operation, see entityPatchWrite().
+*
+* If the entity is not modified, because it doesn't exist or doesn't have all the attributes,
+* *patchedP is set to false and the caller must take the usual path (mongoUpdateContext).
+*/
+HttpStatusCode mongoPatchEntity
+(
+  UpdateContextRequest*                 requestP,
+  UpdateContextResponse*                responseP,
+  OrionldTenant*                        tenantP,
+  const std::vector<std::string>&       servicePathV,
+  std::map<std::string, std::string>&   uriParams,
+  const char*                           xauthToken,
+  const char*                           fiwareCorrelator,
+  ApiVersion                            apiVersion,
+  bool*                                 patchedP
+)
+{
+  bool             reqSemTaken;
+  EntityBulkWrite  bulk;
+  std::string      err;
+  ContextElement*  ceP = requestP->contextElementVector[0];
+
+  *patchedP    = false;
+  bulk.written = false;
+
+  reqSemTake(__FUNCTION__, "ngsi-ld patch request", SemWriteOp, &reqSemTaken);
+
+  if (entityPatchWrite(&bulk, ceP, tenantP, servicePathV, fiwareCorrelator, &err) == true)
+  {
+    processContextElement(ceP,
+                          responseP,
+                          ActionTypeUpdate,
+                          tenantP,
+                          servicePathV,
+                          uriParams,
+                          xauthToken,
+                          fiwareCorrelator,
+                          "",
+                          apiVersion,
+                          NGSIV2_NO_FLAVOUR,
+                          &bulk);
+
+    entityBulkFlush(&bulk, responseP, tenantP, xauthToken, fiwareCorrelator);
+    *patchedP = true;
+  }
+  else if (err != "")
+  {
+    responseP->oe.fill(SccReceiverInternalError, err, "InternalServerError");
+    reqSemGive(__FUNCTION__, "ngsi-ld patch request", reqSemTaken);
+    return SccReceiverInternalError;
+  }
+
+  responseP->errorCode.fill(SccOk);
+
+  reqSemGive(__FUNCTION__, "ngsi-ld patch request", reqSemTaken);
+  return SccOk;
+}
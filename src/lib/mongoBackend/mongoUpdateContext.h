@@ -55,4 +55,24 @@ extern HttpStatusCode mongoUpdateContext
   Ngsiv2Flavour                         ngsiv2Flavour    = NGSIV2_NO_FLAVOUR
 );
 
+
+
+
+/* ****************************************************************************
+*
+* mongoPatchEntity - PATCH of existing attributes of an NGSI-LD entity in a single database operation
+*/
+extern HttpStatusCode mongoPatchEntity
+(
+  UpdateContextRequest*                 requestP,
+  UpdateContextResponse*                responseP,
+  OrionldTenant*                        tenantP,
+  const std::vector<std::string>&       servicePathV,
+  std::map<std::string, std::string>&   uriParams,
+  const char*                           xauthToken,
+  const char*                           fiwareCorrelator,
+  ApiVersion                            apiVersion,
+  bool*                                 patchedP
+);
+
 #endif  // SRC_LIB_MONGOBACKEND_MONGOUPDATECONTEXT_H_
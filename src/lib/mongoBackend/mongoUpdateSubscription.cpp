@@ -967,6 +967,11 @@ std::string mongoUpdateSubscription
   setExpression(subUp, subOrig, &b);
   setFormat(subUp, subOrig, &b);
 
+#ifdef ORIONLD
+  // The sub-cache synchronization re-reads the subscriptions whose modifiedAt has changed
+  b.append(CSUB_MODIFIEDAT, orionldState.requestTime);
+#endif
+
   BSONObj doc = b.obj();
 
   // Update in DB
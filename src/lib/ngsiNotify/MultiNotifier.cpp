@@ -0,0 +1,212 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string>
+#include <vector>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/globals.h"
+#include "common/RenderFormat.h"
+#include "ngsiNotify/QueueStatistics.h"
+#include "ngsiNotify/MultiNotifier.h"
+
+
+
+/* ****************************************************************************
+*
+* MultiNotifier::MultiNotifier -
+*
+* Only HTTP notifications are driven by the curl multi handles. MQTT notifications (and all
+* notifications, if simulated) are sent one at a time, so they go to a queue of their own, served by
+* threadpool workers, where a slow MQTT broker doesn't stop the HTTP transfers.
+*/
+MultiNotifier::MultiNotifier(size_t queueSize, int numThreads, int maxPerEndpoint): queue(queueSize), workers(&queue, numThreads, maxPerEndpoint, queueSize), syncQueue(queueSize), syncWorkers(&syncQueue, numThreads)
+{
+  LM_T(LmtNotifier, ("Setting up queue and curl multi threads for notifications"));
+}
+
+
+
+/* ****************************************************************************
+*
+* MultiNotifier::start -
+*/
+int MultiNotifier::start()
+{
+  int rc = workers.start();
+
+  if (rc != 0)
+  {
+    return rc;
+  }
+
+  return syncWorkers.start();
+}
+
+
+
+/* ****************************************************************************
+*
+* queuePush - push notifications to a queue, or drop them if the queue is full
+*/
+static void queuePush(SyncQOverflow<std::vector<SenderThreadParams*>*>* queueP, std::vector<SenderThreadParams*>* paramsV)
+{
+  size_t notificationsNum = paramsV->size();
+
+  if (!queueP->try_push(paramsV))
+  {
+    QueueStatistics::incReject(notificationsNum);
+    LM_E(("Runtime Error (notification queue is full)"));
+
+    for (unsigned ix = 0; ix < notificationsNum; ix++)
+    {
+      delete (*paramsV)[ix];
+    }
+    delete paramsV;
+
+    return;
+  }
+
+  QueueStatistics::incIn(notificationsNum);
+}
+
+
+
+/* ****************************************************************************
+*
+* MultiNotifier::enqueue -
+*/
+void MultiNotifier::enqueue(std::vector<SenderThreadParams*>* paramsV)
+{
+  size_t notificationsNum = paramsV->size();
+  size_t mqttNum          = 0;
+
+  for (unsigned ix = 0; ix < notificationsNum; ix++)
+  {
+    clock_gettime(CLOCK_REALTIME, &(((*paramsV)[ix])->timeStamp));
+
+    if ((*paramsV)[ix]->protocol == "mqtt")
+    {
+      ++mqttNum;
+    }
+  }
+
+  if ((simulatedNotification) || (mqttNum == notificationsNum))
+  {
+    queuePush(&syncQueue, paramsV);
+    return;
+  }
+
+  if (mqttNum == 0)
+  {
+    queuePush(&queue, paramsV);
+    return;
+  }
+
+  // Both MQTT and HTTP notifications - the MQTT notifications are moved to a vector of their own
+  std::vector<SenderThreadParams*>* httpV = new std::vector<SenderThreadParams*>();
+  std::vector<SenderThreadParams*>* mqttV = new std::vector<SenderThreadParams*>();
+
+  for (unsigned ix = 0; ix < notificationsNum; ix++)
+  {
+    if ((*paramsV)[ix]->protocol == "mqtt")
+    {
+      mqttV->push_back((*paramsV)[ix]);
+    }
+    else
+    {
+      httpV->push_back((*paramsV)[ix]);
+    }
+  }
+  delete paramsV;
+
+  queuePush(&syncQueue, mqttV);
+  queuePush(&queue, httpV);
+}
+
+
+
+/* ****************************************************************************
+*
+* MultiNotifier::sendNotifyContextRequest -
+*/
+void MultiNotifier::sendNotifyContextRequest
+(
+  NotifyContextRequest*            ncr,
+  const ngsiv2::HttpInfo&          httpInfo,
+  const std::string&               tenant,
+  const std::string&               xauthToken,
+  const std::string&               fiwareCorrelator,
+  RenderFormat                     renderFormat,
+  const std::vector<std::string>&  attrsOrder,
+  const std::vector<std::string>&  metadataFilter,
+  bool                             blacklist
+)
+{
+  std::vector<SenderThreadParams*>* paramsV = Notifier::buildSenderParams(ncr,
+                                                                          httpInfo,
+                                                                          tenant,
+                                                                          xauthToken,
+                                                                          fiwareCorrelator,
+                                                                          renderFormat,
+                                                                          attrsOrder,
+                                                                          metadataFilter,
+                                                                          blacklist);
+
+  if (paramsV->empty())
+  {
+    delete paramsV;
+    return;
+  }
+
+  enqueue(paramsV);
+}
+
+
+
+/* ****************************************************************************
+*
+* MultiNotifier::sendNotifyContextAvailabilityRequest -
+*/
+void MultiNotifier::sendNotifyContextAvailabilityRequest
+(
+  NotifyContextAvailabilityRequest*  ncar,
+  const std::string&                 url,
+  const std::string&                 tenant,
+  const std::string&                 fiwareCorrelator,
+  RenderFormat                       renderFormat
+)
+{
+  std::vector<SenderThreadParams*>* paramsV = Notifier::buildAvailabilitySenderParams(ncar, url, tenant, fiwareCorrelator, renderFormat);
+
+  if (paramsV->empty())
+  {
+    delete paramsV;
+    return;
+  }
+
+  enqueue(paramsV);
+}
@@ -0,0 +1,83 @@
+#ifndef SRC_LIB_NGSINOTIFY_MULTINOTIFIER_H_
+#define SRC_LIB_NGSINOTIFY_MULTINOTIFIER_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string>
+#include <vector>
+
+#include "common/SyncQOverflow.h"
+#include "common/RenderFormat.h"
+#include "ngsiNotify/Notifier.h"
+#include "ngsiNotify/senderThread.h"
+#include "ngsiNotify/QueueWorkers.h"
+#include "ngsiNotify/MultiWorkers.h"
+
+
+// default queue size
+#define DEFAULT_MULTI_QS 10000
+// default number of threads
+#define DEFAULT_MULTI_TN 2
+// default number of in-flight notifications per receiver and thread
+#define DEFAULT_MULTI_EC 8
+
+
+
+/* ****************************************************************************
+*
+* class MultiNotifier -
+*/
+class MultiNotifier : public Notifier
+{
+public:
+  MultiNotifier(size_t queueSize, int numThreads, int maxPerEndpoint);
+
+  void sendNotifyContextRequest(NotifyContextRequest*            ncr,
+                                const ngsiv2::HttpInfo&          httpInfo,
+                                const std::string&               tenant,
+                                const std::string&               xauthToken,
+                                const std::string&               fiwareCorrelator,
+                                RenderFormat                     renderFormat,
+                                const std::vector<std::string>&  attrsOrder,
+                                const std::vector<std::string>&  metadataFilter,
+                                bool                             blacklist);
+
+  void sendNotifyContextAvailabilityRequest(NotifyContextAvailabilityRequest*  ncar,
+                                            const std::string&                 url,
+                                            const std::string&                 tenant,
+                                            const std::string&                 fiwareCorrelator,
+                                            RenderFormat                       renderFormat);
+  int start();
+
+private:
+  void enqueue(std::vector<SenderThreadParams*>* paramsV);
+
+  SyncQOverflow<std::vector<SenderThreadParams*>*>  queue;
+  MultiWorkers                                      workers;
+  SyncQOverflow<std::vector<SenderThreadParams*>*>  syncQueue;    // MQTT and simulated notifications
+  QueueWorkers                                      syncWorkers;
+};
+
+#endif  // SRC_LIB_NGSINOTIFY_MULTINOTIFIER_H_
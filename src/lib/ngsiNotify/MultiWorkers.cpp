@@ -0,0 +1,499 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <pthread.h>
+#include <curl/curl.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/clockFunctions.h"
+#include "common/statistics.h"
+#include "common/limits.h"
+#include "alarmMgr/alarmMgr.h"
+#include "cache/subCache.h"
+#include "rest/httpRequestSend.h"
+#include "ngsiNotify/QueueStatistics.h"
+#include "orionld/common/orionldState.h"
+#include "ngsiNotify/MultiWorkers.h"
+
+
+
+/* ****************************************************************************
+*
+* MultiTransfer - an HTTP notification that has been handed over to the multi handle
+*/
+typedef struct MultiTransfer
+{
+  SenderThreadParams*  params;
+  CURL*                curl;
+  std::string          endpoint;
+  HttpRequestTransfer  transfer;
+} MultiTransfer;
+
+
+
+/* ****************************************************************************
+*
+* MultiEndpoint - the notifications of one worker thread for one receiver (ip:port)
+*/
+typedef struct MultiEndpoint
+{
+  int                              inFlight;  // transfers added to the multi handle
+  bool                             ready;     // in the ready list of the worker
+  std::deque<SenderThreadParams*>  pending;   // waiting for a free slot of the endpoint
+} MultiEndpoint;
+
+
+
+/* ****************************************************************************
+*
+* MultiWorkerState - the state of one worker thread
+*
+* Only receivers with pending or in-flight notifications are in 'endpoints'.
+* 'ready' holds the receivers that have pending notifications and a free slot, and
+* is served round-robin.
+*/
+typedef struct MultiWorkerState
+{
+  SyncQOverflow<std::vector<SenderThreadParams*>*>*  queue;
+  int                                                endpointConcurrency;
+  int                                                endpointPendingMax;
+  CURLM*                                             multi;
+  int                                                running;      // transfers added to the multi handle
+  std::map<std::string, MultiEndpoint>               endpoints;    // per receiver (ip:port)
+  std::deque<std::string>                            ready;        // receivers with a notification that can be started
+  std::vector<CURL*>                                 idleHandles;  // easy handles for reuse (keeps connections alive)
+} MultiWorkerState;
+
+
+
+/* ****************************************************************************
+*
+* workerFunc - prototype
+*/
+static void* workerFunc(void* vP);
+
+
+
+/* ****************************************************************************
+*
+* MultiWorkers::start() -
+*/
+int MultiWorkers::start()
+{
+  for (int i = 0; i < numberOfThreads; ++i)
+  {
+    MultiWorkerState* wsP = new MultiWorkerState();
+
+    wsP->queue               = pQueue;
+    wsP->endpointConcurrency = endpointConcurrency;
+    wsP->endpointPendingMax  = endpointPendingMax;
+    wsP->multi               = NULL;
+    wsP->running             = 0;
+
+    pthread_t  tid;
+    int        rc = pthread_create(&tid, NULL, workerFunc, wsP);
+
+    if (rc != 0)
+    {
+      LM_E(("Internal Error (pthread_create: %s)", strerror(errno)));
+      delete wsP;
+      return rc;
+    }
+  }
+
+  return 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* endpointOf -
+*/
+static std::string endpointOf(SenderThreadParams* params)
+{
+  char portV[STRING_SIZE_FOR_INT];
+
+  snprintf(portV, sizeof(portV), "%d", params->port);
+  return params->ip + ":" + portV;
+}
+
+
+
+/* ****************************************************************************
+*
+* notificationDone - statistics, alarms and subscription error status, after a notification has been sent
+*/
+static void notificationDone(SenderThreadParams* params, int r)
+{
+  if (params->toFree != NULL)
+  {
+    free(params->toFree);
+    params->toFree = NULL;
+  }
+
+  std::string url = endpointOf(params) + params->resource;
+
+  if (r == 0)
+  {
+    statisticsUpdate(NotifyContextSent, params->mimeType);
+    QueueStatistics::incSentOK();
+    alarmMgr.notificationErrorReset(url);
+
+    if (params->registration == false)
+    {
+      subCacheItemNotificationErrorStatus(params->tenant, params->subscriptionId, 0);
+    }
+  }
+  else
+  {
+    QueueStatistics::incSentError();
+    alarmMgr.notificationError(url, "notification failure for multi worker");
+
+    if (params->registration == false)
+    {
+      subCacheItemNotificationErrorStatus(params->tenant, params->subscriptionId, 1);
+    }
+  }
+
+  delete params;
+}
+
+
+
+/* ****************************************************************************
+*
+* transferStart - prepare an easy handle for the notification and add it to the multi handle
+*
+* Returns false if the notification couldn't be started - it has then been taken care of.
+*/
+static bool transferStart(MultiWorkerState* wsP, SenderThreadParams* params, const std::string& endpoint)
+{
+  CURL* curl;
+
+  if (wsP->idleHandles.empty())
+  {
+    curl = curl_easy_init();
+    if (curl == NULL)
+    {
+      LM_E(("Runtime Error (curl_easy_init)"));
+      notificationDone(params, -8);
+      return false;
+    }
+  }
+  else
+  {
+    curl = wsP->idleHandles.back();
+    wsP->idleHandles.pop_back();
+  }
+
+  MultiTransfer* mtP = new MultiTransfer();
+
+  mtP->params   = params;
+  mtP->curl     = curl;
+  mtP->endpoint = endpoint;
+
+  strncpy(transactionId, params->transactionId, sizeof(transactionId));
+
+  LM_T(LmtNotifier, ("multi worker sending '%s' message to: host='%s', port=%d, verb=%s, tenant='%s', service-path: '%s', xauthToken: '%s', path='%s', content-type: %s",
+                     params->protocol.c_str(),
+                     params->ip.c_str(),
+                     params->port,
+                     params->verb.c_str(),
+                     params->tenant.c_str(),
+                     params->servicePath.c_str(),
+                     params->xauthToken.c_str(),
+                     params->resource.c_str(),
+                     params->content_type.c_str()));
+
+  // params->content is not copied by httpRequestPrepare - params lives until the transfer is done
+  int r = httpRequestPrepare(curl,
+                             params->ip,
+                             params->port,
+                             params->protocol,
+                             params->verb,
+                             params->tenant.c_str(),
+                             params->servicePath,
+                             params->xauthToken,
+                             params->resource,
+                             params->content_type,
+                             params->content,
+                             params->fiwareCorrelator,
+                             params->renderFormat,
+                             params->extraHeaders,
+                             "",
+                             -1,
+                             &mtP->transfer);
+
+  if (r == 0)
+  {
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, mtP);
+
+    if (curl_multi_add_handle(wsP->multi, curl) == CURLM_OK)
+    {
+      LM_I(("Sending message %lu to HTTP server: sending message of %d bytes to HTTP server", mtP->transfer.callNo, mtP->transfer.outgoingMsgSize));
+
+      wsP->endpoints[endpoint].inFlight += 1;
+      wsP->running                      += 1;
+
+      return true;
+    }
+
+    LM_E(("Runtime Error (curl_multi_add_handle failed)"));
+
+    std::string out;
+    httpRequestDone(&mtP->transfer, CURLE_FAILED_INIT, &out);
+    r = -9;
+  }
+
+  notificationDone(params, r);
+  delete mtP;
+
+  curl_easy_reset(curl);
+  wsP->idleHandles.push_back(curl);
+
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* endpointUpdate - put the endpoint in the ready list if it has a notification that can be started
+*
+* An endpoint without pending and in-flight notifications is removed, so the endpoint map
+* doesn't grow with every receiver that has ever been notified.
+*/
+static void endpointUpdate(MultiWorkerState* wsP, const std::string& endpoint, MultiEndpoint* epP)
+{
+  if (epP->ready == true)
+  {
+    return;
+  }
+
+  if ((!epP->pending.empty()) && (epP->inFlight < wsP->endpointConcurrency))
+  {
+    epP->ready = true;
+    wsP->ready.push_back(endpoint);
+  }
+  else if ((epP->pending.empty()) && (epP->inFlight == 0))
+  {
+    wsP->endpoints.erase(endpoint);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* pendingAdd - add a notification to the pending list of its endpoint
+*
+* A receiver that doesn't keep up may have at most endpointPendingMax notifications waiting
+* in each worker thread. More than that are dropped, as when the queue is full.
+*/
+static void pendingAdd(MultiWorkerState* wsP, SenderThreadParams* params)
+{
+  std::string     endpoint = endpointOf(params);
+  MultiEndpoint*  epP      = &wsP->endpoints[endpoint];
+
+  if ((int) epP->pending.size() >= wsP->endpointPendingMax)
+  {
+    strncpy(transactionId, params->transactionId, sizeof(transactionId));
+    LM_E(("Runtime Error (too many notifications pending for %s - notification dropped)", endpoint.c_str()));
+    notificationDone(params, -10);
+    return;
+  }
+
+  epP->pending.push_back(params);
+  endpointUpdate(wsP, endpoint, epP);
+}
+
+
+
+/* ****************************************************************************
+*
+* pendingStart - start pending notifications, one endpoint at a time, as long as the thread has free slots
+*/
+static void pendingStart(MultiWorkerState* wsP)
+{
+  while ((!wsP->ready.empty()) && (wsP->running < MULTI_MAX_IN_FLIGHT))
+  {
+    std::string          endpoint = wsP->ready.front();
+    MultiEndpoint*       epP      = &wsP->endpoints[endpoint];
+    SenderThreadParams*  params   = epP->pending.front();
+
+    wsP->ready.pop_front();
+    epP->ready = false;
+    epP->pending.pop_front();
+
+    transferStart(wsP, params, endpoint);
+    endpointUpdate(wsP, endpoint, epP);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* queueDrain - move notifications from the queue to the pending lists of their endpoints
+*
+* The queue is drained as long as the thread has free slots. Notifications for a receiver that
+* is at its limit wait in its pending list and don't take any slot, so a slow receiver can't
+* keep the notifications for other receivers in the queue.
+*
+* Blocks on the queue only if the thread has nothing else to do.
+*/
+static void queueDrain(MultiWorkerState* wsP)
+{
+  for (;;)
+  {
+    std::vector<SenderThreadParams*>* paramsV;
+
+    pendingStart(wsP);
+
+    if (wsP->running >= MULTI_MAX_IN_FLIGHT)
+    {
+      return;
+    }
+
+    if (wsP->running == 0)
+    {
+      paramsV = wsP->queue->pop();
+    }
+    else if (wsP->queue->try_pop(&paramsV) == false)
+    {
+      return;
+    }
+
+    for (unsigned ix = 0; ix < paramsV->size(); ix++)
+    {
+      struct timespec     now;
+      struct timespec     howlong;
+      SenderThreadParams* params = (*paramsV)[ix];
+
+      QueueStatistics::incOut();
+      clock_gettime(CLOCK_REALTIME, &now);
+      clock_difftime(&now, &params->timeStamp, &howlong);
+      QueueStatistics::addTimeInQWithSize(&howlong, wsP->queue->size());
+
+      pendingAdd(wsP, params);
+    }
+
+    delete paramsV;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* transfersCollect - take care of all finished transfers
+*/
+static void transfersCollect(MultiWorkerState* wsP)
+{
+  CURLMsg*  msgP;
+  int       msgsLeft;
+
+  while ((msgP = curl_multi_info_read(wsP->multi, &msgsLeft)) != NULL)
+  {
+    if (msgP->msg != CURLMSG_DONE)
+    {
+      continue;
+    }
+
+    CURL*           curl = msgP->easy_handle;
+    CURLcode        res  = msgP->data.result;
+    MultiTransfer*  mtP  = NULL;
+    std::string     out;
+
+    curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char**) &mtP);
+    curl_multi_remove_handle(wsP->multi, curl);
+
+    strncpy(transactionId, mtP->params->transactionId, sizeof(transactionId));
+
+    int r = httpRequestDone(&mtP->transfer, res, &out);
+
+    std::string     endpoint = mtP->endpoint;
+    MultiEndpoint*  epP      = &wsP->endpoints[endpoint];
+
+    epP->inFlight -= 1;
+    wsP->running  -= 1;
+
+    notificationDone(mtP->params, r);
+    delete mtP;
+
+    curl_easy_reset(curl);
+    wsP->idleHandles.push_back(curl);
+
+    endpointUpdate(wsP, endpoint, epP);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* workerFunc -
+*/
+static void* workerFunc(void* vP)
+{
+  MultiWorkerState* wsP = (MultiWorkerState*) vP;
+
+  wsP->multi = curl_multi_init();
+  if (wsP->multi == NULL)
+  {
+    LM_E(("Runtime Error (curl_multi_init)"));
+    pthread_exit(NULL);
+  }
+
+#ifdef CURLPIPE_MULTIPLEX
+  curl_multi_setopt(wsP->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+
+  // Initialize the state of the thread - used by the subscription cache when updating the notification status
+  orionldStateInit();
+
+  for (;;)
+  {
+    int stillRunning = 0;
+
+    queueDrain(wsP);
+
+    curl_multi_perform(wsP->multi, &stillRunning);
+    transfersCollect(wsP);
+
+    if (wsP->running > 0)
+    {
+      curl_multi_wait(wsP->multi, NULL, 0, 10, NULL);
+    }
+  }
+
+  return NULL;
+}
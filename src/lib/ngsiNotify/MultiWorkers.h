@@ -0,0 +1,63 @@
+#ifndef SRC_LIB_NGSINOTIFY_MULTIWORKERS_H_
+#define SRC_LIB_NGSINOTIFY_MULTIWORKERS_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include "common/SyncQOverflow.h"
+#include "ngsiNotify/senderThread.h"
+
+
+
+/* ****************************************************************************
+*
+* MULTI_MAX_IN_FLIGHT - max number of concurrent transfers of one worker thread
+*/
+#define MULTI_MAX_IN_FLIGHT 512
+
+
+
+/* ****************************************************************************
+*
+* MultiWorkers -
+*
+* A small number of threads, each of them driving many concurrent notifications
+* via a curl multi handle, instead of one blocking send per thread.
+* maxPerEndpoint limits the number of in-flight notifications per thread and receiver (ip:port)
+* maxPending limits the number of notifications per thread and receiver that wait for a free slot
+*/
+class MultiWorkers
+{
+public:
+  MultiWorkers(SyncQOverflow<std::vector<SenderThreadParams*>*>* pQ, int numThreads, int maxPerEndpoint, int maxPending): pQueue(pQ), numberOfThreads(numThreads), endpointConcurrency(maxPerEndpoint), endpointPendingMax(maxPending) {}
+  int start();
+
+private:
+  SyncQOverflow<std::vector<SenderThreadParams*>*>*  pQueue;
+  int                                                numberOfThreads;
+  int                                                endpointConcurrency;
+  int                                                endpointPendingMax;
+};
+
+#endif  // SRC_LIB_NGSINOTIFY_MULTIWORKERS_H_
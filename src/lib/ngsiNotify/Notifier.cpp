@@ -130,13 +130,11 @@ void Notifier::sendNotifyContextRequest
 
 /* ****************************************************************************
 *
-* Notifier::sendNotifyContextAvailabilityRequest -
+* Notifier::buildAvailabilitySenderParams -
 *
-* FIXME: this method is very similar to sendNotifyContextRequest and probably
-* they could be refactored in the future to have a common part using a parent
-* class for both types of notifications and using it as first argument
+* An empty vector is returned if the URL is malformed
 */
-void Notifier::sendNotifyContextAvailabilityRequest
+std::vector<SenderThreadParams*>* Notifier::buildAvailabilitySenderParams
 (
   NotifyContextAvailabilityRequest*  ncar,
   const std::string&                 url,
@@ -145,6 +143,8 @@ void Notifier::sendNotifyContextAvailabilityRequest
   RenderFormat                       renderFormat
 )
 {
+    std::vector<SenderThreadParams*>* paramsV = new std::vector<SenderThreadParams*>;
+
     /* Render NotifyContextAvailabilityRequest */
     std::string payload = ncar->render();
 
@@ -159,14 +159,12 @@ void Notifier::sendNotifyContextAvailabilityRequest
       std::string details = std::string("sending NotifyContextAvailabilityRequest: malformed URL: '") + url + "'";
       alarmMgr.badInput(clientIp, details);
 
-      return;
+      return paramsV;
     }
 
     /* Set Content-Type */
     std::string content_type = "application/json";
 
-    /* Send the message (without awaiting response, in a separate thread to avoid blocking) */
-    pthread_t            tid;
     SenderThreadParams*  params = new SenderThreadParams();
 
     params->ip               = host;
@@ -184,9 +182,41 @@ void Notifier::sendNotifyContextAvailabilityRequest
 
     strncpy(params->transactionId, transactionId, sizeof(params->transactionId));
 
-    std::vector<SenderThreadParams*>* paramsV = new std::vector<SenderThreadParams*>;
     paramsV->push_back(params);
 
+    return paramsV;
+}
+
+
+
+/* ****************************************************************************
+*
+* Notifier::sendNotifyContextAvailabilityRequest -
+*
+* FIXME: this method is very similar to sendNotifyContextRequest and probably
+* they could be refactored in the future to have a common part using a parent
+* class for both types of notifications and using it as first argument
+*/
+void Notifier::sendNotifyContextAvailabilityRequest
+(
+  NotifyContextAvailabilityRequest*  ncar,
+  const std::string&                 url,
+  const std::string&                 tenant,
+  const std::string&                 fiwareCorrelator,
+  RenderFormat                       renderFormat
+)
+{
+    std::vector<SenderThreadParams*>* paramsV = buildAvailabilitySenderParams(ncar, url, tenant, fiwareCorrelator, renderFormat);
+
+    if (paramsV->empty())
+    {
+      delete paramsV;
+      return;
+    }
+
+    /* Send the message (without awaiting response, in a separate thread to avoid blocking) */
+    pthread_t tid;
+
     int ret = pthread_create(&tid, NULL, startSenderThread, paramsV);
     if (ret != 0)
     {
@@ -73,6 +73,12 @@ protected:
                                                              const std::vector<std::string>&  metadataFilter,
                                                              bool                             blackList
   );
+
+  static std::vector<SenderThreadParams*>* buildAvailabilitySenderParams(NotifyContextAvailabilityRequest*  ncar,
+                                                                         const std::string&                 url,
+                                                                         const std::string&                 tenant,
+                                                                         const std::string&                 fiwareCorrelator,
+                                                                         RenderFormat                       renderFormat);
 };
 
 #endif  // SRC_LIB_NGSINOTIFY_NOTIFIER_H_
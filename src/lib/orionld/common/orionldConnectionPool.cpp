@@ -0,0 +1,323 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string.h>                                              // strcmp, strncpy
+#include <stdlib.h>                                              // malloc, free
+#include <unistd.h>                                              // close
+#include <time.h>                                                // time
+#include <poll.h>                                                // poll
+#include <pthread.h>                                             // pthread_mutex_t
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/common/orionldServerConnect.h"                 // orionldServerConnect
+#include "orionld/common/orionldConnectionPool.h"                // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// PooledConnection - an idle keep-alive connection
+//
+typedef struct PooledConnection
+{
+  int                       fd;
+  time_t                    lastUsed;
+  struct PooledConnection*  next;
+} PooledConnection;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// PoolEndpoint - the idle connections to one host:port
+//
+// The idle list is LIFO - the most recently used connection is the first one to be reused,
+// which leaves the older ones to expire if the traffic goes down.
+//
+typedef struct PoolEndpoint
+{
+  char                  host[128];
+  uint16_t              port;
+  PooledConnection*     idleList;
+  int                   idle;
+  struct PoolEndpoint*  next;
+} PoolEndpoint;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Pool state
+//
+static pthread_mutex_t  poolMutex          = PTHREAD_MUTEX_INITIALIZER;
+static PoolEndpoint*    endpointList       = NULL;
+static int              poolMaxIdle        = 0;
+static int              poolIdleTimeout    = 0;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldConnectionPoolInit -
+//
+void orionldConnectionPoolInit(int maxIdlePerEndpoint, int idleTimeout)
+{
+  poolMaxIdle     = maxIdlePerEndpoint;
+  poolIdleTimeout = idleTimeout;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// endpointLookup - find an endpoint, creating it if 'create' is set
+//
+// The pool mutex must be taken by the caller
+//
+static PoolEndpoint* endpointLookup(const char* host, uint16_t port, bool create)
+{
+  for (PoolEndpoint* epP = endpointList; epP != NULL; epP = epP->next)
+  {
+    if ((epP->port == port) && (strcmp(epP->host, host) == 0))
+      return epP;
+  }
+
+  if (create == false)
+    return NULL;
+
+  PoolEndpoint* epP = (PoolEndpoint*) calloc(1, sizeof(PoolEndpoint));
+
+  if (epP == NULL)
+    return NULL;
+
+  strncpy(epP->host, host, sizeof(epP->host) - 1);
+  epP->port    = port;
+  epP->next    = endpointList;
+  endpointList = epP;
+
+  return epP;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// connectionAlive - check that an idle connection has not been closed by the peer
+//
+// An idle keep-alive connection has nothing to read. If it is readable, the peer has closed it
+// (read would return 0) or has sent something we never asked for - either way it can't be reused.
+//
+static bool connectionAlive(int fd)
+{
+  struct pollfd pfd = { fd, POLLIN, 0 };
+
+  if (poll(&pfd, 1, 0) != 0)
+    return false;
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// idleListPurge - close the connections that have been idle for too long
+//
+// The pool mutex must be taken by the caller.
+// As the list is LIFO, once an expired connection is found, all the rest are expired as well.
+//
+static void idleListPurge(PoolEndpoint* epP, time_t now)
+{
+  PooledConnection* prev = NULL;
+  PooledConnection* pcP  = epP->idleList;
+
+  while ((pcP != NULL) && (now - pcP->lastUsed < poolIdleTimeout))
+  {
+    prev = pcP;
+    pcP  = pcP->next;
+  }
+
+  if (prev == NULL)
+    epP->idleList = NULL;
+  else
+    prev->next = NULL;
+
+  while (pcP != NULL)
+  {
+    PooledConnection* next = pcP->next;
+
+    LM_T(LmtNotifier, ("Closing idle connection %d to %s:%d", pcP->fd, epP->host, epP->port));
+    close(pcP->fd);
+    free(pcP);
+    --epP->idle;
+
+    pcP = next;
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldConnectionGet -
+//
+int orionldConnectionGet(const char* host, uint16_t port, bool* reusedP)
+{
+  *reusedP = false;
+
+  if (poolMaxIdle > 0)
+  {
+    int    fd  = -1;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&poolMutex);
+
+    PoolEndpoint* epP = endpointLookup(host, port, false);
+
+    if (epP != NULL)
+    {
+      idleListPurge(epP, now);
+
+      while ((fd == -1) && (epP->idleList != NULL))
+      {
+        PooledConnection* pcP = epP->idleList;
+
+        epP->idleList = pcP->next;
+        --epP->idle;
+
+        if (connectionAlive(pcP->fd) == true)
+          fd = pcP->fd;
+        else
+        {
+          LM_T(LmtNotifier, ("Idle connection %d to %s:%d was closed by the peer", pcP->fd, host, port));
+          close(pcP->fd);
+        }
+
+        free(pcP);
+      }
+    }
+
+    pthread_mutex_unlock(&poolMutex);
+
+    if (fd != -1)
+    {
+      *reusedP = true;
+      return fd;
+    }
+  }
+
+  //
+  // No idle connection - connect outside the mutex, connecting may take a while
+  //
+  return orionldServerConnect((char*) host, port);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldConnectionPut -
+//
+void orionldConnectionPut(const char* host, uint16_t port, int fd, bool keepAlive)
+{
+  if (fd == -1)
+    return;
+
+  if ((keepAlive == false) || (poolMaxIdle <= 0))
+  {
+    close(fd);
+    return;
+  }
+
+  PooledConnection* pcP = (PooledConnection*) malloc(sizeof(PooledConnection));
+
+  if (pcP == NULL)
+  {
+    close(fd);
+    return;
+  }
+
+  time_t now = time(NULL);
+
+  pcP->fd       = fd;
+  pcP->lastUsed = now;
+
+  pthread_mutex_lock(&poolMutex);
+
+  PoolEndpoint* epP = endpointLookup(host, port, true);
+
+  if (epP != NULL)
+    idleListPurge(epP, now);
+
+  if ((epP == NULL) || (epP->idle >= poolMaxIdle))
+  {
+    pthread_mutex_unlock(&poolMutex);
+    close(fd);
+    free(pcP);
+    return;
+  }
+
+  pcP->next     = epP->idleList;
+  epP->idleList = pcP;
+  ++epP->idle;
+
+  pthread_mutex_unlock(&poolMutex);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldConnectionPoolRelease -
+//
+void orionldConnectionPoolRelease(void)
+{
+  pthread_mutex_lock(&poolMutex);
+
+  PoolEndpoint* epP = endpointList;
+
+  while (epP != NULL)
+  {
+    PoolEndpoint*     next = epP->next;
+    PooledConnection* pcP  = epP->idleList;
+
+    while (pcP != NULL)
+    {
+      PooledConnection* nextPc = pcP->next;
+
+      close(pcP->fd);
+      free(pcP);
+      pcP = nextPc;
+    }
+
+    free(epP);
+    epP = next;
+  }
+
+  endpointList = NULL;
+
+  pthread_mutex_unlock(&poolMutex);
+}
@@ -0,0 +1,72 @@
+#ifndef SRC_LIB_ORIONLD_COMMON_ORIONLDCONNECTIONPOOL_H_
+#define SRC_LIB_ORIONLD_COMMON_ORIONLDCONNECTIONPOOL_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdint.h>                                              // uint16_t
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldConnectionPoolInit - initialize the pool of keep-alive connections for notifications
+//
+// maxIdlePerEndpoint:  max number of idle connections kept per host:port (0: no pooling)
+// idleTimeout:         seconds an idle connection is kept before it is closed
+//
+extern void orionldConnectionPoolInit(int maxIdlePerEndpoint, int idleTimeout);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldConnectionGet - get a connection to host:port, reusing an idle one if possible
+//
+// *reusedP is set to true if the connection was taken from the pool.
+// A reused connection may have been closed by the peer after the liveness check, so, if the
+// first write fails, the caller should close it and retry once on a fresh connection.
+//
+extern int orionldConnectionGet(const char* host, uint16_t port, bool* reusedP);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldConnectionPut - give back a connection after its response has been read
+//
+// If 'keepAlive' is false, or if the endpoint already has its max number of idle connections,
+// the connection is closed.
+//
+extern void orionldConnectionPut(const char* host, uint16_t port, int fd, bool keepAlive);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldConnectionPoolRelease - close all idle connections and free the pool
+//
+extern void orionldConnectionPoolRelease(void);
+
+#endif  // SRC_LIB_ORIONLD_COMMON_ORIONLDCONNECTIONPOOL_H_
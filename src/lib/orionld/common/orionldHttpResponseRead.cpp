@@ -0,0 +1,440 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string.h>                                              // memmove, memchr, strncasecmp
+#include <strings.h>                                             // strncasecmp
+#include <stdlib.h>                                              // strtol
+#include <unistd.h>                                              // read
+#include <errno.h>                                               // errno
+#include <poll.h>                                                // poll
+#include <sys/time.h>                                            // gettimeofday
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/common/orionldHttpResponseRead.h"              // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// ResponseReader - buffered reader over a socket, with an absolute deadline
+//
+typedef struct ResponseReader
+{
+  int    fd;
+  char*  buf;
+  int    bufSize;
+  int    start;      // First unconsumed byte in buf
+  int    end;        // One after the last byte read into buf
+  long   deadline;   // In milliseconds since the epoch
+  bool   eof;        // The peer has closed the connection
+} ResponseReader;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// msNow -
+//
+static long msNow(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// readerFill - read more bytes into the buffer, waiting at most until the deadline
+//
+// Returns false on timeout, on read error and on EOF.
+//
+static bool readerFill(ResponseReader* rP)
+{
+  if (rP->eof == true)
+    return false;
+
+  // Make room at the end of the buffer
+  if (rP->start > 0)
+  {
+    memmove(rP->buf, &rP->buf[rP->start], rP->end - rP->start);
+    rP->end  -= rP->start;
+    rP->start = 0;
+  }
+
+  if (rP->end >= rP->bufSize)
+  {
+    LM_E(("Internal Error (HTTP response line too long for the read buffer of %d bytes)", rP->bufSize));
+    return false;
+  }
+
+  while (1)
+  {
+    long timeLeft = rP->deadline - msNow();
+
+    if (timeLeft <= 0)
+    {
+      LM_W(("Timeout awaiting HTTP response"));
+      return false;
+    }
+
+    struct pollfd pfd = { rP->fd, POLLIN, 0 };
+    int           fds = poll(&pfd, 1, (int) timeLeft);
+
+    if (fds == -1)
+    {
+      if (errno == EINTR)
+        continue;
+
+      LM_E(("Internal Error (poll error awaiting HTTP response: %s)", strerror(errno)));
+      return false;
+    }
+    else if (fds == 0)
+      continue;  // The deadline will be detected in the next lap
+
+    int nb = read(rP->fd, &rP->buf[rP->end], rP->bufSize - rP->end);
+
+    if (nb == -1)
+    {
+      if ((errno == EINTR) || (errno == EAGAIN))
+        continue;
+
+      LM_E(("Internal Error (error reading HTTP response: %s)", strerror(errno)));
+      return false;
+    }
+
+    if (nb == 0)
+    {
+      rP->eof = true;
+      return false;
+    }
+
+    rP->end += nb;
+    return true;
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// readerLine - get the next line, without its CRLF (or LF), zero-terminated inside the buffer
+//
+static char* readerLine(ResponseReader* rP)
+{
+  while (1)
+  {
+    char* nl = (char*) memchr(&rP->buf[rP->start], '\n', rP->end - rP->start);
+
+    if (nl != NULL)
+    {
+      char* line = &rP->buf[rP->start];
+
+      rP->start = nl - rP->buf + 1;
+
+      *nl = 0;
+      if ((nl > line) && (nl[-1] == '\r'))
+        nl[-1] = 0;
+
+      return line;
+    }
+
+    if (readerFill(rP) == false)
+      return NULL;
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// readerSkip - consume 'bytes' bytes (of the body)
+//
+static bool readerSkip(ResponseReader* rP, long bytes)
+{
+  while (bytes > 0)
+  {
+    if (rP->start == rP->end)
+    {
+      if (readerFill(rP) == false)
+        return false;
+    }
+
+    long available = rP->end - rP->start;
+    long consume   = (available < bytes)? available : bytes;
+
+    rP->start += consume;
+    bytes     -= consume;
+  }
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// readerSkipToEof - consume everything until the peer closes the connection
+//
+static long readerSkipToEof(ResponseReader* rP)
+{
+  long bytes = 0;
+
+  while (1)
+  {
+    bytes += rP->end - rP->start;
+    rP->start = rP->end;
+
+    if (readerFill(rP) == false)
+      break;
+  }
+
+  return bytes;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// headerIs - case insensitive comparison of a header name, returns a pointer to the value or NULL
+//
+static char* headerIs(char* line, const char* name)
+{
+  int nameLen = strlen(name);
+
+  if ((strncasecmp(line, name, nameLen) != 0) || (line[nameLen] != ':'))
+    return NULL;
+
+  char* value = &line[nameLen + 1];
+
+  while ((*value == ' ') || (*value == '\t'))
+    ++value;
+
+  return value;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// tokenPresent - is 'token' one of the comma-separated tokens in 'value' (case insensitive)?
+//
+static bool tokenPresent(const char* value, const char* token)
+{
+  int tokenLen = strlen(token);
+
+  while (*value != 0)
+  {
+    while ((*value == ' ') || (*value == '\t') || (*value == ','))
+      ++value;
+
+    if ((strncasecmp(value, token, tokenLen) == 0) && ((value[tokenLen] == 0) || (value[tokenLen] == ',') || (value[tokenLen] == ' ') || (value[tokenLen] == ';')))
+      return true;
+
+    while ((*value != 0) && (*value != ','))
+      ++value;
+  }
+
+  return false;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// chunkedBodyRead - consume a chunked body, including the trailer
+//
+static bool chunkedBodyRead(ResponseReader* rP, long* bodySizeP)
+{
+  while (1)
+  {
+    char* line = readerLine(rP);
+
+    if (line == NULL)
+      return false;
+
+    char* end;
+    long  chunkSize = strtol(line, &end, 16);  // Chunk extensions (';...') are ignored
+
+    if ((end == line) || (chunkSize < 0))
+    {
+      LM_E(("Internal Error (invalid chunk size in HTTP response: '%s')", line));
+      return false;
+    }
+
+    if (chunkSize == 0)
+      break;
+
+    if (readerSkip(rP, chunkSize) == false)
+      return false;
+
+    *bodySizeP += chunkSize;
+
+    // The CRLF that ends the chunk data
+    if ((line = readerLine(rP)) == NULL)
+      return false;
+
+    if (*line != 0)
+    {
+      LM_E(("Internal Error (chunk data of HTTP response not followed by CRLF)"));
+      return false;
+    }
+  }
+
+  // Trailer fields, until an empty line
+  while (1)
+  {
+    char* line = readerLine(rP);
+
+    if (line == NULL)
+      return false;
+
+    if (*line == 0)
+      return true;
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldHttpResponseRead -
+//
+bool orionldHttpResponseRead(int fd, char* buf, int bufSize, int timeoutMs, OrionldHttpResponse* responseP)
+{
+  ResponseReader  reader        = { fd, buf, bufSize, 0, 0, msNow() + timeoutMs, false };
+  long            contentLength = -1;
+  bool            chunked       = false;
+  char*           line;
+
+  responseP->httpStatus = 0;
+  responseP->bodySize   = 0;
+  responseP->keepAlive  = false;
+
+  //
+  // Status line - "HTTP/1.1 200 OK"
+  // Interim responses (1xx) have no body - they're skipped and the final response is read
+  //
+  while (1)
+  {
+    int minor;
+
+    if ((line = readerLine(&reader)) == NULL)
+      return false;
+
+    if (*line == 0)  // Tolerating empty lines before the status line (RFC 7230, section 3.5)
+      continue;
+
+    if ((strncmp(line, "HTTP/1.", 7) != 0) || (line[7] < '0') || (line[7] > '9') || (line[8] != ' '))
+    {
+      LM_E(("Internal Error (invalid status line in HTTP response: '%s')", line));
+      return false;
+    }
+
+    minor                 = line[7] - '0';
+    responseP->httpStatus = atoi(&line[9]);
+    responseP->keepAlive  = (minor >= 1);  // HTTP/1.0 closes the connection unless 'Connection: keep-alive'
+    contentLength         = -1;
+    chunked               = false;
+
+    if ((responseP->httpStatus < 100) || (responseP->httpStatus > 999))
+    {
+      LM_E(("Internal Error (invalid status code in HTTP response: '%s')", line));
+      return false;
+    }
+
+    //
+    // Header fields
+    //
+    while (1)
+    {
+      char* value;
+
+      if ((line = readerLine(&reader)) == NULL)
+        return false;
+
+      if (*line == 0)
+        break;
+
+      if ((value = headerIs(line, "Content-Length")) != NULL)
+        contentLength = strtol(value, NULL, 10);
+      else if ((value = headerIs(line, "Transfer-Encoding")) != NULL)
+        chunked = tokenPresent(value, "chunked");
+      else if ((value = headerIs(line, "Connection")) != NULL)
+      {
+        if (tokenPresent(value, "close") == true)
+          responseP->keepAlive = false;
+        else if (tokenPresent(value, "keep-alive") == true)
+          responseP->keepAlive = true;
+      }
+    }
+
+    if (responseP->httpStatus >= 200)
+      break;
+  }
+
+  //
+  // Body
+  //
+  if ((responseP->httpStatus == 204) || (responseP->httpStatus == 304))
+    responseP->bodySize = 0;
+  else if (chunked == true)  // Transfer-Encoding overrides Content-Length (RFC 7230, section 3.3.3)
+  {
+    if (chunkedBodyRead(&reader, &responseP->bodySize) == false)
+      return false;
+  }
+  else if (contentLength >= 0)
+  {
+    if (readerSkip(&reader, contentLength) == false)
+      return false;
+
+    responseP->bodySize = contentLength;
+  }
+  else
+  {
+    //
+    // No length - the body ends when the peer closes the connection
+    //
+    responseP->bodySize  = readerSkipToEof(&reader);
+    responseP->keepAlive = false;
+
+    if (reader.eof == false)
+      return false;
+  }
+
+  //
+  // Anything after the response is unexpected (we never pipeline) - the connection can't be reused
+  //
+  if (reader.start != reader.end)
+  {
+    LM_W(("%d unexpected bytes after HTTP response - closing the connection", reader.end - reader.start));
+    responseP->keepAlive = false;
+  }
+
+  return true;
+}
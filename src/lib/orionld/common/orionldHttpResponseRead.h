@@ -0,0 +1,58 @@
+#ifndef SRC_LIB_ORIONLD_COMMON_ORIONLDHTTPRESPONSEREAD_H_
+#define SRC_LIB_ORIONLD_COMMON_ORIONLDHTTPRESPONSEREAD_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+
+
+
+// -----------------------------------------------------------------------------
+//
+// OrionldHttpResponse - the parts of an HTTP response the notification sender is interested in
+//
+typedef struct OrionldHttpResponse
+{
+  int   httpStatus;    // Status code of the final (non 1xx) response
+  long  bodySize;      // Size of the body (after de-chunking)
+  bool  keepAlive;     // The connection can be reused for another request
+} OrionldHttpResponse;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldHttpResponseRead - read and parse an entire HTTP/1.x response
+//
+// The body is delimited using Content-Length, chunked Transfer-Encoding or, if none of them is
+// present, by the peer closing the connection. The body is read but not kept.
+//
+// 'buf' is used as read buffer - the status line and each header line must fit in it.
+// 'timeoutMs' is the max time to wait for the entire response.
+//
+// Returns false on timeout, connection error or unparsable response - the connection must then be closed.
+//
+extern bool orionldHttpResponseRead(int fd, char* buf, int bufSize, int timeoutMs, OrionldHttpResponse* responseP);
+
+#endif  // SRC_LIB_ORIONLD_COMMON_ORIONLDHTTPRESPONSEREAD_H_
@@ -0,0 +1,437 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdio.h>                                             // snprintf
+#include <string.h>                                            // strcmp, strncpy, memcpy
+#include <stdlib.h>                                            // malloc, realloc, free
+#include <time.h>                                              // clock_gettime
+#include <pthread.h>                                           // pthread_mutex_*
+#include <curl/curl.h>                                         // curl
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/common/orionldState.h"                       // orionldStateDelayedFreeEnqueue
+#include "orionld/common/orionldRequestSendMulti.h"            // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// SourceStatistics - list of per-source statistics
+//
+typedef struct SourceStatistics
+{
+  OrionldSourceStatistics   stats;
+  struct SourceStatistics*  next;
+} SourceStatistics;
+
+static SourceStatistics*  sourceStatsList  = NULL;
+static pthread_mutex_t    sourceStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// sourceStatisticsUpdate -
+//
+static void sourceStatisticsUpdate(OrionldMultiRequest* requestP)
+{
+  pthread_mutex_lock(&sourceStatsMutex);
+
+  SourceStatistics* ssP = sourceStatsList;
+
+  while (ssP != NULL)
+  {
+    if (strcmp(ssP->stats.source, requestP->source) == 0)
+      break;
+    ssP = ssP->next;
+  }
+
+  if (ssP == NULL)
+  {
+    ssP = (SourceStatistics*) calloc(1, sizeof(SourceStatistics));
+
+    if (ssP == NULL)
+    {
+      pthread_mutex_unlock(&sourceStatsMutex);
+      LM_E(("Runtime Error (out of memory)"));
+      return;
+    }
+
+    strncpy(ssP->stats.source, requestP->source, sizeof(ssP->stats.source) - 1);
+    ssP->next       = sourceStatsList;
+    sourceStatsList = ssP;
+  }
+
+  ssP->stats.requests   += 1;
+  ssP->stats.latencySum += requestP->latency;
+
+  if ((uint64_t) requestP->latency > ssP->stats.latencyMax)
+    ssP->stats.latencyMax = requestP->latency;
+
+  if (requestP->ok == false)
+    ssP->stats.failures += 1;
+
+  if (requestP->timedOut == true)
+    ssP->stats.timeouts += 1;
+
+  pthread_mutex_unlock(&sourceStatsMutex);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldRequestSendMultiStatisticsGet -
+//
+int orionldRequestSendMultiStatisticsGet(OrionldSourceStatistics* statsV, int maxSources)
+{
+  int sources = 0;
+
+  pthread_mutex_lock(&sourceStatsMutex);
+
+  for (SourceStatistics* ssP = sourceStatsList; (ssP != NULL) && (sources < maxSources); ssP = ssP->next)
+  {
+    statsV[sources] = ssP->stats;
+    ++sources;
+  }
+
+  pthread_mutex_unlock(&sourceStatsMutex);
+
+  return sources;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldRequestSendMultiStatisticsReset -
+//
+void orionldRequestSendMultiStatisticsReset(void)
+{
+  pthread_mutex_lock(&sourceStatsMutex);
+
+  SourceStatistics* ssP = sourceStatsList;
+
+  while (ssP != NULL)
+  {
+    SourceStatistics* next = ssP->next;
+
+    free(ssP);
+    ssP = next;
+  }
+
+  sourceStatsList = NULL;
+
+  pthread_mutex_unlock(&sourceStatsMutex);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// millisecondsSince -
+//
+static int millisecondsSince(struct timespec* startP)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - startP->tv_sec) * 1000 + (now.tv_nsec - startP->tv_nsec) / 1000000;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// writeCallback -
+//
+static size_t writeCallback(void* contents, size_t size, size_t members, void* userP)
+{
+  size_t                bytesToCopy = size * members;
+  OrionldMultiRequest*  requestP    = (OrionldMultiRequest*) userP;
+  int                   xtraBytes   = 512;
+
+  if (bytesToCopy + requestP->bufUsed >= requestP->bufSize)
+  {
+    requestP->buf     = (char*) realloc(requestP->buf, requestP->bufSize + bytesToCopy + xtraBytes);
+    requestP->bufSize = requestP->bufSize + bytesToCopy + xtraBytes;
+
+    if (requestP->buf == NULL)
+      LM_X(1, ("Runtime Error (out of memory)"));
+  }
+
+  memcpy(&requestP->buf[requestP->bufUsed], contents, bytesToCopy);
+
+  requestP->bufUsed += bytesToCopy;
+  requestP->buf[requestP->bufUsed] = 0;
+
+  return bytesToCopy;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// headerName -
+//
+static const char* headerName[7] = {
+  "None",
+  "Content-Type",
+  "Accept",
+  "Link",
+  "NGSILD-Tenant",
+  "NGSILD-Path",
+  "X-Auth-Token"
+};
+
+
+
+// -----------------------------------------------------------------------------
+//
+// requestPrepare - create and setup the curl handle of a request
+//
+static bool requestPrepare(OrionldMultiRequest* requestP, int tmoInMilliSeconds)
+{
+  requestP->ok          = false;
+  requestP->timedOut    = false;
+  requestP->httpStatus  = 0;
+  requestP->responseBuf = NULL;
+  requestP->latency     = 0;
+  requestP->headers     = NULL;
+  requestP->bufUsed     = 0;
+  requestP->bufSize     = 2048;
+  requestP->buf         = (char*) malloc(requestP->bufSize);
+
+  if (requestP->buf == NULL)
+    LM_X(1, ("Runtime Error (out of memory)"));
+
+  requestP->buf[0] = 0;
+
+  if (requestP->port != 0)
+    snprintf(requestP->source, sizeof(requestP->source), "%s://%s:%d", requestP->protocol, requestP->ip, requestP->port);
+  else
+    snprintf(requestP->source, sizeof(requestP->source), "%s://%s", requestP->protocol, requestP->ip);
+
+  if (requestP->urlPath != NULL)
+    snprintf(requestP->url, sizeof(requestP->url), "%s%s", requestP->source, requestP->urlPath);
+  else
+    snprintf(requestP->url, sizeof(requestP->url), "%s", requestP->source);
+
+  //
+  // A handle of its own for each request - the per-host curl contexts of orionldRequestSend are locked
+  // during the request and two context sources on the same host would deadlock
+  //
+  requestP->curl = curl_easy_init();
+  if (requestP->curl == NULL)
+  {
+    LM_E(("Internal Error (Unable to create a CURL handle)"));
+    return false;
+  }
+
+  if (requestP->linkHeader != NULL)
+  {
+    char linkHeaderString[512];
+
+    snprintf(linkHeaderString, sizeof(linkHeaderString), "Link: %s", requestP->linkHeader);
+    requestP->headers = curl_slist_append(requestP->headers, linkHeaderString);
+  }
+
+  if (requestP->acceptHeader != NULL)
+    requestP->headers = curl_slist_append(requestP->headers, requestP->acceptHeader);
+
+  for (int ix = 0; (requestP->headerV != NULL) && (requestP->headerV[ix].type != HttpHeaderNone); ix++)
+  {
+    OrionldHttpHeader* headerP = &requestP->headerV[ix];
+    char               headerString[256];
+
+    snprintf(headerString, sizeof(headerString), "%s:%s", headerName[headerP->type], headerP->value);
+    requestP->headers = curl_slist_append(requestP->headers, headerString);
+  }
+
+  curl_easy_setopt(requestP->curl, CURLOPT_URL, requestP->url);                   // Set the URL Path
+  curl_easy_setopt(requestP->curl, CURLOPT_CUSTOMREQUEST, requestP->verb);        // Set the HTTP verb
+  curl_easy_setopt(requestP->curl, CURLOPT_FOLLOWLOCATION, 1L);                   // Follow redirections
+  curl_easy_setopt(requestP->curl, CURLOPT_WRITEFUNCTION, writeCallback);         // Callback function for writes
+  curl_easy_setopt(requestP->curl, CURLOPT_WRITEDATA, requestP);                  // Custom data for response handling
+  curl_easy_setopt(requestP->curl, CURLOPT_TIMEOUT_MS, (long) tmoInMilliSeconds); // Timeout
+  curl_easy_setopt(requestP->curl, CURLOPT_NOSIGNAL, 1L);                         // No signals - we're in a thread
+  curl_easy_setopt(requestP->curl, CURLOPT_FAILONERROR, true);                    // Fail On Error - to detect 404 etc.
+  curl_easy_setopt(requestP->curl, CURLOPT_PRIVATE, (char*) requestP);            // To find the request from the handle
+
+  if (requestP->headers != NULL)
+    curl_easy_setopt(requestP->curl, CURLOPT_HTTPHEADER, requestP->headers);
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// requestFinish - release the curl handle of a finished request and report it to the caller
+//
+static void requestFinish
+(
+  CURLM*                        multi,
+  OrionldMultiRequest*          requestP,
+  CURLcode                      cCode,
+  OrionldMultiResponseFunction  responseFunction,
+  void*                         dataP
+)
+{
+  requestP->latency = millisecondsSince(&requestP->startTime);
+
+  if (requestP->curl != NULL)
+  {
+    curl_easy_getinfo(requestP->curl, CURLINFO_RESPONSE_CODE, &requestP->httpStatus);
+    curl_multi_remove_handle(multi, requestP->curl);
+    curl_easy_cleanup(requestP->curl);
+    requestP->curl = NULL;
+  }
+
+  if (requestP->headers != NULL)
+  {
+    curl_slist_free_all(requestP->headers);
+    requestP->headers = NULL;
+  }
+
+  if (cCode == CURLE_OPERATION_TIMEDOUT)
+    requestP->timedOut = true;
+
+  if (cCode == CURLE_OK)
+  {
+    requestP->ok          = true;
+    requestP->responseBuf = requestP->buf;
+    orionldStateDelayedFreeEnqueue(requestP->buf);  // Trees parsed from the buffer point into it
+  }
+  else
+  {
+    LM_T(LmtRequestSend, ("Request to %s failed (curl error %d: %s, HTTP status %ld)", requestP->url, cCode, curl_easy_strerror(cCode), requestP->httpStatus));
+    free(requestP->buf);
+  }
+
+  requestP->buf = NULL;
+
+  sourceStatisticsUpdate(requestP);
+
+  if (responseFunction != NULL)
+    responseFunction(requestP, dataP);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldRequestSendMulti - send a number of requests in parallel and await their responses
+//
+int orionldRequestSendMulti
+(
+  OrionldMultiRequest*          requestV,
+  int                           requests,
+  int                           deadlineInMilliSeconds,
+  OrionldMultiResponseFunction  responseFunction,
+  void*                         dataP
+)
+{
+  struct timespec  start;
+  int              oks   = 0;
+  CURLM*           multi = curl_multi_init();
+
+  if (multi == NULL)
+  {
+    LM_E(("Internal Error (curl_multi_init failed)"));
+    return 0;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int ix = 0; ix < requests; ix++)
+  {
+    OrionldMultiRequest* requestP = &requestV[ix];
+
+    requestP->startTime = start;
+
+    if (requestPrepare(requestP, deadlineInMilliSeconds) == false)
+      requestFinish(multi, requestP, CURLE_FAILED_INIT, responseFunction, dataP);
+    else if (curl_multi_add_handle(multi, requestP->curl) != CURLM_OK)
+    {
+      LM_E(("Internal Error (curl_multi_add_handle failed)"));
+      requestFinish(multi, requestP, CURLE_FAILED_INIT, responseFunction, dataP);
+    }
+  }
+
+  //
+  // Responses are handed to the caller as they come in, until all requests have finished or the deadline expires
+  //
+  int stillRunning = 1;
+
+  while (stillRunning > 0)
+  {
+    CURLMsg*  msgP;
+    int       msgsLeft;
+
+    curl_multi_perform(multi, &stillRunning);
+
+    while ((msgP = curl_multi_info_read(multi, &msgsLeft)) != NULL)
+    {
+      OrionldMultiRequest* requestP = NULL;
+
+      if (msgP->msg != CURLMSG_DONE)
+        continue;
+
+      curl_easy_getinfo(msgP->easy_handle, CURLINFO_PRIVATE, (char**) &requestP);
+      requestFinish(multi, requestP, msgP->data.result, responseFunction, dataP);
+    }
+
+    if (stillRunning == 0)
+      break;
+
+    int msLeft = deadlineInMilliSeconds - millisecondsSince(&start);
+    if (msLeft <= 0)
+      break;
+
+    curl_multi_wait(multi, NULL, 0, (msLeft < 100)? msLeft : 100, NULL);
+  }
+
+  //
+  // Whatever is still running when the deadline expires is aborted
+  //
+  for (int ix = 0; ix < requests; ix++)
+  {
+    OrionldMultiRequest* requestP = &requestV[ix];
+
+    if (requestP->curl != NULL)
+      requestFinish(multi, requestP, CURLE_OPERATION_TIMEDOUT, responseFunction, dataP);
+
+    if (requestP->ok == true)
+      ++oks;
+  }
+
+  curl_multi_cleanup(multi);
+
+  return oks;
+}
@@ -0,0 +1,135 @@
+#ifndef SRC_LIB_ORIONLD_COMMON_ORIONLDREQUESTSENDMULTI_H_
+#define SRC_LIB_ORIONLD_COMMON_ORIONLDREQUESTSENDMULTI_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdint.h>                                            // uint16_t, uint64_t
+#include <time.h>                                              // struct timespec
+#include <curl/curl.h>                                         // CURL, curl_slist
+
+#include "orionld/common/orionldRequestSend.h"                 // OrionldHttpHeader
+
+
+
+// -----------------------------------------------------------------------------
+//
+// OrionldMultiRequest - one of the requests sent in parallel by orionldRequestSendMulti
+//
+// The response buffer is freed when the request thread ends (trees parsed from it may point into it).
+//
+typedef struct OrionldMultiRequest
+{
+  // Input
+  const char*          protocol;
+  const char*          ip;
+  uint16_t             port;
+  const char*          verb;
+  const char*          urlPath;
+  const char*          linkHeader;
+  const char*          acceptHeader;
+  OrionldHttpHeader*   headerV;
+
+  // Output
+  bool                 ok;             // A 2xx response has been received
+  bool                 timedOut;       // The deadline expired before the response came in
+  long                 httpStatus;     // 0 if no response at all
+  char*                responseBuf;    // The body of the response, zero-terminated (NULL if not ok)
+  int                  latency;        // Milliseconds until the response (or the failure)
+
+  // Internal
+  CURL*                curl;
+  struct curl_slist*   headers;
+  char                 url[256];
+  char                 source[160];    // protocol://ip:port - the key of the per-source statistics
+  char*                buf;
+  size_t               bufSize;
+  size_t               bufUsed;
+  struct timespec      startTime;
+} OrionldMultiRequest;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// OrionldMultiResponseFunction - called for each request as soon as it has finished (or failed)
+//
+typedef void (*OrionldMultiResponseFunction)(OrionldMultiRequest* requestP, void* dataP);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldRequestSendMulti - send a number of requests in parallel and await their responses
+//
+// All requests are sent at once and 'responseFunction' is called for each of them as its response
+// arrives. Requests still running when 'deadlineInMilliSeconds' expires are aborted (timedOut),
+// so the caller gets whatever responses arrived in time.
+//
+// Returns the number of requests that got a 2xx response.
+//
+extern int orionldRequestSendMulti
+(
+  OrionldMultiRequest*          requestV,
+  int                           requests,
+  int                           deadlineInMilliSeconds,
+  OrionldMultiResponseFunction  responseFunction,
+  void*                         dataP
+);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// OrionldSourceStatistics - counters of the requests forwarded to one context source
+//
+typedef struct OrionldSourceStatistics
+{
+  char      source[160];
+  uint64_t  requests;
+  uint64_t  failures;        // Including timeouts
+  uint64_t  timeouts;
+  uint64_t  latencySum;      // Milliseconds, of all requests (also the failed ones)
+  uint64_t  latencyMax;      // Milliseconds
+} OrionldSourceStatistics;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldRequestSendMultiStatisticsGet - snapshot of the statistics of (at most 'maxSources') context sources
+//
+// Returns the number of sources copied to statsV.
+//
+extern int orionldRequestSendMultiStatisticsGet(OrionldSourceStatistics* statsV, int maxSources);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldRequestSendMultiStatisticsReset -
+//
+extern void orionldRequestSendMultiStatisticsReset(void);
+
+#endif  // SRC_LIB_ORIONLD_COMMON_ORIONLDREQUESTSENDMULTI_H_
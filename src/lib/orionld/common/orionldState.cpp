@@ -40,6 +40,7 @@ extern "C"
 #include "orionld/types/OrionldTenant.h"                         // OrionldTenant
 #include "orionld/db/dbConfiguration.h"                          // DB_DRIVER_MONGOC
 #include "orionld/context/orionldCoreContext.h"                  // orionldCoreContext, ORIONLD_CORE_CONTEXT_URL_V*
+#include "orionld/contextCache/orionldInlineContextCache.h"      // orionldInlineContextCacheRequestRelease
 #include "orionld/troe/troe.h"                                   // TroeMode
 #include "orionld/common/QNode.h"                                // QNode
 #include "orionld/common/performance.h"                          // REQUEST_PERFORMANCE
@@ -64,9 +65,7 @@ const bool performanceTestInluded = true;
 //
 __thread OrionldConnectionState orionldState;
 
-#ifdef REQUEST_PERFORMANCE
 __thread Timestamps timestamps;
-#endif
 
 
 
@@ -202,6 +201,9 @@ void orionldStateRelease(void)
 
   if (orionldState.qMongoFilterP != NULL)
     delete orionldState.qMongoFilterP;
+
+  if (orionldState.inlineContexts > 0)
+    orionldInlineContextCacheRequestRelease();
 }
 
 
@@ -80,12 +80,21 @@ extern "C"
 
 
 
+// -----------------------------------------------------------------------------
+//
+// ORIONLD_INLINE_CONTEXTS_MAX - max number of inline context cache items used by one request
+//
+#define ORIONLD_INLINE_CONTEXTS_MAX 8
+
+
+
 // -----------------------------------------------------------------------------
 //
 // Forward declarations -
 //
 struct OrionLdRestService;
 struct ConnectionInfo;
+struct OrionldInlineContext;
 
 
 
@@ -131,6 +140,7 @@ typedef struct OrionldUriParams
   char*     timerel;
   char*     timeAt;
   char*     endTimeAt;
+  int       lastN;
   bool      details;
   uint32_t  mask;
   bool      prettyPrint;
@@ -149,6 +159,8 @@ typedef struct OrionldNotificationInfo
   MimeType  mimeType;
   KjNode*   attrsForNotification;
   char*     reference;
+  char*     host;       // Host part of 'reference' - key of the notification connection pool
+  uint16_t  port;       // Port part of 'reference'
   int       fd;
   bool      connected;
   bool      allOK;
@@ -201,6 +213,8 @@ typedef struct OrionldConnectionState
   char*                   preferHeader;
   char*                   xauthHeader;
   OrionldContext*         contextP;
+  OrionldInlineContext*   inlineContextV[ORIONLD_INLINE_CONTEXTS_MAX];  // Items of the inline context cache in use by the request
+  int                     inlineContexts;
   ApiVersion              apiVersion;
   int                     requestNo;
   KjNode*                 geoAttrV[100];                // Array of GeoProperty attributes
@@ -253,8 +267,9 @@ typedef struct OrionldConnectionState
   //
   void*                   delayedFreePointer;
 
-  int                     notificationRecords;
-  OrionldNotificationInfo notificationInfo[16];
+  int                      notificationRecords;
+  int                      notificationInfoSize;    // Number of items allocated in notificationInfo
+  OrionldNotificationInfo* notificationInfo;        // Allocated from orionldState.kalloc, grows as needed
   bool                    notify;
   OrionldPrefixCache      prefixCache;
   OrionldResponseBuffer   httpResponse;
@@ -309,9 +324,8 @@ typedef struct OrionldConnectionState
 
 // -----------------------------------------------------------------------------
 //
-// Timestamps - timestamps for performance tests
+// Timestamps - timestamps for performance tests and for the latency metrics (-latencyMetrics)
 //
-#ifdef REQUEST_PERFORMANCE
 typedef struct Timestamps
 {
   struct timespec reqStart;               // Start of          Request
@@ -344,8 +358,6 @@ typedef struct Timestamps
 
 extern __thread Timestamps timestamps;
 
-#endif
-
 
 
 // -----------------------------------------------------------------------------
@@ -383,8 +395,17 @@ extern unsigned short    troePort;                 // From orionld.cpp
 extern char              troeUser[64];             // From orionld.cpp
 extern char              troePwd[64];              // From orionld.cpp
 extern int               troePoolSize;             // From orionld.cpp
+extern int               troePoolWait;             // From orionld.cpp
+extern int               troePoolCheck;            // From orionld.cpp
+extern int               troePartitionDays;        // From orionld.cpp
+extern int               troeRetention;            // From orionld.cpp
+extern bool              latencyMetrics;           // From orionld.cpp
+extern int               troeWriters;              // From orionld.cpp
 extern char              pgPortString[16];
 extern bool              forwarding;               // From orionld.cpp
+extern int               notifPoolSize;            // From orionld.cpp
+extern int               notifIdleTimeout;         // From orionld.cpp
+extern int               notifWorkers;             // From orionld.cpp
 extern const char*       orionldVersion;
 extern OrionldGeoIndex*  geoIndexList;
 extern OrionldPhase      orionldPhase;
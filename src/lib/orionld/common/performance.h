@@ -34,4 +34,25 @@
 //
 // #define REQUEST_PERFORMANCE 1
 
+
+
+// ----------------------------------------------------------------------------
+//
+// PERFORMANCE - take a timestamp of the current request (see Timestamps in orionldState.h)
+//
+// The timestamps are taken only if the broker has been started with the CLI option -latencyMetrics,
+// except when compiled with REQUEST_PERFORMANCE, in which case they're always taken.
+// Needs "kbase/kTime.h" and "orionld/common/orionldState.h" to be included.
+//
+#ifdef REQUEST_PERFORMANCE
+#define PERFORMANCE(timestamp)  kTimeGet(&timestamps.timestamp)
+#else
+#define PERFORMANCE(timestamp)                        \
+do                                                    \
+{                                                     \
+  if (latencyMetrics == true)                         \
+    kTimeGet(&timestamps.timestamp);                  \
+} while (0)
+#endif
+
 #endif  // SRC_LIB_ORIONLD_COMMON_PERFORMANCE_H_
@@ -117,6 +117,7 @@ typedef struct OrionldContext
   double                createdAt;
   double                usedAt;
   int                   lookups;
+  int                   cacheSlot;     // Index in orionldContextCache, -1 if not cached
   bool                  keyValues;
   OrionldContextInfo    context;
   OrionldContextOrigin  origin;
@@ -112,6 +112,7 @@ OrionldContext* orionldContextCreate(const char* url, OrionldContextOrigin origi
 
   contextP->keyValues = keyValues;
   contextP->lookups   = 0;
+  contextP->cacheSlot = -1;
 
   return contextP;
 }
@@ -91,6 +91,38 @@ static int valueCompareFunction(const char* longname, void* itemP)
 
 
 
+// -----------------------------------------------------------------------------
+//
+// orionldContextHashTablesCreate -
+//
+bool orionldContextHashTablesCreate(KAlloc* kaP, OrionldContext* contextP, KjNode* contextObjectP, OrionldProblemDetails* pdP)
+{
+  contextP->context.hash.nameHashTable  = khashTableCreate(kaP, hashCode, nameCompareFunction,  ORIONLD_CONTEXT_CACHE_HASH_ARRAY_SIZE);
+  if (contextP->context.hash.nameHashTable == NULL)
+  {
+    LM_E(("khashTableCreate failed"));
+    return false;
+  }
+
+  contextP->context.hash.valueHashTable = khashTableCreate(kaP, hashCode, valueCompareFunction, ORIONLD_CONTEXT_CACHE_HASH_ARRAY_SIZE);
+  if (contextP->context.hash.valueHashTable == NULL)
+  {
+    LM_E(("khashTableCreate failed"));
+    return false;
+  }
+
+  if (orionldContextHashTablesFill(kaP, contextP, contextObjectP, pdP) == false)
+  {
+    // orionldContextHashTablesFill fills in pdP
+    LM_E(("orionldContextHashTablesFill failed"));
+    return false;
+  }
+
+  return true;
+}
+
+
+
 // -----------------------------------------------------------------------------
 //
 // orionldContextFromObject -
@@ -119,26 +151,8 @@ OrionldContext* orionldContextFromObject
     return NULL;
   }
 
-  contextP->context.hash.nameHashTable  = khashTableCreate(&kalloc, hashCode, nameCompareFunction,  ORIONLD_CONTEXT_CACHE_HASH_ARRAY_SIZE);
-  if (contextP->context.hash.nameHashTable == NULL)
-  {
-    LM_E(("khashTableCreate failed"));
+  if (orionldContextHashTablesCreate(&kalloc, contextP, contextObjectP, pdP) == false)
     ok = false;
-  }
-
-  contextP->context.hash.valueHashTable = khashTableCreate(&kalloc, hashCode, valueCompareFunction, ORIONLD_CONTEXT_CACHE_HASH_ARRAY_SIZE);
-  if (contextP->context.hash.valueHashTable == NULL)
-  {
-    LM_E(("khashTableCreate failed"));
-    ok = false;
-  }
-
-  if ((ok == true) && (orionldContextHashTablesFill(contextP, contextObjectP, pdP) == false))
-  {
-    // orionldContextHashTablesFill fills in pdP
-    LM_E(("orionldContextHashTablesFill failed"));
-    ok = false;
-  }
 
   if (ok == false)
   {
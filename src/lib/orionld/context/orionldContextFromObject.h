@@ -27,6 +27,7 @@
 */
 extern "C"
 {
+#include "kjson/kjson.h"                                         // KAlloc
 #include "kjson/KjNode.h"                                        // KjNode
 }
 
@@ -35,6 +36,16 @@ extern "C"
 
 
 
+// -----------------------------------------------------------------------------
+//
+// orionldContextHashTablesCreate - create and fill the hash tables of a key-value context
+//
+// All allocations are done in the KAlloc instance 'kaP'.
+//
+extern bool orionldContextHashTablesCreate(KAlloc* kaP, OrionldContext* contextP, KjNode* contextObjectP, OrionldProblemDetails* pdP);
+
+
+
 // -----------------------------------------------------------------------------
 //
 // orionldContextFromObject -
@@ -43,6 +43,7 @@ extern "C"
 #include "orionld/context/orionldContextCreate.h"                // orionldContextCreate
 #include "orionld/contextCache/orionldContextCacheLookup.h"      // orionldContextCacheLookup
 #include "orionld/contextCache/orionldContextCacheInsert.h"      // orionldContextCacheInsert
+#include "orionld/contextCache/orionldInlineContextCache.h"      // orionldInlineContextCacheGet
 #include "orionld/context/orionldContextFromTree.h"              // Own interface
 
 
@@ -199,7 +200,17 @@ OrionldContext* orionldContextFromTree(char* url, OrionldContextOrigin origin, c
   }
   else if (contextTreeP->type == KjObject)
   {
-    OrionldContext* contextP = orionldContextFromObject(url, origin, id, contextTreeP, pdP);
+    OrionldContext* contextP = NULL;
+
+    //
+    // Inline contexts that are not to be saved are looked up in the inline context cache,
+    // to avoid building the hash tables of the same context over and over again
+    //
+    if ((url == NULL) && (origin == OrionldContextFromInline))
+      contextP = orionldInlineContextCacheGet(contextTreeP);
+
+    if (contextP == NULL)
+      contextP = orionldContextFromObject(url, origin, id, contextTreeP, pdP);
 
     if (contextP)
       contextP->origin = origin;
@@ -22,13 +22,20 @@
 *
 * Author: Ken Zangelin
 */
-#include <unistd.h>                                              // usleep
-#include <semaphore.h>                                           // sem_init, sem_wait, sem_post
+#include <string.h>                                              // strcmp, strdup, strncpy
+#include <stdlib.h>                                              // malloc, free
+#include <pthread.h>                                             // pthread_mutex_t, pthread_cond_t, ...
+#include <time.h>                                                // clock_gettime
+
+extern "C"
+{
+#include "kalloc/kaStrdup.h"                                     // kaStrdup
+}
 
 #include "logMsg/logMsg.h"                                       // LM_*
 #include "logMsg/traceLevels.h"                                  // Lmt*
 
-#include "orionld/common/orionldState.h"                         // orionldState
+#include "orionld/common/orionldState.h"                         // orionldState, contextDownloadAttempts, contextDownloadTimeout
 #include "orionld/types/OrionldProblemDetails.h"                 // OrionldProblemDetails, orionldProblemDetailsFill
 #include "orionld/context/OrionldContext.h"                      // OrionldContext
 #include "orionld/context/orionldContextFromBuffer.h"            // orionldContextFromBuffer
@@ -38,14 +45,44 @@
 #include "orionld/context/orionldContextFromUrl.h"               // Own interface
 
 
-typedef struct StringListItem
+
+// -----------------------------------------------------------------------------
+//
+// ContextDownload - a download in progress, with all the threads awaiting its result
+//
+// Only ONE thread downloads a context (single-flight). All other threads that need the same URL
+// while the download is in progress wait on the condition variable of the download and are woken up
+// as soon as the downloaded context has been parsed by orionldContextFromBuffer - or has failed.
+//
+// The item is unlinked from the list by the downloader, when the download is done.
+// It is freed by the last thread that uses it - the downloader or the last waiter ('users' reaches zero).
+//
+typedef struct ContextDownload
 {
-  char                    name[256];
-  struct StringListItem*  next;
-} StringListItem;
+  char*                    url;
+  pthread_cond_t           doneCond;
+  bool                     done;
+  OrionldContext*          contextP;       // The downloaded context - NULL if the download failed
+  OrionldResponseErrorType type;           // Error of a failed download ...
+  int                      status;
+  char                     title[128];
+  char                     detail[256];
+  int                      users;          // The downloader plus all the waiters
+  struct ContextDownload*  next;
+} ContextDownload;
+
+static pthread_mutex_t   contextDownloadMutex = PTHREAD_MUTEX_INITIALIZER;
+static ContextDownload*  contextDownloadList  = NULL;
+
 
-static sem_t            contextDownloadListSem;
-static StringListItem*  contextDownloadList = NULL;
+
+// -----------------------------------------------------------------------------
+//
+// Statistics - protected by contextDownloadMutex
+//
+static int  contextDownloads        = 0;   // Number of downloads performed
+static int  contextDownloadFailures = 0;   // Number of downloads that failed
+static int  contextDownloadWaiters  = 0;   // Number of requests coalesced into a download of another request
 
 
 
@@ -55,7 +92,6 @@ static StringListItem*  contextDownloadList = NULL;
 //
 void contextDownloadListInit(void)
 {
-  sem_init(&contextDownloadListSem, 0, 1);  // 0: shared between threads of the same process. 1: free to be taken
   contextDownloadList = NULL;
 }
 
@@ -63,131 +99,234 @@ void contextDownloadListInit(void)
 
 // -----------------------------------------------------------------------------
 //
-// contextDownloadListLookup - lookup a URL in the list and report if found or not
+// contextDownloadListLookup - lookup a URL in the list - contextDownloadMutex must be taken
 //
-bool contextDownloadListLookup(const char* url)
+static ContextDownload* contextDownloadListLookup(const char* url)
 {
-  StringListItem* itemP = contextDownloadList;
-
-  while (itemP != NULL)
+  for (ContextDownload* downloadP = contextDownloadList; downloadP != NULL; downloadP = downloadP->next)
   {
-    if (strcmp(itemP->name, url) == 0)
-      return true;
-
-    itemP = itemP->next;
+    if (strcmp(downloadP->url, url) == 0)
+      return downloadP;
   }
 
-  return false;
+  return NULL;
 }
 
 
 
 // -----------------------------------------------------------------------------
 //
-// contextDownloadListAdd - add a URL to the list
+// contextDownloadListAdd - add a URL to the list - contextDownloadMutex must be taken
 //
-void contextDownloadListAdd(const char* url)
+static ContextDownload* contextDownloadListAdd(const char* url)
 {
-  StringListItem* itemP = (StringListItem*) malloc(sizeof(StringListItem));
+  ContextDownload* downloadP = (ContextDownload*) calloc(1, sizeof(ContextDownload));
+
+  if (downloadP == NULL)
+    LM_X(1, ("Out of memory (allocating a context download item)"));
+
+  downloadP->url   = strdup(url);
+  downloadP->users = 1;  // The downloader
+  pthread_cond_init(&downloadP->doneCond, NULL);
+
+  downloadP->next     = contextDownloadList;
+  contextDownloadList = downloadP;
 
-  strncpy(itemP->name, url, sizeof(itemP->name));
-  itemP->next = contextDownloadList;
-  contextDownloadList = itemP;
+  return downloadP;
 }
 
 
 
 // -----------------------------------------------------------------------------
 //
-// contextDownloadListRemove - remove a URL from the list
+// contextDownloadListRemove - remove an item from the list - contextDownloadMutex must be taken
 //
-void contextDownloadListRemove(const char* url)
+static void contextDownloadListRemove(ContextDownload* downloadP)
 {
-  StringListItem* iterP = contextDownloadList;
-  StringListItem* prevP = NULL;
-  StringListItem* itemP = NULL;
+  if (contextDownloadList == downloadP)
+  {
+    contextDownloadList = downloadP->next;
+    return;
+  }
 
-  while (iterP != NULL)
+  for (ContextDownload* prevP = contextDownloadList; prevP != NULL; prevP = prevP->next)
   {
-    if (strcmp(iterP->name, url) == 0)
+    if (prevP->next == downloadP)
     {
-      itemP = iterP;
-      break;
+      prevP->next = downloadP->next;
+      return;
     }
-
-    prevP = iterP;
-    iterP = iterP->next;
   }
+}
 
-  if (itemP == NULL)  // Not found!
-    return;
 
-  if (prevP == NULL)  // Found as the first item of the list
-  {
-    contextDownloadList = itemP->next;
-    free(itemP);
-  }
-  else if (itemP->next == NULL)  // Found as the last item of the list
-  {
-    prevP->next = NULL;
-    free(itemP);
-  }
-  else  // Found in the middle of the list
-  {
-    prevP->next = itemP->next;
-    free(itemP);
-  }
+
+// -----------------------------------------------------------------------------
+//
+// contextDownloadFree -
+//
+static void contextDownloadFree(ContextDownload* downloadP)
+{
+  pthread_cond_destroy(&downloadP->doneCond);
+  free(downloadP->url);
+  free(downloadP);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// contextDownloadRelease - one user less - the last one frees the item - contextDownloadMutex must be taken
+//
+static void contextDownloadRelease(ContextDownload* downloadP)
+{
+  downloadP->users -= 1;
+
+  if (downloadP->users == 0)
+    contextDownloadFree(downloadP);
 }
 
 
 
 // -----------------------------------------------------------------------------
 //
-// contextDownloadListRelease - release all items in the 'context download cache'
+// contextDownloadListRelease - release all items in the 'context download list'
 //
-// The cache is self-cleaning and this function isn't really necessary - except perhaps
+// The list is self-cleaning and this function isn't really necessary - except perhaps
 // if the broker is killed while serving requests, e.g. while running tests.
 //
 // This function is ONLY called from the main exit-function, to avoid leaks for valgrind tests.
 //
 void contextDownloadListRelease(void)
 {
-  StringListItem* iterP = contextDownloadList;
+  ContextDownload* downloadP = contextDownloadList;
 
-  while (iterP != NULL)
+  while (downloadP != NULL)
   {
-    StringListItem* current = iterP;
-    iterP = iterP->next;
-    free(current);
+    ContextDownload* next = downloadP->next;
+
+    contextDownloadFree(downloadP);
+    downloadP = next;
   }
+
+  contextDownloadList = NULL;
 }
 
 
 
 // -----------------------------------------------------------------------------
 //
-// contextCacheWait -
+// contextDownloadDone - publish the result of a download and wake up all waiters
 //
-static OrionldContext* contextCacheWait(char* url, OrionldProblemDetails* pdP)
+static void contextDownloadDone(ContextDownload* downloadP, OrionldContext* contextP, OrionldProblemDetails* pdP)
 {
-  int             sleepTime = 0;
-  OrionldContext* contextP;
+  pthread_mutex_lock(&contextDownloadMutex);
+
+  downloadP->done     = true;
+  downloadP->contextP = contextP;
 
-  while (sleepTime < 3000000)  // 3 secs - 3 million microsecs ... CLI param?
+  ++contextDownloads;
+
+  if (contextP == NULL)
   {
-    usleep(20000);  // sleep 20 millisecs ... CLI param?
-    contextP = orionldContextCacheLookup(url);
-    if (contextP != NULL)
-      return contextP;
-    sleepTime += 20000;
+    downloadP->type   = pdP->type;
+    downloadP->status = pdP->status;
+    strncpy(downloadP->title,  (pdP->title  != NULL)? pdP->title  : "", sizeof(downloadP->title) - 1);
+    strncpy(downloadP->detail, (pdP->detail != NULL)? pdP->detail : "", sizeof(downloadP->detail) - 1);
+
+    ++contextDownloadFailures;
   }
 
-  // The wait timed out
-  pdP->status     = 400;  // Assuming the URL is invalid, this a "400 Bad Request"
-  pdP->title      = (char*) "Timeout awaiting other thread to download a context";
-  pdP->detail     = (char*) url;
+  contextDownloadListRemove(downloadP);
+  pthread_cond_broadcast(&downloadP->doneCond);
+  contextDownloadRelease(downloadP);
 
-  return NULL;
+  pthread_mutex_unlock(&contextDownloadMutex);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// contextDownloadWait - wait for another thread to download a context - contextDownloadMutex must be taken
+//
+// The maximum wait is the maximum time the downloader may need to download the context (all attempts)
+// plus one second for the parsing of the context.
+//
+static OrionldContext* contextDownloadWait(ContextDownload* downloadP, OrionldProblemDetails* pdP)
+{
+  OrionldContext*  contextP = NULL;
+  struct timespec  deadline;
+  long long        maxWait  = (long long) contextDownloadAttempts * contextDownloadTimeout + 1000;  // milliseconds
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec  += maxWait / 1000;
+  deadline.tv_nsec += (maxWait % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000)
+  {
+    deadline.tv_sec  += 1;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  downloadP->users += 1;
+  ++contextDownloadWaiters;
+
+  while (downloadP->done == false)
+  {
+    if (pthread_cond_timedwait(&downloadP->doneCond, &contextDownloadMutex, &deadline) != 0)
+      break;  // Timeout
+  }
+
+  if (downloadP->done == false)
+  {
+    pdP->type   = OrionldBadRequestData;
+    pdP->status = 400;  // Assuming the URL is invalid, this a "400 Bad Request"
+    pdP->title  = (char*) "Timeout awaiting other thread to download a context";
+    pdP->detail = kaStrdup(&orionldState.kalloc, downloadP->url);
+  }
+  else if (downloadP->contextP == NULL)
+  {
+    pdP->type   = downloadP->type;
+    pdP->status = downloadP->status;
+    pdP->title  = kaStrdup(&orionldState.kalloc, downloadP->title);
+    pdP->detail = kaStrdup(&orionldState.kalloc, downloadP->detail);
+  }
+  else
+    contextP = downloadP->contextP;
+
+  contextDownloadRelease(downloadP);
+
+  return contextP;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextDownloadStatisticsGet -
+//
+void orionldContextDownloadStatisticsGet(int* downloadsP, int* failuresP, int* coalescedWaitersP)
+{
+  pthread_mutex_lock(&contextDownloadMutex);
+  *downloadsP        = contextDownloads;
+  *failuresP         = contextDownloadFailures;
+  *coalescedWaitersP = contextDownloadWaiters;
+  pthread_mutex_unlock(&contextDownloadMutex);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextDownloadStatisticsReset -
+//
+void orionldContextDownloadStatisticsReset(void)
+{
+  pthread_mutex_lock(&contextDownloadMutex);
+  contextDownloads        = 0;
+  contextDownloadFailures = 0;
+  contextDownloadWaiters  = 0;
+  pthread_mutex_unlock(&contextDownloadMutex);
 }
 
 
@@ -206,54 +345,45 @@ OrionldContext* orionldContextFromUrl(char* url, char* id, OrionldProblemDetails
   //
   // Make sure the context isn't already being downloaded
   //
-  // Three possibilities:
-  // CASE 1. No one is trying to download the context, so:
-  //         - mark the URL to be downloading - for the next to know
+  // Two possibilities:
+  // CASE 1. No one is downloading the context, so:
+  //         - register the download in the 'context download list' - for the next to know
   //         - download it and add it to the context cache
-  //         - remove the mark from step 1
-  // CASE 2. No one was trying to download the context, so I tried to take the semaphore.
-  //         However, another thread got the semaphore before me and started the download
-  //         In this case, I will NOT try to download (somebody else is already doing that).
-  //         Instead, I will wait for that download to finish and then lookup the context from the cache
+  //         - wake up all threads that have been waiting for the download and remove it from the list
   //
-  // CASE 3. Someone was actually downloading the context when I wanted to do the same.
-  //         Just like step 2 - I wait for the download to complete and then lookup the context from the cache.
+  // CASE 2. Someone is downloading the context already.
+  //         I will NOT try to download (somebody else is already doing that).
+  //         Instead, I wait for that download to finish and get the context (or the error) from the downloader.
   //
-  bool urlDownloading = contextDownloadListLookup(url);
-  if (urlDownloading == false)
-  {
-    //
-    // Not there, so, we'll download it
-    // First take the 'download semaphore'
-    //
-    sem_wait(&contextDownloadListSem);
-
-    //
-    // OK - got the semaphore - but, did I have to wait?
-    // I must look the context up again, to be sure (in the 'contextDownloadList')
-    //
-    // If the URL is in 'contextDownloadList' then somebody else took the semaphore before me
-    // and started downloading.
-    //
-    urlDownloading = contextDownloadListLookup(url);
-    if (urlDownloading == false)
-      contextDownloadListAdd(url);  // CASE 1: Mark the URL as being downloading
-
-    sem_post(&contextDownloadListSem);
+  // The lookup in the context cache is repeated with the mutex taken, as the download may have finished
+  // between the first lookup and the taking of the mutex
+  //
+  pthread_mutex_lock(&contextDownloadMutex);
 
-    if (urlDownloading == true)  // If somebody has taken the semaphore before me and is downloading the context - I'll have to wait
-      return contextCacheWait(url, pdP);  // CASE 2 - another thread has downloaded the context
+  ContextDownload* downloadP = contextDownloadListLookup(url);
+  if (downloadP != NULL)
+  {
+    contextP = contextDownloadWait(downloadP, pdP);  // CASE 2 - another thread is downloading the context
+    pthread_mutex_unlock(&contextDownloadMutex);
+    return contextP;
+  }
 
-    // CASE 1 - the context will be downloaded
+  contextP = orionldContextCacheLookup(url);
+  if (contextP != NULL)
+  {
+    pthread_mutex_unlock(&contextDownloadMutex);
+    return contextP;
   }
-  else
-    return contextCacheWait(url, pdP);  // CASE 3 - another thread has downloaded the context
+
+  downloadP = contextDownloadListAdd(url);  // CASE 1 - the context will be downloaded by me
+  pthread_mutex_unlock(&contextDownloadMutex);
 
   char* buffer = orionldContextDownload(url, pdP);
   if (buffer == NULL)
   {
     // orionldContextDownload fills in pdP
     LM_W(("Bad Input? (%s: %s)", pdP->title, pdP->detail));
+    contextDownloadDone(downloadP, NULL, pdP);
     return NULL;
   }
 
@@ -268,7 +398,7 @@ OrionldContext* orionldContextFromUrl(char* url, char* id, OrionldProblemDetails
     // Still, I believe this is the best solution.
     //
     LM_E(("Context Error (%s: %s)", pdP->title, pdP->detail));
-    contextDownloadListRemove(url);
+    contextDownloadDone(downloadP, NULL, pdP);
     return NULL;  // Parse Error?
   }
 
@@ -276,10 +406,8 @@ OrionldContext* orionldContextFromUrl(char* url, char* id, OrionldProblemDetails
   contextP->createdAt = orionldState.requestTime;
   contextP->usedAt    = orionldState.requestTime;
 
-  // Remove the 'url' from the contextDownloadList and persist it to DB
-  sem_wait(&contextDownloadListSem);
-  contextDownloadListRemove(url);
-  sem_post(&contextDownloadListSem);
+  // Wake up the waiters, remove the download from the contextDownloadList and persist the context to DB
+  contextDownloadDone(downloadP, contextP, pdP);
   orionldContextCachePersist(contextP);
 
   return contextP;
@@ -30,6 +30,38 @@
 
 
 
+// -----------------------------------------------------------------------------
+//
+// contextDownloadListInit - initiaize the 'context download list'
+//
+extern void contextDownloadListInit(void);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// contextDownloadListRelease - release all items in the 'context download list'
+//
+extern void contextDownloadListRelease(void);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextDownloadStatisticsGet -
+//
+extern void orionldContextDownloadStatisticsGet(int* downloadsP, int* failuresP, int* coalescedWaitersP);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextDownloadStatisticsReset -
+//
+extern void orionldContextDownloadStatisticsReset(void);
+
+
+
 // -----------------------------------------------------------------------------
 //
 // orionldContextFromUrl -
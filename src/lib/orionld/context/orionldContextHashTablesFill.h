@@ -27,6 +27,7 @@
 */
 extern "C"
 {
+#include "kjson/kjson.h"                                         // KAlloc
 #include "kjson/KjNode.h"                                        // KjNode
 }
 
@@ -73,6 +74,6 @@ extern "C"
 // The value-table MUST be created in the second pass as its key is the value, and as the value changes in pass II, no other choice.
 // Remember that the key (in this case the value is used as key) is what decides the slot in the hash array.
 //
-extern bool orionldContextHashTablesFill(OrionldContext* contextP, KjNode* keyValueTree, OrionldProblemDetails* pdP);
+extern bool orionldContextHashTablesFill(KAlloc* kaP, OrionldContext* contextP, KjNode* keyValueTree, OrionldProblemDetails* pdP);
 
 #endif  // SRC_LIB_ORIONLD_CONTEXT_ORIONLDCONTEXTHASHTABLESFILL_H_
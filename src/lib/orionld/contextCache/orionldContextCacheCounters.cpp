@@ -0,0 +1,246 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdlib.h>                                              // calloc, free
+#include <string.h>                                              // memcpy
+#include <pthread.h>                                             // pthread_key_t, pthread_once_t, ...
+#include <semaphore.h>                                           // sem_wait, sem_post
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/common/orionldState.h"                         // orionldState
+#include "orionld/context/OrionldContext.h"                      // OrionldContext
+#include "orionld/contextCache/orionldContextCache.h"            // Context Cache Internals
+#include "orionld/contextCache/orionldContextCacheCounters.h"    // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// ContextCacheCounters - the lookup counters of one thread, indexed by the slot of the context in the cache
+//
+// Each thread only ever writes its own counters, so a lookup in the context cache never writes to shared memory.
+// The counters of all threads are added up when the cache is presented (GET /ngsi-ld/ex/v1/contexts?details=true).
+//
+// The list of counters is protected by orionldContextCacheSem.
+// A thread only needs the semaphore when its vectors grow (new slots in the cache).
+//
+typedef struct ContextCacheCounters
+{
+  int                           slots;
+  int*                          lookupsV;
+  double*                       usedAtV;
+  struct ContextCacheCounters*  next;
+} ContextCacheCounters;
+
+
+
+static __thread ContextCacheCounters*  threadCountersP = NULL;
+static ContextCacheCounters*           countersList    = NULL;
+static pthread_key_t                   countersKey;
+static pthread_once_t                  countersKeyOnce = PTHREAD_ONCE_INIT;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// countersRelease - thread destructor - fold the counters of the dying thread into the contexts
+//
+static void countersRelease(void* vP)
+{
+  ContextCacheCounters* countersP = (ContextCacheCounters*) vP;
+
+  sem_wait(&orionldContextCacheSem);
+
+  for (int slot = 0; (slot < countersP->slots) && (slot < orionldContextCacheSlotIx); slot++)
+  {
+    OrionldContext* contextP = orionldContextCache[slot];
+
+    if (contextP == NULL)
+      continue;
+
+    contextP->lookups += countersP->lookupsV[slot];
+    if (countersP->usedAtV[slot] > contextP->usedAt)
+      contextP->usedAt = countersP->usedAtV[slot];
+  }
+
+  if (countersList == countersP)
+    countersList = countersP->next;
+  else
+  {
+    for (ContextCacheCounters* prevP = countersList; prevP != NULL; prevP = prevP->next)
+    {
+      if (prevP->next == countersP)
+      {
+        prevP->next = countersP->next;
+        break;
+      }
+    }
+  }
+
+  sem_post(&orionldContextCacheSem);
+
+  free(countersP->lookupsV);
+  free(countersP->usedAtV);
+  free(countersP);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// countersKeyCreate -
+//
+static void countersKeyCreate(void)
+{
+  if (pthread_key_create(&countersKey, countersRelease) != 0)
+    LM_X(1, ("Runtime Error (unable to create the thread key for the context cache counters)"));
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// countersGrow - make room for 'slot' in the counters of the calling thread
+//
+static void countersGrow(int slot)
+{
+  int      slots    = (slot < orionldContextCacheSlots)? orionldContextCacheSlots : slot + 1;
+  int*     lookupsV = (int*)    calloc(slots, sizeof(int));
+  double*  usedAtV  = (double*) calloc(slots, sizeof(double));
+
+  if ((lookupsV == NULL) || (usedAtV == NULL))
+    LM_X(1, ("Out of memory (allocating context cache counters for %d slots)", slots));
+
+  if (threadCountersP == NULL)
+  {
+    pthread_once(&countersKeyOnce, countersKeyCreate);
+
+    threadCountersP = (ContextCacheCounters*) calloc(1, sizeof(ContextCacheCounters));
+    if (threadCountersP == NULL)
+      LM_X(1, ("Out of memory (allocating context cache counters)"));
+
+    pthread_setspecific(countersKey, threadCountersP);
+
+    sem_wait(&orionldContextCacheSem);
+    threadCountersP->next = countersList;
+    countersList          = threadCountersP;
+    sem_post(&orionldContextCacheSem);
+  }
+
+  int*    oldLookupsV = threadCountersP->lookupsV;
+  double* oldUsedAtV  = threadCountersP->usedAtV;
+
+  sem_wait(&orionldContextCacheSem);
+
+  if (oldLookupsV != NULL)
+  {
+    memcpy(lookupsV, oldLookupsV, threadCountersP->slots * sizeof(int));
+    memcpy(usedAtV,  oldUsedAtV,  threadCountersP->slots * sizeof(double));
+  }
+
+  threadCountersP->lookupsV = lookupsV;
+  threadCountersP->usedAtV  = usedAtV;
+  threadCountersP->slots    = slots;
+
+  sem_post(&orionldContextCacheSem);
+
+  free(oldLookupsV);
+  free(oldUsedAtV);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheCountersLookup -
+//
+void orionldContextCacheCountersLookup(OrionldContext* contextP)
+{
+  int slot = contextP->cacheSlot;
+
+  if (slot < 0)
+    return;
+
+  if ((threadCountersP == NULL) || (slot >= threadCountersP->slots))
+    countersGrow(slot);
+
+  threadCountersP->lookupsV[slot] += 1;
+  threadCountersP->usedAtV[slot]   = orionldState.requestTime;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheCountersReset -
+//
+// A slot is reset when a context is inserted into it or removed from it.
+// The owning thread might be incrementing the counter at the same time - that's a risk we can live with, for statistics.
+//
+void orionldContextCacheCountersReset(int slot)
+{
+  for (ContextCacheCounters* countersP = countersList; countersP != NULL; countersP = countersP->next)
+  {
+    if (slot < countersP->slots)
+    {
+      countersP->lookupsV[slot] = 0;
+      countersP->usedAtV[slot]  = 0;
+    }
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheCountersGet -
+//
+void orionldContextCacheCountersGet(OrionldContext* contextP, int* lookupsP, double* usedAtP)
+{
+  int    slot    = contextP->cacheSlot;
+  int    lookups = contextP->lookups;
+  double usedAt  = contextP->usedAt;
+
+  if (slot >= 0)
+  {
+    sem_wait(&orionldContextCacheSem);
+
+    for (ContextCacheCounters* countersP = countersList; countersP != NULL; countersP = countersP->next)
+    {
+      if (slot >= countersP->slots)
+        continue;
+
+      lookups += countersP->lookupsV[slot];
+      if (countersP->usedAtV[slot] > usedAt)
+        usedAt = countersP->usedAtV[slot];
+    }
+
+    sem_post(&orionldContextCacheSem);
+  }
+
+  *lookupsP = lookups;
+  *usedAtP  = usedAt;
+}
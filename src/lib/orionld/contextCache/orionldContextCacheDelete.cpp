@@ -23,6 +23,7 @@
 * Author: Ken Zangelin
 */
 #include <string.h>                                              // strcmp
+#include <semaphore.h>                                           // sem_wait, sem_post
 
 extern "C"
 {
@@ -35,6 +36,8 @@ extern "C"
 #include "orionld/mongoc/mongocContextCacheDelete.h"             // mongocContextCacheDelete
 #include "orionld/context/OrionldContext.h"                      // OrionldContext
 #include "orionld/contextCache/orionldContextCache.h"            // Context Cache Internals
+#include "orionld/contextCache/orionldContextCacheIndex.h"       // orionldContextCacheIndexRemove
+#include "orionld/contextCache/orionldContextCacheCounters.h"    // orionldContextCacheCountersReset
 #include "orionld/contextCache/orionldContextCacheDelete.h"      // Own interface
 
 
@@ -45,6 +48,10 @@ extern "C"
 //
 static void contextCacheReleaseOne(OrionldContext* contextP)
 {
+  orionldContextCacheIndexRemove(contextP);
+  orionldContextCacheCountersReset(contextP->cacheSlot);
+  contextP->cacheSlot = -1;
+
   if (contextP->tree != NULL)
     kjFree(contextP->tree);
 }
@@ -57,6 +64,8 @@ static void contextCacheReleaseOne(OrionldContext* contextP)
 //
 bool orionldContextCacheDelete(const char* id)
 {
+  sem_wait(&orionldContextCacheSem);
+
   for (int ix = 0; ix < orionldContextCacheSlotIx; ix++)
   {
     if (orionldContextCache[ix] == NULL)
@@ -80,5 +89,7 @@ bool orionldContextCacheDelete(const char* id)
     }
   }
 
+  sem_post(&orionldContextCacheSem);
+
   return true;
 }
@@ -38,6 +38,7 @@ extern "C"
 #include "orionld/context/orionldCoreContext.h"                  // orionldCoreContextP
 #include "orionld/context/OrionldContextItem.h"                  // OrionldContextItem
 #include "orionld/contextCache/orionldContextCache.h"            // Context Cache Internals
+#include "orionld/contextCache/orionldContextCacheCounters.h"    // orionldContextCacheCountersGet
 #include "orionld/contextCache/orionldContextCacheGet.h"         // Own interface
 
 
@@ -51,18 +52,22 @@ KjNode* orionldContextCacheGet(KjNode* arrayP, bool details)
 {
   for (int ix = 0; ix < orionldContextCacheSlotIx; ix++)
   {
-    OrionldContext*  contextP         = orionldContextCacheArray[ix];
+    OrionldContext*  contextP         = orionldContextCache[ix];
 
     if (contextP == NULL)
       continue;
 
     if (details == true)
     {
-      char createdAtString[64];
-      char lastUseString[64];
+      char   createdAtString[64];
+      char   lastUseString[64];
+      int    lookups;
+      double usedAt;
+
+      orionldContextCacheCountersGet(contextP, &lookups, &usedAt);
 
       numberToDate(contextP->createdAt, createdAtString, sizeof(createdAtString));
-      numberToDate(contextP->usedAt,    lastUseString,   sizeof(lastUseString));
+      numberToDate(usedAt,              lastUseString,   sizeof(lastUseString));
 
       KjNode*          contextObjP      = kjObject(orionldState.kjsonP, NULL);
       KjNode*          urlStringP       = kjString(orionldState.kjsonP, "url",       contextP->url);
@@ -80,7 +85,7 @@ KjNode* orionldContextCacheGet(KjNode* arrayP, bool details)
       if (contextP != orionldCoreContextP)
       {
         KjNode*          usedAtP          = kjString(orionldState.kjsonP,  "lastUse",  lastUseString);
-        KjNode*          lookupsP         = kjInteger(orionldState.kjsonP, "lookups",  contextP->lookups);
+        KjNode*          lookupsP         = kjInteger(orionldState.kjsonP, "lookups",  lookups);
 
         kjChildAdd(contextObjP, usedAtP);
         kjChildAdd(contextObjP, lookupsP);
@@ -0,0 +1,333 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdlib.h>                                              // calloc, free
+#include <string.h>                                              // strcmp
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/context/OrionldContext.h"                      // OrionldContext
+#include "orionld/contextCache/orionldContextCacheIndex.h"       // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// ORIONLD_CONTEXT_CACHE_INDEX_INITIAL_BUCKETS - must be a power of two
+//
+#define ORIONLD_CONTEXT_CACHE_INDEX_INITIAL_BUCKETS  1024
+
+
+
+// -----------------------------------------------------------------------------
+//
+// RetiredIndex - list of indices that have been replaced by a bigger one, only freed at exit
+//
+typedef struct RetiredIndex
+{
+  OrionldContextCacheIndex*  indexP;
+  struct RetiredIndex*       next;
+} RetiredIndex;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexP -
+//
+OrionldContextCacheIndex*  orionldContextCacheIndexP = NULL;
+static RetiredIndex*       retiredList               = NULL;
+static OrionldContext      tombstone;
+static unsigned int        indexItems                = 0;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// keyHash - FNV-1a
+//
+static inline unsigned int keyHash(const char* key)
+{
+  unsigned int hash = 2166136261U;
+
+  while (*key != 0)
+  {
+    hash ^= (unsigned char) *key;
+    hash *= 16777619U;
+    ++key;
+  }
+
+  return hash;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// indexCreate -
+//
+static OrionldContextCacheIndex* indexCreate(unsigned int buckets)
+{
+  OrionldContextCacheIndex* indexP = (OrionldContextCacheIndex*) calloc(1, sizeof(OrionldContextCacheIndex));
+
+  if (indexP == NULL)
+    LM_X(1, ("Out of memory (allocating the context cache index)"));
+
+  indexP->buckets = buckets;
+  indexP->used    = 0;
+  indexP->urlV    = (OrionldContext**) calloc(buckets, sizeof(OrionldContext*));
+  indexP->idV     = (OrionldContext**) calloc(buckets, sizeof(OrionldContext*));
+
+  if ((indexP->urlV == NULL) || (indexP->idV == NULL))
+    LM_X(1, ("Out of memory (allocating %d buckets for the context cache index)", buckets));
+
+  return indexP;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// slotInsert - insert a context in the first free slot of its probing chain
+//
+static void slotInsert(OrionldContext** vector, unsigned int buckets, const char* key, OrionldContext* contextP)
+{
+  unsigned int mask = buckets - 1;
+  unsigned int slot = keyHash(key) & mask;
+
+  while (vector[slot] != NULL)
+    slot = (slot + 1) & mask;
+
+  // The context is completely built - make it visible to the readers
+  __atomic_store_n(&vector[slot], contextP, __ATOMIC_RELEASE);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// indexInsert -
+//
+static void indexInsert(OrionldContextCacheIndex* indexP, OrionldContext* contextP)
+{
+  slotInsert(indexP->urlV, indexP->buckets, contextP->url, contextP);
+
+  if (contextP->id != NULL)
+    slotInsert(indexP->idV, indexP->buckets, contextP->id, contextP);
+
+  indexP->used += 1;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// indexGrow - build a new index with all the live contexts of the current index and publish it
+//
+// If most of the used slots are tombstones, the new index keeps the same size.
+//
+static void indexGrow(void)
+{
+  OrionldContextCacheIndex* oldP    = orionldContextCacheIndexP;
+  unsigned int              buckets = (indexItems * 4 > oldP->used)? oldP->buckets * 2 : oldP->buckets;
+  OrionldContextCacheIndex* newP    = indexCreate(buckets);
+
+  for (unsigned int ix = 0; ix < oldP->buckets; ix++)
+  {
+    OrionldContext* contextP = oldP->urlV[ix];
+
+    if ((contextP != NULL) && (contextP != &tombstone))
+      indexInsert(newP, contextP);
+  }
+
+  __atomic_store_n(&orionldContextCacheIndexP, newP, __ATOMIC_RELEASE);
+
+  RetiredIndex* retiredP = (RetiredIndex*) malloc(sizeof(RetiredIndex));
+
+  if (retiredP == NULL)
+    LM_X(1, ("Out of memory (allocating a retired context cache index)"));
+
+  retiredP->indexP = oldP;
+  retiredP->next   = retiredList;
+  retiredList      = retiredP;
+
+  LM_T(LmtContextList, ("Context cache index rebuilt: %d -> %d buckets (%d contexts)", oldP->buckets, buckets, indexItems));
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexInit -
+//
+void orionldContextCacheIndexInit(void)
+{
+  if (orionldContextCacheIndexP == NULL)
+    orionldContextCacheIndexP = indexCreate(ORIONLD_CONTEXT_CACHE_INDEX_INITIAL_BUCKETS);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexInsert -
+//
+void orionldContextCacheIndexInsert(OrionldContext* contextP)
+{
+  if (contextP->url == NULL)
+    return;
+
+  orionldContextCacheIndexInit();
+
+  // Keep the load factor under 50% - linear probing degrades fast after that
+  if ((orionldContextCacheIndexP->used + 1) * 2 > orionldContextCacheIndexP->buckets)
+    indexGrow();
+
+  indexInsert(orionldContextCacheIndexP, contextP);
+  ++indexItems;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// slotRemove - replace the context with a tombstone, keeping the probing chain intact
+//
+static void slotRemove(OrionldContext** vector, unsigned int buckets, const char* key, OrionldContext* contextP)
+{
+  unsigned int mask = buckets - 1;
+  unsigned int slot = keyHash(key) & mask;
+
+  while (vector[slot] != NULL)
+  {
+    if (vector[slot] == contextP)
+    {
+      __atomic_store_n(&vector[slot], &tombstone, __ATOMIC_RELEASE);
+      return;
+    }
+
+    slot = (slot + 1) & mask;
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexRemove -
+//
+void orionldContextCacheIndexRemove(OrionldContext* contextP)
+{
+  if ((orionldContextCacheIndexP == NULL) || (contextP->url == NULL))
+    return;
+
+  slotRemove(orionldContextCacheIndexP->urlV, orionldContextCacheIndexP->buckets, contextP->url, contextP);
+
+  if (contextP->id != NULL)
+    slotRemove(orionldContextCacheIndexP->idV, orionldContextCacheIndexP->buckets, contextP->id, contextP);
+
+  --indexItems;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// slotLookup -
+//
+static OrionldContext* slotLookup(OrionldContext** vector, unsigned int buckets, const char* key, bool byUrl)
+{
+  unsigned int     mask = buckets - 1;
+  unsigned int     slot = keyHash(key) & mask;
+  OrionldContext*  contextP;
+
+  while ((contextP = __atomic_load_n(&vector[slot], __ATOMIC_ACQUIRE)) != NULL)
+  {
+    if (contextP != &tombstone)
+    {
+      const char* contextKey = (byUrl == true)? contextP->url : contextP->id;
+
+      if (strcmp(key, contextKey) == 0)
+        return contextP;
+    }
+
+    slot = (slot + 1) & mask;
+  }
+
+  return NULL;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexLookup -
+//
+OrionldContext* orionldContextCacheIndexLookup(const char* key)
+{
+  OrionldContextCacheIndex* indexP = __atomic_load_n(&orionldContextCacheIndexP, __ATOMIC_ACQUIRE);
+
+  if (indexP == NULL)
+    return NULL;
+
+  OrionldContext* contextP = slotLookup(indexP->urlV, indexP->buckets, key, true);
+
+  if (contextP == NULL)
+    contextP = slotLookup(indexP->idV, indexP->buckets, key, false);
+
+  return contextP;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexRelease - free the current and all retired indices - only at exit
+//
+void orionldContextCacheIndexRelease(void)
+{
+  RetiredIndex* retiredP = retiredList;
+
+  while (retiredP != NULL)
+  {
+    RetiredIndex* next = retiredP->next;
+
+    free(retiredP->indexP->urlV);
+    free(retiredP->indexP->idV);
+    free(retiredP->indexP);
+    free(retiredP);
+
+    retiredP = next;
+  }
+  retiredList = NULL;
+
+  if (orionldContextCacheIndexP != NULL)
+  {
+    free(orionldContextCacheIndexP->urlV);
+    free(orionldContextCacheIndexP->idV);
+    free(orionldContextCacheIndexP);
+    orionldContextCacheIndexP = NULL;
+  }
+}
@@ -0,0 +1,103 @@
+#ifndef SRC_LIB_ORIONLD_CONTEXTCACHE_ORIONLDCONTEXTCACHEINDEX_H_
+#define SRC_LIB_ORIONLD_CONTEXTCACHE_ORIONLDCONTEXTCACHEINDEX_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include "orionld/context/OrionldContext.h"                      // OrionldContext
+
+
+
+// -----------------------------------------------------------------------------
+//
+// OrionldContextCacheIndex - hashed index of the context cache, keyed by URL and by id
+//
+// Open addressing (linear probing) - one table for the URLs and another one for the ids.
+// 'buckets' is always a power of two.
+//
+// The index is only modified with orionldContextCacheSem taken, while readers never take the semaphore.
+// To make that possible:
+// - a slot is only ever written with an atomic store, after the context has been completely built
+// - a deleted context leaves a tombstone in its slot, so that probing chains are never broken
+// - when the index needs to grow, a new index is built and published with an atomic store of orionldContextCacheIndexP.
+//   The old index is never freed, as a reader may still be probing it.
+//   As the index doubles its size every time, the retired indices never add up to more than the size of the current one.
+//
+typedef struct OrionldContextCacheIndex
+{
+  unsigned int      buckets;
+  unsigned int      used;        // Slots that are not empty - contexts + tombstones
+  OrionldContext**  urlV;
+  OrionldContext**  idV;
+} OrionldContextCacheIndex;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexP - the currently published index
+//
+extern OrionldContextCacheIndex* orionldContextCacheIndexP;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexInit -
+//
+extern void orionldContextCacheIndexInit(void);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexInsert - add a context to the index - orionldContextCacheSem must be taken
+//
+extern void orionldContextCacheIndexInsert(OrionldContext* contextP);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexRemove - remove a context from the index - orionldContextCacheSem must be taken
+//
+extern void orionldContextCacheIndexRemove(OrionldContext* contextP);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexLookup - lookup a context by URL or by id - no semaphore needed
+//
+extern OrionldContext* orionldContextCacheIndexLookup(const char* key);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldContextCacheIndexRelease - free the current and all retired indices - only at exit
+//
+extern void orionldContextCacheIndexRelease(void);
+
+#endif  // SRC_LIB_ORIONLD_CONTEXTCACHE_ORIONLDCONTEXTCACHEINDEX_H_
@@ -42,6 +42,7 @@ extern "C"
 #include "orionld/context/orionldContextFromUrl.h"               // orionldContextFromUrl
 #include "orionld/context/orionldContextFromTree.h"              // orionldContextFromTree
 #include "orionld/contextCache/orionldContextCache.h"            // orionldContextCacheArray, orionldContextCacheSem
+#include "orionld/contextCache/orionldContextCacheIndex.h"       // orionldContextCacheIndexInit
 #include "orionld/contextCache/orionldContextCachePersist.h"     // orionldContextCachePersist
 #include "orionld/contextCache/orionldContextCacheInit.h"        // Own interface
 
@@ -100,6 +101,8 @@ void orionldContextCacheInit(void)
   if (sem_init(&orionldContextCacheSem, 0, 1) == -1)
     LM_X(1, ("Runtime Error (error initializing semaphore for orionld context list; %s)", strerror(errno)));
 
+  orionldContextCacheIndexInit();
+
   mongocInit(dbHost, "orionld");  // If mongocInit fails, an exit is issued
 
   //
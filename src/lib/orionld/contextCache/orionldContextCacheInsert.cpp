@@ -35,6 +35,8 @@
 #include "orionld/serviceRoutines/orionldPostRegistrations.h"    // orionldPostRegistrations
 #include "orionld/context/OrionldContext.h"                      // OrionldContext
 #include "orionld/contextCache/orionldContextCache.h"            // Context Cache Internals
+#include "orionld/contextCache/orionldContextCacheIndex.h"       // orionldContextCacheIndexInsert
+#include "orionld/contextCache/orionldContextCacheCounters.h"    // orionldContextCacheCountersReset
 #include "orionld/contextCache/orionldContextCacheInsert.h"      // Own interface
 
 
@@ -67,8 +69,6 @@ const char* originName(OrionldContextOrigin origin)
 //
 void orionldContextCacheInsert(OrionldContext* contextP)
 {
-  int slotNo = orionldContextCacheSlotIx;
-
   if (contextP == NULL)
   {
     LM_W(("contextP == NULL"));
@@ -88,6 +88,8 @@ void orionldContextCacheInsert(OrionldContext* contextP)
 
   sem_wait(&orionldContextCacheSem);
 
+  int slotNo = orionldContextCacheSlotIx;
+
   if (slotNo >= orionldContextCacheSlots)
   {
     // Look for holes - a context may have been deleted !!!
@@ -126,8 +128,14 @@ void orionldContextCacheInsert(OrionldContext* contextP)
     orionldContextCache = (OrionldContext**) newArray;
 
     slotNo = orionldContextCacheSlotIx;
+    ++orionldContextCacheSlotIx;
   }
 
+  contextP->cacheSlot = slotNo;
+  orionldContextCacheCountersReset(slotNo);
+
   orionldContextCache[slotNo] = contextP;
+  orionldContextCacheIndexInsert(contextP);
+
   sem_post(&orionldContextCacheSem);
 }
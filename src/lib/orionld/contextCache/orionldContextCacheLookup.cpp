@@ -22,14 +22,12 @@
 *
 * Author: Ken Zangelin
 */
-#include <string.h>                                              // strcmp
-
 #include "logMsg/logMsg.h"                                       // LM_*
 #include "logMsg/traceLevels.h"                                  // Lmt*
 
-#include "orionld/common/orionldState.h"                         // orionldState
 #include "orionld/context/OrionldContext.h"                      // OrionldContext
-#include "orionld/contextCache/orionldContextCache.h"            // Context Cache Internals
+#include "orionld/contextCache/orionldContextCacheIndex.h"       // orionldContextCacheIndexLookup
+#include "orionld/contextCache/orionldContextCacheCounters.h"    // orionldContextCacheCountersLookup
 #include "orionld/contextCache/orionldContextCacheLookup.h"      // Own interface
 
 
@@ -38,28 +36,15 @@
 //
 // orionldContextCacheLookup -
 //
+// The context is looked up in the hashed index of the cache, both by URL and by id.
+// No semaphore is taken - see orionldContextCacheIndex.h.
+//
 OrionldContext* orionldContextCacheLookup(const char* url)
 {
-  OrionldContext* contextP = NULL;
-
-  for (int ix = 0; ix < orionldContextCacheSlotIx; ix++)
-  {
-    if (orionldContextCache[ix] == NULL)
-      continue;
-
-    if (strcmp(url, orionldContextCache[ix]->url) == 0)
-      contextP = orionldContextCache[ix];
-
-    if ((orionldContextCache[ix]->id != NULL) && (strcmp(url, orionldContextCache[ix]->id) == 0))
-      contextP = orionldContextCache[ix];
+  OrionldContext* contextP = orionldContextCacheIndexLookup(url);
 
-    if (contextP != NULL)
-    {
-      contextP->usedAt   = orionldState.requestTime;
-      contextP->lookups += 1;
-      return contextP;
-    }
-  }
+  if (contextP != NULL)
+    orionldContextCacheCountersLookup(contextP);
 
-  return NULL;
+  return contextP;
 }
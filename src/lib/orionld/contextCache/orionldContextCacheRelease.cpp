@@ -33,6 +33,7 @@ extern "C"
 #include "logMsg/traceLevels.h"                                  // Lmt*
 
 #include "orionld/contextCache/orionldContextCache.h"            // orionldContextCache, orionldContextCacheSlotIx
+#include "orionld/contextCache/orionldContextCacheIndex.h"       // orionldContextCacheIndexRelease
 #include "orionld/contextCache/orionldContextCacheRelease.h"     // Own interface
 
 
@@ -54,4 +55,6 @@ void orionldContextCacheRelease(void)
       orionldContextCache[ix]->tree = NULL;
     }
   }
+
+  orionldContextCacheIndexRelease();
 }
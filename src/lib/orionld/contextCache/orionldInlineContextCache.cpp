@@ -0,0 +1,610 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdint.h>                                              // int64_t, uint64_t
+#include <stdlib.h>                                              // malloc, calloc, free
+#include <string.h>                                              // strcmp, memcpy, bzero
+#include <pthread.h>                                             // pthread_mutex_t
+
+extern "C"
+{
+#include "kalloc/kaAlloc.h"                                      // kaAlloc
+#include "kalloc/kaBufferInit.h"                                 // kaBufferInit
+#include "kalloc/kaBufferReset.h"                                // kaBufferReset
+#include "kjson/kjson.h"                                         // Kjson, KAlloc
+#include "kjson/KjNode.h"                                        // KjNode
+#include "kjson/kjBufferCreate.h"                                // kjBufferCreate
+#include "kjson/kjClone.h"                                       // kjClone
+}
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/types/OrionldProblemDetails.h"                 // OrionldProblemDetails
+#include "orionld/common/orionldState.h"                         // orionldState, ORIONLD_INLINE_CONTEXTS_MAX
+#include "orionld/context/OrionldContext.h"                      // OrionldContext
+#include "orionld/context/orionldContextFromObject.h"            // orionldContextHashTablesCreate
+#include "orionld/contextCache/orionldInlineContextCache.h"      // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// OrionldInlineContext - an inline key-value context, with its hash tables built
+//
+// Everything the context needs (the clone of the tree and the hash tables) is allocated in the
+// private KAlloc instance of the item, so that the item can be freed when evicted from the cache.
+// The initial buffer of the KAlloc instance is big enough for the two hash tables of a small context.
+//
+// An evicted item that is still in use by some request is freed by the last of those requests.
+//
+typedef struct OrionldInlineContext
+{
+  uint64_t                      fingerprint;
+  KjNode*                       tree;           // Clone of the key-value object - to verify a fingerprint match
+  OrionldContext                context;
+  int                           refs;           // Number of requests currently using the context
+  bool                          evicted;
+  struct OrionldInlineContext*  bucketNext;
+  struct OrionldInlineContext*  lruPrev;        // More recently used
+  struct OrionldInlineContext*  lruNext;        // Less recently used
+  Kjson                         kjson;
+  KAlloc                        kalloc;
+  char                          kallocBuffer[24 * 1024];
+} OrionldInlineContext;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// The cache - a hash table on the fingerprint plus an LRU list, all protected by cacheMutex
+//
+static pthread_mutex_t         cacheMutex   = PTHREAD_MUTEX_INITIALIZER;
+static OrionldInlineContext**  bucketV      = NULL;
+static int                     buckets      = 0;
+static int                     maxEntries   = 0;
+static int                     entries      = 0;
+static OrionldInlineContext*   lruFirst     = NULL;
+static OrionldInlineContext*   lruLast      = NULL;
+static int64_t                 hits         = 0;
+static int64_t                 misses       = 0;
+static int64_t                 evictions    = 0;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// FNV-1a, 64 bits
+//
+#define FNV_OFFSET_BASIS  14695981039346656037ULL
+#define FNV_PRIME         1099511628211ULL
+
+
+
+// -----------------------------------------------------------------------------
+//
+// fnvBytes -
+//
+static inline uint64_t fnvBytes(uint64_t hash, const void* data, int len)
+{
+  const unsigned char* p = (const unsigned char*) data;
+
+  for (int ix = 0; ix < len; ix++)
+  {
+    hash ^= p[ix];
+    hash *= FNV_PRIME;
+  }
+
+  return hash;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// fnvString - the terminating zero is included, so that "ab"+"c" differs from "a"+"bc"
+//
+static inline uint64_t fnvString(uint64_t hash, const char* s)
+{
+  do
+  {
+    hash ^= (unsigned char) *s;
+    hash *= FNV_PRIME;
+  } while (*s++ != 0);
+
+  return hash;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// fingerprint - hash of the members of a container node (type, name and value of all descendants)
+//
+// The name of the container itself is not part of the fingerprint - it is "@context" for a
+// payload context and NULL for an item of a context array.
+//
+static uint64_t fingerprint(uint64_t hash, KjNode* containerP)
+{
+  for (KjNode* nodeP = containerP->value.firstChildP; nodeP != NULL; nodeP = nodeP->next)
+  {
+    unsigned char type = (unsigned char) nodeP->type;
+
+    hash = fnvBytes(hash, &type, 1);
+
+    if (nodeP->name != NULL)
+      hash = fnvString(hash, nodeP->name);
+
+    switch (nodeP->type)
+    {
+    case KjString:   hash = fnvString(hash, nodeP->value.s);                             break;
+    case KjInt:      hash = fnvBytes(hash, &nodeP->value.i, sizeof(nodeP->value.i));    break;
+    case KjFloat:    hash = fnvBytes(hash, &nodeP->value.f, sizeof(nodeP->value.f));    break;
+    case KjBoolean:  hash = fnvBytes(hash, &nodeP->value.b, sizeof(nodeP->value.b));    break;
+    case KjObject:
+    case KjArray:    hash = fingerprint(hash, nodeP);                                    break;
+    default:                                                                             break;
+    }
+
+    // End-of-node marker, so that the nesting of containers is part of the fingerprint
+    hash = fnvBytes(hash, "", 1);
+  }
+
+  return hash;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// treeEqual - compare the members of two container nodes, order included
+//
+static bool treeEqual(KjNode* aContainerP, KjNode* bContainerP)
+{
+  KjNode* aP = aContainerP->value.firstChildP;
+  KjNode* bP = bContainerP->value.firstChildP;
+
+  while ((aP != NULL) && (bP != NULL))
+  {
+    if (aP->type != bP->type)
+      return false;
+
+    if ((aP->name == NULL) != (bP->name == NULL))
+      return false;
+
+    if ((aP->name != NULL) && (strcmp(aP->name, bP->name) != 0))
+      return false;
+
+    switch (aP->type)
+    {
+    case KjString:   if (strcmp(aP->value.s, bP->value.s) != 0) return false;  break;
+    case KjInt:      if (aP->value.i != bP->value.i)             return false;  break;
+    case KjFloat:    if (aP->value.f != bP->value.f)             return false;  break;
+    case KjBoolean:  if (aP->value.b != bP->value.b)             return false;  break;
+    case KjObject:
+    case KjArray:    if (treeEqual(aP, bP) == false)             return false;  break;
+    default:                                                                    break;
+    }
+
+    aP = aP->next;
+    bP = bP->next;
+  }
+
+  return (aP == NULL) && (bP == NULL);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// itemLookup - cacheMutex must be taken
+//
+static OrionldInlineContext* itemLookup(uint64_t fprint, KjNode* contextTreeP)
+{
+  for (OrionldInlineContext* itemP = bucketV[fprint % buckets]; itemP != NULL; itemP = itemP->bucketNext)
+  {
+    if ((itemP->fingerprint == fprint) && (treeEqual(itemP->tree, contextTreeP) == true))
+      return itemP;
+  }
+
+  return NULL;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// lruRemove - cacheMutex must be taken
+//
+static void lruRemove(OrionldInlineContext* itemP)
+{
+  if (itemP->lruPrev != NULL)
+    itemP->lruPrev->lruNext = itemP->lruNext;
+  else
+    lruFirst = itemP->lruNext;
+
+  if (itemP->lruNext != NULL)
+    itemP->lruNext->lruPrev = itemP->lruPrev;
+  else
+    lruLast = itemP->lruPrev;
+
+  itemP->lruPrev = NULL;
+  itemP->lruNext = NULL;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// lruPushFront - cacheMutex must be taken
+//
+static void lruPushFront(OrionldInlineContext* itemP)
+{
+  itemP->lruPrev = NULL;
+  itemP->lruNext = lruFirst;
+
+  if (lruFirst != NULL)
+    lruFirst->lruPrev = itemP;
+  else
+    lruLast = itemP;
+
+  lruFirst = itemP;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// bucketRemove - cacheMutex must be taken
+//
+static void bucketRemove(OrionldInlineContext* itemP)
+{
+  OrionldInlineContext** pp = &bucketV[itemP->fingerprint % buckets];
+
+  while (*pp != NULL)
+  {
+    if (*pp == itemP)
+    {
+      *pp = itemP->bucketNext;
+      break;
+    }
+
+    pp = &(*pp)->bucketNext;
+  }
+
+  itemP->bucketNext = NULL;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// itemFree -
+//
+static void itemFree(OrionldInlineContext* itemP)
+{
+  kaBufferReset(&itemP->kalloc, false);
+  free(itemP);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// itemCreate - clone the tree and build the hash tables of the context
+//
+// Done without holding cacheMutex - it's the expensive part.
+//
+static OrionldInlineContext* itemCreate(uint64_t fprint, KjNode* contextTreeP)
+{
+  OrionldInlineContext* itemP = (OrionldInlineContext*) malloc(sizeof(OrionldInlineContext));
+
+  if (itemP == NULL)
+  {
+    LM_E(("Out of memory (allocating an inline context cache item of %d bytes)", (int) sizeof(OrionldInlineContext)));
+    return NULL;
+  }
+
+  kaBufferInit(&itemP->kalloc, itemP->kallocBuffer, sizeof(itemP->kallocBuffer), 16 * 1024, NULL, "Inline context KAlloc buffer");
+  kjBufferCreate(&itemP->kjson, &itemP->kalloc);
+
+  itemP->fingerprint = fprint;
+  itemP->refs        = 0;
+  itemP->evicted     = false;
+  itemP->bucketNext  = NULL;
+  itemP->lruPrev     = NULL;
+  itemP->lruNext     = NULL;
+  itemP->tree        = kjClone(&itemP->kjson, contextTreeP);
+
+  if (itemP->tree == NULL)
+  {
+    itemFree(itemP);
+    return NULL;
+  }
+
+  OrionldContext* contextP = &itemP->context;
+
+  bzero(contextP, sizeof(OrionldContext));
+  contextP->tree      = itemP->tree;
+  contextP->origin    = OrionldContextFromInline;
+  contextP->keyValues = true;
+  contextP->cacheSlot = -1;
+
+  //
+  // An invalid context is not cached - the caller builds it again, the usual way, to get the error
+  //
+  OrionldProblemDetails pd;
+  if (orionldContextHashTablesCreate(&itemP->kalloc, contextP, itemP->tree, &pd) == false)
+  {
+    LM_T(LmtContext, ("Not caching invalid inline context (%s: %s)", pd.title, pd.detail));
+    itemFree(itemP);
+    return NULL;
+  }
+
+  return itemP;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// requestContext - copy of the cached context, allocated in the request's kalloc instance
+//
+// The copy shares the (read-only) hash tables with the cached context but its tree is the
+// context tree of the request. The request may modify its copy (origin, parent) and link the
+// tree into its notifications, without disturbing other requests.
+//
+static OrionldContext* requestContext(OrionldInlineContext* itemP, KjNode* contextTreeP)
+{
+  OrionldContext* contextP = (OrionldContext*) kaAlloc(&orionldState.kalloc, sizeof(OrionldContext));
+
+  memcpy(contextP, &itemP->context, sizeof(OrionldContext));
+  contextP->tree = contextTreeP;
+
+  return contextP;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheInit -
+//
+void orionldInlineContextCacheInit(int _maxEntries)
+{
+  if (_maxEntries <= 0)
+    return;
+
+  buckets = (_maxEntries < 64)? 64 : _maxEntries;
+  bucketV = (OrionldInlineContext**) calloc(buckets, sizeof(OrionldInlineContext*));
+
+  if (bucketV == NULL)
+    LM_X(1, ("Out of memory (allocating %d buckets for the inline context cache)", buckets));
+
+  maxEntries = _maxEntries;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheRelease -
+//
+// Called at exit, when no request is running anymore.
+//
+void orionldInlineContextCacheRelease(void)
+{
+  pthread_mutex_lock(&cacheMutex);
+
+  OrionldInlineContext* itemP = lruFirst;
+  while (itemP != NULL)
+  {
+    OrionldInlineContext* next = itemP->lruNext;
+
+    itemFree(itemP);
+    itemP = next;
+  }
+
+  free(bucketV);
+
+  bucketV    = NULL;
+  lruFirst   = NULL;
+  lruLast    = NULL;
+  entries    = 0;
+  maxEntries = 0;
+
+  pthread_mutex_unlock(&cacheMutex);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheGet -
+//
+// The cache item stays referenced until the end of the request (orionldStateRelease)
+//
+OrionldContext* orionldInlineContextCacheGet(KjNode* contextTreeP)
+{
+  if (maxEntries == 0)
+    return NULL;
+
+  uint64_t               fprint = fingerprint(FNV_OFFSET_BASIS, contextTreeP);
+  OrionldInlineContext*  itemP  = NULL;
+
+  //
+  // The request already holds a reference to the context? (e.g. batch operations with the same @context in all entities)
+  //
+  for (int ix = 0; ix < orionldState.inlineContexts; ix++)
+  {
+    OrionldInlineContext* heldP = orionldState.inlineContextV[ix];
+
+    if ((heldP->fingerprint == fprint) && (treeEqual(heldP->tree, contextTreeP) == true))
+      return requestContext(heldP, contextTreeP);
+  }
+
+  if (orionldState.inlineContexts >= ORIONLD_INLINE_CONTEXTS_MAX)
+    return NULL;
+
+  pthread_mutex_lock(&cacheMutex);
+  itemP = itemLookup(fprint, contextTreeP);
+  if (itemP != NULL)
+  {
+    lruRemove(itemP);
+    lruPushFront(itemP);
+    ++itemP->refs;
+    ++hits;
+  }
+  else
+    ++misses;
+  pthread_mutex_unlock(&cacheMutex);
+
+  if (itemP == NULL)
+  {
+    OrionldInlineContext* newItemP = itemCreate(fprint, contextTreeP);
+    OrionldInlineContext* evictV   = NULL;  // Evicted items not in use - freed once the mutex is released
+
+    if (newItemP == NULL)
+      return NULL;
+
+    pthread_mutex_lock(&cacheMutex);
+
+    // Another request may have inserted the same context while this one was being built
+    itemP = itemLookup(fprint, contextTreeP);
+    if (itemP != NULL)
+    {
+      lruRemove(itemP);
+      lruPushFront(itemP);
+      ++itemP->refs;
+    }
+    else
+    {
+      itemP             = newItemP;
+      newItemP          = NULL;
+      itemP->refs       = 1;
+      itemP->bucketNext = bucketV[fprint % buckets];
+
+      bucketV[fprint % buckets] = itemP;
+      lruPushFront(itemP);
+      ++entries;
+
+      while ((entries > maxEntries) && (lruLast != itemP))
+      {
+        OrionldInlineContext* victimP = lruLast;
+
+        lruRemove(victimP);
+        bucketRemove(victimP);
+        victimP->evicted = true;
+        --entries;
+        ++evictions;
+
+        if (victimP->refs == 0)
+        {
+          victimP->lruNext = evictV;
+          evictV           = victimP;
+        }
+      }
+    }
+
+    pthread_mutex_unlock(&cacheMutex);
+
+    if (newItemP != NULL)
+      itemFree(newItemP);
+
+    while (evictV != NULL)
+    {
+      OrionldInlineContext* next = evictV->lruNext;
+
+      itemFree(evictV);
+      evictV = next;
+    }
+  }
+
+  orionldState.inlineContextV[orionldState.inlineContexts++] = itemP;
+
+  return requestContext(itemP, contextTreeP);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheRequestRelease -
+//
+void orionldInlineContextCacheRequestRelease(void)
+{
+  for (int ix = 0; ix < orionldState.inlineContexts; ix++)
+  {
+    OrionldInlineContext* itemP = orionldState.inlineContextV[ix];
+    bool                  release;
+
+    pthread_mutex_lock(&cacheMutex);
+    --itemP->refs;
+    release = (itemP->evicted == true) && (itemP->refs == 0);
+    pthread_mutex_unlock(&cacheMutex);
+
+    if (release)
+      itemFree(itemP);
+
+    orionldState.inlineContextV[ix] = NULL;
+  }
+
+  orionldState.inlineContexts = 0;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheStatisticsGet -
+//
+bool orionldInlineContextCacheStatisticsGet(int64_t* hitsP, int64_t* missesP, int64_t* evictionsP, int* entriesP)
+{
+  if (maxEntries == 0)
+    return false;
+
+  pthread_mutex_lock(&cacheMutex);
+  *hitsP      = hits;
+  *missesP    = misses;
+  *evictionsP = evictions;
+  *entriesP   = entries;
+  pthread_mutex_unlock(&cacheMutex);
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheStatisticsReset -
+//
+void orionldInlineContextCacheStatisticsReset(void)
+{
+  pthread_mutex_lock(&cacheMutex);
+  hits      = 0;
+  misses    = 0;
+  evictions = 0;
+  pthread_mutex_unlock(&cacheMutex);
+}
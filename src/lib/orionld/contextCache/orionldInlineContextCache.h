@@ -0,0 +1,90 @@
+#ifndef SRC_LIB_ORIONLD_CONTEXTCACHE_ORIONLDINLINECONTEXTCACHE_H_
+#define SRC_LIB_ORIONLD_CONTEXTCACHE_ORIONLDINLINECONTEXTCACHE_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdint.h>                                              // int64_t
+
+extern "C"
+{
+#include "kjson/KjNode.h"                                        // KjNode
+}
+
+#include "orionld/context/OrionldContext.h"                      // OrionldContext
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheInit - initialize the cache of inline key-value contexts
+//
+// maxEntries == 0 turns the cache off
+//
+extern void orionldInlineContextCacheInit(int maxEntries);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheRelease - free all contexts in the cache
+//
+extern void orionldInlineContextCacheRelease(void);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheGet - lookup (or build and insert) an inline key-value context
+//
+// Returns NULL if the context could not be served by the cache (cache off, or the context is
+// invalid) - the caller then builds the context the usual way.
+//
+extern OrionldContext* orionldInlineContextCacheGet(KjNode* contextTreeP);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheRequestRelease - release the contexts used by the current request
+//
+extern void orionldInlineContextCacheRequestRelease(void);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheStatisticsGet - returns false if the cache is off
+//
+extern bool orionldInlineContextCacheStatisticsGet(int64_t* hitsP, int64_t* missesP, int64_t* evictionsP, int* entriesP);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldInlineContextCacheStatisticsReset -
+//
+extern void orionldInlineContextCacheStatisticsReset(void);
+
+#endif  // SRC_LIB_ORIONLD_CONTEXTCACHE_ORIONLDINLINECONTEXTCACHE_H_
@@ -94,7 +94,7 @@ typedef KjNode* (*DbEntitiesGet)(char** fieldV, int fields);
 typedef KjNode* (*DbEntityTypesFromRegistrationsGet)(bool details);
 typedef bool    (*DbGeoIndexCreate)(OrionldTenant* tenantP, const char* attrName);
 typedef bool    (*DbIdIndexCreate)(OrionldTenant* tenantP);
-typedef KjNode* (*DbEntitiesQuery)(KjNode* entityInfoArrayP, KjNode* attrsP, QNode* qP, KjNode* geoqP, int limit, int offset, int* countP);
+typedef KjNode* (*DbEntitiesQuery)(OrionldProblemDetails* pdP, KjNode* entityInfoArrayP, KjNode* attrsP, QNode* qP, KjNode* geoqP, int limit, int offset, int* countP, char** projectionV);
 typedef KjNode* (*DbDatasetGet)(const char* entityId, const char* attributeNameExpandedEq, const char* datasetId);
 
 
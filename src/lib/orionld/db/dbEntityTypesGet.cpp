@@ -43,6 +43,7 @@ extern "C"
 #include "orionld/kjTree/kjStringValueLookupInArray.h"            // kjStringValueLookupInArray
 #include "orionld/kjTree/kjStringArraySortedInsert.h"             // kjStringArraySortedInsert
 #include "orionld/db/dbConfiguration.h"                           // dbEntityTypesFromRegistrationsGet, dbEntitiesGet
+#include "mongoBackend/mongoEntityTypeCatalog.h"                  // mongoEntityTypeCatalogActive, mongoEntityTypeCatalogTypesGet
 #include "orionld/db/dbEntityTypesGet.h"                          // Own interface
 
 
@@ -320,14 +321,25 @@ KjNode* dbEntityTypesGet(OrionldProblemDetails* pdP, bool details)
   fields[0] = (char*) "_id";
 
   //
-  // GET local types - i.e. from the "entities" collection
+  // GET local types - i.e. from the "entities" collection, or from the entity type catalog, if active.
+  // The catalog has no duplicates and gives the same layout as dbEntitiesGet
   //
-  if (details == false)
-    local  = dbEntitiesGet(fields, 1);
+  KjNode* catalogP = NULL;
+
+  if (mongoEntityTypeCatalogActive() == true)
+    catalogP = mongoEntityTypeCatalogTypesGet(orionldState.tenantP, details);  // NULL on database error
+
+  if (catalogP != NULL)
+    local = (catalogP->value.firstChildP != NULL)? catalogP : NULL;
   else
   {
-    fields[1] = (char*) "attrNames";
-    local  = dbEntitiesGet(fields, 2);
+    if (details == false)
+      local  = dbEntitiesGet(fields, 1);
+    else
+    {
+      fields[1] = (char*) "attrNames";
+      local  = dbEntitiesGet(fields, 2);
+    }
   }
 
   if (local != NULL)
@@ -348,9 +360,9 @@ KjNode* dbEntityTypesGet(OrionldProblemDetails* pdP, bool details)
 
 
   //
-  // Fix duplicates in 'local'
+  // Fix duplicates in 'local' - not needed if 'local' comes from the entity type catalog
   //
-  if (local != NULL)
+  if ((local != NULL) && (catalogP == NULL))
   {
     //
     // If 'details' is not on - just remove the duplicates
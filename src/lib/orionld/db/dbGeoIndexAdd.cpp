@@ -22,40 +22,34 @@
 *
 * Author: Ken Zangelin
 */
-extern "C"
-{
-#include "kalloc/kaAlloc.h"                                      // kaAlloc
-#include "kalloc/kaStrdup.h"                                     // kaStrdup
-}
+#include <pthread.h>                                             // pthread_mutex_lock, pthread_mutex_unlock
 
 #include "logMsg/logMsg.h"                                       // LM_*
 #include "logMsg/traceLevels.h"                                  // Lmt*
 
 #include "orionld/types/OrionldGeoIndex.h"                       // OrionldGeoIndex
-#include "orionld/common/orionldState.h"                         // kalloc, geoIndexList
+#include "orionld/db/dbGeoIndexRegistry.h"                       // geoIndexMutex, dbGeoIndexInsert
+#include "orionld/db/dbGeoIndexLookup.h"                         // dbGeoIndexLookup
 #include "orionld/db/dbGeoIndexAdd.h"                            // Own interface
 
 
 
 // ----------------------------------------------------------------------------
 //
-// dbGeoIndexAdd -
+// dbGeoIndexAdd - register a geo-index that exists in the database
+//
+// If the index is already in the registry (queued by a request), it is marked as ready.
 //
 void dbGeoIndexAdd(const char* tenant, const char* attrName)
 {
-  OrionldGeoIndex* geoNodeP = (OrionldGeoIndex*) kaAlloc(&kalloc, sizeof(OrionldGeoIndex));
+  pthread_mutex_lock(&geoIndexMutex);
 
-  geoNodeP->tenant   = kaStrdup(&kalloc, tenant);
-  geoNodeP->attrName = kaStrdup(&kalloc, attrName);
+  OrionldGeoIndex* giP = dbGeoIndexLookup(tenant, attrName);
 
-  if (geoIndexList == NULL)
-  {
-    geoNodeP->next = NULL;
-    geoIndexList   = geoNodeP;
-  }
+  if (giP != NULL)
+    __atomic_store_n(&giP->state, GeoIndexReady, __ATOMIC_RELEASE);
   else
-  {
-    geoNodeP->next = geoIndexList;
-    geoIndexList   = geoNodeP;
-  }
+    dbGeoIndexInsert(NULL, tenant, attrName, GeoIndexReady);
+
+  pthread_mutex_unlock(&geoIndexMutex);
 }
@@ -30,7 +30,7 @@
 
 // ----------------------------------------------------------------------------
 //
-// dbGeoIndexAdd -
+// dbGeoIndexAdd - register a geo-index that exists in the database (marking it as ready if already queued)
 //
 extern void dbGeoIndexAdd(const char* tenant, const char* attrName);
 
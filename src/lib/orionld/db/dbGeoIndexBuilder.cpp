@@ -0,0 +1,175 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string.h>                                              // strerror
+#include <errno.h>                                               // errno
+#include <time.h>                                                // time, clock_gettime
+#include <pthread.h>                                             // pthread_*
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/types/OrionldGeoIndex.h"                       // OrionldGeoIndex
+#include "orionld/db/dbConfiguration.h"                          // dbGeoIndexCreate
+#include "orionld/db/dbGeoIndexBuilder.h"                        // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Builder thread state
+//
+static pthread_t        builderThread;
+static bool             builderThreadRunning = false;
+static bool             builderStop          = false;
+static OrionldGeoIndex* queueFirst           = NULL;
+static OrionldGeoIndex* queueLast            = NULL;
+static pthread_mutex_t  queueMutex           = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   queueCond            = PTHREAD_COND_INITIALIZER;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// geoIndexBuild -
+//
+static void geoIndexBuild(OrionldGeoIndex* giP)
+{
+  struct timespec start;
+  struct timespec end;
+
+  __atomic_store_n(&giP->state, GeoIndexBuilding, __ATOMIC_RELEASE);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // dbGeoIndexCreate registers the index as ready (dbGeoIndexAdd) on success
+  if ((dbGeoIndexCreate == NULL) || (dbGeoIndexCreate(giP->tenantP, giP->attrName) == false))
+  {
+    LM_E(("Database Error (unable to create the geo-index for attribute '%s' of tenant '%s')", giP->attrName, giP->tenant));
+    __atomic_store_n(&giP->failedAt, time(NULL), __ATOMIC_RELAXED);
+    __atomic_store_n(&giP->state, GeoIndexFailed, __ATOMIC_RELEASE);
+    return;
+  }
+
+  __atomic_store_n(&giP->state, GeoIndexReady, __ATOMIC_RELEASE);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  int ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+  LM_T(LmtMongo, ("Built the geo-index for attribute '%s' of tenant '%s' in %d milliseconds", giP->attrName, giP->tenant, ms));
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexBuilderThread -
+//
+static void* dbGeoIndexBuilderThread(void* vP)
+{
+  pthread_mutex_lock(&queueMutex);
+
+  while (builderStop == false)
+  {
+    if (queueFirst == NULL)
+    {
+      pthread_cond_wait(&queueCond, &queueMutex);
+      continue;
+    }
+
+    OrionldGeoIndex* giP = queueFirst;
+
+    queueFirst = giP->queueNext;
+    if (queueFirst == NULL)
+      queueLast = NULL;
+    giP->queueNext = NULL;
+
+    pthread_mutex_unlock(&queueMutex);
+    geoIndexBuild(giP);
+    pthread_mutex_lock(&queueMutex);
+  }
+
+  pthread_mutex_unlock(&queueMutex);
+
+  return NULL;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexBuilderStart -
+//
+bool dbGeoIndexBuilderStart(void)
+{
+  builderStop = false;
+
+  if (pthread_create(&builderThread, NULL, dbGeoIndexBuilderThread, NULL) != 0)
+    LM_RE(false, ("Internal Error (unable to create the geo-index builder thread: %s)", strerror(errno)));
+
+  builderThreadRunning = true;
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexBuilderPush -
+//
+void dbGeoIndexBuilderPush(OrionldGeoIndex* giP)
+{
+  pthread_mutex_lock(&queueMutex);
+
+  giP->queueNext = NULL;
+
+  if (queueLast == NULL)
+    queueFirst = giP;
+  else
+    queueLast->queueNext = giP;
+  queueLast = giP;
+
+  pthread_cond_signal(&queueCond);
+  pthread_mutex_unlock(&queueMutex);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexBuilderStop -
+//
+void dbGeoIndexBuilderStop(void)
+{
+  if (builderThreadRunning == false)
+    return;
+
+  pthread_mutex_lock(&queueMutex);
+  builderStop = true;
+  pthread_cond_signal(&queueCond);
+  pthread_mutex_unlock(&queueMutex);
+
+  pthread_join(builderThread, NULL);
+  builderThreadRunning = false;
+}
@@ -0,0 +1,98 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <time.h>                                                // time
+#include <pthread.h>                                             // pthread_mutex_lock, pthread_mutex_unlock
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/types/OrionldTenant.h"                         // OrionldTenant
+#include "orionld/types/OrionldGeoIndex.h"                       // OrionldGeoIndex
+#include "orionld/db/dbGeoIndexRegistry.h"                       // geoIndexMutex, dbGeoIndexInsert
+#include "orionld/db/dbGeoIndexLookup.h"                         // dbGeoIndexLookup
+#include "orionld/db/dbGeoIndexBuilder.h"                        // dbGeoIndexBuilderPush
+#include "orionld/db/dbGeoIndexEnqueue.h"                        // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// GEO_INDEX_RETRY_DELAY - seconds before a failed geo-index build is retried
+//
+#define GEO_INDEX_RETRY_DELAY  60
+
+
+
+// -----------------------------------------------------------------------------
+//
+// retryDue - is 'giP' a failed geo-index build that should be retried?
+//
+static bool retryDue(OrionldGeoIndex* giP, time_t now)
+{
+  if (__atomic_load_n(&giP->state, __ATOMIC_ACQUIRE) != GeoIndexFailed)
+    return false;
+
+  return now - __atomic_load_n(&giP->failedAt, __ATOMIC_RELAXED) >= GEO_INDEX_RETRY_DELAY;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexEnqueue -
+//
+void dbGeoIndexEnqueue(OrionldTenant* tenantP, const char* attrName)
+{
+  // Fast path - no lock - the index is known (the normal case)
+  OrionldGeoIndex* giP = dbGeoIndexLookup(tenantP->tenant, attrName);
+  time_t           now = time(NULL);
+
+  if ((giP != NULL) && (retryDue(giP, now) == false))
+    return;
+
+  pthread_mutex_lock(&geoIndexMutex);
+
+  // Another request may have queued it while waiting for the mutex
+  giP = dbGeoIndexLookup(tenantP->tenant, attrName);
+
+  if (giP == NULL)
+  {
+    giP = dbGeoIndexInsert(tenantP, tenantP->tenant, attrName, GeoIndexQueued);
+  }
+  else if (retryDue(giP, now) == true)
+  {
+    giP->tenantP = tenantP;
+    __atomic_store_n(&giP->state, GeoIndexQueued, __ATOMIC_RELEASE);
+  }
+  else
+  {
+    giP = NULL;  // Already queued again by another request
+  }
+
+  pthread_mutex_unlock(&geoIndexMutex);
+
+  if (giP != NULL)
+    dbGeoIndexBuilderPush(giP);
+}
@@ -22,10 +22,8 @@
 *
 * Author: Ken Zangelin
 */
-#include <string.h>                                              // strcmp
-
 #include "orionld/types/OrionldGeoIndex.h"                       // OrionldGeoIndex
-#include "orionld/common/orionldState.h"                         // geoIndexList
+#include "orionld/db/dbGeoIndexRegistry.h"                       // geoIndexBucketV, dbGeoIndexHash, dbGeoIndexMatch
 #include "orionld/db/dbGeoIndexLookup.h"                         // Own interface
 
 
@@ -34,19 +32,20 @@
 //
 // dbGeoIndexLookup -
 //
-// FIXME: OrionldGeoIndex could have a OrionldTenant pointer instead and we'd save a strcmp
-//        Would get a pointer comparison instead - much faster!
+// Lock-free - items are never removed from the registry and they're published only once completely built.
+// The attribute name can be given with dots or with '=' (as in the database).
 //
 OrionldGeoIndex* dbGeoIndexLookup(const char* tenant, const char* attrName)
 {
-  OrionldGeoIndex* giP = geoIndexList;
+  unsigned int      bucket = dbGeoIndexHash(tenant, attrName) & (GEO_INDEX_BUCKETS - 1);
+  OrionldGeoIndex*  giP    = __atomic_load_n(&geoIndexBucketV[bucket], __ATOMIC_ACQUIRE);
 
   while (giP != NULL)
   {
-    if ((strcmp(giP->tenant, tenant) == 0) && (strcmp(giP->attrName, attrName) == 0))
+    if (dbGeoIndexMatch(giP, tenant, attrName) == true)
       return giP;
 
-    giP = giP->next;
+    giP = giP->hashNext;
   }
 
   return NULL;
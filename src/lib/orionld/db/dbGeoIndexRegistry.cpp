@@ -0,0 +1,164 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdlib.h>                                              // malloc, free
+#include <string.h>                                              // strdup
+#include <pthread.h>                                             // pthread_mutex_t
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/types/OrionldTenant.h"                         // OrionldTenant
+#include "orionld/types/OrionldGeoIndex.h"                       // OrionldGeoIndex, OrionldGeoIndexState
+#include "orionld/common/orionldState.h"                         // geoIndexList
+#include "orionld/common/dotForEq.h"                             // dotForEq
+#include "orionld/db/dbGeoIndexRegistry.h"                       // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Geo-index registry
+//
+OrionldGeoIndex*  geoIndexBucketV[GEO_INDEX_BUCKETS];
+pthread_mutex_t   geoIndexMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexHash -
+//
+unsigned int dbGeoIndexHash(const char* tenant, const char* attrName)
+{
+  unsigned int hash = 2166136261U;
+
+  while (*tenant != 0)
+  {
+    hash ^= (unsigned char) *tenant;
+    hash *= 16777619U;
+    ++tenant;
+  }
+
+  // Separator, so that "ab" + "c" and "a" + "bc" hash differently
+  hash *= 16777619U;
+
+  while (*attrName != 0)
+  {
+    hash ^= (unsigned char) ((*attrName == '.')? '=' : *attrName);
+    hash *= 16777619U;
+    ++attrName;
+  }
+
+  return hash;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexMatch -
+//
+bool dbGeoIndexMatch(OrionldGeoIndex* giP, const char* tenant, const char* attrName)
+{
+  if (strcmp(giP->tenant, tenant) != 0)
+    return false;
+
+  const char* dbName = giP->attrName;
+
+  while ((*dbName != 0) && ((*dbName == *attrName) || ((*dbName == '=') && (*attrName == '.'))))
+  {
+    ++dbName;
+    ++attrName;
+  }
+
+  return (*dbName == 0) && (*attrName == 0);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexInsert -
+//
+OrionldGeoIndex* dbGeoIndexInsert(OrionldTenant* tenantP, const char* tenant, const char* attrName, OrionldGeoIndexState state)
+{
+  OrionldGeoIndex* giP = (OrionldGeoIndex*) malloc(sizeof(OrionldGeoIndex));
+
+  if (giP == NULL)
+    LM_RE(NULL, ("Out of memory (allocating a geo-index registry item)"));
+
+  giP->tenant    = strdup(tenant);
+  giP->attrName  = strdup(attrName);
+  giP->tenantP   = tenantP;
+  giP->state     = state;
+  giP->failedAt  = 0;
+  giP->queueNext = NULL;
+
+  if ((giP->tenant == NULL) || (giP->attrName == NULL))
+  {
+    free(giP->tenant);
+    free(giP->attrName);
+    free(giP);
+    LM_RE(NULL, ("Out of memory (allocating a geo-index registry item)"));
+  }
+
+  dotForEq(giP->attrName);
+
+  unsigned int bucket = dbGeoIndexHash(tenant, attrName) & (GEO_INDEX_BUCKETS - 1);
+
+  // The item is completely built - make it visible to the readers
+  giP->hashNext = geoIndexBucketV[bucket];
+  giP->next     = geoIndexList;
+  __atomic_store_n(&geoIndexBucketV[bucket], giP, __ATOMIC_RELEASE);
+  __atomic_store_n(&geoIndexList, giP, __ATOMIC_RELEASE);
+
+  return giP;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexRegistryRelease -
+//
+void dbGeoIndexRegistryRelease(void)
+{
+  OrionldGeoIndex* giP = geoIndexList;
+
+  while (giP != NULL)
+  {
+    OrionldGeoIndex* next = giP->next;
+
+    free(giP->tenant);
+    free(giP->attrName);
+    free(giP);
+
+    giP = next;
+  }
+
+  geoIndexList = NULL;
+  for (int ix = 0; ix < GEO_INDEX_BUCKETS; ix++)
+    geoIndexBucketV[ix] = NULL;
+}
@@ -0,0 +1,88 @@
+#ifndef SRC_LIB_ORIONLD_DB_DBGEOINDEXREGISTRY_H_
+#define SRC_LIB_ORIONLD_DB_DBGEOINDEXREGISTRY_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <pthread.h>                                             // pthread_mutex_t
+
+#include "orionld/types/OrionldTenant.h"                         // OrionldTenant
+#include "orionld/types/OrionldGeoIndex.h"                       // OrionldGeoIndex, OrionldGeoIndexState
+
+
+
+// -----------------------------------------------------------------------------
+//
+// GEO_INDEX_BUCKETS - number of buckets of the geo-index registry - must be a power of two
+//
+#define GEO_INDEX_BUCKETS  256
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Geo-index registry - all geo-indexes, hashed on tenant + attribute name
+//
+// Items are only inserted (never removed), with geoIndexMutex taken, and published with an atomic store
+// of the bucket head (and of geoIndexList) once completely built.
+// Readers (dbGeoIndexLookup, GET /ngsi-ld/ex/v1/dbIndexes) never take the mutex.
+//
+extern OrionldGeoIndex*  geoIndexBucketV[GEO_INDEX_BUCKETS];
+extern pthread_mutex_t   geoIndexMutex;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexHash - FNV-1a of tenant + attribute name
+//
+// Dots in the attribute name are hashed as '=', so the name can be given as it comes in the request, or as it is in the database.
+//
+extern unsigned int dbGeoIndexHash(const char* tenant, const char* attrName);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexMatch - does the registry item 'giP' correspond to tenant + attribute name?
+//
+extern bool dbGeoIndexMatch(OrionldGeoIndex* giP, const char* tenant, const char* attrName);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexInsert - add a new item to the registry - geoIndexMutex must be taken
+//
+extern OrionldGeoIndex* dbGeoIndexInsert(OrionldTenant* tenantP, const char* tenant, const char* attrName, OrionldGeoIndexState state);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dbGeoIndexRegistryRelease - free all items of the registry (at exit)
+//
+extern void dbGeoIndexRegistryRelease(void);
+
+#endif  // SRC_LIB_ORIONLD_DB_DBGEOINDEXREGISTRY_H_
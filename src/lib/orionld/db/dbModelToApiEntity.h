@@ -0,0 +1,59 @@
+#ifndef SRC_LIB_ORIONLD_DB_DBMODELTOAPIENTITY_H_
+#define SRC_LIB_ORIONLD_DB_DBMODELTOAPIENTITY_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+extern "C"
+{
+#include "kjson/KjNode.h"                                        // KjNode
+}
+
+
+
+// ----------------------------------------------------------------------------
+//
+// dbModelToApiEntity - transform an entity as stored in the database into its API representation
+//
+// PARAMETERS
+//   dbTree          the entity, as extracted from the database (dbDataToKjTree)
+//   attrs           array of attribute names, terminated by a NULL pointer
+//   attrMandatory   If true - NULL is returned unless any of the attributes in 'attrs' is present in the entity
+//   sysAttrs        include 'createdAt' and 'modifiedAt'
+//   keyValues       short representation of the attributes
+//   geoPropertyName long name of geopoperty - only if geo-json represenatation (else NULL)
+//   geoPropertyP    output: the geo-property, if 'geoPropertyName' is given
+//
+extern KjNode* dbModelToApiEntity
+(
+  KjNode*      dbTree,
+  char**       attrs,
+  bool         attrMandatory,
+  bool         sysAttrs,
+  bool         keyValues,
+  const char*  geoPropertyName,
+  KjNode**     geoPropertyP
+);
+
+#endif  // SRC_LIB_ORIONLD_DB_DBMODELTOAPIENTITY_H_
@@ -0,0 +1,108 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string.h>                                            // strcmp
+
+extern "C"
+{
+#include "kjson/KjNode.h"                                      // KjNode
+}
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/common/orionldState.h"                       // orionldState
+#include "orionld/context/orionldContextItemAliasLookup.h"     // orionldContextItemAliasLookup
+#include "orionld/kjTree/kjTemporalEntityCompact.h"            // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// instanceFieldNames - the fields of an attribute instance that are not sub-attributes
+//
+static const char* instanceFieldNames[] =
+{
+  "type",
+  "value",
+  "object",
+  "languageMap",
+  "instanceId",
+  "datasetId",
+  "observedAt",
+  "unitCode",
+  "createdAt",
+  "modifiedAt",
+  NULL
+};
+
+
+
+// -----------------------------------------------------------------------------
+//
+// isInstanceField -
+//
+static bool isInstanceField(const char* name)
+{
+  for (int ix = 0; instanceFieldNames[ix] != NULL; ix++)
+  {
+    if (strcmp(name, instanceFieldNames[ix]) == 0)
+      return true;
+  }
+
+  return false;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// kjTemporalEntityCompact -
+//
+void kjTemporalEntityCompact(KjNode* entityP)
+{
+  for (KjNode* nodeP = entityP->value.firstChildP; nodeP != NULL; nodeP = nodeP->next)
+  {
+    if (strcmp(nodeP->name, "id") == 0)
+      continue;
+
+    if (strcmp(nodeP->name, "type") == 0)
+    {
+      nodeP->value.s = orionldContextItemAliasLookup(orionldState.contextP, nodeP->value.s, NULL, NULL);
+      continue;
+    }
+
+    // An attribute - an array of instances
+    nodeP->name = orionldContextItemAliasLookup(orionldState.contextP, nodeP->name, NULL, NULL);
+
+    for (KjNode* instanceP = nodeP->value.firstChildP; instanceP != NULL; instanceP = instanceP->next)
+    {
+      for (KjNode* fieldP = instanceP->value.firstChildP; fieldP != NULL; fieldP = fieldP->next)
+      {
+        if (isInstanceField(fieldP->name) == false)
+          fieldP->name = orionldContextItemAliasLookup(orionldState.contextP, fieldP->name, NULL, NULL);
+      }
+    }
+  }
+}
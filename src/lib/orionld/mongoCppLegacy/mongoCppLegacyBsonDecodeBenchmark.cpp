@@ -0,0 +1,298 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdio.h>                                                   // printf, snprintf
+#include <stdlib.h>                                                  // free
+#include <string.h>                                                  // strdup
+#include <string>                                                    // std::string
+#include <vector>                                                    // std::vector
+
+#include "mongo/client/dbclient.h"                                   // mongo::BSONObj
+
+extern "C"
+{
+#include "kbase/kTime.h"                                             // kTimeGet, kTimeDiff
+#include "kalloc/kaBufferReset.h"                                    // kaBufferReset
+#include "kjson/KjNode.h"                                            // KjNode
+#include "kjson/kjParse.h"                                           // kjParse
+}
+
+#include "logMsg/logMsg.h"                                           // LM_*
+#include "logMsg/traceLevels.h"                                      // Lmt*
+
+#include "orionld/common/orionldState.h"                             // orionldState, orionldStateInit
+#include "orionld/mongoCppLegacy/mongoCppLegacyDataToKjTree.h"       // mongoCppLegacyDataToKjTree
+#include "orionld/mongoCppLegacy/mongoCppLegacyBsonDecodeBenchmark.h"  // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// BENCH_ENTITIES - number of entities in the test set
+// BENCH_ATTRS    - number of attributes of each entity (plus 'location' and 'isParkedAt')
+//
+#define BENCH_ENTITIES  100
+#define BENCH_ATTRS      20
+
+
+
+// -----------------------------------------------------------------------------
+//
+// propertyBuild - an attribute as stored in the database, with 'observedAt' and 'unitCode' as metadata
+//
+static mongo::BSONObj propertyBuild(int ix, double timestamp)
+{
+  mongo::BSONObjBuilder    attr;
+  mongo::BSONObjBuilder    md;
+  mongo::BSONObjBuilder    observedAt;
+  mongo::BSONObjBuilder    unitCode;
+  mongo::BSONArrayBuilder  mdNames;
+
+  observedAt.append("value", timestamp);
+  unitCode.append("value", "KMH");
+  md.append("https://uri=etsi=org/ngsi-ld/observedAt", observedAt.obj());
+  md.append("unitCode", unitCode.obj());
+  mdNames.append("https://uri.etsi.org/ngsi-ld/observedAt");
+  mdNames.append("unitCode");
+
+  attr.append("type", "https://uri.etsi.org/ngsi-ld/Property");
+  attr.append("creDate", timestamp);
+  attr.append("modDate", timestamp);
+
+  if (ix % 3 == 0)
+    attr.append("value", "a string value, not too short, not too long");
+  else if (ix % 3 == 1)
+    attr.append("value", 100.0 + ix / 7.0);
+  else
+    attr.append("value", ix);
+
+  attr.append("md", md.obj());
+  attr.append("mdNames", mdNames.arr());
+
+  return attr.obj();
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// entityBuild - an entity as stored in the database (the NGSIv2 database model)
+//
+static mongo::BSONObj entityBuild(int entityNo)
+{
+  double                   timestamp = 1600000000.123 + entityNo;
+  char                     entityId[64];
+  char                     attrName[64];
+  mongo::BSONObjBuilder    entity;
+  mongo::BSONObjBuilder    id;
+  mongo::BSONObjBuilder    attrs;
+  mongo::BSONArrayBuilder  attrNames;
+
+  snprintf(entityId, sizeof(entityId), "urn:ngsi-ld:Vehicle:%06d", entityNo);
+
+  id.append("id",          entityId);
+  id.append("type",        "https://uri.fiware.org/ns/data-models#Vehicle");
+  id.append("servicePath", "/");
+
+  for (int ix = 0; ix < BENCH_ATTRS; ix++)
+  {
+    snprintf(attrName, sizeof(attrName), "https://uri=fiware=org/ns/data-models#attr%02d", ix);
+    attrs.append(attrName, propertyBuild(ix, timestamp));
+
+    snprintf(attrName, sizeof(attrName), "https://uri.fiware.org/ns/data-models#attr%02d", ix);
+    attrNames.append(attrName);
+  }
+
+  // A GeoProperty
+  mongo::BSONObjBuilder    location;
+  mongo::BSONObjBuilder    point;
+  mongo::BSONArrayBuilder  coordinates;
+
+  coordinates.append(-3.691944 + entityNo / 1000.0);
+  coordinates.append(40.418889);
+  point.append("type", "Point");
+  point.append("coordinates", coordinates.arr());
+  location.append("type",    "https://uri.etsi.org/ngsi-ld/GeoProperty");
+  location.append("creDate", timestamp);
+  location.append("modDate", timestamp);
+  location.append("value",   point.obj());
+  location.append("mdNames", mongo::BSONArrayBuilder().arr());
+  attrs.append("location", location.obj());
+  attrNames.append("location");
+
+  // A Relationship
+  mongo::BSONObjBuilder    isParkedAt;
+
+  isParkedAt.append("type",    "https://uri.etsi.org/ngsi-ld/Relationship");
+  isParkedAt.append("creDate", timestamp);
+  isParkedAt.append("modDate", timestamp);
+  isParkedAt.append("value",   "urn:ngsi-ld:OffStreetParking:Downtown1");
+  isParkedAt.append("mdNames", mongo::BSONArrayBuilder().arr());
+  attrs.append("https://uri=fiware=org/ns/data-models#isParkedAt", isParkedAt.obj());
+  attrNames.append("https://uri.fiware.org/ns/data-models#isParkedAt");
+
+  entity.append("_id",            id.obj());
+  entity.append("attrNames",      attrNames.arr());
+  entity.append("attrs",          attrs.obj());
+  entity.append("creDate",        timestamp);
+  entity.append("modDate",        timestamp);
+  entity.append("lastCorrelator", "");
+
+  return entity.obj();
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// kjNodes - number of nodes in a KjNode tree
+//
+static int kjNodes(KjNode* nodeP)
+{
+  int nodes = 1;
+
+  if ((nodeP->type == KjObject) || (nodeP->type == KjArray))
+  {
+    for (KjNode* childP = nodeP->value.firstChildP; childP != NULL; childP = childP->next)
+      nodes += kjNodes(childP);
+  }
+
+  return nodes;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// jsonRoundTrip - the old way: BSONObj => JSON string => strdup => kjParse
+//
+static KjNode* jsonRoundTrip(mongo::BSONObj* bsonObjP, char** jsonBufP)
+{
+  std::string jsonString = bsonObjP->jsonString();
+
+  *jsonBufP = strdup(jsonString.c_str());  // kjParse parses in-place - the buffer must live as long as the tree
+  if (*jsonBufP == NULL)
+    return NULL;
+
+  return kjParse(orionldState.kjsonP, *jsonBufP);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// kallocReset - start over with the kalloc buffer, just like in between requests
+//
+static void kallocReset(void)
+{
+  kaBufferReset(&orionldState.kalloc, false);
+  orionldStateInit();
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// mongoCppLegacyBsonDecodeBenchmark -
+//
+// Both decoders are run over the same set of entities (in the database model), 'iterations' times.
+// The kalloc buffer is reset after each pass over the entities, as it would be at the end of a request.
+//
+void mongoCppLegacyBsonDecodeBenchmark(int iterations)
+{
+  std::vector<mongo::BSONObj>  entityV;
+  int                          bytes = 0;
+
+  for (int ix = 0; ix < BENCH_ENTITIES; ix++)
+  {
+    entityV.push_back(entityBuild(ix));
+    bytes += entityV[ix].objsize();
+  }
+
+  struct timespec  start;
+  struct timespec  end;
+  struct timespec  diff;
+  float            roundTripTime;
+  float            directTime;
+  int              roundTripNodes = 0;
+  int              directNodes    = 0;
+  char*            jsonBufV[BENCH_ENTITIES];
+  char*            title;
+  char*            details;
+
+  //
+  // jsonString() + kjParse
+  //
+  kTimeGet(&start);
+  for (int iteration = 0; iteration < iterations; iteration++)
+  {
+    for (int ix = 0; ix < BENCH_ENTITIES; ix++)
+    {
+      KjNode* treeP = jsonRoundTrip(&entityV[ix], &jsonBufV[ix]);
+
+      if ((iteration == 0) && (treeP != NULL))
+        roundTripNodes += kjNodes(treeP);
+    }
+
+    for (int ix = 0; ix < BENCH_ENTITIES; ix++)
+      free(jsonBufV[ix]);
+
+    kallocReset();
+  }
+  kTimeGet(&end);
+  kTimeDiff(&start, &end, &diff, &roundTripTime);
+
+  //
+  // Direct BSON walk
+  //
+  kTimeGet(&start);
+  for (int iteration = 0; iteration < iterations; iteration++)
+  {
+    for (int ix = 0; ix < BENCH_ENTITIES; ix++)
+    {
+      KjNode* treeP = mongoCppLegacyDataToKjTree(&entityV[ix], false, &title, &details);
+
+      if ((iteration == 0) && (treeP != NULL))
+        directNodes += kjNodes(treeP);
+    }
+
+    kallocReset();
+  }
+  kTimeGet(&end);
+  kTimeDiff(&start, &end, &diff, &directTime);
+
+  int decodes = iterations * BENCH_ENTITIES;
+
+  printf("BSON decode benchmark: %d entities of %d bytes on average, %d iterations\n", BENCH_ENTITIES, bytes / BENCH_ENTITIES, iterations);
+  printf("  jsonString + kjParse:  %8.3f seconds  (%7.2f microseconds per entity, %d nodes per pass)\n",
+         roundTripTime, roundTripTime * 1000000 / decodes, roundTripNodes);
+  printf("  direct BSON walk:      %8.3f seconds  (%7.2f microseconds per entity, %d nodes per pass)\n",
+         directTime, directTime * 1000000 / decodes, directNodes);
+
+  if (directTime > 0)
+    printf("  speedup:               %8.2f\n", roundTripTime / directTime);
+
+  if (roundTripNodes != directNodes)
+    LM_W(("The two decoders produced a different number of nodes (%d vs %d)", roundTripNodes, directNodes));
+}
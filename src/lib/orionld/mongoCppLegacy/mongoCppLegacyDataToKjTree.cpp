@@ -22,115 +22,234 @@
 *
 * Author: Ken Zangelin
 */
+#include <string.h>                                                  // memcpy
+#include <stdint.h>                                                  // uint64_t
+#include <math.h>                                                    // pow
+
 #include "mongo/client/dbclient.h"                                   // mongo::BSONObj
 
 extern "C"
 {
-#include "kalloc/kaStrdup.h"                                         // kaStrdup
 #include "kjson/KjNode.h"                                            // KjNode
-#include "kjson/kjParse.h"                                           // kjParse
-#include "kjson/kjBuilder.h"                                         // kjBuilder
+#include "kjson/kjBuilder.h"                                         // kjString, kjObject, ...
 }
 
 #include "logMsg/logMsg.h"                                           // LM_*
 #include "logMsg/traceLevels.h"                                      // Lmt*
 
-#include "orionld/common/orionldState.h"                             // orionldState, orionldStateDelayedFreeEnqueue
+#include "orionld/common/orionldState.h"                             // orionldState
+#include "orionld/common/numberToDate.h"                             // numberToDate
 #include "orionld/mongoBackend/mongoTypeName.h"                      // mongoTypeName
 #include "orionld/mongoCppLegacy/mongoCppLegacyDataToKjTree.h"       // Own interface
 
 
 
-static void arrayToKjTree(KjNode* containerP, mongo::BSONArray* bsonArrayP, char** titleP, char** detailsP);
 // -----------------------------------------------------------------------------
 //
-// objectToKjTree -
+// BSON_DECIMAL128 - BSON type 19, not part of mongo::BSONType in the legacy driver
+//
+#define BSON_DECIMAL128  19
+
+
+
+// -----------------------------------------------------------------------------
 //
-static void objectToKjTree(KjNode* containerP, mongo::BSONObj* bsonObjP, char** titleP, char** detailsP)
+// decimal128ToDouble - convert an IEEE 754-2008 decimal128 (BID encoding) into a double
+//
+// The 16 bytes are little endian (as everything in BSON): low 64 bits first, then the high 64 bits.
+// Returns false for NaN and Infinity, as they have no JSON representation.
+//
+static bool decimal128ToDouble(const char* valueP, double* dP)
 {
-  for (mongo::BSONObj::iterator iter = bsonObjP->begin(); iter.more();)
+  uint64_t low;
+  uint64_t high;
+
+  memcpy(&low,  valueP,     sizeof(low));
+  memcpy(&high, &valueP[8], sizeof(high));
+
+  if ((high & 0x7800000000000000ULL) == 0x7800000000000000ULL)  // Infinity or NaN
+    return false;
+
+  bool     negative = (high >> 63) != 0;
+  int      exponent;
+  uint64_t coefficientHigh;
+
+  if ((high & 0x6000000000000000ULL) == 0x6000000000000000ULL)
   {
-    mongo::BSONElement be       = iter.next();
-    mongo::BSONType    type     = be.type();
-    KjNode*            nodeP    = NULL;
-    const char*        nodeName = be.fieldName();
-
-    if (type == mongo::String)
-      nodeP = kjString(orionldState.kjsonP, nodeName, be.String().c_str());
-    else if (type == mongo::Bool)
-      nodeP = kjBoolean(orionldState.kjsonP, nodeName, be.Bool());
-    else if (type == mongo::NumberDouble)
-      nodeP = kjFloat(orionldState.kjsonP, nodeName, be.Number());
-    else if (type == mongo::NumberInt)
-      nodeP = kjInteger(orionldState.kjsonP, nodeName, be.Number());
-    else if (type == mongo::jstNULL)
-      nodeP = kjNull(orionldState.kjsonP, nodeName);
-    else if (type == mongo::Object)
-    {
-      mongo::BSONObj bo = be.embeddedObject();
-      nodeP = kjObject(orionldState.kjsonP, nodeName);
-      objectToKjTree(nodeP, &bo, titleP, detailsP);
-    }
-    else if (type == mongo::Array)
-    {
-      mongo::BSONArray ba = (mongo::BSONArray) be.embeddedObject();
-      nodeP = kjArray(orionldState.kjsonP, nodeName);
-      arrayToKjTree(nodeP, &ba, titleP, detailsP);
-    }
-    else
-    {
-      LM_E(("Unsupported mongo type %d (%s) for field '%s'", type, mongoTypeName(type), nodeName));
-      continue;
-    }
+    // Coefficient larger than the max allowed - non-canonical, its value is zero
+    exponent        = (high >> 47) & 0x3FFF;
+    coefficientHigh = 0;
+    low             = 0;
+  }
+  else
+  {
+    exponent        = (high >> 49) & 0x3FFF;
+    coefficientHigh = high & 0x1FFFFFFFFFFFFULL;
+  }
+
+  double d = ((double) coefficientHigh * 18446744073709551616.0 + (double) low) * pow(10, exponent - 6176);
+
+  *dP = (negative == true)? -d : d;
+
+  return true;
+}
 
-    kjChildAdd(containerP, nodeP);
+
+
+// -----------------------------------------------------------------------------
+//
+// oidToKjString - 24 hex chars, built straight from the 12 bytes of the ObjectId
+//
+static KjNode* oidToKjString(const char* nodeName, const unsigned char* oidP)
+{
+  static const char  hex[] = "0123456789abcdef";
+  char               oidString[25];
+
+  for (int ix = 0; ix < 12; ix++)
+  {
+    oidString[ix * 2]     = hex[oidP[ix] >> 4];
+    oidString[ix * 2 + 1] = hex[oidP[ix] & 0x0F];
   }
+  oidString[24] = 0;
+
+  return kjString(orionldState.kjsonP, nodeName, oidString);
 }
 
 
 
 // -----------------------------------------------------------------------------
 //
-// arrayToKjTree -
+// dateToKjString - ISO8601 string of a BSON date (milliseconds since the epoch)
 //
-static void arrayToKjTree(KjNode* containerP, mongo::BSONArray* bsonArrayP, char** titleP, char** detailsP)
+static KjNode* dateToKjString(const char* nodeName, long long millis)
 {
-  for (mongo::BSONObj::iterator iter = bsonArrayP->begin(); iter.more();)
+  char dateString[64];
+
+  if (numberToDate((double) millis / 1000, dateString, sizeof(dateString)) == false)
+    return NULL;
+
+  return kjString(orionldState.kjsonP, nodeName, dateString);
+}
+
+
+
+static void bsonObjToKjTree(KjNode* containerP, const mongo::BSONObj* bsonObjP, bool isArray, char** titleP, char** detailsP);
+// -----------------------------------------------------------------------------
+//
+// bsonElementToKjNode - create a KjNode from a BSON element
+//
+// Strings and field names are copied straight from the BSON buffer into the kalloc buffer of the request
+// (by the kjBuilder functions), without any intermediate std::string.
+//
+static KjNode* bsonElementToKjNode(const mongo::BSONElement& be, const char* nodeName, char** titleP, char** detailsP)
+{
+  mongo::BSONType type  = be.type();
+  KjNode*         nodeP = NULL;
+
+  switch ((int) type)
   {
-    mongo::BSONElement be       = iter.next();
-    mongo::BSONType    type     = be.type();
-    KjNode*            nodeP    = NULL;
-    char*              nodeName = NULL;
-
-    if (type == mongo::String)
-      nodeP = kjString(orionldState.kjsonP, nodeName, be.String().c_str());
-    else if (type == mongo::Bool)
-      nodeP = kjBoolean(orionldState.kjsonP, nodeName, be.Bool());
-    else if (type == mongo::NumberDouble)
-      nodeP = kjFloat(orionldState.kjsonP, nodeName, be.Number());
-    else if (type == mongo::NumberInt)
-      nodeP = kjInteger(orionldState.kjsonP, nodeName, be.Number());
-    else if (type == mongo::jstNULL)
-      nodeP = kjNull(orionldState.kjsonP, nodeName);
-    else if (type == mongo::Object)
-    {
-      mongo::BSONObj bo = be.embeddedObject();
-      nodeP = kjObject(orionldState.kjsonP, nodeName);
-      objectToKjTree(nodeP, &bo, titleP, detailsP);
-    }
-    else if (type == mongo::Array)
-    {
-      mongo::BSONArray ba = (mongo::BSONArray) be.embeddedObject();
-      nodeP = kjArray(orionldState.kjsonP, nodeName);
-      arrayToKjTree(nodeP, &ba, titleP, detailsP);
-    }
+  case mongo::String:
+  case mongo::Symbol:
+  case mongo::Code:
+    nodeP = kjString(orionldState.kjsonP, nodeName, be.valuestr());
+    break;
+
+  case mongo::NumberDouble:
+    nodeP = kjFloat(orionldState.kjsonP, nodeName, be.Double());
+    break;
+
+  case mongo::NumberInt:
+    nodeP = kjInteger(orionldState.kjsonP, nodeName, be._numberInt());
+    break;
+
+  case mongo::NumberLong:
+    nodeP = kjInteger(orionldState.kjsonP, nodeName, be._numberLong());
+    break;
+
+  case BSON_DECIMAL128:
+  {
+    double d;
+
+    if (decimal128ToDouble(be.value(), &d) == true)
+      nodeP = kjFloat(orionldState.kjsonP, nodeName, d);
     else
-    {
-      LM_E(("Unsupported mongo type %d (%s) for field '%s'", type, mongoTypeName(type), nodeName));
-      continue;
-    }
+      nodeP = kjNull(orionldState.kjsonP, nodeName);
+    break;
+  }
+
+  case mongo::Bool:
+    nodeP = kjBoolean(orionldState.kjsonP, nodeName, be.Bool());
+    break;
+
+  case mongo::Date:
+    nodeP = dateToKjString(nodeName, (long long) be.date().millis);
+    break;
 
-    kjChildAdd(containerP, nodeP);
+  case mongo::Timestamp:
+    nodeP = dateToKjString(nodeName, (long long) be.timestampTime().millis);
+    break;
+
+  case mongo::jstOID:
+    nodeP = oidToKjString(nodeName, (const unsigned char*) be.value());
+    break;
+
+  case mongo::RegEx:
+    nodeP = kjString(orionldState.kjsonP, nodeName, be.regex());
+    break;
+
+  case mongo::jstNULL:
+  case mongo::Undefined:
+  case mongo::MinKey:
+  case mongo::MaxKey:
+    nodeP = kjNull(orionldState.kjsonP, nodeName);
+    break;
+
+  case mongo::Object:
+  {
+    mongo::BSONObj bo = be.embeddedObject();
+
+    nodeP = kjObject(orionldState.kjsonP, nodeName);
+    bsonObjToKjTree(nodeP, &bo, false, titleP, detailsP);
+    break;
+  }
+
+  case mongo::Array:
+  {
+    mongo::BSONObj bo = be.embeddedObject();
+
+    nodeP = kjArray(orionldState.kjsonP, nodeName);
+    bsonObjToKjTree(nodeP, &bo, true, titleP, detailsP);
+    break;
+  }
+
+  default:
+    LM_E(("Unsupported mongo type %d (%s) for field '%s'", type, mongoTypeName(type), be.fieldName()));
+    break;
+  }
+
+  return nodeP;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// bsonObjToKjTree -
+//
+// BSON arrays are BSON objects whose field names are "0", "1", ... - the names are skipped for arrays.
+//
+static void bsonObjToKjTree(KjNode* containerP, const mongo::BSONObj* bsonObjP, bool isArray, char** titleP, char** detailsP)
+{
+  mongo::BSONObjIterator iter(*bsonObjP);
+
+  while (iter.more())
+  {
+    mongo::BSONElement  be       = iter.next();
+    const char*         nodeName = (isArray == true)? NULL : be.fieldName();
+    KjNode*             nodeP    = bsonElementToKjNode(be, nodeName, titleP, detailsP);
+
+    if (nodeP != NULL)
+      kjChildAdd(containerP, nodeP);
   }
 }
 
@@ -140,20 +259,18 @@ static void arrayToKjTree(KjNode* containerP, mongo::BSONArray* bsonArrayP, char
 //
 // mongoCppLegacyDataToKjTree -
 //
+// Single pass over the BSON buffer, building the KjNode tree in the kalloc buffer of the request.
+//
 KjNode* mongoCppLegacyDataToKjTree(const void* dataP, bool isArray, char** titleP, char** detailsP)
 {
   KjNode* rootP;
 
   if (isArray == false)
-  {
     rootP = kjObject(orionldState.kjsonP, NULL);
-    objectToKjTree(rootP, (mongo::BSONObj*) dataP, titleP, detailsP);
-  }
   else
-  {
     rootP = kjArray(orionldState.kjsonP, NULL);
-    arrayToKjTree(rootP, (mongo::BSONArray*) dataP, titleP, detailsP);
-  }
+
+  bsonObjToKjTree(rootP, (const mongo::BSONObj*) dataP, isArray, titleP, detailsP);
 
   return rootP;
 }
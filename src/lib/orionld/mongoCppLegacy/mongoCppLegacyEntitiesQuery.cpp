@@ -25,6 +25,7 @@
 
 extern "C"
 {
+#include "kalloc/kaStrdup.h"                                     // kaStrdup
 #include "kjson/KjNode.h"                                        // KjNode
 #include "kjson/kjBuilder.h"                                     // kjArray, kjChildAdd
 }
@@ -37,8 +38,9 @@ extern "C"
 #include "orionld/common/QNode.h"                                // QNode
 #include "orionld/common/orionldState.h"                         // orionldState
 #include "orionld/common/qTreeToBsonObj.h"                       // qTreeToBsonObj
-#include "orionld/common/orionldErrorResponse.h"                 // orionldErrorResponseCreate
+#include "orionld/common/orionldErrorResponse.h"                 // OrionldBadRequestData, OrionldInternalError
 #include "orionld/common/SCOMPARE.h"                             // SCOMPARE
+#include "orionld/types/OrionldProblemDetails.h"                 // OrionldProblemDetails, orionldProblemDetailsFill
 #include "orionld/db/dbConfiguration.h"                          // dbDataToKjTree
 #include "orionld/mongoCppLegacy/mongoCppLegacyKjTreeToBsonObj.h"  // mongoCppLegacyKjTreeToBsonObj
 #include "orionld/mongoCppLegacy/mongoCppLegacyEntitiesQuery.h"  // Own interface
@@ -49,11 +51,14 @@ extern "C"
 //
 // entityInfoArrayFilter -
 //
+// mongo shell: { "$or": [ { "_id.id": "E1", "_id.type": "T" }, { "_id.id": { "$regex": "^urn:" } } ] }
+//
+// An item of the array that has neither id, nor (a non-wildcard) idPattern, nor type matches all entities,
+// and in such case the filter is left out entirely.
+//
 static void entityInfoArrayFilter(mongo::BSONObjBuilder* queryBuilderP, KjNode* entityInfoArrayP)
 {
-  mongo::BSONObjBuilder    orFilter;
   mongo::BSONArrayBuilder  eArray;
-  bool                     touched = false;
 
   for (KjNode* entityP = entityInfoArrayP->value.firstChildP; entityP != NULL; entityP = entityP->next)
   {
@@ -71,37 +76,33 @@ static void entityInfoArrayFilter(mongo::BSONObjBuilder* queryBuilderP, KjNode*
         typeP = nodeP;
     }
 
-    mongo::BSONObjBuilder eFilter;
     mongo::BSONObjBuilder ePart;
+    bool                  touched = false;
 
     if (idP != NULL)
     {
       ePart.append("_id.id", idP->value.s);
       touched = true;
     }
-    if (typeP != NULL)
+    else if ((idPatternP != NULL) && (strcmp(idPatternP->value.s, ".*") != 0))
     {
-      ePart.append("_id.type", typeP->value.s);
+      ePart.appendRegex("_id.id", idPatternP->value.s);
       touched = true;
     }
-    if ((idPatternP != NULL) && (strcmp(idPatternP->value.s, ".*") != 0))
+
+    if (typeP != NULL)
     {
-      // Add REGEX to ePart
+      ePart.append("_id.type", typeP->value.s);
       touched = true;
     }
 
-    if (touched == true)
-    {
-      eFilter.appendElements(ePart.obj());
-      eArray.append(eFilter.obj());
-    }
-  }
+    if (touched == false)  // This item matches all entities - no filter needed
+      return;
 
-  if (touched == true)
-  {
-    orFilter.append("$or", eArray.arr());
-    queryBuilderP->appendElements(orFilter.obj());
+    eArray.append(ePart.obj());
   }
+
+  queryBuilderP->append("$or", eArray.arr());
 }
 
 
@@ -465,7 +466,7 @@ static void geoqFilter(mongo::BSONObjBuilder* queryBuilderP, KjNode* geoqP)
 
   char* georel      = georelP->value.s;
   char* geometry    = geometryP->value.s;
-  char* geoproperty = geopropertyP->value.s;
+  char* geoproperty = (geopropertyP != NULL)? geopropertyP->value.s : (char*) "location";
 
   if (SCOMPARE5(georel, 'n', 'e', 'a', 'r', ';'))
     geoqNearFilter(queryBuilderP, geometry, &georel[5], coordinatesP, geoproperty);
@@ -483,11 +484,67 @@ static void geoqFilter(mongo::BSONObjBuilder* queryBuilderP, KjNode* geoqP)
 
 
 
+// -----------------------------------------------------------------------------
+//
+// projectionFields -
+//
+// Only the attributes in 'projectionV' (names as in the database - dots replaced by '=') are extracted
+// from the database. The entity id/type and the timestamps are always included.
+//
+static void projectionFields(mongo::BSONObjBuilder* fieldsBuilderP, char** projectionV)
+{
+  char  path[512];
+
+  fieldsBuilderP->append("_id",     1);
+  fieldsBuilderP->append("creDate", 1);
+  fieldsBuilderP->append("modDate", 1);
+
+  for (int ix = 0; projectionV[ix] != NULL; ix++)
+  {
+    snprintf(path, sizeof(path), "attrs.%s", projectionV[ix]);
+    fieldsBuilderP->append(path, 1);
+
+    snprintf(path, sizeof(path), "@datasets.%s", projectionV[ix]);
+    fieldsBuilderP->append(path, 1);
+  }
+}
+
+
+
 // -----------------------------------------------------------------------------
 //
 // mongoCppLegacyEntitiesQuery -
 //
-KjNode* mongoCppLegacyEntitiesQuery(KjNode* entityInfoArrayP, KjNode* attrsP, QNode* qP, KjNode* geoqP, int limit, int offset, int* countP)
+// PARAMETERS
+//   pdP               output: the error, if NULL is returned
+//   entityInfoArrayP  array of { id | idPattern, type } - all expanded
+//   attrsP            array of expanded attribute names - entities with none of these attributes are not matched
+//   qP                q-filter
+//   geoqP             geo-query: { geometry, coordinates, georel, geoproperty }
+//   limit             max number of entities to return (0: just count)
+//   offset            number of matching entities to skip
+//   countP            output: number of matching entities (NULL if not asked for)
+//   projectionV       attributes to extract (database names), terminated by a NULL pointer. NULL: all attributes
+//
+// The entities are returned as extracted from the database (use dbModelToApiEntity to get the API representation).
+// No hits is an empty array - NULL is only returned on error, and then 'pdP' is filled in (and orionldState.httpStatusCode set).
+//
+// There is no filter on the service path (_id.servicePath). NGSI-LD has no service paths and the NGSIv2 query
+// this function replaced for GET /entities always used "/#" (set by orionldMhdConnectionInit for all GET requests),
+// which matches every entity, so the filter would only cost a regex per document.
+//
+KjNode* mongoCppLegacyEntitiesQuery
+(
+  OrionldProblemDetails*  pdP,
+  KjNode*                 entityInfoArrayP,
+  KjNode*                 attrsP,
+  QNode*                  qP,
+  KjNode*                 geoqP,
+  int                     limit,
+  int                     offset,
+  int*                    countP,
+  char**                  projectionV
+)
 {
   mongo::BSONObjBuilder  queryBuilder;
   char*                  title;
@@ -501,49 +558,44 @@ KjNode* mongoCppLegacyEntitiesQuery(KjNode* entityInfoArrayP, KjNode* attrsP, QN
 
   if ((qP != NULL) && (qFilter(&queryBuilder, qP, &title, &detail) == false))
   {
-    orionldErrorResponseCreate(OrionldBadRequestData, title, detail);
+    orionldProblemDetailsFill(pdP, OrionldBadRequestData, title, detail, 400);
     return NULL;
   }
 
   if (geoqP != NULL)
     geoqFilter(&queryBuilder, geoqP);
 
-  KjNode* arrayP = kjArray(orionldState.kjsonP, NULL);
-
-  // semTake()
+  KjNode*                               arrayP      = kjArray(orionldState.kjsonP, NULL);
   mongo::DBClientBase*                  connectionP = getMongoConnection();
   std::auto_ptr<mongo::DBClientCursor>  cursorP;
   mongo::Query                          query(queryBuilder.obj());
 
   //
-  // Count asked for ?
+  // Any exception, be it from the count, the query itself or while iterating over the cursor, is an error.
+  // A partial result is never returned
   //
-  if (countP != NULL)
+  try
   {
-    try
-    {
+    if (countP != NULL)
       *countP = connectionP->count(orionldState.tenantP->entities, query);
-    }
-    catch (const std::exception &e)
+
+    if (limit != 0)
     {
-      LM_E(("Database Error (asking for the number of hits: %s)", e.what()));
-      arrayP = NULL;
-      limit = 0;  // Just to avoid performing the query
-    }
-  }
+      // Sort according to creDate
+      query.sort("creDate", 1);
 
-  //
-  // Performing the Query in the database
-  //
-  if (limit != 0)
-  {
-    // Sort according to creDate
-    query.sort("creDate", 1);
+      if (projectionV != NULL)
+      {
+        mongo::BSONObjBuilder  fieldsBuilder;
+        mongo::BSONObj         fieldsObj;
 
-    cursorP = connectionP->query(orionldState.tenantP->entities, query, limit, offset);
+        projectionFields(&fieldsBuilder, projectionV);
+        fieldsObj = fieldsBuilder.obj();
+        cursorP   = connectionP->query(orionldState.tenantP->entities, query, limit, offset, &fieldsObj);
+      }
+      else
+        cursorP = connectionP->query(orionldState.tenantP->entities, query, limit, offset);
 
-    try
-    {
       while (cursorP->more())
       {
         mongo::BSONObj  bsonObj = cursorP->nextSafe();
@@ -554,19 +606,21 @@ KjNode* mongoCppLegacyEntitiesQuery(KjNode* entityInfoArrayP, KjNode* attrsP, QN
         entityP = dbDataToKjTree(&bsonObj, false, &title, &details);
         if (entityP == NULL)
           LM_E(("dbDataToKjTree: %s: %s", title, details));
-
-        kjChildAdd(arrayP, entityP);
+        else
+          kjChildAdd(arrayP, entityP);
       }
     }
-    catch (const std::exception &e)
-    {
-      LM_E(("Database Error (%s)", e.what()));
-    }
   }
+  catch (const std::exception &e)
+  {
+    releaseMongoConnection(connectionP);
 
-  releaseMongoConnection(connectionP);
+    LM_E(("Database Error (querying entities: %s)", e.what()));
+    orionldProblemDetailsFill(pdP, OrionldInternalError, "Database Error", kaStrdup(&orionldState.kalloc, e.what()), 500);
+    return NULL;
+  }
 
-  // semGive()
+  releaseMongoConnection(connectionP);
 
   return arrayP;
 }
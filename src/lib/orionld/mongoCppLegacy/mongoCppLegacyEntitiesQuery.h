@@ -32,6 +32,7 @@ extern "C"
 }
 
 #include "orionld/common/QNode.h"                                // QNode
+#include "orionld/types/OrionldProblemDetails.h"                 // OrionldProblemDetails
 
 
 
@@ -39,6 +40,17 @@ extern "C"
 //
 // mongoCppLegacyEntitiesQuery -
 //
-extern KjNode* mongoCppLegacyEntitiesQuery(KjNode* entityInfoArrayP, KjNode* attrsP, QNode* qP, KjNode* geoqP, int limit, int offset, int* countP);
+extern KjNode* mongoCppLegacyEntitiesQuery
+(
+  OrionldProblemDetails*  pdP,
+  KjNode*                 entityInfoArrayP,
+  KjNode*                 attrsP,
+  QNode*                  qP,
+  KjNode*                 geoqP,
+  int                     limit,
+  int                     offset,
+  int*                    countP,
+  char**                  projectionV
+);
 
 #endif  // SRC_LIB_ORIONLD_MONGOCPPLEGACY_MONGOCPPLEGACYENTITIESQUERY_H_
@@ -33,6 +33,7 @@ extern "C"
 #include "logMsg/traceLevels.h"                                  // Lmt*
 
 #include "mongoBackend/MongoGlobal.h"                            // getMongoConnection, releaseMongoConnection, ...
+#include "mongoBackend/mongoEntityTypeCatalog.h"                 // mongoEntityTypeCatalogActive, mongoEntityTypeCatalogTypeGet
 
 #include "orionld/common/orionldState.h"                         // orionldState
 #include "orionld/common/eqForDot.h"                             // eqForDot
@@ -149,6 +150,18 @@ static bool kjAttributesWithTypeExtract(KjNode* kjTree, KjNode* entityP)
 //
 KjNode* mongoCppLegacyEntityTypeGet(OrionldProblemDetails* pdP, const char* typeLongName, int* noOfEntitiesP)
 {
+  //
+  // With the entity type catalog active, there's no need to query the entities of the type
+  // If the catalog fails (database error), the entities are queried
+  //
+  if (mongoEntityTypeCatalogActive() == true)
+  {
+    KjNode* outArray = mongoEntityTypeCatalogTypeGet(orionldState.tenantP, typeLongName, noOfEntitiesP);
+
+    if (outArray != NULL)
+      return outArray;
+  }
+
   //
   // Populate 'queryBuilder' - only Entity ID for this operation
   //
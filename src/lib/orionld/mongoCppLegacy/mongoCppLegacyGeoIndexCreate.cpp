@@ -22,18 +22,13 @@
 *
 * Author: Ken Zangelin
 */
+#include <stdlib.h>                                               // malloc, free
+#include <string.h>                                               // strdup
 #include <string>                                                 // std::string
 
-extern "C"
-{
-#include "kalloc/kaAlloc.h"                                       // kaAlloc
-#include "kalloc/kaStrdup.h"                                      // kaStrdup
-}
-
 #include "logMsg/logMsg.h"                                        // LM_*
 #include "logMsg/traceLevels.h"                                   // Lmt*
 
-#include "orionld/common/orionldState.h"                          // kalloc
 #include "mongoBackend/connectionOperations.h"                    // collectionCreateIndex
 #include "orionld/db/dbGeoIndexAdd.h"                             // dbGeoIndexAdd
 #include "orionld/common/dotForEq.h"                              // dotForEq
@@ -45,23 +40,34 @@ extern "C"
 //
 // mongoCppLegacyGeoIndexCreate -
 //
+// Called by the geo-index builder thread - the global kalloc buffer must not be used here.
+//
 bool mongoCppLegacyGeoIndexCreate(OrionldTenant* tenantP, const char* attrLongName)
 {
   int         len          = 6 + strlen(attrLongName) + 6 + 1;              // "attrs." == 6, ".value" == 6, 1 for string-termination
-  char*       index        = kaAlloc(&kalloc, len);
-  char*       attrNameCopy = kaStrdup(&kalloc, attrLongName);  // To not destroy the original attrName
+  char*       index        = (char*) malloc(len);
+  char*       attrNameCopy = strdup(attrLongName);  // To not destroy the original attrName
   std::string err;
 
+  if ((index == NULL) || (attrNameCopy == NULL))
+  {
+    free(index);
+    free(attrNameCopy);
+    LM_RE(false, ("Out of memory (creating a 2dsphere index for attribute '%s')", attrLongName));
+  }
+
   dotForEq(attrNameCopy);
   snprintf(index, len, "attrs.%s.value", attrNameCopy);
 
-  if (collectionCreateIndex(tenantP->entities, BSON(index << "2dsphere"), false, &err) == false)
-  {
+  bool ok = collectionCreateIndex(tenantP->entities, BSON(index << "2dsphere"), false, &err);
+
+  if (ok == false)
     LM_E(("Database Error (error creating 2dsphere index for attribute '%s' for db '%s')", attrNameCopy, tenantP->mongoDbName));
-    return false;
-  }
+  else
+    dbGeoIndexAdd(tenantP->tenant, attrNameCopy);
 
-  dbGeoIndexAdd(tenantP->tenant, attrNameCopy);
+  free(index);
+  free(attrNameCopy);
 
-  return true;
+  return ok;
 }
@@ -22,22 +22,17 @@
 *
 * Author: Ken Zangelin
 */
-#include <string>                                                    // std::string
-
 #include "mongo/client/dbclient.h"                                   // mongo::BSONObj
 
 extern "C"
 {
-#include "kalloc/kaStrdup.h"                                         // kaStrdup
 #include "kjson/KjNode.h"                                            // KjNode
-#include "kjson/kjParse.h"                                           // kjParse
-#include "kjson/kjBuilder.h"                                         // kjBuilder
 }
 
 #include "logMsg/logMsg.h"                                           // LM_*
 #include "logMsg/traceLevels.h"                                      // Lmt*
 
-#include "orionld/common/orionldState.h"                             // orionldState, orionldStateDelayedFreeEnqueue
+#include "orionld/mongoCppLegacy/mongoCppLegacyDataToKjTree.h"       // mongoCppLegacyDataToKjTree
 #include "orionld/mongoCppLegacy/mongoCppLegacyKjTreeFromBsonObj.h"  // Own interface
 
 
@@ -46,31 +41,10 @@ extern "C"
 //
 // mongoCppLegacyKjTreeFromBsonObj -
 //
+// This function used to render the BSONObj as JSON (jsonString()) and then parse the JSON string (kjParse).
+// It now walks the BSONObj directly (see mongoCppLegacyDataToKjTree) - a single pass and no intermediate copies.
+//
 KjNode* mongoCppLegacyKjTreeFromBsonObj(const void* dataP, char** titleP, char** detailsP)
 {
-  mongo::BSONObj* bsonObjP = (mongo::BSONObj*) dataP;
-  KjNode*         treeP    = NULL;
-
-  std::string jsonString = bsonObjP->jsonString();
-
-  if (jsonString == "")
-  {
-    *titleP   = (char*) "Internal Error";
-    *detailsP = (char*) "Error creating JSON from BSONObj";
-  }
-  else
-  {
-    orionldState.jsonBuf = strdup(jsonString.c_str());
-    if (orionldPhase != OrionldPhaseStartup)
-      orionldStateDelayedFreeEnqueue(orionldState.jsonBuf);  // automatic free if not in startup phase
-
-    treeP = kjParse(orionldState.kjsonP, orionldState.jsonBuf);
-    if (treeP == NULL)
-    {
-      *titleP   = (char*) "Internal Error";
-      *detailsP = (char*) "Error parsing JSON output from bson_as_json";
-    }
-  }
-
-  return treeP;
+  return mongoCppLegacyDataToKjTree(dataP, false, titleP, detailsP);
 }
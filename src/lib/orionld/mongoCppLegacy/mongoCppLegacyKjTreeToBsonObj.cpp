@@ -22,6 +22,8 @@
 *
 * Author: Ken Zangelin
 */
+#include <limits.h>                                                // INT_MIN, INT_MAX
+
 #include "mongo/client/dbclient.h"                                 // MongoDB C++ Client Legacy Driver
 
 extern "C"
@@ -73,7 +75,13 @@ static void kjTreeToBsonObject(KjNode* nodeP, mongo::BSONObjBuilder* objBuilderP
   else if (nodeP->type == KjFloat)
     objBuilderP->append(nodeP->name, nodeP->value.f);
   else if (nodeP->type == KjInt)
-    objBuilderP->append(nodeP->name, (int) nodeP->value.i);  // long long => int to avoid "NumberLong(i)" in mongo ...
+  {
+    // long long => int to avoid "NumberLong(i)" in mongo ... unless it doesn't fit
+    if ((nodeP->value.i >= INT_MIN) && (nodeP->value.i <= INT_MAX))
+      objBuilderP->append(nodeP->name, (int) nodeP->value.i);
+    else
+      objBuilderP->append(nodeP->name, nodeP->value.i);
+  }
   else if (nodeP->type == KjBoolean)
     objBuilderP->appendBool(nodeP->name, nodeP->value.b);
 }
@@ -109,7 +117,13 @@ static void kjTreeToBsonArray(KjNode* nodeP, mongo::BSONArrayBuilder* arrayBuild
   else if (nodeP->type == KjFloat)
     arrayBuilderP->append(nodeP->value.f);
   else if (nodeP->type == KjInt)
-    arrayBuilderP->append((int) nodeP->value.i);  // long long => int to avoid "NumberLong(i)" in mongo ...
+  {
+    // long long => int to avoid "NumberLong(i)" in mongo ... unless it doesn't fit
+    if ((nodeP->value.i >= INT_MIN) && (nodeP->value.i <= INT_MAX))
+      arrayBuilderP->append((int) nodeP->value.i);
+    else
+      arrayBuilderP->append(nodeP->value.i);
+  }
   else if (nodeP->type == KjBoolean)
     arrayBuilderP->appendBool(nodeP->value.b);
 }
@@ -29,6 +29,7 @@
 
 #include "orionld/common/orionldState.h"                         // orionldState
 #include "mongoBackend/MongoGlobal.h"                            // getMongoConnection, releaseMongoConnection, ...
+#include "mongoBackend/mongoRegistrationCache.h"                 // mongoRegistrationCacheRemove
 #include "orionld/mongoCppLegacy/mongoCppLegacyRegistrationDelete.h"  // Own interface
 
 
@@ -58,5 +59,8 @@ bool mongoCppLegacyRegistrationDelete(const char* registrationId)
 
   // semGive()
 
+  if (operationOk == true)
+    mongoRegistrationCacheRemove(orionldState.tenantP, registrationId);
+
   return operationOk;
 }
@@ -36,6 +36,7 @@ extern "C"
 #include "orionld/common/orionldState.h"                         // orionldState
 
 #include "mongoBackend/MongoGlobal.h"                            // getMongoConnection, releaseMongoConnection, ...
+#include "mongoBackend/mongoRegistrationCache.h"                 // mongoRegistrationCacheActive, mongoRegistrationCacheLookup
 #include "orionld/db/dbConfiguration.h"                          // dbDataToKjTree
 
 
@@ -60,8 +61,13 @@ extern "C"
 // ToDo
 //   o Include idPattern in the query
 //
+// With the registration cache on (-regCacheIval), the registrations are found in the cache instead.
+//
 KjNode* mongoCppLegacyRegistrationLookup(const char* entityId, const char* attribute, int* noOfRegsP)
 {
+  if (mongoRegistrationCacheActive())
+    return mongoRegistrationCacheLookup(orionldState.tenantP, entityId, attribute, noOfRegsP);
+
   KjNode* kjRegArray = NULL;
 
   if (noOfRegsP != NULL)
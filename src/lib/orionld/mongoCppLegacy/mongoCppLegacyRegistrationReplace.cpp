@@ -36,6 +36,7 @@ extern "C"
 #include "orionld/common/orionldState.h"                         // orionldState
 
 #include "mongoBackend/MongoGlobal.h"                            // getMongoConnection, releaseMongoConnection, ...
+#include "mongoBackend/mongoRegistrationCache.h"                 // mongoRegistrationCacheInsert
 #include "orionld/db/dbConfiguration.h"                          // dbDataToKjTree, dbDataFromKjTree
 #include "orionld/mongoCppLegacy/mongoCppLegacyRegistrationReplace.h"   // Own interface
 
@@ -75,5 +76,8 @@ bool mongoCppLegacyRegistrationReplace(const char* registrationId, KjNode* dbReg
   releaseMongoConnection(connectionP);
   // semGive()
 
+  if (ok == true)
+    mongoRegistrationCacheInsert(orionldState.tenantP, registrationId, payloadAsBsonObj);
+
   return ok;
 }
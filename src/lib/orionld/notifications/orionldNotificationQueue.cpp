@@ -0,0 +1,434 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string.h>                                              // strlen, strcmp, memcpy
+#include <stdlib.h>                                              // malloc, calloc, free
+#include <time.h>                                                // clock_gettime
+#include <errno.h>                                               // errno
+#include <pthread.h>                                             // pthread_*
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/notifications/orionldNotificationSend.h"           // orionldNotificationSend
+#include "orionld/notifications/orionldNotificationResponseAwait.h"  // orionldNotificationResponseAwait, ORIONLD_NOTIFICATION_TIMEOUT
+#include "orionld/notifications/orionldNotificationQueue.h"          // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// QueuedNotification - a notification waiting for a sender thread
+//
+// Allocated in one single chunk - the strings and the HTTP request follow the struct.
+//
+typedef struct QueuedNotification
+{
+  char*                       subscriptionId;
+  char*                       host;
+  uint16_t                    port;
+  char*                       request;
+  int                         requestLen;
+  struct timespec             queuedAt;
+  struct QueuedNotification*  next;
+} QueuedNotification;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// SenderQueue - the sub-queue of one sender thread
+//
+typedef struct SenderQueue
+{
+  pthread_mutex_t       mutex;
+  pthread_cond_t        notEmpty;
+  QueuedNotification*   first;
+  QueuedNotification*   last;
+  int                   size;
+  pthread_t             tid;
+  bool                  started;
+} SenderQueue;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Queue state
+//
+static SenderQueue*   senderQueueV     = NULL;
+static int            senderQueues     = 0;
+static int            senderQueueMax   = 0;     // Capacity of each sub-queue
+static bool           dropOldest       = false;
+static volatile bool  sendersStop      = false;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Statistics
+//
+static volatile long long  statIn          = 0;
+static volatile long long  statOut         = 0;
+static volatile long long  statRejected    = 0;
+static volatile long long  statEvicted     = 0;
+static volatile long long  statSentOk      = 0;
+static volatile long long  statSentError   = 0;
+static volatile long long  statTimeInQueue = 0;     // In microseconds
+static volatile int        statSize        = 0;
+static volatile int        statHighWater   = 0;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// subscriptionHash - FNV-1a hash of the subscription id, to pick a sub-queue
+//
+static unsigned int subscriptionHash(const char* subscriptionId)
+{
+  unsigned int hash = 2166136261u;
+
+  while (*subscriptionId != 0)
+  {
+    hash ^= (unsigned char) *subscriptionId;
+    hash *= 16777619u;
+    ++subscriptionId;
+  }
+
+  return hash;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// sizeIncrement - one more notification in the queue - also updates the high-water mark
+//
+static void sizeIncrement(void)
+{
+  int size      = __sync_add_and_fetch(&statSize, 1);
+  int highWater = statHighWater;
+
+  while ((size > highWater) && (__sync_bool_compare_and_swap(&statHighWater, highWater, size) == false))
+    highWater = statHighWater;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// senderThread - pop notifications from a sub-queue and send them, one by one
+//
+static void* senderThread(void* vP)
+{
+  SenderQueue* qP = (SenderQueue*) vP;
+
+  while (1)
+  {
+    QueuedNotification* nP;
+
+    pthread_mutex_lock(&qP->mutex);
+
+    while ((qP->first == NULL) && (sendersStop == false))
+      pthread_cond_wait(&qP->notEmpty, &qP->mutex);
+
+    if (sendersStop == true)
+    {
+      pthread_mutex_unlock(&qP->mutex);
+      break;
+    }
+
+    nP        = qP->first;
+    qP->first = nP->next;
+    if (qP->first == NULL)
+      qP->last = NULL;
+    --qP->size;
+
+    pthread_mutex_unlock(&qP->mutex);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long long usInQueue = (now.tv_sec - nP->queuedAt.tv_sec) * 1000000LL + (now.tv_nsec - nP->queuedAt.tv_nsec) / 1000;
+
+    __sync_sub_and_fetch(&statSize, 1);
+    __sync_fetch_and_add(&statOut, 1);
+    __sync_fetch_and_add(&statTimeInQueue, usInQueue);
+
+    struct iovec  ioVec = { nP->request, (size_t) nP->requestLen };
+    int           fd    = orionldNotificationSend(nP->host, nP->port, &ioVec, 1);
+    bool          ok    = false;
+
+    if (fd == -1)
+      LM_E(("Internal Error (unable to send notification for subscription '%s' to %s:%d)", nP->subscriptionId, nP->host, nP->port));
+    else
+      ok = orionldNotificationResponseAwait(nP->subscriptionId, nP->host, nP->port, fd, ORIONLD_NOTIFICATION_TIMEOUT);
+
+    if (ok == true)
+      __sync_fetch_and_add(&statSentOk, 1);
+    else
+      __sync_fetch_and_add(&statSentError, 1);
+
+    free(nP);
+  }
+
+  return NULL;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationQueueInit -
+//
+bool orionldNotificationQueueInit(int senders, int queueSize, const char* dropPolicy)
+{
+  if (strcmp(dropPolicy, "oldest") == 0)
+    dropOldest = true;
+  else if (strcmp(dropPolicy, "incoming") == 0)
+    dropOldest = false;
+  else
+  {
+    LM_E(("Invalid notification queue drop policy: '%s' (valid policies: 'incoming' and 'oldest')", dropPolicy));
+    return false;
+  }
+
+  if (senders <= 0)
+    return true;
+
+  senderQueueV = (SenderQueue*) calloc(senders, sizeof(SenderQueue));
+  if (senderQueueV == NULL)
+  {
+    LM_E(("Out of memory allocating %d notification sender queues", senders));
+    return false;
+  }
+
+  senderQueues   = senders;
+  senderQueueMax = (queueSize + senders - 1) / senders;  // Rounding up, so the total capacity is at least 'queueSize'
+  sendersStop    = false;
+
+  for (int ix = 0; ix < senders; ix++)
+  {
+    SenderQueue* qP = &senderQueueV[ix];
+
+    pthread_mutex_init(&qP->mutex, NULL);
+    pthread_cond_init(&qP->notEmpty, NULL);
+
+    if (pthread_create(&qP->tid, NULL, senderThread, qP) != 0)
+    {
+      LM_E(("Internal Error (pthread_create: %s)", strerror(errno)));
+      return false;
+    }
+
+    qP->started = true;
+  }
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationEnqueue -
+//
+bool orionldNotificationEnqueue(const char* subscriptionId, const char* host, uint16_t port, struct iovec* ioVec, int ioVecLen)
+{
+  int subscriptionIdLen = strlen(subscriptionId);
+  int hostLen           = strlen(host);
+  int requestLen        = 0;
+
+  for (int ix = 0; ix < ioVecLen; ix++)
+    requestLen += ioVec[ix].iov_len;
+
+  QueuedNotification* nP = (QueuedNotification*) malloc(sizeof(QueuedNotification) + subscriptionIdLen + 1 + hostLen + 1 + requestLen);
+
+  if (nP == NULL)
+  {
+    LM_E(("Out of memory queueing a notification for subscription '%s'", subscriptionId));
+    __sync_fetch_and_add(&statRejected, 1);
+    return false;
+  }
+
+  nP->subscriptionId = (char*) &nP[1];
+  nP->host           = &nP->subscriptionId[subscriptionIdLen + 1];
+  nP->request        = &nP->host[hostLen + 1];
+  nP->port           = port;
+  nP->requestLen     = requestLen;
+  nP->next           = NULL;
+
+  memcpy(nP->subscriptionId, subscriptionId, subscriptionIdLen + 1);
+  memcpy(nP->host, host, hostLen + 1);
+
+  char* requestP = nP->request;
+  for (int ix = 0; ix < ioVecLen; ix++)
+  {
+    memcpy(requestP, ioVec[ix].iov_base, ioVec[ix].iov_len);
+    requestP += ioVec[ix].iov_len;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &nP->queuedAt);
+
+  //
+  // Same subscription, same sub-queue - that keeps the notifications of a subscription in order
+  //
+  SenderQueue*         qP      = &senderQueueV[subscriptionHash(subscriptionId) % senderQueues];
+  QueuedNotification*  evicted = NULL;
+
+  pthread_mutex_lock(&qP->mutex);
+
+  if (qP->size >= senderQueueMax)
+  {
+    if (dropOldest == false)
+    {
+      pthread_mutex_unlock(&qP->mutex);
+
+      __sync_fetch_and_add(&statRejected, 1);
+      LM_E(("Runtime Error (notification queue is full - dropping notification for subscription '%s')", subscriptionId));
+      free(nP);
+
+      return false;
+    }
+
+    evicted   = qP->first;
+    qP->first = evicted->next;
+    if (qP->first == NULL)
+      qP->last = NULL;
+    --qP->size;
+  }
+
+  if (qP->last == NULL)
+    qP->first = nP;
+  else
+    qP->last->next = nP;
+  qP->last = nP;
+  ++qP->size;
+
+  pthread_cond_signal(&qP->notEmpty);
+  pthread_mutex_unlock(&qP->mutex);
+
+  __sync_fetch_and_add(&statIn, 1);
+
+  if (evicted != NULL)
+  {
+    __sync_fetch_and_add(&statEvicted, 1);
+    LM_E(("Runtime Error (notification queue is full - dropping the oldest notification, of subscription '%s')", evicted->subscriptionId));
+    free(evicted);
+  }
+  else
+    sizeIncrement();
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationQueueRelease -
+//
+// Sender threads finish the notification they are sending (if any) and exit.
+// Notifications still in the queue are dropped.
+//
+void orionldNotificationQueueRelease(void)
+{
+  if (senderQueueV == NULL)
+    return;
+
+  sendersStop = true;
+
+  for (int ix = 0; ix < senderQueues; ix++)
+  {
+    SenderQueue* qP = &senderQueueV[ix];
+
+    pthread_mutex_lock(&qP->mutex);
+    pthread_cond_broadcast(&qP->notEmpty);
+    pthread_mutex_unlock(&qP->mutex);
+  }
+
+  for (int ix = 0; ix < senderQueues; ix++)
+  {
+    SenderQueue* qP = &senderQueueV[ix];
+
+    if (qP->started == true)
+      pthread_join(qP->tid, NULL);
+
+    QueuedNotification* nP = qP->first;
+    while (nP != NULL)
+    {
+      QueuedNotification* next = nP->next;
+
+      free(nP);
+      nP = next;
+    }
+
+    pthread_mutex_destroy(&qP->mutex);
+    pthread_cond_destroy(&qP->notEmpty);
+  }
+
+  free(senderQueueV);
+
+  senderQueueV = NULL;
+  senderQueues = 0;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationQueueStatisticsGet -
+//
+void orionldNotificationQueueStatisticsGet(OrionldNotificationQueueStatistics* statsP)
+{
+  statsP->in          = __sync_fetch_and_add(&statIn,          0);
+  statsP->out         = __sync_fetch_and_add(&statOut,         0);
+  statsP->rejected    = __sync_fetch_and_add(&statRejected,    0);
+  statsP->evicted     = __sync_fetch_and_add(&statEvicted,     0);
+  statsP->sentOk      = __sync_fetch_and_add(&statSentOk,      0);
+  statsP->sentError   = __sync_fetch_and_add(&statSentError,   0);
+  statsP->timeInQueue = __sync_fetch_and_add(&statTimeInQueue, 0) / 1000000.0;
+  statsP->size        = __sync_fetch_and_add(&statSize,        0);
+  statsP->highWater   = __sync_fetch_and_add(&statHighWater,   0);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationQueueStatisticsReset -
+//
+// The current size is state, not a counter - it is not reset. The high-water mark restarts from it.
+//
+void orionldNotificationQueueStatisticsReset(void)
+{
+  __sync_fetch_and_and(&statIn,          0);
+  __sync_fetch_and_and(&statOut,         0);
+  __sync_fetch_and_and(&statRejected,    0);
+  __sync_fetch_and_and(&statEvicted,     0);
+  __sync_fetch_and_and(&statSentOk,      0);
+  __sync_fetch_and_and(&statSentError,   0);
+  __sync_fetch_and_and(&statTimeInQueue, 0);
+
+  statHighWater = statSize;
+}
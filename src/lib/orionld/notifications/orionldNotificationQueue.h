@@ -0,0 +1,103 @@
+#ifndef SRC_LIB_ORIONLD_NOTIFICATIONS_ORIONLDNOTIFICATIONQUEUE_H_
+#define SRC_LIB_ORIONLD_NOTIFICATIONS_ORIONLDNOTIFICATIONQUEUE_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdint.h>                                              // uint16_t
+#include <sys/uio.h>                                             // struct iovec
+
+
+
+// -----------------------------------------------------------------------------
+//
+// OrionldNotificationQueueStatistics - back-pressure statistics of the NGSI-LD notification queue
+//
+typedef struct OrionldNotificationQueueStatistics
+{
+  long long  in;           // Notifications accepted into the queue
+  long long  out;          // Notifications taken out of the queue by a sender thread
+  long long  rejected;     // Incoming notifications dropped as the queue was full (drop policy 'incoming')
+  long long  evicted;      // Queued notifications dropped to make room for new ones (drop policy 'oldest')
+  long long  sentOk;       // Notifications that got a 2xx response
+  long long  sentError;    // Notifications that could not be sent or got an error response
+  double     timeInQueue;  // Accumulated time (in seconds) that the notifications have spent in the queue
+  int        size;         // Current number of notifications in the queue
+  int        highWater;    // Max number of notifications in the queue since the last reset
+} OrionldNotificationQueueStatistics;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationQueueInit - create the queue and start its sender threads
+//
+// The queue is split in one sub-queue per sender thread and a subscription always maps to the same
+// sub-queue, so notifications of a subscription are delivered in the order they were queued.
+// 'queueSize' is the total capacity, shared equally among the sub-queues.
+//
+// dropPolicy:
+//   "incoming":  when full, new notifications are dropped
+//   "oldest":    when full, the oldest queued notification is dropped to make room for the new one
+//
+// Returns false if the drop policy is invalid or the threads can't be created
+//
+extern bool orionldNotificationQueueInit(int senders, int queueSize, const char* dropPolicy);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationEnqueue - queue a notification for a sender thread
+//
+// The ioVec (the entire HTTP request) is copied, so it doesn't need to outlive the call.
+// Returns false if the notification was dropped.
+//
+extern bool orionldNotificationEnqueue(const char* subscriptionId, const char* host, uint16_t port, struct iovec* ioVec, int ioVecLen);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationQueueRelease - stop the sender threads and free the queued notifications
+//
+extern void orionldNotificationQueueRelease(void);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationQueueStatisticsGet -
+//
+extern void orionldNotificationQueueStatisticsGet(OrionldNotificationQueueStatistics* statsP);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationQueueStatisticsReset -
+//
+extern void orionldNotificationQueueStatisticsReset(void);
+
+#endif  // SRC_LIB_ORIONLD_NOTIFICATIONS_ORIONLDNOTIFICATIONQUEUE_H_
@@ -0,0 +1,59 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/common/orionldConnectionPool.h"                // orionldConnectionPut
+#include "orionld/common/orionldHttpResponseRead.h"              // orionldHttpResponseRead
+#include "orionld/notifications/orionldNotificationResponseAwait.h"  // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationResponseAwait -
+//
+bool orionldNotificationResponseAwait(const char* subscriptionId, const char* host, uint16_t port, int fd, int timeoutMs)
+{
+  OrionldHttpResponse  response;
+  char                 responseBuf[2048];
+
+  if ((timeoutMs <= 0) || (orionldHttpResponseRead(fd, responseBuf, sizeof(responseBuf), timeoutMs, &response) == false))
+  {
+    LM_E(("Internal Error (no valid response to notification for subscription '%s')", subscriptionId));
+    orionldConnectionPut(host, port, fd, false);
+    return false;
+  }
+
+  orionldConnectionPut(host, port, fd, response.keepAlive);
+
+  if ((response.httpStatus < 200) || (response.httpStatus >= 300))
+  {
+    LM_W(("Notification for subscription '%s' got a %d response", subscriptionId, response.httpStatus));
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,88 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string.h>                                              // bzero
+#include <unistd.h>                                              // close
+#include <sys/uio.h>                                             // struct iovec
+#include <sys/socket.h>                                          // sendmsg, MSG_NOSIGNAL
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "orionld/common/orionldConnectionPool.h"                // orionldConnectionGet
+#include "orionld/notifications/orionldNotificationSend.h"       // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// ioVecSend - like writev, but without SIGPIPE if the receiver has closed the connection
+//
+static bool ioVecSend(int fd, struct iovec* ioVec, int ioVecLen)
+{
+  struct msghdr msg;
+
+  bzero(&msg, sizeof(msg));
+  msg.msg_iov    = ioVec;
+  msg.msg_iovlen = ioVecLen;
+
+  return sendmsg(fd, &msg, MSG_NOSIGNAL) != -1;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldNotificationSend -
+//
+// A connection taken from the pool may have been closed by the receiver after it was checked.
+// If so, the write fails and the notification is sent again, once, over a brand new connection.
+//
+int orionldNotificationSend(const char* host, uint16_t port, struct iovec* ioVec, int ioVecLen)
+{
+  bool reused;
+  int  fd = orionldConnectionGet(host, port, &reused);
+
+  if (fd == -1)
+    return -1;
+
+  if (ioVecSend(fd, ioVec, ioVecLen) == true)
+    return fd;
+
+  close(fd);
+
+  if (reused == false)
+    return -1;
+
+  LM_T(LmtNotifier, ("Pooled connection to %s:%d was stale - reconnecting", host, port));
+
+  if ((fd = orionldConnectionGet(host, port, &reused)) == -1)
+    return -1;
+
+  if (ioVecSend(fd, ioVec, ioVecLen) == true)
+    return fd;
+
+  close(fd);
+  return -1;
+}
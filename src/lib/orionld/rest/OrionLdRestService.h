@@ -136,6 +136,7 @@ typedef struct OrionLdRestServiceSimplifiedVector
 #define ORIONLD_URIPARAM_DETAILS              (1 << 21)
 #define ORIONLD_URIPARAM_PRETTYPRINT          (1 << 22)
 #define ORIONLD_URIPARAM_SPACES               (1 << 23)
+#define ORIONLD_URIPARAM_LASTN                (1 << 24)
 
 
 
@@ -162,6 +163,7 @@ typedef struct OrionLdRestService
   int                    matchForSecondWildcardLen;     // strlen of last path to match
   uint32_t               options;                       // Peculiarities of this type of requests (bitmask)
   uint32_t               uriParams;                     // Supported URI parameters (bitmask)
+  int                    index;                         // Unique index among all services, all verbs (for latency metrics)
 } OrionLdRestService;
 
 
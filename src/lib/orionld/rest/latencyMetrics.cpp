@@ -0,0 +1,379 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdio.h>                                               // snprintf
+#include <stdlib.h>                                              // calloc, free
+#include <stdint.h>                                              // uint64_t
+#include <string.h>                                              // strlen
+#include <pthread.h>                                             // pthread_mutex_t
+#include <string>                                                // std::string
+
+#include "logMsg/logMsg.h"                                       // LM_*
+#include "logMsg/traceLevels.h"                                  // Lmt*
+
+#include "rest/Verb.h"                                           // Verb, verbName
+#include "orionld/common/orionldState.h"                         // Timestamps
+#include "orionld/rest/OrionLdRestService.h"                     // OrionLdRestService
+#include "orionld/rest/orionldServiceInit.h"                     // orionldRestServiceV
+#include "orionld/rest/latencyMetrics.h"                         // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// LatencyPhase - the phases of a request that are measured
+//
+// Each phase is delimited by a pair of the timestamps in 'Timestamps' (see orionldState.h).
+// A phase whose start or end timestamp hasn't been taken during the request is simply not
+// recorded, e.g. "notification" for a request that triggered no notifications.
+//
+typedef enum LatencyPhase
+{
+  LatencyTotal,
+  LatencyParse,
+  LatencyServiceRoutine,
+  LatencyDb,
+  LatencyExtraDb,
+  LatencyNotification,
+  LatencyNotificationDb,
+  LatencyForward,
+  LatencyForwardDb,
+  LatencyRender,
+  LatencyReply,
+  LatencyTroe,
+  LATENCY_PHASES
+} LatencyPhase;
+
+static const char* phaseName[LATENCY_PHASES] =
+{
+  "total",
+  "parse",
+  "serviceRoutine",
+  "db",
+  "extraDb",
+  "notification",
+  "notificationDb",
+  "forward",
+  "forwardDb",
+  "render",
+  "reply",
+  "troe"
+};
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Buckets - upper limits in microseconds, plus the implicit "+Inf" bucket
+//
+// Every histogram (service + phase) has LATENCY_SLOTS counters:
+//   - LATENCY_BUCKETS counters for the finite buckets (non-cumulative - made cumulative when rendered)
+//   - one counter for the +Inf bucket
+//   - one counter for the accumulated time (in microseconds)
+//
+#define LATENCY_BUCKETS  10
+#define LATENCY_INF_SLOT LATENCY_BUCKETS
+#define LATENCY_SUM_SLOT (LATENCY_BUCKETS + 1)
+#define LATENCY_SLOTS    (LATENCY_BUCKETS + 2)
+
+static const uint64_t bucketLimit[LATENCY_BUCKETS] =
+{
+  100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000
+};
+
+static const char* bucketLabel[LATENCY_BUCKETS + 1] =
+{
+  "0.0001", "0.0005", "0.001", "0.005", "0.01", "0.05", "0.1", "0.5", "1", "5", "+Inf"
+};
+
+
+
+// -----------------------------------------------------------------------------
+//
+// LatencyThreadBuckets - the counters of one thread
+//
+// Each thread has its own set of counters, and it's the only writer of those counters.
+// So, no locks and no atomic read-modify-write instructions are needed to record a request.
+// The counters are loaded and stored with relaxed atomics just to make sure a reader (the
+// thread rendering GET /admin/metrics/latency) never sees a torn value.
+//
+// The buckets of a thread are allocated the first time the thread records a request, and they're
+// linked into a global list (under 'listMutex'). They are never freed, as the counters of
+// a thread that has ended still need to be part of the totals.
+//
+typedef struct LatencyThreadBuckets
+{
+  uint64_t*                     counters;
+  struct LatencyThreadBuckets*  next;
+} LatencyThreadBuckets;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Module variables
+//
+static __thread LatencyThreadBuckets*  threadBuckets = NULL;
+static LatencyThreadBuckets*           bucketList    = NULL;
+static pthread_mutex_t                 listMutex     = PTHREAD_MUTEX_INITIALIZER;
+static int                             services      = 0;
+static char**                          serviceNameV  = NULL;
+static uint64_t*                       baseline      = NULL;  // Totals at the time of the last reset
+static int                             counters      = 0;     // services * LATENCY_PHASES * LATENCY_SLOTS
+
+
+
+// -----------------------------------------------------------------------------
+//
+// latencyMetricsInit -
+//
+bool latencyMetricsInit(void)
+{
+  for (int verb = 0; verb < 9; verb++)
+    services += orionldRestServiceV[verb].services;
+
+  counters     = services * LATENCY_PHASES * LATENCY_SLOTS;
+  serviceNameV = (char**)    calloc(services, sizeof(char*));
+  baseline     = (uint64_t*) calloc(counters, sizeof(uint64_t));
+
+  if ((serviceNameV == NULL) || (baseline == NULL))
+    LM_RE(false, ("Out of memory (allocating latency metrics for %d services)", services));
+
+  for (int verb = 0; verb < 9; verb++)
+  {
+    for (int sIx = 0; sIx < orionldRestServiceV[verb].services; sIx++)
+    {
+      OrionLdRestService* serviceP = &orionldRestServiceV[verb].serviceV[sIx];
+      const char*         vName    = verbName((Verb) verb);
+      int                 nameLen  = strlen(vName) + 1 + strlen(serviceP->url) + 1;
+
+      serviceNameV[serviceP->index] = (char*) malloc(nameLen);
+      if (serviceNameV[serviceP->index] == NULL)
+        LM_RE(false, ("Out of memory (allocating latency metrics service name)"));
+
+      snprintf(serviceNameV[serviceP->index], nameLen, "%s %s", vName, serviceP->url);
+    }
+  }
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// threadBucketsCreate -
+//
+static LatencyThreadBuckets* threadBucketsCreate(void)
+{
+  LatencyThreadBuckets* tbP = (LatencyThreadBuckets*) calloc(1, sizeof(LatencyThreadBuckets));
+
+  if (tbP == NULL)
+    return NULL;
+
+  tbP->counters = (uint64_t*) calloc(counters, sizeof(uint64_t));
+  if (tbP->counters == NULL)
+  {
+    free(tbP);
+    return NULL;
+  }
+
+  pthread_mutex_lock(&listMutex);
+  tbP->next  = bucketList;
+  bucketList = tbP;
+  pthread_mutex_unlock(&listMutex);
+
+  return tbP;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// counterAdd - single writer, so a load and a store is all that's needed
+//
+static inline void counterAdd(uint64_t* counterP, uint64_t value)
+{
+  __atomic_store_n(counterP, __atomic_load_n(counterP, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// phaseRecord -
+//
+static void phaseRecord(uint64_t* serviceCounters, LatencyPhase phase, struct timespec* startP, struct timespec* endP)
+{
+  if ((startP->tv_sec == 0) || (endP->tv_sec == 0))
+    return;
+
+  int64_t micros = (endP->tv_sec - startP->tv_sec) * 1000000 + (endP->tv_nsec - startP->tv_nsec) / 1000;
+
+  if (micros < 0)  // Timestamp from a previous request (not taken in this one)
+    return;
+
+  uint64_t* histogram = &serviceCounters[phase * LATENCY_SLOTS];
+  int       bucket    = 0;
+
+  while ((bucket < LATENCY_BUCKETS) && ((uint64_t) micros > bucketLimit[bucket]))
+    ++bucket;
+
+  counterAdd(&histogram[bucket], 1);
+  counterAdd(&histogram[LATENCY_SUM_SLOT], micros);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// latencyMetricsRecord -
+//
+void latencyMetricsRecord(OrionLdRestService* serviceP, Timestamps* tsP)
+{
+  if ((serviceP->index < 0) || (serviceP->index >= services))
+    return;
+
+  if (threadBuckets == NULL)
+  {
+    threadBuckets = threadBucketsCreate();
+    if (threadBuckets == NULL)
+      return;
+  }
+
+  uint64_t* serviceCounters = &threadBuckets->counters[serviceP->index * LATENCY_PHASES * LATENCY_SLOTS];
+
+  phaseRecord(serviceCounters, LatencyTotal,          &tsP->reqStart,            &tsP->reqEnd);
+  phaseRecord(serviceCounters, LatencyParse,          &tsP->parseStart,          &tsP->parseEnd);
+  phaseRecord(serviceCounters, LatencyServiceRoutine, &tsP->serviceRoutineStart, &tsP->serviceRoutineEnd);
+  phaseRecord(serviceCounters, LatencyDb,             &tsP->dbStart,             &tsP->dbEnd);
+  phaseRecord(serviceCounters, LatencyExtraDb,        &tsP->extraDbStart,        &tsP->extraDbEnd);
+  phaseRecord(serviceCounters, LatencyNotification,   &tsP->notifStart,          &tsP->notifEnd);
+  phaseRecord(serviceCounters, LatencyNotificationDb, &tsP->notifDbStart,        &tsP->notifDbEnd);
+  phaseRecord(serviceCounters, LatencyForward,        &tsP->forwardStart,        &tsP->forwardEnd);
+  phaseRecord(serviceCounters, LatencyForwardDb,      &tsP->forwardDbStart,      &tsP->forwardDbEnd);
+  phaseRecord(serviceCounters, LatencyRender,         &tsP->renderStart,         &tsP->renderEnd);
+  phaseRecord(serviceCounters, LatencyReply,          &tsP->restReplyStart,      &tsP->restReplyEnd);
+  phaseRecord(serviceCounters, LatencyTroe,           &tsP->troeStart,           &tsP->troeEnd);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// totalsGet - sum of the counters of all threads - listMutex must be taken
+//
+static void totalsGet(uint64_t* totals)
+{
+  for (LatencyThreadBuckets* tbP = bucketList; tbP != NULL; tbP = tbP->next)
+  {
+    for (int ix = 0; ix < counters; ix++)
+      totals[ix] += __atomic_load_n(&tbP->counters[ix], __ATOMIC_RELAXED);
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// latencyMetricsReset -
+//
+// The per-thread counters are only ever written by their owning thread, so, instead of zeroing them,
+// the current totals are saved as a baseline, that is subtracted when rendering.
+//
+void latencyMetricsReset(void)
+{
+  if (baseline == NULL)
+    return;
+
+  pthread_mutex_lock(&listMutex);
+  bzero(baseline, counters * sizeof(uint64_t));
+  totalsGet(baseline);
+  pthread_mutex_unlock(&listMutex);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// latencyMetricsRender -
+//
+void latencyMetricsRender(std::string* outP)
+{
+  if (baseline == NULL)
+    return;
+
+  uint64_t* totals = (uint64_t*) calloc(counters, sizeof(uint64_t));
+
+  if (totals == NULL)
+  {
+    LM_E(("Out of memory (rendering latency metrics)"));
+    return;
+  }
+
+  pthread_mutex_lock(&listMutex);
+  totalsGet(totals);
+  for (int ix = 0; ix < counters; ix++)
+    totals[ix] -= baseline[ix];
+  pthread_mutex_unlock(&listMutex);
+
+  char line[512];
+
+  *outP += "# HELP orionld_request_phase_seconds Latency of NGSI-LD requests, per service and phase\n";
+  *outP += "# TYPE orionld_request_phase_seconds histogram\n";
+
+  for (int sIx = 0; sIx < services; sIx++)
+  {
+    for (int phase = 0; phase < LATENCY_PHASES; phase++)
+    {
+      uint64_t* histogram = &totals[(sIx * LATENCY_PHASES + phase) * LATENCY_SLOTS];
+      uint64_t  count     = 0;
+
+      for (int bucket = 0; bucket <= LATENCY_INF_SLOT; bucket++)
+        count += histogram[bucket];
+
+      if (count == 0)
+        continue;
+
+      uint64_t cumulative = 0;
+      for (int bucket = 0; bucket <= LATENCY_INF_SLOT; bucket++)
+      {
+        cumulative += histogram[bucket];
+        snprintf(line, sizeof(line), "orionld_request_phase_seconds_bucket{service=\"%s\",phase=\"%s\",le=\"%s\"} %lu\n",
+                 serviceNameV[sIx], phaseName[phase], bucketLabel[bucket], (unsigned long) cumulative);
+        *outP += line;
+      }
+
+      snprintf(line, sizeof(line), "orionld_request_phase_seconds_sum{service=\"%s\",phase=\"%s\"} %.6f\n",
+               serviceNameV[sIx], phaseName[phase], (double) histogram[LATENCY_SUM_SLOT] / 1000000);
+      *outP += line;
+
+      snprintf(line, sizeof(line), "orionld_request_phase_seconds_count{service=\"%s\",phase=\"%s\"} %lu\n",
+               serviceNameV[sIx], phaseName[phase], (unsigned long) count);
+      *outP += line;
+    }
+  }
+
+  free(totals);
+}
@@ -0,0 +1,68 @@
+#ifndef SRC_LIB_ORIONLD_REST_LATENCYMETRICS_H_
+#define SRC_LIB_ORIONLD_REST_LATENCYMETRICS_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string>                                                // std::string
+
+#include "orionld/common/orionldState.h"                         // Timestamps
+#include "orionld/rest/OrionLdRestService.h"                     // OrionLdRestService
+
+
+
+// -----------------------------------------------------------------------------
+//
+// latencyMetricsInit - allocate the name vector and the baseline of the latency histograms
+//
+// Must be called after orionldServiceInit, as the service vectors are needed to know the
+// number of services and their names.
+//
+extern bool latencyMetricsInit(void);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// latencyMetricsRecord - add the phases of the current request to the histograms of the calling thread
+//
+extern void latencyMetricsRecord(OrionLdRestService* serviceP, Timestamps* tsP);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// latencyMetricsRender - render all histograms in Prometheus text exposition format
+//
+extern void latencyMetricsRender(std::string* outP);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// latencyMetricsReset - reset all histograms
+//
+extern void latencyMetricsReset(void);
+
+#endif  // SRC_LIB_ORIONLD_REST_LATENCYMETRICS_H_
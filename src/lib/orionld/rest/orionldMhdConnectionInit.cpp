@@ -396,6 +396,19 @@ static MHD_Result orionldUriArgumentGet(void* cbDataP, MHD_ValueKind kind, const
     orionldState.uriParams.endTimeAt = (char*) value;
     orionldState.uriParams.mask |= ORIONLD_URIPARAM_ENDTIMEAT;
   }
+  else if (SCOMPARE6(key, 'l', 'a', 's', 't', 'N', 0))
+  {
+    if (atoi(value) <= 0)
+    {
+      LM_W(("Bad Input (invalid value for /lastN/ URI param: %s)", value));
+      orionldErrorResponseCreate(OrionldBadRequestData, "Bad value for URI parameter /lastN/ (must be an integer value >= 1)", value);
+      orionldState.httpStatusCode = 400;
+      return MHD_YES;
+    }
+
+    orionldState.uriParams.lastN = atoi(value);
+    orionldState.uriParams.mask |= ORIONLD_URIPARAM_LASTN;
+  }
   else if (SCOMPARE8(key, 'd', 'e', 't', 'a', 'i', 'l', 's', 0))
   {
     if (strcmp(value, "true") == 0)
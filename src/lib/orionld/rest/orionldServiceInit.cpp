@@ -80,6 +80,8 @@ extern "C"
 #include "orionld/serviceRoutines/orionldGetEntityAttributes.h"      // orionldGetEntityAttributes
 #include "orionld/serviceRoutines/orionldGetEntityAttribute.h"       // orionldGetEntityAttribute
 #include "orionld/serviceRoutines/orionldPostTemporalEntities.h"     // orionldPostTemporalEntities
+#include "orionld/serviceRoutines/orionldGetTemporalEntities.h"      // orionldGetTemporalEntities
+#include "orionld/serviceRoutines/orionldGetTemporalEntity.h"        // orionldGetTemporalEntity
 #include "orionld/serviceRoutines/orionldGetContexts.h"              // orionldGetContexts
 #include "orionld/serviceRoutines/orionldGetContext.h"               // orionldGetContext
 #include "orionld/serviceRoutines/orionldPostContexts.h"             // orionldPostContexts
@@ -409,6 +411,27 @@ static void restServicePrepare(OrionLdRestService* serviceP, OrionLdRestServiceS
   {
     serviceP->options   |= ORIONLD_SERVICE_OPTION_NO_V2_URI_PARAMS;
   }
+  else if ((serviceP->serviceRoutine == orionldGetTemporalEntities) || (serviceP->serviceRoutine == orionldGetTemporalEntity))
+  {
+    if (serviceP->serviceRoutine == orionldGetTemporalEntities)
+    {
+      serviceP->uriParams |= ORIONLD_URIPARAM_IDLIST;
+      serviceP->uriParams |= ORIONLD_URIPARAM_TYPELIST;
+      serviceP->uriParams |= ORIONLD_URIPARAM_IDPATTERN;
+      serviceP->uriParams |= ORIONLD_URIPARAM_LIMIT;
+      serviceP->uriParams |= ORIONLD_URIPARAM_OFFSET;
+      serviceP->uriParams |= ORIONLD_URIPARAM_COUNT;
+    }
+
+    serviceP->uriParams |= ORIONLD_URIPARAM_ATTRS;
+    serviceP->uriParams |= ORIONLD_URIPARAM_TIMEPROPERTY;
+    serviceP->uriParams |= ORIONLD_URIPARAM_TIMEREL;
+    serviceP->uriParams |= ORIONLD_URIPARAM_TIMEAT;
+    serviceP->uriParams |= ORIONLD_URIPARAM_ENDTIMEAT;
+    serviceP->uriParams |= ORIONLD_URIPARAM_LASTN;
+
+    serviceP->options   |= ORIONLD_SERVICE_OPTION_NO_V2_URI_PARAMS;
+  }
   else if (serviceP->serviceRoutine == orionldPostTemporalEntities)
   {
     serviceP->options  = 0;  // Tenant will be created if necessary
@@ -503,7 +526,8 @@ extern void pcheckUriInit(void);
 //
 void orionldServiceInit(OrionLdRestServiceSimplifiedVector* restServiceVV, int vecItems, char* cachedContextDir)
 {
-  int svIx;    // Service Vector Index
+  int svIx;        // Service Vector Index
+  int index  = 0;  // Unique index of the service, over all verbs
 
   bzero(orionldRestServiceV, sizeof(orionldRestServiceV));
 
@@ -524,6 +548,7 @@ void orionldServiceInit(OrionLdRestServiceSimplifiedVector* restServiceVV, int v
     for (sIx = 0; sIx < services; sIx++)
     {
       restServicePrepare(&orionldRestServiceV[svIx].serviceV[sIx], &restServiceVV[svIx].serviceV[sIx]);
+      orionldRestServiceV[svIx].serviceV[sIx].index = index++;
     }
   }
 
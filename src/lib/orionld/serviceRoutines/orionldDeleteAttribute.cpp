@@ -47,6 +47,7 @@ extern "C"
 #include "orionld/common/eqForDot.h"                             // eqForDot
 #include "orionld/payloadCheck/pcheckUri.h"                      // pcheckUri
 #include "orionld/db/dbConfiguration.h"                          // dbEntityAttributeLookup, dbEntityAttributesDelete
+#include "mongoBackend/mongoEntityTypeCatalog.h"                 // mongoEntityTypeCatalogAttrsInvalidate
 #include "orionld/context/orionldAttributeExpand.h"              // orionldAttributeExpand
 #include "orionld/serviceRoutines/orionldDeleteAttribute.h"      // Own Interface
 
@@ -169,6 +170,7 @@ bool orionldDeleteAttribute(ConnectionInfo* ciP)
   char*    attrNameExpanded;
   char*    attrNameExpandedEq;
   char*    detail;
+  KjNode*  dbEntityP = NULL;
 
   //
   // URI param check: both datasetId and deleteAll cannot be set
@@ -239,7 +241,7 @@ bool orionldDeleteAttribute(ConnectionInfo* ciP)
   }
   else
   {
-    if (dbEntityAttributeLookup(entityId, attrNameExpanded) == NULL)
+    if ((dbEntityP = dbEntityAttributeLookup(entityId, attrNameExpanded)) == NULL)
     {
       orionldState.httpStatusCode = 404;
       orionldErrorResponseCreate(OrionldResourceNotFound, "Entity/Attribute not found", attrNameExpanded);
@@ -266,6 +268,11 @@ bool orionldDeleteAttribute(ConnectionInfo* ciP)
     return false;
   }
 
+  // The type of the entity is unknown if the attribute was looked up with its datasets - all types are invalidated
+  KjNode* dbIdP   = (dbEntityP != NULL)? kjLookup(dbEntityP, "_id") : NULL;
+  KjNode* dbTypeP = (dbIdP != NULL)? kjLookup(dbIdP, "type") : NULL;
+  mongoEntityTypeCatalogAttrsInvalidate(orionldState.tenantP, (dbTypeP != NULL)? dbTypeP->value.s : NULL);
+
   orionldState.httpStatusCode = SccNoContent;
   return true;
 }
@@ -25,6 +25,12 @@
 #include <string>
 #include <vector>
 
+extern "C"
+{
+#include "kjson/KjNode.h"                                        // KjNode
+#include "kjson/kjLookup.h"                                      // kjLookup
+}
+
 #include "logMsg/logMsg.h"                                       // LM_*
 #include "logMsg/traceLevels.h"                                  // Lmt*
 
@@ -34,6 +40,7 @@
 #include "orionld/common/orionldErrorResponse.h"                 // orionldErrorResponseCreate
 #include "orionld/payloadCheck/pcheckUri.h"                      // pcheckUri
 #include "orionld/db/dbConfiguration.h"                          // dbEntityDelete, dbEntityLookup
+#include "mongoBackend/mongoEntityTypeCatalog.h"                 // mongoEntityTypeCatalogEntityRemoved
 #include "orionld/serviceRoutines/orionldDeleteEntity.h"         // Own Interface
 
 
@@ -55,7 +62,9 @@ bool orionldDeleteEntity(ConnectionInfo* ciP)
     return false;
   }
 
-  if (dbEntityLookup(entityId) == NULL)
+  KjNode* dbEntityP;
+
+  if ((dbEntityP = dbEntityLookup(entityId)) == NULL)
   {
     orionldErrorResponseCreate(OrionldResourceNotFound, "Entity not found", entityId);
     orionldState.httpStatusCode = 404;  // Not Found
@@ -69,6 +78,12 @@ bool orionldDeleteEntity(ConnectionInfo* ciP)
     return false;
   }
 
+  KjNode* dbIdP   = kjLookup(dbEntityP, "_id");
+  KjNode* dbTypeP = (dbIdP != NULL)? kjLookup(dbIdP, "type") : NULL;
+
+  if (dbTypeP != NULL)
+    mongoEntityTypeCatalogEntityRemoved(orionldState.tenantP, dbTypeP->value.s);
+
   orionldState.httpStatusCode = SccNoContent;  // 204
 
   return true;
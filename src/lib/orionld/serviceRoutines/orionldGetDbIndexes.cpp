@@ -34,24 +34,46 @@ extern "C"
 
 #include "rest/ConnectionInfo.h"                                 // ConnectionInfo
 
-#include "orionld/common/orionldState.h"                         // orionldState
+#include "orionld/types/OrionldGeoIndex.h"                       // OrionldGeoIndex, OrionldGeoIndexState
+#include "orionld/common/orionldState.h"                         // orionldState, geoIndexList
 #include "orionld/common/eqForDot.h"                             // eqForDot
 #include "orionld/context/orionldContextItemAliasLookup.h"       // orionldContextItemAliasLookup
 #include "orionld/serviceRoutines/orionldGetDbIndexes.h"         // Own interface
 
 
 
+// ----------------------------------------------------------------------------
+//
+// geoIndexStateName -
+//
+static const char* geoIndexStateName(OrionldGeoIndexState state)
+{
+  switch (state)
+  {
+  case GeoIndexQueued:    return "queued";
+  case GeoIndexBuilding:  return "building";
+  case GeoIndexReady:     return "ready";
+  case GeoIndexFailed:    return "failed";
+  }
+
+  return "unknown";
+}
+
+
+
 // ----------------------------------------------------------------------------
 //
 // orionldGetDbIndexes -
 //
+// The geo-index registry is read without lock - items are never removed and only published once completely built
+//
 bool orionldGetDbIndexes(ConnectionInfo* ciP)
 {
   int items = 0;
 
   orionldState.responseTree = kjArray(orionldState.kjsonP, NULL);
 
-  for (OrionldGeoIndex* geoNodeP = geoIndexList; geoNodeP != NULL; geoNodeP = geoNodeP->next)
+  for (OrionldGeoIndex* geoNodeP = __atomic_load_n(&geoIndexList, __ATOMIC_ACQUIRE); geoNodeP != NULL; geoNodeP = geoNodeP->next)
   {
     char*   attrName  =  kaStrdup(&orionldState.kalloc, geoNodeP->attrName);
 
@@ -61,8 +83,11 @@ bool orionldGetDbIndexes(ConnectionInfo* ciP)
     KjNode* tenantP   = kjString(orionldState.kjsonP, "tenant",   geoNodeP->tenant);
     KjNode* attrNameP = kjString(orionldState.kjsonP, "attribute", orionldContextItemAliasLookup(orionldState.contextP, attrName, NULL, NULL));
 
+    KjNode* statusP   = kjString(orionldState.kjsonP, "status",   geoIndexStateName(__atomic_load_n(&geoNodeP->state, __ATOMIC_ACQUIRE)));
+
     kjChildAdd(objP, tenantP);
     kjChildAdd(objP, attrNameP);
+    kjChildAdd(objP, statusP);
     kjChildAdd(orionldState.responseTree, objP);
 
     ++items;
@@ -22,39 +22,37 @@
 *
 * Author: Ken Zangelin
 */
-#include <string>
-#include <vector>
+#include <string.h>                                            // strcmp, strlen
 
 extern "C"
 {
 #include "kbase/kMacros.h"                                     // K_FT
 #include "kbase/kStringSplit.h"                                // kStringSplit
 #include "kbase/kTime.h"                                       // kTimeGet
+#include "kalloc/kaAlloc.h"                                    // kaAlloc
 #include "kalloc/kaStrdup.h"                                   // kaStrdup
 #include "kjson/kjBuilder.h"                                   // kjArray, kjChildAdd, ...
 #include "kjson/kjLookup.h"                                    // kjLookup
-#include "kjson/kjRender.h"                                    // kjFastRender
+#include "kjson/kjClone.h"                                     // kjClone
+#include "kjson/kjParse.h"                                     // kjParse
 }
 
 #include "logMsg/logMsg.h"                                     // LM_*
 #include "logMsg/traceLevels.h"                                // Lmt*
 
 #include "rest/ConnectionInfo.h"                               // ConnectionInfo
-#include "ngsi10/QueryContextRequest.h"                        // QueryContextRequest
-#include "ngsi10/QueryContextResponse.h"                       // QueryContextResponse
-#include "mongoBackend/mongoQueryContext.h"                    // mongoQueryContext
 
-#include "orionld/common/SCOMPARE.h"                           // SCOMPAREx
+#include "orionld/common/QNode.h"                              // QNode
 #include "orionld/common/qLex.h"                               // qLex
 #include "orionld/common/qParse.h"                             // qParse
-#include "orionld/common/qTreeToBsonObj.h"                     // qTreeToBsonObj
 #include "orionld/common/orionldState.h"                       // orionldState
 #include "orionld/common/orionldErrorResponse.h"               // orionldErrorResponseCreate
 #include "orionld/common/performance.h"                        // REQUEST_PERFORMANCE
 #include "orionld/common/dotForEq.h"                           // dotForEq
 #include "orionld/payloadCheck/pcheckUri.h"                    // pcheckUri
-#include "orionld/kjTree/kjTreeFromQueryContextResponse.h"     // kjTreeFromQueryContextResponse
-#include "orionld/context/orionldCoreContext.h"                // orionldDefaultUrl
+#include "orionld/payloadCheck/pcheckGeoQ.h"                   // pcheckGeoQ
+#include "orionld/db/dbConfiguration.h"                        // dbEntitiesQuery
+#include "orionld/db/dbModelToApiEntity.h"                     // dbModelToApiEntity
 #include "orionld/context/orionldContextItemExpand.h"          // orionldContextItemExpand
 #include "orionld/context/orionldAttributeExpand.h"            // orionldAttributeExpand
 #include "orionld/serviceRoutines/orionldGetEntity.h"          // orionldGetEntity - if URI param 'id' is given
@@ -62,14 +60,6 @@ extern "C"
 
 
 
-// -----------------------------------------------------------------------------
-//
-// FIXME - put dmodelEntity in its own module (perhaps even its own library ...)
-//
-extern KjNode* dmodelEntity(KjNode* dbEntityP, bool sysAttrs, OrionldProblemDetails* pdP);
-
-
-
 // ----------------------------------------------------------------------------
 //
 // geoPropertyInAttrs -
@@ -87,6 +77,78 @@ static bool geoPropertyInAttrs(char** attrsV, int attrsCount, const char* geoPro
 
 
 
+// ----------------------------------------------------------------------------
+//
+// entityInfoAdd - add an { id | idPattern, type } item to the entity part of the query
+//
+static void entityInfoAdd(KjNode* entityInfoArrayP, char* id, char* idPattern, char* type)
+{
+  KjNode* entityInfoP = kjObject(orionldState.kjsonP, NULL);
+
+  if (id != NULL)
+    kjChildAdd(entityInfoP, kjString(orionldState.kjsonP, "id", id));
+  else if (idPattern != NULL)
+    kjChildAdd(entityInfoP, kjString(orionldState.kjsonP, "idPattern", idPattern));
+
+  if (type != NULL)
+    kjChildAdd(entityInfoP, kjString(orionldState.kjsonP, "type", type));
+
+  kjChildAdd(entityInfoArrayP, entityInfoP);
+}
+
+
+
+// ----------------------------------------------------------------------------
+//
+// geoqFromUriParams - create a geo-query tree, like the 'geoQ' of POST Query, from the URI params
+//
+// The geo-query is checked (and the geo-property expanded) by pcheckGeoQ, just like for POST Query.
+//
+static KjNode* geoqFromUriParams(char* geometry, char* georel, char* coordinates, char* geoproperty)
+{
+  KjNode* geoqP = kjObject(orionldState.kjsonP, NULL);
+  KjNode* coordinatesP;
+  char*   coordsString;
+
+  //
+  // The coordinates come as a string - a JSON array (the '[]' are optional, for compatibility with APIv2)
+  //
+  if (coordinates[0] == '[')
+    coordsString = kaStrdup(&orionldState.kalloc, coordinates);
+  else
+  {
+    int len = strlen(coordinates) + 3;
+
+    coordsString = kaAlloc(&orionldState.kalloc, len);
+    snprintf(coordsString, len, "[%s]", coordinates);
+  }
+
+  coordinatesP = kjParse(orionldState.kjsonP, coordsString);
+  if ((coordinatesP == NULL) || (coordinatesP->type != KjArray))
+  {
+    LM_W(("Bad Input (invalid value for URI parameter 'coordinates')"));
+    orionldErrorResponseCreate(OrionldBadRequestData, "Invalid value for URI parameter /coordinates/", coordinates);
+    orionldState.httpStatusCode = SccBadRequest;
+    return NULL;
+  }
+
+  coordinatesP->name = (char*) "coordinates";
+
+  kjChildAdd(geoqP, kjString(orionldState.kjsonP, "geometry", geometry));
+  kjChildAdd(geoqP, coordinatesP);
+  kjChildAdd(geoqP, kjString(orionldState.kjsonP, "georel", georel));
+
+  if (geoproperty != NULL)
+    kjChildAdd(geoqP, kjString(orionldState.kjsonP, "geoproperty", geoproperty));
+
+  if (pcheckGeoQ(geoqP, false) == false)
+    return NULL;
+
+  return geoqP;
+}
+
+
+
 // ----------------------------------------------------------------------------
 //
 // orionldGetEntities -
@@ -105,6 +167,12 @@ static bool geoPropertyInAttrs(char** attrsV, int attrsCount, const char* geoPro
 // - coordinates
 // - georel
 // - maxDistance
+// - geoproperty
+// - count
+//
+// The query is performed natively in the database layer (dbEntitiesQuery) and the entities, as extracted
+// from the database, are transformed into their API representation by dbModelToApiEntity - the same
+// transformation as for GET /entities/{entityId}.
 //
 // If "id" is given, then all other URI params are just to hint the broker on where to look for the
 // entity (except for pagination params 'offset' and 'limit', and 'attrs' that has an additional function).
@@ -130,10 +198,6 @@ bool orionldGetEntities(ConnectionInfo* ciP)
   char*                 georel         = orionldState.uriParams.georel;
   char*                 coordinates    = orionldState.uriParams.coordinates;
 
-  char*                 idString       = (id != NULL)? id      : idPattern;
-  const char*           isIdPattern    = (id != NULL)? "false" : "true";
-  bool                  isTypePattern  = (type != NULL)? false   : true;
-  EntityId*             entityIdP;
   char*                 typeExpanded   = NULL;
   char*                 detail;
   char*                 idVector[32];    // Is 32 a good limit?
@@ -141,8 +205,7 @@ bool orionldGetEntities(ConnectionInfo* ciP)
   int                   idVecItems     = (int) sizeof(idVector) / sizeof(idVector[0]);
   int                   typeVecItems   = (int) sizeof(typeVector) / sizeof(typeVector[0]);
   bool                  keyValues      = orionldState.uriParamOptions.keyValues;
-  QueryContextRequest   mongoRequest;
-  QueryContextResponse  mongoResponse;
+  KjNode*               geoqP          = NULL;
 
   //
   // FIXME: Move all this to orionldMhdConnectionInit()
@@ -274,50 +337,14 @@ bool orionldGetEntities(ConnectionInfo* ciP)
       return false;
     }
 
-    Scope*       scopeP = new Scope(SCOPE_TYPE_LOCATION, "");
-    std::string  errorString;
-
-    //
-    // In APIv2, the vector is a string without [], in NGSI-LD, [] are present. Must remove ...
-    //
-    if (coordinates[0] == '[')
-    {
-      ++coordinates;
-
-      int len = strlen(coordinates);
-      if (coordinates[len - 1] == ']')
-        coordinates[len - 1] = 0;
-    }
-
-    if (scopeP->fill(ciP->apiVersion, geometry, coordinates, georel, &errorString) != 0)
-    {
-      scopeP->release();
-      delete scopeP;
-
-      LM_E(("Geo: Scope::fill failed"));
-      orionldErrorResponseCreate(OrionldInternalError, "Invalid Geometry", errorString.c_str());
-      orionldState.httpStatusCode = SccBadRequest;
+    if ((geoqP = geoqFromUriParams(geometry, georel, coordinates, orionldState.uriParams.geoproperty)) == NULL)
       return false;
-    }
-
-    LM_E(("Geo: Scope::fill OK"));
-    mongoRequest.restriction.scopeVector.push_back(scopeP);
   }
 
-  if (idString == NULL)
-  {
-    idString    = (char*) ".*";
-    isIdPattern = (char*) "true";
-  }
-
-  if (type == NULL)  // No type given - match all types
-  {
-    type          = (char*) ".*";
-    isTypePattern = true;
-    typeVecItems  = 0;  // Just to avoid entering the "if (typeVecItems == 1)"
-  }
-  else
+  if (type != NULL)
     typeVecItems = kStringSplit(type, ',', (char**) typeVector, typeVecItems);
+  else
+    typeVecItems = 0;
 
   idVecItems   = kStringSplit(id, ',', (char**) idVector, idVecItems);
 
@@ -352,16 +379,20 @@ bool orionldGetEntities(ConnectionInfo* ciP)
     //   I always expand ...
     //
     type = orionldContextItemExpand(orionldState.contextP, type, true, NULL);  // entity type
-
-    isTypePattern = false;  // Just in case ...
   }
+  else if (typeVecItems == 0)
+    type = NULL;
+
+  //
+  // The entity part of the query - an array of { id | idPattern, type }
+  //
+  KjNode* entityInfoArrayP = kjArray(orionldState.kjsonP, NULL);
 
   if (idVecItems > 1)  // A list of Entity IDs
   {
     for (int ix = 0; ix < idVecItems; ix++)
     {
-      entityIdP = new EntityId(idVector[ix], type, "false", isTypePattern);
-      mongoRequest.entityIdVector.push_back(entityIdP);
+      entityInfoAdd(entityInfoArrayP, idVector[ix], NULL, type);
     }
   }
   else if (typeVecItems > 1)  // A list of Entity Types
@@ -373,24 +404,32 @@ bool orionldGetEntities(ConnectionInfo* ciP)
       else
         typeExpanded = typeVector[ix];
 
-      entityIdP = new EntityId(idString, typeExpanded, isIdPattern, false);
-      mongoRequest.entityIdVector.push_back(entityIdP);
+      entityInfoAdd(entityInfoArrayP, id, idPattern, typeExpanded);
     }
   }
   else  // Definitely no lists in EntityId id/type
-  {
-    entityIdP = new EntityId(idString, type, isIdPattern, isTypePattern);
-    mongoRequest.entityIdVector.push_back(entityIdP);
-  }
+    entityInfoAdd(entityInfoArrayP, id, idPattern, type);
 
-  char* attrsV[100];
-  int   attrsCount = 0;
+  //
+  // attrs - the attribute names in the database have their dots replaced for '='.
+  // That is what is needed for the projection, while the filter on 'attrNames' needs the names as they are.
+  // For Accept: application/geo+json, the geo-property must be extracted as well, even if not part of 'attrs'.
+  //
+  char*        attrsV[100];
+  char*        eqAttrsV[100 + 1];
+  char*        projectionV[100 + 2];
+  int          attrsCount              = 0;
+  KjNode*      attrsP                  = NULL;
+  char**       eqAttrs                 = NULL;
+  char**       projection              = NULL;
+  const char*  geoPropertyName         = NULL;
+  char*        geoPropertyNameExpanded = NULL;
 
   if (attrs != NULL)
   {
     attrsCount = (int) sizeof(attrsV) / sizeof(attrsV[0]);
-
     attrsCount = kStringSplit(attrs, ',', (char**) attrsV, attrsCount);
+    attrsP     = kjArray(orionldState.kjsonP, NULL);
 
     for (int ix = 0; ix < attrsCount; ix++)
     {
@@ -401,22 +440,53 @@ bool orionldGetEntities(ConnectionInfo* ciP)
         attrsV[ix] = orionldAttributeExpand(orionldState.contextP, attrsV[ix], true, NULL);
       }
 
-      mongoRequest.attributeList.push_back(attrsV[ix]);
+      kjChildAdd(attrsP, kjString(orionldState.kjsonP, NULL, attrsV[ix]));
+
+      eqAttrsV[ix] = kaStrdup(&orionldState.kalloc, attrsV[ix]);
+      dotForEq(eqAttrsV[ix]);
+      projectionV[ix] = eqAttrsV[ix];
+    }
+
+    eqAttrsV[attrsCount]    = NULL;
+    projectionV[attrsCount] = NULL;
+    eqAttrs                 = eqAttrsV;
+    projection              = projectionV;
+
+    if (orionldState.acceptGeojson == true)
+    {
+      geoPropertyName         = (orionldState.uriParams.geometryProperty == NULL)? "location" : orionldState.uriParams.geometryProperty;
+      geoPropertyNameExpanded = (char*) geoPropertyName;
+
+      if ((strcmp(geoPropertyName, "location")         != 0) &&
+          (strcmp(geoPropertyName, "observationSpace") != 0) &&
+          (strcmp(geoPropertyName, "operationSpace")   != 0))
+      {
+        geoPropertyNameExpanded = orionldAttributeExpand(orionldState.contextP, (char*) geoPropertyName, true, NULL);
+        geoPropertyNameExpanded = kaStrdup(&orionldState.kalloc, geoPropertyNameExpanded);
+        dotForEq(geoPropertyNameExpanded);
+      }
+
+      if (geoPropertyInAttrs(eqAttrsV, attrsCount, geoPropertyNameExpanded) == false)
+      {
+        projectionV[attrsCount]     = geoPropertyNameExpanded;
+        projectionV[attrsCount + 1] = NULL;
+      }
+      else
+        geoPropertyNameExpanded = NULL;  // Part of the entities already
     }
   }
 
+  QNode* qTree = NULL;
   if (q != NULL)
   {
     char*  title;
     char*  detail;
     QNode* lexList;
-    QNode* qTree;
 
     if ((lexList = qLex(q, &title, &detail)) == NULL)
     {
       LM_W(("Bad Input (qLex: %s: %s)", title, detail));
       orionldErrorResponseCreate(OrionldBadRequestData, title, detail);
-      mongoRequest.release();
       return false;
     }
 
@@ -424,150 +494,91 @@ bool orionldGetEntities(ConnectionInfo* ciP)
     {
       LM_W(("Bad Input (qParse: %s: %s)", title, detail));
       orionldErrorResponseCreate(OrionldBadRequestData, title, detail);
-      mongoRequest.release();
-      return false;
-    }
-
-
-    //
-    // FIXME: this part about Q-Filter depends on the database and must be moved to
-    //        the DB layer
-    //
-    orionldState.qMongoFilterP = new mongo::BSONObj;
-
-    mongo::BSONObjBuilder objBuilder;
-    if (qTreeToBsonObj(qTree, &objBuilder, &title, &detail) == false)
-    {
-      LM_W(("Bad Input (qTreeToBsonObj: %s: %s)", title, detail));
-      orionldErrorResponseCreate(OrionldBadRequestData, title, detail);
-      mongoRequest.release();
       return false;
     }
-
-    *orionldState.qMongoFilterP = objBuilder.obj();
   }
 
 
   //
-  // Call mongoBackend
+  // Query the database
   //
-  long long   count;
-  long long*  countP = (orionldState.uriParams.count == true)? &count : NULL;
+  int                    count;
+  int*                   countP        = (orionldState.uriParams.count == true)? &count : NULL;
+  KjNode*                dbEntityArray;
+  OrionldProblemDetails  pd;
 
-  //
-  // Special case:
-  // If count is asked for and limit == 0 - just do the count query
-  //
-  if ((countP != NULL) && (orionldState.uriParams.limit == 0))
-    orionldState.onlyCount = true;
-
-#ifdef REQUEST_PERFORMANCE
-  kTimeGet(&timestamps.dbStart);
-#endif
-
-  orionldState.httpStatusCode = mongoQueryContext(&mongoRequest,
-                                                  &mongoResponse,
-                                                  orionldState.tenantP,
-                                                  ciP->servicePathV,
-                                                  ciP->uriParam,
-                                                  ciP->uriParamOptions,
-                                                  countP,
-                                                  ciP->apiVersion);
-#ifdef REQUEST_PERFORMANCE
-  kTimeGet(&timestamps.dbEnd);
-#endif
+  count = 0;
 
-  //
-  // Transform QueryContextResponse to KJ-Tree
-  //
-  orionldState.httpStatusCode = SccOk;  // FIXME: What about the response from mongoQueryContext???
+  PERFORMANCE(dbStart);
 
-  orionldState.responseTree = kjTreeFromQueryContextResponse(false, NULL, keyValues, &mongoResponse);
+  dbEntityArray = dbEntitiesQuery(&pd,
+                                  entityInfoArrayP,
+                                  attrsP,
+                                  qTree,
+                                  geoqP,
+                                  orionldState.uriParams.limit,
+                                  orionldState.uriParams.offset,
+                                  countP,
+                                  projection);
+
+  PERFORMANCE(dbEnd);
+
+  if (dbEntityArray == NULL)  // Invalid q-filter (400) or database error (500) - never a partial result
+  {
+    orionldErrorResponseCreate(pd.type, pd.title, pd.detail);
+    orionldState.httpStatusCode = (HttpStatusCode) pd.status;
+    return false;
+  }
 
   //
-  // Work-around for Accept: application/geo+json
-  //
-  // If attrs is used and the Geo-Property is not part of the attrs list, then the GeoProperty will be set to NULL
-  // even though it may exist.
-  //
-  // As it will be really hard to modify mongoBackend to include that attribute that is not asked for (in URI param 'attrs'),
-  // a workaround would be to perform an extra query:
+  // Transform the entities from the database model into their API representation
   //
-  // if (Accept: application/geo+json) && (URI param attrs is in use)
-  //   Get the name of the geo-property (default: location)
-  //   If geo-property is NOT in 'attrs' URI param
-  //     Prepare a query for all entities in orionldState.responseTree, for:
-  //     * _id.id and
-  //     * geo-property
-  //   Now go over the tree (orionldState.responseTree) and replace
-  //     "geometry": null
-  //   with whatever was found in this second query to mongo
+  // For Accept: application/geo+json, if the geo-property isn't part of 'attrs', it is not included in the entity
+  // but it's still needed for the 'geometry' of the Feature. Such geo-properties are collected in
+  // orionldState.geoPropertyNodes, as { "id": <entity id>, <geometryProperty>: <GeoProperty value> }.
   //
-  if ((orionldState.acceptGeojson) && (attrsCount > 0) && (orionldState.responseTree->type == KjArray))
-  {
-    const char* geoPropertyName        = (orionldState.uriParams.geometryProperty == NULL)? "location" : orionldState.uriParams.geometryProperty;
-    bool        geoPropertyNameInAttrs = geoPropertyInAttrs(attrsV, attrsCount, geoPropertyName);
+  orionldState.httpStatusCode = SccOk;
+  orionldState.responseTree   = kjArray(orionldState.kjsonP, NULL);
 
-    int ix = 0;
-    while (ix < attrsCount)
-    {
-      if (strcmp(geoPropertyName, attrsV[ix]) == 0)
-        geoPropertyNameInAttrs = true;
+  if (geoPropertyNameExpanded != NULL)
+    orionldState.geoPropertyNodes = kjArray(orionldState.kjsonP, NULL);
 
-      ++ix;
-    }
+  if (dbEntityArray != NULL)
+  {
+    bool  sysAttrs = orionldState.uriParamOptions.sysAttrs;
 
-    if (geoPropertyNameInAttrs == false)
+    for (KjNode* dbEntityP = dbEntityArray->value.firstChildP; dbEntityP != NULL; dbEntityP = dbEntityP->next)
     {
-      int entities = 0;
+      KjNode*  geoPropertyP = NULL;
+      KjNode*  entityP      = dbModelToApiEntity(dbEntityP, eqAttrs, false, sysAttrs, keyValues, geoPropertyNameExpanded, &geoPropertyP);
 
-      // Count the number of entities of the response
-      for (KjNode* entityP = orionldState.responseTree->value.firstChildP; entityP != NULL; entityP = entityP->next)
+      if (entityP == NULL)
       {
-        ++entities;
+        LM_E(("Database Error (unable to transform a DB entity into its API representation)"));
+        continue;
       }
 
-      // Allocate array of entity ids
-      char** entityArray = (char**) kaAlloc(&orionldState.kalloc, sizeof(KjNode*) * entities);
-      int    entityIx    = 0;
-
-      // Populate the array with all entity ids
-      for (KjNode* entityP = orionldState.responseTree->value.firstChildP; entityP != NULL; entityP = entityP->next)
+      //
+      // The geo-property was only extracted for the 'geometry' of geo+json - it is not part of the entity
+      //
+      if (geoPropertyNameExpanded != NULL)
       {
         KjNode* idP = kjLookup(entityP, "id");
 
-        if (idP != NULL)
-          entityArray[entityIx++] = idP->value.s;
-      }
-
-      // DB Query, to extract the needed info from the DB
-      char* geoPropertyNameExpanded = (char*) geoPropertyName;
-
-      if ((strcmp(geoPropertyName, "location")         != 0) &&
-          (strcmp(geoPropertyName, "observationSpace") != 0) &&
-          (strcmp(geoPropertyName, "operationSpace")   != 0))
-      {
-        geoPropertyNameExpanded = orionldAttributeExpand(orionldState.contextP, (char*) geoPropertyName, true, NULL);
-
-        geoPropertyNameExpanded = kaStrdup(&orionldState.kalloc, geoPropertyNameExpanded);
-        dotForEq(geoPropertyNameExpanded);
-      }
-
-      KjNode* dbEntityArray = dbEntitiesAttributeLookup(entityArray, entities, geoPropertyNameExpanded);
-      if (dbEntityArray != NULL)
-      {
-        orionldState.geoPropertyNodes = kjArray(orionldState.kjsonP, NULL);
-
-        // Transform the Database model into a "valid" NGSI-LD tree
-        for (KjNode* dbEntityP = dbEntityArray->value.firstChildP; dbEntityP != NULL; dbEntityP = dbEntityP->next)
+        if ((idP != NULL) && (geoPropertyP != NULL))
         {
-          OrionldProblemDetails pd;
-          KjNode*               entityP = dmodelEntity(dbEntityP, false, &pd);
-
-          if (entityP != NULL)
-            kjChildAdd(orionldState.geoPropertyNodes, entityP);
+          KjNode* geoEntityP = kjObject(orionldState.kjsonP, NULL);
+          KjNode* geoIdP     = kjString(orionldState.kjsonP, "id", idP->value.s);
+
+          geoPropertyP       = kjClone(orionldState.kjsonP, geoPropertyP);
+          geoPropertyP->name = (char*) geoPropertyName;
+          kjChildAdd(geoEntityP, geoIdP);
+          kjChildAdd(geoEntityP, geoPropertyP);
+          kjChildAdd(orionldState.geoPropertyNodes, geoEntityP);
         }
       }
+
+      kjChildAdd(orionldState.responseTree, entityP);
     }
   }
 
@@ -578,12 +589,10 @@ bool orionldGetEntities(ConnectionInfo* ciP)
   if (countP != NULL)
   {
     char cV[32];
-    snprintf(cV, sizeof(cV), "%llu", *countP);
+    snprintf(cV, sizeof(cV), "%d", *countP);
     ciP->httpHeader.push_back("NGSILD-Results-Count");
     ciP->httpHeaderValue.push_back(cV);
   }
 
-  mongoRequest.release();
-
   return true;
 }
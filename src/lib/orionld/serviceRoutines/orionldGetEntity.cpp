@@ -22,6 +22,8 @@
 *
 * Author: Ken Zangelin
 */
+#include <strings.h>                                            // bzero
+
 extern "C"
 {
 #include "kbase/kMacros.h"                                       // K_VEC_SIZE, K_FT
@@ -44,7 +46,8 @@ extern "C"
 #include "orionld/common/SCOMPARE.h"                             // SCOMPAREx
 #include "orionld/common/orionldState.h"                         // orionldState
 #include "orionld/common/orionldErrorResponse.h"                 // orionldErrorResponseCreate
-#include "orionld/common/orionldRequestSend.h"                   // orionldRequestSend
+#include "orionld/common/orionldRequestSend.h"                   // OrionldHttpHeader
+#include "orionld/common/orionldRequestSendMulti.h"              // orionldRequestSendMulti
 #include "orionld/common/dotForEq.h"                             // dotForEq
 #include "orionld/common/performance.h"                          // REQUEST_PERFORMANCE
 #include "orionld/common/tenantList.h"                           // tenant0
@@ -155,19 +158,28 @@ static void attrsToAlias(OrionldContext* contextP, char* attrV[], int attrs)
 //   YES                                               YES                                    "attrs" URI param is a merge between the two
 //
 //
-static KjNode* orionldForwardGetEntityPart(KjNode* registrationP, char* entityId, char** uriParamAttrV, int uriParamAttrs)
+static bool orionldForwardGetEntityPrepare
+(
+  KjNode*               registrationP,
+  char*                 entityId,
+  char**                uriParamAttrV,
+  int                   uriParamAttrs,
+  OrionldMultiRequest*  requestP
+)
 {
-  char            host[128]                  = { 0 };
-  char            protocol[32]               = { 0 };
+  char*           host                       = (char*) kaAlloc(&orionldState.kalloc, 128);
+  char*           protocol                   = (char*) kaAlloc(&orionldState.kalloc, 32);
   unsigned short  port                       = 0;
   char*           uriDir                     = (char*) "";
   char*           detail;
-  KjNode*         entityP                    = NULL;
   char*           registrationAttrV[100];
   int             registrationAttrs          = 0;
 
-  if (kjTreeRegistrationInfoExtract(registrationP, protocol, sizeof(protocol), host, sizeof(host), &port, &uriDir, registrationAttrV, 100, &registrationAttrs, &detail) == false)
-    return NULL;
+  host[0]     = 0;
+  protocol[0] = 0;
+
+  if (kjTreeRegistrationInfoExtract(registrationP, protocol, 32, host, 128, &port, &uriDir, registrationAttrV, 100, &registrationAttrs, &detail) == false)
+    return false;
 
   char* newUriParamAttrsString = (char*) kaAlloc(&orionldState.kalloc, 200 * 30);  // Assuming max 30 attrs, max 200 chars per attr ...
 
@@ -213,7 +225,7 @@ static KjNode* orionldForwardGetEntityPart(KjNode* registrationP, char* entityId
   if (uriDirP != NULL)
   {
     int slen = strlen(uriDirP);
-    if (uriDirP[slen - 1] == '/')
+    if ((slen > 0) && (uriDirP[slen - 1] == '/'))
       uriDirP[slen - 1] = 0;
   }
 
@@ -232,23 +244,76 @@ static KjNode* orionldForwardGetEntityPart(KjNode* registrationP, char* entityId
       snprintf(urlPath, size, "%s/ngsi-ld/v1/entities/%s", uriDirP, entityId);
   }
 
-  //
-  // Sending the Forwarded request
-  //
-  orionldState.httpResponse.buf       = NULL;  // orionldRequestSend allocates
-  orionldState.httpResponse.size      = 0;
-  orionldState.httpResponse.used      = 0;
-  orionldState.httpResponse.allocated = false;
+  requestP->protocol     = protocol;
+  requestP->ip           = host;
+  requestP->port         = port;
+  requestP->verb         = "GET";
+  requestP->urlPath      = urlPath;
+  requestP->acceptHeader = "Accept: application/json";
+
+  return true;
+}
+
 
-  bool tryAgain = false;
-  bool reqOk;
-  bool downloadFailed;
+
+// -----------------------------------------------------------------------------
+//
+// ForwardResponses - the responses to the forwarded requests, parsed as they come in
+//
+typedef struct ForwardResponses
+{
+  OrionldMultiRequest*  requestV;
+  KjNode**              partTreeV;
+} ForwardResponses;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldForwardGetEntityResponse - parse the response of one of the forwarded requests
+//
+static void orionldForwardGetEntityResponse(OrionldMultiRequest* requestP, void* dataP)
+{
+  ForwardResponses* responsesP = (ForwardResponses*) dataP;
+  int               ix         = requestP - responsesP->requestV;
+
+  if (requestP->ok == false)
+  {
+    LM_E(("Internal Error (forwarded request to %s failed%s)", requestP->url, (requestP->timedOut == true)? " - timeout" : ""));
+    return;
+  }
+
+  responsesP->partTreeV[ix] = kjParse(orionldState.kjsonP, requestP->responseBuf);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// orionldForwardGetEntity -
+//
+// All matching registrations are forwarded to in parallel and the responses are parsed as they come in.
+// Context sources that haven't responded within 5 seconds (counted from the moment the requests are sent)
+// are left out of the response.
+// The pieces of the entity are merged in registration order, so the response doesn't depend on what
+// context source responded first.
+//
+static KjNode* orionldForwardGetEntity(ConnectionInfo* ciP, char* entityId, KjNode* regArrayP, KjNode* responseP, bool needEntityType, char** attrsV, int attrs)
+{
+  int registrations = 0;
+
+  for (KjNode* regP = regArrayP->value.firstChildP; regP != NULL; regP = regP->next)
+    ++registrations;
+
+  if (registrations == 0)
+    return responseP;
 
   //
-  // Prepare HTTP headers
+  // Prepare HTTP headers - the same for all forwarded requests
   //
   OrionldHttpHeader headerV[5];
   int               header = 0;
+  char*             link   = NULL;
 
   if (orionldState.tenantP != &tenant0)
   {
@@ -275,39 +340,51 @@ static KjNode* orionldForwardGetEntityPart(KjNode* registrationP, char* entityId
 
   if (orionldState.linkHttpHeaderPresent)
   {
-    char link[512];
-
-    snprintf(link, sizeof(link), "<%s>; rel=\"http://www.w3.org/ns/json-ld#context\"; type=\"application/ld+json\"", orionldState.link);
-    reqOk = orionldRequestSend(&orionldState.httpResponse, protocol, host, port, "GET", urlPath, 5000, link, &detail, &tryAgain, &downloadFailed, "Accept: application/json", NULL, NULL, 0, headerV);
+    link = (char*) kaAlloc(&orionldState.kalloc, 512);
+    snprintf(link, 512, "<%s>; rel=\"http://www.w3.org/ns/json-ld#context\"; type=\"application/ld+json\"", orionldState.link);
   }
-  else
-    reqOk = orionldRequestSend(&orionldState.httpResponse, protocol, host, port, "GET", urlPath, 5000, NULL, &detail, &tryAgain, &downloadFailed, "Accept: application/json", NULL, NULL, 0, headerV);
 
-  if (reqOk)
-    entityP = kjParse(orionldState.kjsonP, orionldState.httpResponse.buf);
+  //
+  // One request per registration
+  //
+  OrionldMultiRequest*  requestV  = (OrionldMultiRequest*) kaAlloc(&orionldState.kalloc, registrations * sizeof(OrionldMultiRequest));
+  KjNode**              partTreeV = (KjNode**) kaAlloc(&orionldState.kalloc, registrations * sizeof(KjNode*));
+  int                   requests  = 0;
 
-  return entityP;
-}
+  for (KjNode* regP = regArrayP->value.firstChildP; regP != NULL; regP = regP->next)
+  {
+    OrionldMultiRequest* requestP = &requestV[requests];
+
+    bzero(requestP, sizeof(OrionldMultiRequest));
+    partTreeV[requests] = NULL;
+
+    if (orionldForwardGetEntityPrepare(regP, entityId, attrsV, attrs, requestP) == false)
+    {
+      LM_E(("Internal Error (unable to extract the endpoint of a matching registration)"));
+      continue;
+    }
 
+    requestP->linkHeader = link;
+    requestP->headerV    = headerV;
+    ++requests;
+  }
 
+  //
+  // Sending the Forwarded requests
+  //
+  ForwardResponses responses = { requestV, partTreeV };
+
+  orionldRequestSendMulti(requestV, requests, 5000, orionldForwardGetEntityResponse, &responses);
 
-// -----------------------------------------------------------------------------
-//
-// orionldForwardGetEntity -
-//
-static KjNode* orionldForwardGetEntity(ConnectionInfo* ciP, char* entityId, KjNode* regArrayP, KjNode* responseP, bool needEntityType, char** attrsV, int attrs)
-{
   //
   // Treat all hits from the registrations
   //
-  for (KjNode* regP = regArrayP->value.firstChildP; regP != NULL; regP = regP->next)
+  for (int ix = 0; ix < requests; ix++)
   {
-    KjNode*  partTree = orionldForwardGetEntityPart(regP, entityId, attrsV, attrs);
+    KjNode* partTree = partTreeV[ix];
+
     if (partTree == NULL)
-    {
-      LM_E(("Internal Error (forwarded request failed)"));
       continue;
-    }
 
     if (partTree->type != KjObject)
     {
@@ -22,12 +22,28 @@
 *
 * Author: Ken Zangelin
 */
+#include <stdio.h>                                               // snprintf
+
+extern "C"
+{
+#include "kjson/KjNode.h"                                        // KjNode
+}
+
 #include "logMsg/logMsg.h"
 
 #include "rest/ConnectionInfo.h"
+#include "rest/httpHeaderAdd.h"                                  // httpHeaderAdd
 #include "orionld/common/orionldState.h"                         // orionldState
 #include "orionld/common/orionldErrorResponse.h"                 // orionldErrorResponseCreate
 #include "orionld/rest/OrionLdRestService.h"                     // OrionLdRestService
+#include "orionld/kjTree/kjTemporalEntityCompact.h"              // kjTemporalEntityCompact
+#include "orionld/troe/PgConnection.h"                           // PgConnection
+#include "orionld/troe/pgConnectionGet.h"                        // pgConnectionGet
+#include "orionld/troe/pgConnectionRelease.h"                    // pgConnectionRelease
+#include "orionld/troe/PgTemporalQuery.h"                        // PgTemporalQuery
+#include "orionld/troe/pgTemporalQueryInit.h"                    // pgTemporalQueryInit
+#include "orionld/troe/pgTemporalEntitiesGet.h"                  // pgTemporalEntitiesGet
+#include "orionld/troe/pgTemporalAttributesGet.h"                // pgTemporalAttributesGet
 #include "orionld/serviceRoutines/orionldGetTemporalEntities.h"  // Own Interface
 
 
@@ -36,11 +52,80 @@
 //
 // orionldGetTemporalEntities -
 //
+// URI params:
+// - id, type, idPattern
+// - attrs
+// - timeproperty, timerel, timeAt, endTimeAt
+// - lastN
+// - offset, limit, count
+//
+// The query is performed by the broker itself, in the TRoE database (only if TRoE is on - else Mintaka is needed).
+// The entity filter and pagination are pushed down to a SELECT on the entities table, and then the attribute
+// instances of the entities of the page are streamed from the attributes/subAttributes tables through a cursor,
+// with the attrs filter, timerel and lastN pushed down to SQL.
+//
 bool orionldGetTemporalEntities(ConnectionInfo* ciP)
 {
-  orionldState.httpStatusCode = 501;
-  orionldState.noLinkHeader   = true;  // We don't want the Link header for non-implemented requests
+  if (troe == false)
+  {
+    orionldState.httpStatusCode = 501;
+    orionldState.noLinkHeader   = true;  // We don't want the Link header for non-implemented requests
+
+    orionldErrorResponseCreate(OrionldOperationNotSupported, "Not Implemented in Orion-LD, please use Mintaka for this operation", orionldState.serviceP->url);
+    return false;
+  }
+
+  PgTemporalQuery tq;
+
+  if (pgTemporalQueryInit(&tq, NULL) == false)
+    return false;
+
+  if ((tq.idV == NULL) && (tq.typeV == NULL) && (tq.idPattern == NULL) && (tq.attrV == NULL))
+  {
+    LM_W(("Bad Input (too broad query - need at least one of: entity-id, entity-type, idPattern, attrs)"));
+    orionldErrorResponseCreate(OrionldBadRequestData, "Too broad query", "Need at least one of: entity-id, entity-type, idPattern, attrs");
+    orionldState.httpStatusCode = 400;
+    return false;
+  }
+
+  PgConnection* connectionP = pgConnectionGet(orionldState.tenantP->troeDbName);
+
+  if ((connectionP == NULL) || (connectionP->connectionP == NULL))
+  {
+    LM_E(("Database Error (no connection to postgres)"));
+    orionldErrorResponseCreate(OrionldInternalError, "Database Error", "no connection to the temporal database");
+    orionldState.httpStatusCode = 500;
+    return false;
+  }
+
+  int      count;
+  int*     countP      = (orionldState.uriParams.count == true)? &count : NULL;
+  KjNode*  entityArray = pgTemporalEntitiesGet(connectionP->connectionP, &tq, orionldState.uriParams.offset, orionldState.uriParams.limit, countP);
+  bool     ok          = (entityArray != NULL) && (pgTemporalAttributesGet(connectionP->connectionP, &tq, entityArray) == true);
+
+  pgConnectionRelease(connectionP);
+
+  if (ok == false)
+  {
+    orionldErrorResponseCreate(OrionldInternalError, "Database Error", "querying the temporal database");
+    orionldState.httpStatusCode = 500;
+    return false;
+  }
+
+  for (KjNode* entityP = entityArray->value.firstChildP; entityP != NULL; entityP = entityP->next)
+    kjTemporalEntityCompact(entityP);
+
+  if (entityArray->value.firstChildP == NULL)
+    orionldState.noLinkHeader = true;
+
+  if (countP != NULL)
+  {
+    char number[16];
+
+    snprintf(number, sizeof(number), "%d", count);
+    httpHeaderAdd(ciP, "NGSILD-Results-Count", number);
+  }
 
-  orionldErrorResponseCreate(OrionldOperationNotSupported, "Not Implemented in Orion-LD, please use Mintaka for this operation", orionldState.serviceP->url);
-  return false;
+  orionldState.responseTree = entityArray;
+  return true;
 }
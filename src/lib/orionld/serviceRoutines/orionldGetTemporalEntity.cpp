@@ -22,12 +22,25 @@
 *
 * Author: Ken Zangelin
 */
+extern "C"
+{
+#include "kjson/KjNode.h"                                        // KjNode
+}
+
 #include "logMsg/logMsg.h"
 
 #include "rest/ConnectionInfo.h"
 #include "orionld/common/orionldState.h"                         // orionldState
 #include "orionld/common/orionldErrorResponse.h"                 // orionldErrorResponseCreate
 #include "orionld/rest/OrionLdRestService.h"                     // OrionLdRestService
+#include "orionld/kjTree/kjTemporalEntityCompact.h"              // kjTemporalEntityCompact
+#include "orionld/troe/PgConnection.h"                           // PgConnection
+#include "orionld/troe/pgConnectionGet.h"                        // pgConnectionGet
+#include "orionld/troe/pgConnectionRelease.h"                    // pgConnectionRelease
+#include "orionld/troe/PgTemporalQuery.h"                        // PgTemporalQuery
+#include "orionld/troe/pgTemporalQueryInit.h"                    // pgTemporalQueryInit
+#include "orionld/troe/pgTemporalEntitiesGet.h"                  // pgTemporalEntitiesGet
+#include "orionld/troe/pgTemporalAttributesGet.h"                // pgTemporalAttributesGet
 #include "orionld/serviceRoutines/orionldGetTemporalEntity.h"    // Own Interface
 
 
@@ -36,11 +49,62 @@
 //
 // orionldGetTemporalEntity -
 //
+// URI params:
+// - attrs
+// - timeproperty, timerel, timeAt, endTimeAt
+// - lastN
+//
+// Same as orionldGetTemporalEntities, for a single entity.
+//
 bool orionldGetTemporalEntity(ConnectionInfo* ciP)
 {
-  orionldState.httpStatusCode = 501;
-  orionldState.noLinkHeader   = true;  // We don't want the Link header for non-implemented requests
+  if (troe == false)
+  {
+    orionldState.httpStatusCode = 501;
+    orionldState.noLinkHeader   = true;  // We don't want the Link header for non-implemented requests
+
+    orionldErrorResponseCreate(OrionldOperationNotSupported, "Not Implemented in Orion-LD, please use Mintaka for this operation", orionldState.serviceP->url);
+    return false;
+  }
+
+  PgTemporalQuery tq;
+
+  if (pgTemporalQueryInit(&tq, orionldState.wildcard[0]) == false)
+    return false;
+
+  PgConnection* connectionP = pgConnectionGet(orionldState.tenantP->troeDbName);
+
+  if ((connectionP == NULL) || (connectionP->connectionP == NULL))
+  {
+    LM_E(("Database Error (no connection to postgres)"));
+    orionldErrorResponseCreate(OrionldInternalError, "Database Error", "no connection to the temporal database");
+    orionldState.httpStatusCode = 500;
+    return false;
+  }
+
+  KjNode*  entityArray = pgTemporalEntitiesGet(connectionP->connectionP, &tq, 0, 1, NULL);
+  bool     ok          = (entityArray != NULL) && (pgTemporalAttributesGet(connectionP->connectionP, &tq, entityArray) == true);
+
+  pgConnectionRelease(connectionP);
+
+  if (ok == false)
+  {
+    orionldErrorResponseCreate(OrionldInternalError, "Database Error", "querying the temporal database");
+    orionldState.httpStatusCode = 500;
+    return false;
+  }
+
+  KjNode* entityP = entityArray->value.firstChildP;
+
+  if (entityP == NULL)
+  {
+    orionldErrorResponseCreate(OrionldResourceNotFound, "Entity Not Found", orionldState.wildcard[0]);
+    orionldState.httpStatusCode = 404;
+    return false;
+  }
+
+  kjTemporalEntityCompact(entityP);
 
-  orionldErrorResponseCreate(OrionldOperationNotSupported, "Not Implemented in Orion-LD, please use Mintaka for this operation", orionldState.serviceP->url);
-  return false;
+  orionldState.responseTree = entityP;
+  return true;
 }
@@ -23,8 +23,9 @@
 * Author: Ken Zangelin
 */
 #include <string.h>                                              // strlen
-#include <sys/uio.h>                                             // writev
-#include <sys/select.h>                                          // select
+#include <sys/uio.h>                                             // struct iovec
+#include <sys/time.h>                                            // gettimeofday
+#include <unistd.h>                                              // close
 
 extern "C"
 {
@@ -32,6 +33,7 @@ extern "C"
 #include "kjson/kjRender.h"                                      // kjFastRender
 #include "kjson/kjBuilder.h"                                     // kjObject, kjArray, kjString, kjChildAdd, ...
 #include "kalloc/kaAlloc.h"                                      // kaAlloc
+#include "kalloc/kaStrdup.h"                                     // kaStrdup
 }
 
 #include "logMsg/logMsg.h"
@@ -40,15 +42,20 @@ extern "C"
 #include "orionld/common/orionldState.h"                         // orionldState, coreContextUrl
 #include "orionld/common/numberToDate.h"                         // numberToDate
 #include "orionld/common/uuidGenerate.h"                         // uuidGenerate
-#include "orionld/common/orionldServerConnect.h"                 // orionldServerConnect
 #include "orionld/context/orionldCoreContext.h"                  // orionldCoreContextP
+#include "orionld/notifications/orionldNotificationSend.h"           // orionldNotificationSend
+#include "orionld/notifications/orionldNotificationResponseAwait.h"  // orionldNotificationResponseAwait, ORIONLD_NOTIFICATION_TIMEOUT
+#include "orionld/notifications/orionldNotificationQueue.h"          // orionldNotificationEnqueue
 #include "orionld/serviceRoutines/orionldNotify.h"               // Own interface
 
 
 
 // -----------------------------------------------------------------------------
 //
-// ipPortAndRest - extract ip, port and URL-PATH from a 'reference' string
+// ipPortAndRest - extract host, port and URL-PATH from a 'reference' string
+//
+// The host is copied (to orionldState.kalloc), as the reference string is not modified
+// and the host must outlive the notification (it is needed to give back the connection).
 //
 // FIXME
 //   This function is generic and should be moved to its own module in orionld/common
@@ -56,69 +63,51 @@ extern "C"
 //
 static void ipPortAndRest(char* ipport, char** ipP, unsigned short* portP, char** restP)
 {
-  char*            colon;
   char*            ip;
+  char*            slash;
+  char*            hostEnd;
+  char*            colon;
   unsigned short   portNo  = 80;  // What should be the default port?
-  char*            rest;
+  int              ipLen;
 
   //
   // Starts with http:// ...
   //
   ip = strchr(ipport, '/');
   ip += 2;
-  rest = ip;
 
-  colon = strchr(ip, ':');
+  slash   = strchr(ip, '/');
+  hostEnd = (slash != NULL)? slash : &ip[strlen(ip)];
+  colon   = (char*) memchr(ip, ':', hostEnd - ip);
+
   if (colon != NULL)
   {
-    *colon = 0;
+    ipLen  = colon - ip;
     portNo = atoi(&colon[1]);
-    rest = &colon[1];
   }
+  else
+    ipLen = hostEnd - ip;
 
-  *ipP   = ip;
-  *portP = portNo;
+  *ipP = kaAlloc(&orionldState.kalloc, ipLen + 1);
+  strncpy(*ipP, ip, ipLen);
+  (*ipP)[ipLen] = 0;
 
-  rest = strchr(rest, '/');
-  *restP = rest;
+  *portP = portNo;
+  *restP = (slash != NULL)? slash : (char*) "/";
 }
 
 
 
 // -----------------------------------------------------------------------------
 //
-// responseTreat -
+// msNow -
 //
-static void responseTreat(OrionldNotificationInfo* niP, char* buf, int bufLen)
+static long msNow(void)
 {
-  int    nb             = read(niP->fd, buf, bufLen);
-  char*  firstLine      = NULL;
-  char*  endOfFirstLine = NULL;
-
-  if (nb == -1)
-  {
-    LM_E(("Internal Error (error reading from notification endpoint: %s)", strerror(errno)));
-    return;
-  }
+  struct timeval tv;
 
-  //
-  //
-  //
-  firstLine      = buf;
-  endOfFirstLine = strchr(firstLine, '\n');
-
-  if (endOfFirstLine == NULL)
-  {
-    LM_E(("Internal Error (unable to find end of first line from notification endpoint: %s)", strerror(errno)));
-    return;
-  }
-
-  *endOfFirstLine = 0;
-
-  //
-  // FIXME: Read the rest of the message, using select
-  //
-  niP->allOK = true;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
 }
 
 
@@ -135,23 +124,28 @@ static void responseTreat(OrionldNotificationInfo* niP, char* buf, int bufLen)
 //
 // All attribute names and the entity type are assumed to be already aliased according to the context
 //
+// If there are notification sender threads (-notifWorkers), the rendered notifications are just queued
+// and this function returns without waiting for any receiver.
+//
+// Else, the notifications are sent from this thread, over keep-alive connections from the notification connection pool.
+// All notifications are sent first, then the responses are read - a connection is only given back
+// to the pool once its entire response has been read, and only if the receiver agreed to keep it open.
+//
 void orionldNotify(void)
 {
   //
   // Preparing the HTTP headers which will be pretty much the same for all notifications
   // What differs is Content-Length, Content-Type, and the Request header
   //
-  char  requestHeader[128];
+  char  requestHeader[256];
   char  contentLenHeader[32];
+  char  linkHeader[512];
   char* lenP                    = &contentLenHeader[16];
   char* contentTypeHeaderJson   = (char*) "Content-Type: application/json\r\n";
   char* contentTypeHeaderJsonLd = (char*) "Content-Type: application/ld+json\r\n";
   char* userAgentHeader         = (char*) "User-Agent: orionld\r\n\r\n";  // Double newline - must be the last HTTP header
-  int   payloadLen              = 10000;
-  char* payload                 = (char*) malloc(payloadLen + 1);
-
-  if (payload == NULL)
-    LM_X(1, ("Unable to allocate room for notification!"));
+  int   payloadSize             = 0;     // Allocated size of 'payload'
+  char* payload                 = NULL;  // Rendering buffer, reused for all notifications, grown (in orionldState.kalloc) when too small
 
   strcpy(contentLenHeader, "Content-Length: 0");  // Can't modify inside static strings, so need a char-vec on the stack for contentLenHeader
 
@@ -163,8 +157,8 @@ void orionldNotify(void)
   // };
   //
   int           contentLength;
-  struct iovec  ioVec[6]        = { { requestHeader, 0 }, { contentLenHeader, 0 }, { contentTypeHeaderJson, 32 }, { userAgentHeader, 23 }, { payload, 0 } };
-  int           ioVecLen        = 5;
+  struct iovec  ioVec[6];
+  int           ioVecLen;
   char          requestTimeV[64];
 
   if (numberToDate(orionldState.requestTime, requestTimeV, sizeof(requestTimeV)) == false)
@@ -176,32 +170,35 @@ void orionldNotify(void)
   for (int ix = 0; ix < orionldState.notificationRecords; ix++)
   {
     OrionldNotificationInfo*  niP = &orionldState.notificationInfo[ix];
-    char*                     ip;
-    unsigned short            port;
     char*                     rest;
     KjNode*                   notificationTree;
     char                      notificationId[80];
 
+    niP->fd        = -1;
+    niP->connected = false;
+    niP->allOK     = false;
+
     notificationTree = kjObject(orionldState.kjsonP, NULL);
 
     strncpy(notificationId, "urn:ngsi-ld:Notification:", sizeof(notificationId));
     uuidGenerate(&notificationId[25], sizeof(notificationId) - 25, false);
 
-    ipPortAndRest(niP->reference, &ip, &port, &rest);
-    snprintf(requestHeader, sizeof(requestHeader), "POST %s HTTP/1.1\r\n", rest);
+    ipPortAndRest(niP->reference, &niP->host, &niP->port, &rest);
+    snprintf(requestHeader, sizeof(requestHeader), "POST %s HTTP/1.1\r\nHost: %s:%d\r\n", rest, niP->host, niP->port);
+
+    //
+    // The ioVec is set up for each notification, as the headers differ with the mime type
+    //
+    ioVec[0].iov_base = requestHeader;
+    ioVec[1].iov_base = contentLenHeader;
 
     if (niP->mimeType == JSONLD)
     {
-      //
-      // For better tput, I could maintain not one ioVec but TWO.
-      // One for "application/json" and another one for "application/ld+json"
-      //
-
-      //
-      // Overwrite contentTypeHeaderJson in ioVec[2]
-      //
       ioVec[2].iov_base = contentTypeHeaderJsonLd;
       ioVec[2].iov_len  = 35;
+      ioVec[3].iov_base = userAgentHeader;
+      ioVec[3].iov_len  = 23;
+      ioVecLen          = 5;
 
       // Add @context to payload
       if ((orionldState.contextP == NULL) || (orionldState.contextP == orionldCoreContextP))
@@ -217,22 +214,17 @@ void orionldNotify(void)
     }
     else
     {
-      //
-      // Add Link HTTP header
-      //
-      ioVecLen = 6;
-
-      // Move down PAYLOAD
-      ioVec[5].iov_base = ioVec[4].iov_base;
-      ioVec[5].iov_len  = ioVec[4].iov_len;
-
-      // Move down userAgentHeader - must be the last as it contains the double \r\n
-      ioVec[4].iov_base = ioVec[3].iov_base;
-      ioVec[4].iov_len  = ioVec[3].iov_len;
-
-      // Now ioVec[3] is free for the Link header
-      ioVec[3].iov_base = orionldState.contextP->url;
-      ioVec[3].iov_len  = strlen(orionldState.contextP->url);
+      const char* contextUrl = ((orionldState.contextP != NULL) && (orionldState.contextP->url != NULL))? orionldState.contextP->url : coreContextUrl;
+
+      snprintf(linkHeader, sizeof(linkHeader), "Link: <%s>; rel=\"http://www.w3.org/ns/json-ld#context\"; type=\"application/ld+json\"\r\n", contextUrl);
+
+      ioVec[2].iov_base = contentTypeHeaderJson;
+      ioVec[2].iov_len  = 32;
+      ioVec[3].iov_base = linkHeader;
+      ioVec[3].iov_len  = strlen(linkHeader);
+      ioVec[4].iov_base = userAgentHeader;  // Must be the last header as it contains the double \r\n
+      ioVec[4].iov_len  = 23;
+      ioVecLen          = 6;
     }
 
     //
@@ -261,112 +253,75 @@ void orionldNotify(void)
     kjChildAdd(notificationTree, dataNodeP);
     kjChildAdd(dataNodeP, niP->attrsForNotification);
 
+    //
+    // The payload buffer is only allocated when the notification doesn't fit in the current one.
+    // A bigger buffer is allocated from orionldState.kalloc - the old one is freed with the rest of the
+    // request's kalloc buffer, at the end of the request
+    //
     int renderedSize = kjFastRenderSize(notificationTree);
 
-    if (renderedSize > payloadLen)
+    if (renderedSize + 1 > payloadSize)
     {
-      LM_W(("No Room in the notification buffer"));
-      strncpy(payload, "{\"error\": \"Implementation problem in Orion-LD - the notification buffer size needs a smarter allocation algorithm\"}", payloadLen);
+      payloadSize = renderedSize + 1;
+      payload     = kaAlloc(&orionldState.kalloc, payloadSize);
+
+      if (payload == NULL)
+      {
+        LM_E(("Out of memory allocating %d bytes for the notification of subscription '%s'", payloadSize, niP->subscriptionId));
+        payloadSize = 0;
+        continue;
+      }
     }
-    else
-      kjFastRender(notificationTree, payload);
+
+    kjFastRender(notificationTree, payload);
 
     int sizeLeftForLen = 16;  // sizeof(contentLenHeader) - 16
     contentLength = strlen(payload);
     snprintf(lenP, sizeLeftForLen, "%d\r\n", contentLength);  // Writing Content-Length inside contentLenHeader
 
-    ioVec[0].iov_len = strlen(requestHeader);
-    ioVec[1].iov_len = strlen(contentLenHeader);
-    ioVec[4].iov_len = contentLength;
+    ioVec[0].iov_len             = strlen(requestHeader);
+    ioVec[1].iov_len             = strlen(contentLenHeader);
+    ioVec[ioVecLen - 1].iov_base = payload;  // The payload buffer may have been reallocated - can't be set before rendering
+    ioVec[ioVecLen - 1].iov_len  = contentLength;
 
     //
-    // Data ready to send
+    // Data ready to send - or to queue, for a sender thread
     //
-    niP->fd = orionldServerConnect(ip, port);
-
-    if (niP->fd == -1)
+    if (notifWorkers > 0)
     {
-      niP->connected = false;
-      LM_E(("Internal Error (unable to connent to server for notification for subscription '%s': %s)", niP->subscriptionId, strerror(errno)));
+      orionldNotificationEnqueue(niP->subscriptionId, niP->host, niP->port, ioVec, ioVecLen);
       continue;
     }
 
-    niP->connected = true;
+    niP->fd = orionldNotificationSend(niP->host, niP->port, ioVec, ioVecLen);
 
-    if (writev(niP->fd, ioVec, ioVecLen) == -1)
+    if (niP->fd == -1)
     {
-      close(niP->fd);
-
-      niP->fd        = -1;
-      niP->connected = false;
-
-      LM_E(("Internal Error (unable to send to server for notification for subscription '%s'): %s", niP->subscriptionId, strerror(errno)));
+      LM_E(("Internal Error (unable to send notification for subscription '%s' to %s:%d)", niP->subscriptionId, niP->host, niP->port));
       continue;
     }
+
+    niP->connected = true;
   }
 
   //
   // Receive responses
   //
-  int             fds;
-  fd_set          rFds;
-  int             fdMax      = 0;
-  int             startTime  = time(NULL);
-  struct timeval  tv         = { 1, 0 };
-
-  while (1)
-  {
-    //
-    // Set File Descriptors for the select
-    //
-    FD_ZERO(&rFds);
-    for (int ix = 0; ix < orionldState.notificationRecords; ix++)
-    {
-      OrionldNotificationInfo*  niP = &orionldState.notificationInfo[ix];
-
-      if ((niP->fd != -1) && (niP->connected == true))
-      {
-        FD_SET(niP->fd, &rFds);
-        fdMax = MAX(fdMax, niP->fd);
-      }
-
-      niP->allOK = false;  // Set to 'true' once the response of the notification is received
-    }
-
-    fds = select(1, &rFds, NULL, NULL, &tv);
-    if ((fds == -1) && (errno != EINTR))
-      LM_X(1, ("select error: %s\n", strerror(errno)));
-    else if (fds > 0)
-    {
-      for (int ix = 0; ix < orionldState.notificationRecords; ix++)
-      {
-        OrionldNotificationInfo*  niP = &orionldState.notificationInfo[ix];
-
-        if (FD_ISSET(niP->fd, &rFds))
-          responseTreat(niP, payload, payloadLen);  // We reuse the allocated buffer 'payload'
-      }
-    }
-
-    //
-    // Timeout after 10 seconds
-    //
-    // FIXME: calling time() might be avoided by inspecting 'tv'
-    //
-    if (time(NULL) > startTime + 10)
-      break;
-  }
-
-  free(payload);
-
-  //
-  // Close file descriptors and set lastFailure/lastSuccess
+  // All notifications have been sent already, so the receivers are working in parallel and the
+  // responses can be read one by one. The timeout is for all responses together.
   //
+  long deadline = msNow() + ORIONLD_NOTIFICATION_TIMEOUT;
+
   for (int ix = 0; ix < orionldState.notificationRecords; ix++)
   {
     OrionldNotificationInfo*  niP = &orionldState.notificationInfo[ix];
 
-    if (niP->fd != -1)
-      close(niP->fd);
+    if (niP->connected == false)
+      continue;
+
+    niP->allOK     = orionldNotificationResponseAwait(niP->subscriptionId, niP->host, niP->port, niP->fd, deadline - msNow());
+    niP->fd        = -1;
+    niP->connected = false;
 
 #if 0
     if (niP->allOK == true)
@@ -28,13 +28,14 @@ extern "C"
 #include "kjson/KjNode.h"                                        // KjNode
 #include "kjson/kjLookup.h"                                      // kjLookup
 #include "kjson/kjBuilder.h"                                     // kjChildRemove
+#include "kjson/kjClone.h"                                       // kjClone
 }
 
 #include "logMsg/logMsg.h"                                       // LM_*
 #include "logMsg/traceLevels.h"                                  // Lmt*
 
 #include "rest/ConnectionInfo.h"                                 // ConnectionInfo
-#include "mongoBackend/mongoUpdateContext.h"                     // mongoUpdateContext
+#include "mongoBackend/mongoUpdateContext.h"                     // mongoUpdateContext, mongoPatchEntity
 
 #include "orionld/common/orionldErrorResponse.h"                 // orionldErrorResponseCreate
 #include "orionld/common/orionldState.h"                         // orionldState
@@ -46,6 +47,7 @@ extern "C"
 #include "orionld/common/attributeNotUpdated.h"                  // attributeNotUpdated
 #include "orionld/payloadCheck/pcheckUri.h"                      // pcheckUri
 #include "orionld/context/orionldAttributeExpand.h"              // orionldAttributeExpand
+#include "orionld/context/orionldContextItemAliasLookup.h"       // orionldContextItemAliasLookup
 #include "orionld/kjTree/kjTreeToContextAttribute.h"             // kjTreeToContextAttribute
 #include "orionld/kjTree/kjStringValueLookupInArray.h"           // kjStringValueLookupInArray
 #include "orionld/serviceRoutines/orionldPatchEntity.h"          // Own Interface
@@ -155,6 +157,11 @@ bool attributeCheck(ConnectionInfo* ciP, KjNode* attrNodeP, char** titleP, char*
 //   Attribute includes a datasetId, only an Attribute instance with the same datasetId is replaced.
 //   In all other cases, the Attribute shall be ignored.
 //
+// In the usual case (the entity exists and has all the attributes of the payload), the attributes are updated with
+// a single database operation (mongoPatchEntity), that also gives mongoBackend the entity as it was before the
+// update, for the notifications.
+// Only if that fails, the entity is looked up, to find out which attributes don't exist, and then REPLACED.
+//
 bool orionldPatchEntity(ConnectionInfo* ciP)
 {
   char* entityId   = orionldState.wildcard[0];
@@ -171,68 +178,19 @@ bool orionldPatchEntity(ConnectionInfo* ciP)
   // 2. Is the payload not a JSON object?
   OBJECT_CHECK(orionldState.requestTree, kjValueType(orionldState.requestTree->type));
 
-  // 3. Get the entity from mongo
-  KjNode* dbEntityP;
-  if ((dbEntityP = dbEntityLookup(entityId)) == NULL)
-  {
-    orionldState.httpStatusCode = 404;  // Not Found
-    orionldErrorResponseCreate(OrionldResourceNotFound, "Entity does not exist", entityId);
-    return false;
-  }
-
-  // 3. Get the Entity Type, needed later in the call to the constructor of ContextElement
-  KjNode* idNodeP = kjLookup(dbEntityP, "_id");
-
-  if (idNodeP == NULL)
-  {
-    orionldState.httpStatusCode = 500;
-    orionldErrorResponseCreate(OrionldInternalError, "Corrupt Database", "'_id' field of entity from DB not found");
-    return false;
-  }
-
-  KjNode*     entityTypeNodeP = kjLookup(idNodeP, "type");
-  const char* entityType      = (entityTypeNodeP != NULL)? entityTypeNodeP->value.s : NULL;
-
-  if (entityTypeNodeP == NULL)
-  {
-    orionldState.httpStatusCode = 500;
-    orionldErrorResponseCreate(OrionldInternalError, "Corrupt Database", "'_id::type' field of entity from DB not found");
-    return false;
-  }
-
-  // 4. Get the 'attrNames' array from the mongo entity - to see whether an attribute already existed or not
-  KjNode* inDbAttrNamesP = kjLookup(dbEntityP, "attrNames");
-  if (inDbAttrNamesP == NULL)
-  {
-    orionldState.httpStatusCode = 500;
-    orionldErrorResponseCreate(OrionldInternalError, "Corrupt Database", "'attrNames' field of entity from DB not found");
-    return false;
-  }
-
-  // 4. Also, get the "attrs" object for insertion of modified attributes
-  KjNode* inDbAttrsP = kjLookup(dbEntityP, "attrs");
-  if (inDbAttrsP == NULL)
-  {
-    orionldState.httpStatusCode = 500;
-    orionldErrorResponseCreate(OrionldInternalError, "Corrupt Database", "'attrs' field of entity from DB not found");
-    return false;
-  }
-
   //
-  // 5. Loop over the incoming payload data
-  //    Those attrs that don't exist in the DB (dbEntityP) are discarded and added to the 'notUpdated' array
-  //    Those that do exist in dbEntityP are removed from dbEntityP and replaced with the corresponding attribute from the incoming payload data.
-  //    (finally the modified dbEntityP will REPLACE what is currently in the database)
+  // 3. Loop over the incoming payload data
+  //    Those attrs that can't be updated are removed from the payload (which is what TRoE records) and added to the 'notUpdated' array
   //
   KjNode* newAttrP     = orionldState.requestTree->value.firstChildP;
   KjNode* next;
   KjNode* updatedP     = kjArray(orionldState.kjsonP, "updated");
   KjNode* notUpdatedP  = kjArray(orionldState.kjsonP, "notUpdated");
   int     newAttrs     = 0;
+  bool    geoProperty  = false;
 
   while (newAttrP != NULL)
   {
-    KjNode*  dbAttrP;
     char*    title;
     char*    detail;
     char*    shortName = newAttrP->name;
@@ -242,18 +200,21 @@ bool orionldPatchEntity(ConnectionInfo* ciP)
     if ((strcmp(newAttrP->name, "createdAt") == 0) || (strcmp(newAttrP->name, "modifiedAt") == 0))
     {
       attributeNotUpdated(notUpdatedP, shortName, "built-in timestamps are ignored");
+      kjChildRemove(orionldState.requestTree, newAttrP);
       newAttrP = next;
       continue;
     }
     else if ((strcmp(newAttrP->name, "id") == 0) || (strcmp(newAttrP->name, "@id") == 0))
     {
       attributeNotUpdated(notUpdatedP, shortName, "the ID of an entity cannot be altered");
+      kjChildRemove(orionldState.requestTree, newAttrP);
       newAttrP = next;
       continue;
     }
     else if ((strcmp(newAttrP->name, "type") == 0) || (strcmp(newAttrP->name, "@type") == 0))
     {
       attributeNotUpdated(notUpdatedP, shortName, "the TYPE of an entity cannot be altered");
+      kjChildRemove(orionldState.requestTree, newAttrP);
       newAttrP = next;
       continue;
     }
@@ -265,76 +226,211 @@ bool orionldPatchEntity(ConnectionInfo* ciP)
     {
       LM_E(("attributeCheck: %s: %s", title, detail));
       attributeNotUpdated(notUpdatedP, shortName, detail);
+      kjChildRemove(orionldState.requestTree, newAttrP);
       newAttrP = next;
       continue;
     }
 
-    char* eqName = kaStrdup(&orionldState.kalloc, newAttrP->name);
-    dotForEq(eqName);
-
-    dbAttrP = kjLookup(inDbAttrsP, eqName);
-    if (dbAttrP == NULL)  // Doesn't already exist - must be discarded
-    {
-      attributeNotUpdated(notUpdatedP, shortName, "attribute doesn't exist");
-      newAttrP = next;
-      continue;
-    }
-
-    // Steal createdAt from dbAttrP?
-
-    // Remove the attribute to be updated (from dbEntityP::inDbAttrsP) and insert the attribute from the payload data
-    kjChildRemove(inDbAttrsP, dbAttrP);
-    kjChildAdd(inDbAttrsP, newAttrP);
-    attributeUpdated(updatedP, shortName);
+    KjNode* typeP = kjLookup(newAttrP, "type");
+    if (strcmp(typeP->value.s, "GeoProperty") == 0)
+      geoProperty = true;
 
     ++newAttrs;
     newAttrP = next;
   }
 
-  if (newAttrs > 0)
+  //
+  // 4. Update all the attributes in a single database operation - not for GeoProperties, as they may affect the location of the entity
+  //
+  bool patched = false;
+
+  if ((newAttrs > 0) && (geoProperty == false))
   {
-    // 6. Convert the resulting tree (dbEntityP) to a ContextElement
     UpdateContextRequest ucRequest;
-    ContextElement*      ceP = new ContextElement(entityId, entityType, "false");
+    ContextElement*      ceP = new ContextElement(entityId, "", "false");
 
     ucRequest.contextElementVector.push_back(ceP);
 
-    for (KjNode* attrP = inDbAttrsP->value.firstChildP; attrP != NULL; attrP = attrP->next)
+    //
+    // kjTreeToContextAttribute modifies the tree it converts - a copy is converted, so that the payload
+    // is intact for the REPLACE in case the single database operation isn't possible
+    //
+    newAttrP = orionldState.requestTree->value.firstChildP;
+    while (newAttrP != NULL)
     {
       ContextAttribute* caP = new ContextAttribute();
 
-      eqForDot(attrP->name);
+      next = newAttrP->next;
 
-      if (kjTreeToContextAttribute(orionldState.contextP, attrP, caP, NULL, &detail) == false)
+      if (kjTreeToContextAttribute(orionldState.contextP, kjClone(orionldState.kjsonP, newAttrP), caP, NULL, &detail) == false)
       {
         LM_E(("kjTreeToContextAttribute: %s", detail));
-        attributeNotUpdated(notUpdatedP, attrP->name, "Error");
+        attributeNotUpdated(notUpdatedP, orionldContextItemAliasLookup(orionldState.contextP, newAttrP->name, NULL, NULL), "Error");
+        kjChildRemove(orionldState.requestTree, newAttrP);
+        --newAttrs;
         delete caP;
       }
       else
         ceP->contextAttributeVector.push_back(caP);
-    }
-    ucRequest.updateActionType = ActionTypeReplace;
 
+      newAttrP = next;
+    }
 
-    // 8. Call mongoBackend to do the REPLACE of the entity
-    UpdateContextResponse  ucResponse;
+    if (newAttrs > 0)
+    {
+      UpdateContextResponse  ucResponse;
 
-    orionldState.httpStatusCode = mongoUpdateContext(&ucRequest,
+      orionldState.httpStatusCode = mongoPatchEntity(&ucRequest,
                                                      &ucResponse,
                                                      orionldState.tenantP,
                                                      ciP->servicePathV,
                                                      ciP->uriParam,
                                                      ciP->httpHeaders.xauthToken.c_str(),
                                                      ciP->httpHeaders.correlator.c_str(),
-                                                     ciP->httpHeaders.ngsiv2AttrsFormat.c_str(),
                                                      ciP->apiVersion,
-                                                     NGSIV2_NO_FLAVOUR);
+                                                     &patched);
+
+      if (orionldState.httpStatusCode != 200)
+      {
+        LM_E(("mongoPatchEntity: HTTP Status Code: %d", orionldState.httpStatusCode));
+        orionldErrorResponseCreate(OrionldBadRequestData, "Internal Error", "Error from Mongo-DB backend");
+        ucRequest.release();
+        return false;
+      }
+    }
+    else
+      orionldState.httpStatusCode = 200;  // kjTreeToContextAttribute may have set an error code - the failed attributes are in 'notUpdated'
 
     ucRequest.release();
+
+    if (patched == true)
+    {
+      for (KjNode* attrP = orionldState.requestTree->value.firstChildP; attrP != NULL; attrP = attrP->next)
+      {
+        attributeUpdated(updatedP, orionldContextItemAliasLookup(orionldState.contextP, attrP->name, NULL, NULL));
+      }
+    }
+  }
+
+  if (patched == false)
+  {
+    // 5. Get the entity from mongo
+    KjNode* dbEntityP;
+    if ((dbEntityP = dbEntityLookup(entityId)) == NULL)
+    {
+      orionldState.httpStatusCode = 404;  // Not Found
+      orionldErrorResponseCreate(OrionldResourceNotFound, "Entity does not exist", entityId);
+      return false;
+    }
+
+    // 6. Get the Entity Type, needed later in the call to the constructor of ContextElement
+    KjNode* idNodeP = kjLookup(dbEntityP, "_id");
+
+    if (idNodeP == NULL)
+    {
+      orionldState.httpStatusCode = 500;
+      orionldErrorResponseCreate(OrionldInternalError, "Corrupt Database", "'_id' field of entity from DB not found");
+      return false;
+    }
+
+    KjNode*     entityTypeNodeP = kjLookup(idNodeP, "type");
+    const char* entityType      = (entityTypeNodeP != NULL)? entityTypeNodeP->value.s : NULL;
+
+    if (entityTypeNodeP == NULL)
+    {
+      orionldState.httpStatusCode = 500;
+      orionldErrorResponseCreate(OrionldInternalError, "Corrupt Database", "'_id::type' field of entity from DB not found");
+      return false;
+    }
+
+    // 7. Get the "attrs" object for insertion of modified attributes
+    KjNode* inDbAttrsP = kjLookup(dbEntityP, "attrs");
+    if (inDbAttrsP == NULL)
+    {
+      orionldState.httpStatusCode = 500;
+      orionldErrorResponseCreate(OrionldInternalError, "Corrupt Database", "'attrs' field of entity from DB not found");
+      return false;
+    }
+
+    //
+    // 8. Loop over the remaining attributes of the incoming payload data
+    //    Those attrs that don't exist in the DB (dbEntityP) are discarded and added to the 'notUpdated' array
+    //    Those that do exist in dbEntityP are replaced in dbEntityP with a copy of the corresponding attribute from the incoming payload data.
+    //    (finally the modified dbEntityP will REPLACE what is currently in the database)
+    //
+    newAttrs = 0;
+    newAttrP = orionldState.requestTree->value.firstChildP;
+    while (newAttrP != NULL)
+    {
+      const char* shortName = orionldContextItemAliasLookup(orionldState.contextP, newAttrP->name, NULL, NULL);
+      char*       eqName    = kaStrdup(&orionldState.kalloc, newAttrP->name);
+
+      next = newAttrP->next;
+      dotForEq(eqName);
+
+      KjNode* dbAttrP = kjLookup(inDbAttrsP, eqName);
+      if (dbAttrP == NULL)  // Doesn't already exist - must be discarded
+      {
+        attributeNotUpdated(notUpdatedP, shortName, "attribute doesn't exist");
+        kjChildRemove(orionldState.requestTree, newAttrP);
+        newAttrP = next;
+        continue;
+      }
+
+      // Remove the attribute to be updated (from dbEntityP::inDbAttrsP) and insert a copy of the attribute from the payload data
+      kjChildRemove(inDbAttrsP, dbAttrP);
+      kjChildAdd(inDbAttrsP, kjClone(orionldState.kjsonP, newAttrP));
+      attributeUpdated(updatedP, shortName);
+
+      ++newAttrs;
+      newAttrP = next;
+    }
+
+    if (newAttrs > 0)
+    {
+      // 9. Convert the resulting tree (dbEntityP) to a ContextElement
+      UpdateContextRequest ucRequest;
+      ContextElement*      ceP = new ContextElement(entityId, entityType, "false");
+
+      ucRequest.contextElementVector.push_back(ceP);
+
+      for (KjNode* attrP = inDbAttrsP->value.firstChildP; attrP != NULL; attrP = attrP->next)
+      {
+        ContextAttribute* caP = new ContextAttribute();
+
+        eqForDot(attrP->name);
+
+        if (kjTreeToContextAttribute(orionldState.contextP, attrP, caP, NULL, &detail) == false)
+        {
+          LM_E(("kjTreeToContextAttribute: %s", detail));
+          attributeNotUpdated(notUpdatedP, attrP->name, "Error");
+          delete caP;
+        }
+        else
+          ceP->contextAttributeVector.push_back(caP);
+      }
+      ucRequest.updateActionType = ActionTypeReplace;
+
+
+      // 10. Call mongoBackend to do the REPLACE of the entity
+      UpdateContextResponse  ucResponse;
+
+      orionldState.httpStatusCode = mongoUpdateContext(&ucRequest,
+                                                       &ucResponse,
+                                                       orionldState.tenantP,
+                                                       ciP->servicePathV,
+                                                       ciP->uriParam,
+                                                       ciP->httpHeaders.xauthToken.c_str(),
+                                                       ciP->httpHeaders.correlator.c_str(),
+                                                       ciP->httpHeaders.ngsiv2AttrsFormat.c_str(),
+                                                       ciP->apiVersion,
+                                                       NGSIV2_NO_FLAVOUR);
+
+      ucRequest.release();
+    }
   }
 
-  // 9. Postprocess output from mongoBackend
+  // 11. Postprocess output from mongoBackend
   if (orionldState.httpStatusCode == 200)
   {
     //
@@ -43,6 +43,7 @@ extern "C"
 #include "orionld/common/entityErrorPush.h"                    // entityErrorPush
 #include "orionld/db/dbConfiguration.h"                        // dbEntitiesDelete, dbEntityListLookupWithIdTypeCreDate
 #include "orionld/payloadCheck/pcheckUri.h"                    // pcheckUri
+#include "mongoBackend/mongoEntityTypeCatalog.h"               // mongoEntityTypeCatalogEntitiesRemoved
 #include "orionld/serviceRoutines/orionldPostBatchDelete.h"    // Own interface
 
 
@@ -178,6 +179,8 @@ bool orionldPostBatchDelete(ConnectionInfo* ciP)
     return false;
   }
 
+  mongoEntityTypeCatalogEntitiesRemoved(orionldState.tenantP, orionldState.requestTree, dbEntities);
+
   if (errors->value.firstChildP == NULL)
   {
     orionldState.responseTree   = NULL;
@@ -71,6 +71,7 @@ extern "C"
 #include "orionld/kjTree/kjTreeToUpdateContextRequest.h"       // kjTreeToUpdateContextRequest
 #include "orionld/kjTree/kjEntityIdArrayExtract.h"             // kjEntityIdArrayExtract
 #include "orionld/kjTree/kjEntityArrayErrorPurge.h"            // kjEntityArrayErrorPurge
+#include "mongoBackend/mongoEntityTypeCatalog.h"               // mongoEntityTypeCatalogEntitiesRemoved
 #include "orionld/serviceRoutines/orionldPostBatchUpsert.h"    // Own Interface
 
 
@@ -339,7 +340,10 @@ bool orionldPostBatchUpsert(ConnectionInfo* ciP)
   if (orionldState.uriParamOptions.update == false)
   {
     if ((removeArray != NULL) && (removeArray->value.firstChildP != NULL))
-      dbEntitiesDelete(removeArray);
+    {
+      if (dbEntitiesDelete(removeArray) == true)
+        mongoEntityTypeCatalogEntitiesRemoved(orionldState.tenantP, removeArray, idTypeAndCreDateFromDb);
+    }
   }
 
 
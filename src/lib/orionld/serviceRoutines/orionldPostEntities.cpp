@@ -391,9 +391,7 @@ bool orionldPostEntities(ConnectionInfo* ciP)
   if (datasets->value.firstChildP != NULL)  // Not Empty
     orionldState.datasets = datasets;
 
-#ifdef REQUEST_PERFORMANCE
-  kTimeGet(&timestamps.dbStart);
-#endif
+  PERFORMANCE(dbStart);
 
   orionldState.httpStatusCode = mongoUpdateContext(&mongoRequest,
                                                    &mongoResponse,
@@ -406,9 +404,7 @@ bool orionldPostEntities(ConnectionInfo* ciP)
                                                    ciP->apiVersion,
                                                    NGSIV2_NO_FLAVOUR);
 
-#ifdef REQUEST_PERFORMANCE
-  kTimeGet(&timestamps.dbEnd);
-#endif
+  PERFORMANCE(dbEnd);
   mongoRequest.release();
   mongoResponse.release();
 
@@ -46,6 +46,7 @@ extern "C"
 #include "ngsi10/UpdateContextRequest.h"                         // UpdateContextRequest
 #include "ngsi10/UpdateContextResponse.h"                        // UpdateContextResponse
 #include "mongoBackend/mongoUpdateContext.h"                     // mongoUpdateContext
+#include "mongoBackend/mongoEntityTypeCatalog.h"                 // mongoEntityTypeCatalogAttrsInvalidate
 
 #include "orionld/common/CHECK.h"                                // CHECK
 #include "orionld/common/SCOMPARE.h"                             // SCOMPAREx
@@ -460,8 +461,14 @@ bool orionldPostEntity(ConnectionInfo* ciP)
     ucr.updateActionType = ActionTypeAppend;
 
     if (attrNameIx > 0)
+    {
       dbEntityAttributesDelete(entityId, attrNameV, attrsInPayload);
 
+      KjNode* dbIdP   = kjLookup(dbEntityP, "_id");
+      KjNode* dbTypeP = (dbIdP != NULL)? kjLookup(dbIdP, "type") : NULL;
+      mongoEntityTypeCatalogAttrsInvalidate(orionldState.tenantP, (dbTypeP != NULL)? dbTypeP->value.s : NULL);
+    }
+
     status = mongoUpdateContext(&ucr,
                                 &ucResponse,
                                 orionldState.tenantP,
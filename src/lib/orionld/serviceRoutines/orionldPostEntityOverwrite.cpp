@@ -586,11 +586,14 @@ static bool subscriptionMatchCallback
 
 
   //
-  // Is there room in the notificationInfo vector?
+  // Get a new item in the notificationInfo vector
   //
 
   // FIXME semTake for orionldState.notificationInfo/notificationRecords
-  if ((unsigned int) orionldState.notificationRecords >= K_VEC_SIZE(orionldState.notificationInfo))
+  OrionldNotificationInfo*  niP = orionldNotificationInfoAdd();
+  // FIXME semGive for orionldState.notificationInfo/notificationRecords
+
+  if (niP == NULL)
   {
     LM_W(("SUB: No room in orionldState.notificationInfo - notification dropped"));
     return false;
@@ -601,11 +604,6 @@ static bool subscriptionMatchCallback
   // Creating the attribute list that the Notification will be based on
   //
 
-  OrionldNotificationInfo*  niP = &orionldState.notificationInfo[orionldState.notificationRecords];
-
-  orionldState.notificationRecords += 1;  // For next callback - FIXME: will need a semaphore for this
-  // FIXME semGive for orionldState.notificationInfo/notificationRecords
-
   niP->subscriptionId       = idP->value.s;
   niP->reference            = referenceP->value.s;
   niP->attrsForNotification = NULL;  // The notification is based on this list of attributes
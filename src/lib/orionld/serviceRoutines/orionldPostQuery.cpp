@@ -316,24 +316,19 @@ bool orionldPostQuery(ConnectionInfo* ciP)
   if (pcheckQuery(orionldState.requestTree, &entitiesP, &attrsP, &qTree, &geoqP) == false)
     return false;
 
-  int      count;
-  int      limit  = orionldState.uriParams.limit;
-  int      offset = orionldState.uriParams.offset;
-  int*     countP = (orionldState.uriParams.count == true)? &count : NULL;
-  KjNode*  dbEntityArray;
-
-  if ((dbEntityArray = dbEntitiesQuery(entitiesP, attrsP, qTree, geoqP, limit, offset, countP)) == NULL)
+  int                    count;
+  int                    limit  = orionldState.uriParams.limit;
+  int                    offset = orionldState.uriParams.offset;
+  int*                   countP = (orionldState.uriParams.count == true)? &count : NULL;
+  KjNode*                dbEntityArray;
+  OrionldProblemDetails  pd;
+
+  if ((dbEntityArray = dbEntitiesQuery(&pd, entitiesP, attrsP, qTree, geoqP, limit, offset, countP, NULL)) == NULL)
   {
-    // Not an error - just "nothing found" - return an empty array
-    orionldState.responsePayload = (char*) "[]";
-    if (countP != NULL)
-    {
-      char number[16];
-
-      snprintf(number, sizeof(number), "%d", count);
-      httpHeaderAdd(ciP, "NGSILD-Results-Count", number);
-    }
-    return true;
+    // "Nothing found" is an empty array - NULL is an error (invalid q-filter or database error)
+    orionldErrorResponseCreate(pd.type, pd.title, pd.detail);
+    orionldState.httpStatusCode = (HttpStatusCode) pd.status;
+    return false;
   }
 
   //
@@ -25,6 +25,7 @@
 *
 * Author: Ken Zangelin
 */
+#include <time.h>                                               // time_t
 #include <postgresql/libpq-fe.h>                                 // PGconn
 
 
@@ -33,11 +34,16 @@
 //
 // PgConnection -
 //
+struct PgConnectionPool;
 typedef struct PgConnection
 {
-  bool    busy;          // In use or free
-  PGconn* connectionP;   // the postgres connection
-  int     uses;          // Number of times the connection has been used
+  bool                     busy;          // In use or free
+  PGconn*                  connectionP;   // the postgres connection
+  int                      uses;          // Number of times the connection has been used
+  int                      slot;          // Index in the connectionV of the pool
+  time_t                   lastUsed;      // Monotonic time (seconds) of the last release - for the health check
+  struct PgConnectionPool* poolP;         // The pool the connection belongs to
+  struct PgConnection*     next;          // Next connection in the free-list of the pool
 } PgConnection;
 
 #endif  // SRC_LIB_ORIONLD_TROE_PGCONNECTION_H_
@@ -25,24 +25,56 @@
 *
 * Author: Ken Zangelin
 */
-#include <semaphore.h>                                         // sem_t
+#include <stdint.h>                                            // uint64_t
+#include <pthread.h>                                           // pthread_mutex_t, pthread_cond_t
 
 #include "orionld/troe/PgConnection.h"                         // PgConnection
 
 
 
+// -----------------------------------------------------------------------------
+//
+// PG_POOL_WAIT_BUCKETS - number of buckets in the wait-time histogram of a pool
+//
+// The upper limits of the buckets are in pgPoolWaitBucketLimit (pgConnectionPoolStatistics.cpp).
+// The last bucket has no upper limit.
+//
+#define PG_POOL_WAIT_BUCKETS 8
+
+
+
 // -----------------------------------------------------------------------------
 //
 // PgConnectionPool -
 //
+// 'items' is the max number of connections to the database (the cap per tenant).
+// 'connections' counts the connections that are open or being opened, idle or busy.
+// Idle connections are kept in 'freeList' (LIFO, so the hottest connection is reused first).
+// 'mutex' protects all fields but 'db', 'items' and 'next', which never change once the pool
+// is inserted in the list of pools.
+// Connecting to postgres is done without the mutex, a slot is reserved by incrementing 'connections'.
+//
 typedef struct PgConnectionPool
 {
-  char*                     db;           // Name of the database
-  sem_t                     queueSem;     // Counting semaphore - size same as number of connections in the pool
-  sem_t                     poolSem;      // Binary semaphore - grants rights to modify the pool
-  int                       items;        // Number of connections in the pool
-  PgConnection**            connectionV;  // Allocated array of PgConnection pointers
-  struct PgConnectionPool*  next;         // Connection Pools are stored in a linked list
+  char*                     db;             // Name of the database
+  pthread_mutex_t           mutex;          // Protects the pool
+  pthread_cond_t            freeCond;       // Signalled when a connection is released or a slot is freed
+  int                       items;          // Max number of connections in the pool
+  int                       connections;    // Number of connections open or being opened
+  int                       waiters;        // Number of threads waiting for a connection
+  PgConnection*             freeList;       // Idle, connected connections
+  PgConnection**            connectionV;    // Allocated array of PgConnection pointers (all connections, 'items' slots)
+
+  // Statistics
+  uint64_t                  gets;           // Successful pgConnectionGet
+  uint64_t                  timeouts;       // pgConnectionGet that gave up waiting for a connection
+  uint64_t                  connects;       // Connections established
+  uint64_t                  connectErrors;  // Failed connection attempts
+  uint64_t                  checkErrors;    // Broken connections detected (at get, release or by the health check)
+  double                    waitTime;       // Accumulated time awaiting a connection (seconds)
+  uint64_t                  waitHistogram[PG_POOL_WAIT_BUCKETS];
+
+  struct PgConnectionPool*  next;           // Connection Pools are stored in a linked list
 } PgConnectionPool;
 
 #endif  // SRC_LIB_ORIONLD_TROE_PGCONNECTIONPOOL_H_
@@ -0,0 +1,56 @@
+#ifndef SRC_LIB_ORIONLD_TROE_PGTEMPORALQUERY_H_
+#define SRC_LIB_ORIONLD_TROE_PGTEMPORALQUERY_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+
+
+
+// -----------------------------------------------------------------------------
+//
+// PgTemporalQuery - a temporal query, as given by the URI parameters, ready to be pushed down to SQL
+//
+// All names (entity types and attribute names) are expanded.
+// The strings are NOT escaped - that is done when the SQL is built (pgLiteral), as libpq needs the connection for that.
+//
+typedef struct PgTemporalQuery
+{
+  const char*  timeProperty;  // "observedAt", "modifiedAt" or "createdAt"
+  const char*  timeColumn;    // Column for the time filter: "observedAt" or "ts" (timeproperty=createdAt|modifiedAt)
+  const char*  timerel;       // NULL (no time filter), "before", "after", or "between"
+  double       timeAt;        // Seconds since the epoch
+  double       endTimeAt;     // Seconds since the epoch - only for timerel=between
+  int          lastN;         // Only the last N instances of each attribute - 0: all instances
+
+  char**       idV;           // Entity IDs - NULL if no 'id' filter
+  int          ids;
+  char**       typeV;         // Entity types - NULL if no 'type' filter
+  int          types;
+  const char*  idPattern;     // POSIX regular expression for the entity ID - NULL if none
+  char**       attrV;         // Attribute names - NULL means all attributes
+  int          attrs;
+} PgTemporalQuery;
+
+#endif  // SRC_LIB_ORIONLD_TROE_PGTEMPORALQUERY_H_
@@ -50,6 +50,9 @@ void pgAppend(PgAppendBuffer* pgBufP, const char* tail, int tailLen)
 
     pgBufP->bufSize += 4 * 1024;  // Add 4k every time
 
+    while (pgBufP->currentIx + tailLen >= pgBufP->bufSize)  // A tail larger than 4k (e.g. a long URI parameter pushed down to a query)
+      pgBufP->bufSize += 4 * 1024;
+
     if (pgBufP->bufSize < 16 * 1024)  // Use kaAlloc for smaller buffers
     {
       pgBufP->buf = kaAlloc(&orionldState.kalloc, pgBufP->bufSize);
@@ -34,6 +34,7 @@
 #include "orionld/troe/pgTransactionBegin.h"                   // pgTransactionBegin
 #include "orionld/troe/pgTransactionRollback.h"                // pgTransactionRollback
 #include "orionld/troe/pgTransactionCommit.h"                  // pgTransactionCommit
+#include "orionld/troe/troeQueue.h"                            // troeQueuePush
 #include "orionld/troe/pgCommands.h"                           // Own interface
 
 
@@ -42,8 +43,17 @@
 //
 // pgCommands -
 //
+// With TRoE writer threads (-troeWriters), the commands are queued, to be flushed by a writer, in
+// batches with the commands of other requests.
+//
 void pgCommands(char* sql[], int commands)
 {
+  if (troeWriters > 0)
+  {
+    troeQueuePush(orionldState.tenantP->troeDbName, sql, commands);
+    return;
+  }
+
   PgConnection* connectionP = pgConnectionGet(orionldState.tenantP->troeDbName);
 
   if ((connectionP == NULL) || (connectionP->connectionP == NULL))
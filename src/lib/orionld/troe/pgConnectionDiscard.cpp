@@ -0,0 +1,63 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdlib.h>                                            // free
+#include <pthread.h>                                           // pthread_mutex_lock, pthread_cond_signal
+#include <postgresql/libpq-fe.h>                               // PQfinish
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/troe/PgConnection.h"                         // PgConnection
+#include "orionld/troe/PgConnectionPool.h"                     // PgConnectionPool
+#include "orionld/troe/pgConnectionDiscard.h"                  // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionDiscard - close a broken connection and free its slot in the pool
+//
+// The connection must not be in the free-list of the pool.
+// The slot is freed with the mutex taken, the postgres connection is closed after letting go of it.
+//
+void pgConnectionDiscard(PgConnection* connectionP)
+{
+  PgConnectionPool* poolP = connectionP->poolP;
+
+  pthread_mutex_lock(&poolP->mutex);
+
+  poolP->connectionV[connectionP->slot] = NULL;
+  poolP->connections -= 1;
+  poolP->checkErrors += 1;
+  pthread_cond_signal(&poolP->freeCond);  // A thread awaiting a connection can now open a new one
+
+  pthread_mutex_unlock(&poolP->mutex);
+
+  LM_W(("Discarding a broken postgres connection for db '%s' (used %d times)", (poolP->db != NULL)? poolP->db : "NULL", connectionP->uses));
+
+  if (connectionP->connectionP != NULL)
+    PQfinish(connectionP->connectionP);
+  free(connectionP);
+}
@@ -22,14 +22,22 @@
 *
 * Author: Ken Zangelin
 */
+#include <stdlib.h>                                            // calloc, free
+#include <errno.h>                                             // ETIMEDOUT
+#include <time.h>                                              // clock_gettime
+#include <pthread.h>                                           // pthread_mutex_lock, pthread_cond_timedwait
+#include <postgresql/libpq-fe.h>                               // PQstatus, PQreset
+
 #include "logMsg/logMsg.h"                                     // LM_*
 #include "logMsg/traceLevels.h"                                // Lmt*
 
-#include "orionld/common/orionldState.h"                       // troeHost, pgPortString, troeUser, troePwd
+#include "orionld/common/orionldState.h"                       // dbName, troePoolWait
 #include "orionld/troe/pgConnect.h"                            // pgConnect
 #include "orionld/troe/PgConnection.h"                         // PgConnection
 #include "orionld/troe/PgConnectionPool.h"                     // PgConnectionPool
 #include "orionld/troe/pgConnectionPoolGet.h"                  // pgConnectionPoolGet
+#include "orionld/troe/pgConnectionPoolStatistics.h"           // pgConnectionPoolWaitRecord
+#include "orionld/troe/pgConnectionDiscard.h"                  // pgConnectionDiscard
 #include "orionld/troe/pgConnectionGet.h"                      // Own interface
 
 
@@ -44,23 +52,90 @@ static char* wsTrim(char* s)
   while ((*s == ' ') || (*s == '\t') || (*s == '\n'))
     ++s;
 
+  //
   // trim trailing whitespace
-  int last = strlen(s);
-  while ((s[last] == ' ') || (s[last] == '\t') || (s[last] == '\n'))
+  // Only written to if there is whitespace to remove - the database name is shared by all requests of the tenant
+  //
+  int last = strlen(s) - 1;
+  while ((last >= 0) && ((s[last] == ' ') || (s[last] == '\t') || (s[last] == '\n')))
   {
-    ++s;
+    s[last] = 0;
+    --last;
   }
-  s[last] = 0;
 
   return s;
 }
 
 
 
+// -----------------------------------------------------------------------------
+//
+// pgConnectionOpen - connect a new PgConnection, for a slot already reserved in the pool
+//
+// Called without the mutex of the pool - connecting to postgres takes time.
+// If the connection fails, the reserved slot is given back.
+//
+static PgConnection* pgConnectionOpen(PgConnectionPool* poolP, const char* db)
+{
+  PgConnection* cP = (PgConnection*) calloc(1, sizeof(PgConnection));
+
+  if (cP != NULL)
+  {
+    cP->connectionP = pgConnect(db);
+
+    if ((cP->connectionP != NULL) && (PQstatus(cP->connectionP) != CONNECTION_OK))
+    {
+      LM_E(("Database Error (%s)", PQerrorMessage(cP->connectionP)));
+      PQfinish(cP->connectionP);
+      cP->connectionP = NULL;
+    }
+  }
+
+  pthread_mutex_lock(&poolP->mutex);
+
+  if ((cP == NULL) || (cP->connectionP == NULL))
+  {
+    poolP->connections   -= 1;
+    poolP->connectErrors += 1;
+    pthread_cond_signal(&poolP->freeCond);
+    pthread_mutex_unlock(&poolP->mutex);
+
+    if (cP == NULL)
+      LM_RE(NULL, ("Out of memory (unable to allocate room for a Postgres Connection - %d bytes)", sizeof(PgConnection)));
+
+    free(cP);
+    LM_RE(NULL, ("Database Error (unable to connect to postgres(%s))", db));
+  }
+
+  // As the slot was reserved (poolP->connections), there is always a free slot in connectionV
+  for (int ix = 0; ix < poolP->items; ix++)
+  {
+    if (poolP->connectionV[ix] == NULL)
+    {
+      poolP->connectionV[ix] = cP;
+      cP->slot = ix;
+      break;
+    }
+  }
+
+  poolP->connects += 1;
+  pthread_mutex_unlock(&poolP->mutex);
+
+  cP->poolP = poolP;
+  return cP;
+}
+
+
+
 // -----------------------------------------------------------------------------
 //
 // pgConnectionGet -
 //
+// Idle connections are taken from the free-list of the pool.
+// If there is none, and the pool isn't full, a slot is reserved and a new connection is opened -
+// after letting go of the mutex.
+// If the pool is full, the calling thread waits (at most troePoolWait milliseconds) for a connection to be released.
+//
 PgConnection* pgConnectionGet(const char* db)
 {
   char* _db = (char*) db;
@@ -77,90 +152,83 @@ PgConnection* pgConnectionGet(const char* db)
   if (_db != NULL)
     _db = wsTrim(_db);
 
-  // FIXME: Need a semaphore to protect the list of pools
   PgConnectionPool* poolP = pgConnectionPoolGet(_db);  // pgConnectionPoolGet creates the pool if it doesn't already exist
 
   if (poolP == NULL)
     LM_RE(NULL, ("unable to obtain a connection pool reference"));
 
-  // Await a free slot in the pool
-  sem_wait(&poolP->queueSem);
+  struct timespec start;
+  struct timespec deadline;
 
-  // Await the right to modify the pool
-  sem_wait(&poolP->poolSem);
-
-  // Search for a free but already connected PgConnection in the pool
-  for (int ix = 0; ix < poolP->items; ix++)
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  deadline.tv_sec  = start.tv_sec  + troePoolWait / 1000;
+  deadline.tv_nsec = start.tv_nsec + (troePoolWait % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000)
   {
-    PgConnection* cP = poolP->connectionV[ix];
+    deadline.tv_sec  += 1;
+    deadline.tv_nsec -= 1000000000;
+  }
 
-    if ((cP == NULL) || (cP->busy == true))
-      continue;
+  pthread_mutex_lock(&poolP->mutex);
 
-    if (cP->connectionP != NULL)
-    {
-      // Great - found a free and already connected item - let's use it !
-      cP->busy = true;
-
-      sem_post(&poolP->poolSem);
-      sem_post(&poolP->queueSem);
+  // Await an idle connection or a free slot
+  while ((poolP->freeList == NULL) && (poolP->connections >= poolP->items))
+  {
+    int r;
 
-      cP->uses += 1;
-      return cP;
-    }
-  }
+    poolP->waiters += 1;
+    if (troePoolWait > 0)
+      r = pthread_cond_timedwait(&poolP->freeCond, &poolP->mutex, &deadline);
+    else
+      r = pthread_cond_wait(&poolP->freeCond, &poolP->mutex);
+    poolP->waiters -= 1;
 
-  //
-  // No already connected item was found - just look for an unused item and connect it to postgres
-  //
-  PgConnection* cP = NULL;
-  for (int ix = 0; ix < poolP->items; ix++)
-  {
-    if (poolP->connectionV[ix] == NULL)
+    if (r == ETIMEDOUT)
     {
-      //
-      // We found a completely unused slot - need to allocate
-      // Pity doing this with the semaphore taken ...
-      // But, there's no other choice as the slot must be marked as 'busy' before the sem can be released
-      //
-      poolP->connectionV[ix] = (PgConnection*) calloc(1, sizeof(PgConnection));
-      if (poolP->connectionV[ix] == NULL)
-      {
-        sem_post(&poolP->poolSem);
-        sem_post(&poolP->queueSem);
-        LM_RE(NULL, ("Out of memory (unable to allocate room for a Postgres Connection - %d bytes)", sizeof(PgConnection)));
-      }
-
-      cP = poolP->connectionV[ix];
-      break;
-    }
-    else if (poolP->connectionV[ix]->busy == false)
-    {
-      cP = poolP->connectionV[ix];
-      break;
+      poolP->timeouts += 1;
+      pthread_mutex_unlock(&poolP->mutex);
+      LM_RE(NULL, ("Database Error (no free postgres connection for db '%s' after %d milliseconds)", (_db != NULL)? _db : "NULL", troePoolWait));
     }
   }
 
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  pgConnectionPoolWaitRecord(poolP, (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1000000000.0);
+
+  PgConnection* cP = poolP->freeList;
 
   if (cP != NULL)
-    cP->busy = true;  // Now the pool item 'cP' is ours - after this we can let go of the semaphore
+    poolP->freeList = cP->next;
+  else
+    poolP->connections += 1;  // The slot is ours - the connection is opened after letting go of the mutex
 
-  sem_post(&poolP->poolSem);
-  sem_post(&poolP->queueSem);
+  poolP->gets += 1;
+  pthread_mutex_unlock(&poolP->mutex);
 
   if (cP == NULL)
-    LM_RE(NULL, ("Internal Error (bug in postgres connection pool logic)"));
-
-  if (cP->connectionP == NULL)  // Virgin connection
   {
-    cP->connectionP = pgConnect(_db);
-    if (cP->connectionP == NULL)
+    cP = pgConnectionOpen(poolP, _db);
+    if (cP == NULL)
+      return NULL;
+  }
+  else if (PQstatus(cP->connectionP) != CONNECTION_OK)
+  {
+    //
+    // The connection was broken after it was last used (the last user or the health check would have discarded it otherwise).
+    // PQstatus doesn't talk to the server, so this check is for free.
+    // One attempt to reset it, and if that fails, it's discarded and we start over.
+    //
+    PQreset(cP->connectionP);
+    if (PQstatus(cP->connectionP) != CONNECTION_OK)
     {
-      cP->busy = false;  // So the slot can be used again!
-      LM_RE(NULL, ("Database Error (unable to connect to postgres(%s))", _db));
+      pgConnectionDiscard(cP);
+      return pgConnectionGet(db);
     }
   }
 
+  cP->next  = NULL;
+  cP->busy  = true;
   cP->uses += 1;
+
   return cP;
 }
@@ -0,0 +1,235 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <time.h>                                              // clock_gettime
+#include <string.h>                                            // strerror
+#include <errno.h>                                             // ETIMEDOUT, errno
+#include <pthread.h>                                           // pthread_*
+#include <postgresql/libpq-fe.h>                               // PQexec, PQreset, ...
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/troe/PgConnection.h"                         // PgConnection
+#include "orionld/troe/PgConnectionPool.h"                     // PgConnectionPool
+#include "orionld/troe/pgConnectionPools.h"                    // pgPoolMaster
+#include "orionld/troe/pgConnectionDiscard.h"                  // pgConnectionDiscard
+#include "orionld/troe/pgConnectionPoolCheck.h"                // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Health check thread state
+//
+static pthread_t        checkThread;
+static bool             checkThreadRunning = false;
+static bool             checkStop          = false;
+static int              checkInterval      = 30;
+static pthread_mutex_t  checkMutex         = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   checkCond;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionValid -
+//
+static bool pgConnectionValid(PGconn* connectionP)
+{
+  if (PQstatus(connectionP) != CONNECTION_OK)
+    return false;
+
+  PGresult* res = PQexec(connectionP, "SELECT 1");
+  bool      ok  = (res != NULL) && (PQresultStatus(res) == PGRES_TUPLES_OK);
+
+  if (res != NULL)
+    PQclear(res);
+
+  return ok;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionPoolCheck - validate the connections of a pool that have been idle for 'interval' seconds or more
+//
+static void pgConnectionPoolCheck(PgConnectionPool* poolP, time_t now, int interval)
+{
+  PgConnection* checkList = NULL;
+  PgConnection* keepList  = NULL;
+  PgConnection* keepLast  = NULL;
+
+  //
+  // Take the connections to check out of the free-list - the rest stay available
+  //
+  pthread_mutex_lock(&poolP->mutex);
+
+  PgConnection* cP = poolP->freeList;
+  while (cP != NULL)
+  {
+    PgConnection* next = cP->next;
+
+    if (now - cP->lastUsed >= interval)
+    {
+      cP->next  = checkList;
+      checkList = cP;
+    }
+    else
+    {
+      cP->next = NULL;
+      if (keepLast == NULL)
+        keepList = cP;
+      else
+        keepLast->next = cP;
+      keepLast = cP;
+    }
+
+    cP = next;
+  }
+  poolP->freeList = keepList;
+
+  pthread_mutex_unlock(&poolP->mutex);
+
+  //
+  // Validate them without the mutex
+  //
+  while (checkList != NULL)
+  {
+    cP        = checkList;
+    checkList = cP->next;
+
+    if (pgConnectionValid(cP->connectionP) == false)
+    {
+      LM_W(("Broken postgres connection for db '%s' - resetting it", (poolP->db != NULL)? poolP->db : "NULL"));
+      PQreset(cP->connectionP);
+
+      if (pgConnectionValid(cP->connectionP) == false)
+      {
+        pgConnectionDiscard(cP);
+        continue;
+      }
+    }
+
+    pthread_mutex_lock(&poolP->mutex);
+
+    cP->lastUsed    = now;
+    cP->next        = poolP->freeList;
+    poolP->freeList = cP;
+
+    if (poolP->waiters > 0)
+      pthread_cond_signal(&poolP->freeCond);
+
+    pthread_mutex_unlock(&poolP->mutex);
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionPoolCheckThread -
+//
+static void* pgConnectionPoolCheckThread(void* vP)
+{
+  pthread_mutex_lock(&checkMutex);
+
+  while (checkStop == false)
+  {
+    struct timespec wakeup;
+
+    clock_gettime(CLOCK_MONOTONIC, &wakeup);
+    wakeup.tv_sec += checkInterval;
+
+    while ((checkStop == false) && (pthread_cond_timedwait(&checkCond, &checkMutex, &wakeup) != ETIMEDOUT))
+      ;
+
+    if (checkStop == true)
+      break;
+
+    pthread_mutex_unlock(&checkMutex);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    PgConnectionPool* poolP = pgPoolMaster;
+    while (poolP != NULL)
+    {
+      pgConnectionPoolCheck(poolP, now.tv_sec, checkInterval);
+      poolP = __atomic_load_n(&poolP->next, __ATOMIC_ACQUIRE);
+    }
+
+    pthread_mutex_lock(&checkMutex);
+  }
+
+  pthread_mutex_unlock(&checkMutex);
+
+  return NULL;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionPoolCheckStart -
+//
+bool pgConnectionPoolCheckStart(int interval)
+{
+  pthread_condattr_t condAttr;
+
+  pthread_condattr_init(&condAttr);
+  pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+  pthread_cond_init(&checkCond, &condAttr);
+  pthread_condattr_destroy(&condAttr);
+
+  checkInterval = interval;
+  checkStop     = false;
+
+  if (pthread_create(&checkThread, NULL, pgConnectionPoolCheckThread, NULL) != 0)
+    LM_RE(false, ("Internal Error (unable to create the postgres connection health check thread: %s)", strerror(errno)));
+
+  checkThreadRunning = true;
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionPoolCheckStop -
+//
+void pgConnectionPoolCheckStop(void)
+{
+  if (checkThreadRunning == false)
+    return;
+
+  pthread_mutex_lock(&checkMutex);
+  checkStop = true;
+  pthread_cond_signal(&checkCond);
+  pthread_mutex_unlock(&checkMutex);
+
+  pthread_join(checkThread, NULL);
+  checkThreadRunning = false;
+}
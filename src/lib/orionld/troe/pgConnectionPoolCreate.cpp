@@ -22,9 +22,10 @@
 *
 * Author: Ken Zangelin
 */
-#include <stdlib.h>                                            // malloc, free
+#include <stdlib.h>                                            // calloc, free
 #include <string.h>                                            // strdup
-#include <semaphore.h>                                         // sem_init
+#include <pthread.h>                                           // pthread_mutex_init, pthread_cond_init
+#include <time.h>                                              // CLOCK_MONOTONIC
 
 #include "logMsg/logMsg.h"                                     // LM_*
 #include "logMsg/traceLevels.h"                                // Lmt*
@@ -40,7 +41,7 @@
 //
 PgConnectionPool* pgConnectionPoolCreate(const char* db, int poolSize)
 {
-  PgConnectionPool* poolP = (PgConnectionPool*) malloc(sizeof(PgConnectionPool));
+  PgConnectionPool* poolP = (PgConnectionPool*) calloc(1, sizeof(PgConnectionPool));
 
   if (poolP == NULL)
     LM_RE(NULL, ("Out of memory (unable to allocate room for a postgres connection pool)"));
@@ -65,8 +66,18 @@ PgConnectionPool* pgConnectionPoolCreate(const char* db, int poolSize)
   else
     poolP->db = NULL;
 
-  sem_init(&poolP->queueSem, 0, poolSize);  // Counting semaphore - there's a free slot
-  sem_init(&poolP->poolSem,  0, 1);         // Binary semaphore - the pool is yours to modify
+  //
+  // The condition variable uses the monotonic clock, so that pgConnectionGet's timeout
+  // isn't affected by changes of the system time
+  //
+  pthread_condattr_t condAttr;
+
+  pthread_condattr_init(&condAttr);
+  pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+  pthread_cond_init(&poolP->freeCond, &condAttr);
+  pthread_condattr_destroy(&condAttr);
+
+  pthread_mutex_init(&poolP->mutex, NULL);
 
   poolP->items = poolSize;
 
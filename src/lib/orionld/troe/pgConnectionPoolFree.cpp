@@ -23,7 +23,7 @@
 * Author: Ken Zangelin
 */
 #include <stdlib.h>                                            // free
-#include <semaphore.h>                                         // sem_destroy
+#include <pthread.h>                                           // pthread_mutex_destroy, pthread_cond_destroy
 
 #include "logMsg/logMsg.h"                                     // LM_*
 #include "logMsg/traceLevels.h"                                // Lmt*
@@ -39,8 +39,8 @@
 //
 void pgConnectionPoolFree(PgConnectionPool* poolP)
 {
-  sem_destroy(&poolP->queueSem);
-  sem_destroy(&poolP->poolSem);
+  pthread_mutex_destroy(&poolP->mutex);
+  pthread_cond_destroy(&poolP->freeCond);
 
   for (int ix = 0; ix < poolP->items; ix++)
   {
@@ -23,18 +23,40 @@
 * Author: Ken Zangelin
 */
 #include <string.h>                                            // strcmp
+#include <pthread.h>                                           // pthread_mutex_lock, pthread_mutex_unlock
 
 #include "logMsg/logMsg.h"                                     // LM_*
 #include "logMsg/traceLevels.h"                                // Lmt*
 
 #include "orionld/troe/PgConnectionPool.h"                     // PgConnectionPool
-#include "orionld/troe/pgConnectionPools.h"                    // pgPoolMaster
+#include "orionld/troe/pgConnectionPools.h"                    // pgPoolMaster, pgPoolsMutex
 #include "orionld/troe/pgConnectionPoolCreate.h"               // pgConnectionPoolCreate
 #include "orionld/troe/pgConnectionPoolInsert.h"               // pgConnectionPoolInsert
 #include "orionld/troe/pgConnectionPoolGet.h"                  // Own interface
 
 
 
+// -----------------------------------------------------------------------------
+//
+// pgConnectionPoolLookup -
+//
+static PgConnectionPool* pgConnectionPoolLookup(const char* db)
+{
+  PgConnectionPool* poolP = __atomic_load_n(&pgPoolMaster->next, __ATOMIC_ACQUIRE);
+
+  while (poolP != NULL)
+  {
+    if (strcmp(poolP->db, db) == 0)
+      return poolP;
+
+    poolP = __atomic_load_n(&poolP->next, __ATOMIC_ACQUIRE);
+  }
+
+  return NULL;
+}
+
+
+
 // -----------------------------------------------------------------------------
 //
 // pgConnectionPoolGet -
@@ -47,21 +69,31 @@ PgConnectionPool* pgConnectionPoolGet(char* db)
   if (db == NULL)
     return pgPoolMaster;
 
-  PgConnectionPool* poolP = pgPoolMaster->next;
+  PgConnectionPool* poolP = pgConnectionPoolLookup(db);
 
-  while (poolP != NULL)
+  if (poolP != NULL)
+    return poolP;
+
+  //
+  // No pool found, will have to create a new one.
+  // Another thread may have created it while we were searching, so, search again, this time with the mutex taken
+  //
+  pthread_mutex_lock(&pgPoolsMutex);
+
+  poolP = pgConnectionPoolLookup(db);
+  if (poolP == NULL)
   {
-    if (strcmp(poolP->db, db) == 0)
-      return poolP;
+    poolP = pgConnectionPoolCreate(db, pgPoolMaster->items);
+    if (poolP == NULL)
+    {
+      pthread_mutex_unlock(&pgPoolsMutex);
+      LM_RE(NULL, ("Database Error (unable to create connection pool for db '%s')", db));
+    }
 
-    poolP = poolP->next;
+    pgConnectionPoolInsert(poolP);
   }
 
-  // No pool found, will have to create a new one
-  poolP = pgConnectionPoolCreate(db, pgPoolMaster->items);
-  if (poolP == NULL)
-    LM_RE(NULL, ("Database Error (unable to create connection pool for db '%s')", db));
+  pthread_mutex_unlock(&pgPoolsMutex);
 
-  pgConnectionPoolInsert(poolP);
   return poolP;
 }
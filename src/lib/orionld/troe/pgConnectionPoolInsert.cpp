@@ -37,8 +37,12 @@
 // New pools are inserted in the beginning of the list, so we don't need to maintain a pointer
 // to the last item in the linked list.
 //
+// The caller must hold pgPoolsMutex.
+// The new pool is fully initialized before it's published (release store), so that pgConnectionPoolGet
+// can search the list without taking the mutex.
+//
 void pgConnectionPoolInsert(PgConnectionPool* poolP)
 {
-  poolP->next        = pgPoolMaster->next;
-  pgPoolMaster->next = poolP;
+  poolP->next = pgPoolMaster->next;
+  __atomic_store_n(&pgPoolMaster->next, poolP, __ATOMIC_RELEASE);
 }
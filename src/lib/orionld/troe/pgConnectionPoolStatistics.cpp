@@ -0,0 +1,144 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string.h>                                            // strncpy, memcpy, memset
+#include <pthread.h>                                           // pthread_mutex_lock, pthread_mutex_unlock
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/troe/PgConnection.h"                         // PgConnection
+#include "orionld/troe/PgConnectionPool.h"                     // PgConnectionPool
+#include "orionld/troe/pgConnectionPools.h"                    // pgPoolMaster
+#include "orionld/troe/pgConnectionPoolStatistics.h"           // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPoolWaitBucketLimit - upper limits (seconds) of the buckets of the wait-time histogram
+//
+// The last bucket has no upper limit.
+//
+static const double pgPoolWaitBucketLimit[PG_POOL_WAIT_BUCKETS - 1] = { 0.0001, 0.001, 0.005, 0.01, 0.05, 0.1, 1.0 };
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPoolWaitBucketName -
+//
+const char* pgPoolWaitBucketName[PG_POOL_WAIT_BUCKETS] = { "100us", "1ms", "5ms", "10ms", "50ms", "100ms", "1s", "inf" };
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionPoolWaitRecord -
+//
+void pgConnectionPoolWaitRecord(PgConnectionPool* poolP, double waited)
+{
+  int bucket = 0;
+
+  while ((bucket < PG_POOL_WAIT_BUCKETS - 1) && (waited > pgPoolWaitBucketLimit[bucket]))
+    ++bucket;
+
+  poolP->waitHistogram[bucket] += 1;
+  poolP->waitTime              += waited;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionPoolStatisticsGet -
+//
+int pgConnectionPoolStatisticsGet(PgConnectionPoolStatistics* statsV, int maxPools)
+{
+  int               pools = 0;
+  PgConnectionPool* poolP = pgPoolMaster;
+
+  while ((poolP != NULL) && (pools < maxPools))
+  {
+    PgConnectionPoolStatistics* statsP = &statsV[pools];
+
+    strncpy(statsP->db, (poolP->db != NULL)? poolP->db : "postgres", sizeof(statsP->db) - 1);
+    statsP->db[sizeof(statsP->db) - 1] = 0;
+
+    pthread_mutex_lock(&poolP->mutex);
+
+    statsP->items         = poolP->items;
+    statsP->connections   = poolP->connections;
+    statsP->waiters       = poolP->waiters;
+    statsP->gets          = poolP->gets;
+    statsP->timeouts      = poolP->timeouts;
+    statsP->connects      = poolP->connects;
+    statsP->connectErrors = poolP->connectErrors;
+    statsP->checkErrors   = poolP->checkErrors;
+    statsP->waitTime      = poolP->waitTime;
+    statsP->idle          = 0;
+
+    for (PgConnection* cP = poolP->freeList; cP != NULL; cP = cP->next)
+      statsP->idle += 1;
+
+    memcpy(statsP->waitHistogram, poolP->waitHistogram, sizeof(statsP->waitHistogram));
+
+    pthread_mutex_unlock(&poolP->mutex);
+
+    ++pools;
+    poolP = __atomic_load_n(&poolP->next, __ATOMIC_ACQUIRE);
+  }
+
+  return pools;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionPoolStatisticsReset -
+//
+// Only the counters are reset - not the state of the pools (connections, idle, waiters)
+//
+void pgConnectionPoolStatisticsReset(void)
+{
+  PgConnectionPool* poolP = pgPoolMaster;
+
+  while (poolP != NULL)
+  {
+    pthread_mutex_lock(&poolP->mutex);
+
+    poolP->gets          = 0;
+    poolP->timeouts      = 0;
+    poolP->connects      = 0;
+    poolP->connectErrors = 0;
+    poolP->checkErrors   = 0;
+    poolP->waitTime      = 0;
+    memset(poolP->waitHistogram, 0, sizeof(poolP->waitHistogram));
+
+    pthread_mutex_unlock(&poolP->mutex);
+
+    poolP = __atomic_load_n(&poolP->next, __ATOMIC_ACQUIRE);
+  }
+}
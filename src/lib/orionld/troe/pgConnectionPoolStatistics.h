@@ -0,0 +1,88 @@
+#ifndef SRC_LIB_ORIONLD_TROE_PGCONNECTIONPOOLSTATISTICS_H_
+#define SRC_LIB_ORIONLD_TROE_PGCONNECTIONPOOLSTATISTICS_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdint.h>                                            // uint64_t
+
+#include "orionld/troe/PgConnectionPool.h"                     // PgConnectionPool, PG_POOL_WAIT_BUCKETS
+
+
+
+// -----------------------------------------------------------------------------
+//
+// PgConnectionPoolStatistics - snapshot of the counters of one connection pool
+//
+typedef struct PgConnectionPoolStatistics
+{
+  char      db[128];        // Name of the database ("postgres" for the pool of the NULL database)
+  int       items;          // Max number of connections
+  int       connections;    // Connections open or being opened
+  int       idle;           // Connections in the free-list
+  int       waiters;        // Threads awaiting a connection
+  uint64_t  gets;
+  uint64_t  timeouts;
+  uint64_t  connects;
+  uint64_t  connectErrors;
+  uint64_t  checkErrors;
+  double    waitTime;
+  uint64_t  waitHistogram[PG_POOL_WAIT_BUCKETS];
+} PgConnectionPoolStatistics;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPoolWaitBucketName - names of the buckets of the wait-time histogram
+//
+extern const char* pgPoolWaitBucketName[PG_POOL_WAIT_BUCKETS];
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionPoolWaitRecord - add a wait time (in seconds) to the histogram of a pool - the mutex of the pool must be taken
+//
+extern void pgConnectionPoolWaitRecord(PgConnectionPool* poolP, double waited);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionPoolStatisticsGet - snapshot of the statistics of (at most 'maxPools') pools
+//
+// Returns the number of pools copied to statsV.
+//
+extern int pgConnectionPoolStatisticsGet(PgConnectionPoolStatistics* statsV, int maxPools);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgConnectionPoolStatisticsReset -
+//
+extern void pgConnectionPoolStatisticsReset(void);
+
+#endif  // SRC_LIB_ORIONLD_TROE_PGCONNECTIONPOOLSTATISTICS_H_
@@ -22,6 +22,8 @@
 *
 * Author: Ken Zangelin
 */
+#include <pthread.h>                                           // pthread_mutex_t
+
 #include "logMsg/logMsg.h"                                     // LM_*
 #include "logMsg/traceLevels.h"                                // Lmt*
 
@@ -35,3 +37,11 @@
 // pgPoolMaster -
 //
 PgConnectionPool* pgPoolMaster = NULL;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPoolsMutex -
+//
+pthread_mutex_t pgPoolsMutex = PTHREAD_MUTEX_INITIALIZER;
@@ -25,6 +25,8 @@
 *
 * Author: Ken Zangelin
 */
+#include <pthread.h>                                           // pthread_mutex_t
+
 #include "orionld/troe/PgConnectionPool.h"                     // PgConnectionPool
 
 
@@ -35,4 +37,15 @@
 //
 extern PgConnectionPool* pgPoolMaster;
 
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPoolsMutex - serializes the creation of connection pools
+//
+// Lookups in the list of pools don't need the mutex - pools are only ever inserted (never removed
+// before exit) and the insertion publishes the new pool with a single atomic store.
+//
+extern pthread_mutex_t pgPoolsMutex;
+
 #endif  // SRC_LIB_ORIONLD_TROE_PGCONNECTIONPOOLS_H_
@@ -44,6 +44,11 @@ static void pgConnectionPoolPresent(PgConnectionPool* poolP)
 {
   LM_TMP(("PGPOOL: Postgres Connection Pool for DB '%s'", poolP->db));
   LM_TMP(("PGPOOL:   Size of pool:   %d", poolP->items));
+  LM_TMP(("PGPOOL:   Connections:    %d", poolP->connections));
+  LM_TMP(("PGPOOL:   Gets:           %llu (%llu timeouts)", (unsigned long long) poolP->gets, (unsigned long long) poolP->timeouts));
+  LM_TMP(("PGPOOL:   Connects:       %llu (%llu errors)", (unsigned long long) poolP->connects, (unsigned long long) poolP->connectErrors));
+  LM_TMP(("PGPOOL:   Broken:         %llu", (unsigned long long) poolP->checkErrors));
+  LM_TMP(("PGPOOL:   Wait time:      %f secs", poolP->waitTime));
 
   for (int ix = 0; ix < poolP->items; ix++)
   {
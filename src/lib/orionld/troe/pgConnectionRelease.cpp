@@ -22,7 +22,14 @@
 *
 * Author: Ken Zangelin
 */
+#include <time.h>                                              // clock_gettime
+#include <pthread.h>                                           // pthread_mutex_lock, pthread_cond_signal
+#include <postgresql/libpq-fe.h>                               // PQstatus, PQtransactionStatus
+
 #include "orionld/troe/PgConnection.h"                         // PgConnection
+#include "orionld/troe/PgConnectionPool.h"                     // PgConnectionPool
+#include "orionld/troe/pgConnectionDiscard.h"                  // pgConnectionDiscard
+#include "orionld/troe/pgConnectionRelease.h"                  // Own interface
 
 
 
@@ -30,8 +37,36 @@
 //
 // pgConnectionRelease - release a connection to a postgres database
 //
+// The connection goes back to the head of the free-list of its pool (unless it's broken)
+// and one of the threads awaiting a connection is woken up.
+//
 void pgConnectionRelease(PgConnection* connectionP)
 {
-  // Return the connection to its pool
-  connectionP->busy = false;
+  PgConnectionPool* poolP = connectionP->poolP;
+
+  //
+  // A connection that is broken, or that has been left in the middle of a transaction, isn't
+  // given to the next user - it's closed
+  //
+  if ((PQstatus(connectionP->connectionP) != CONNECTION_OK) || (PQtransactionStatus(connectionP->connectionP) != PQTRANS_IDLE))
+  {
+    connectionP->busy = false;
+    pgConnectionDiscard(connectionP);
+    return;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  pthread_mutex_lock(&poolP->mutex);
+
+  connectionP->busy     = false;
+  connectionP->lastUsed = now.tv_sec;
+  connectionP->next     = poolP->freeList;
+  poolP->freeList       = connectionP;
+
+  if (poolP->waiters > 0)
+    pthread_cond_signal(&poolP->freeCond);
+
+  pthread_mutex_unlock(&poolP->mutex);
 }
@@ -27,11 +27,12 @@
 #include "logMsg/logMsg.h"                                     // LM_*
 #include "logMsg/traceLevels.h"                                // Lmt*
 
-#include "orionld/common/orionldState.h"                       // dbName
+#include "orionld/common/orionldState.h"                       // dbName, troePartitionDays, troeRetention
 #include "orionld/troe/pgConnectionGet.h"                      // pgConnectionGet
 #include "orionld/troe/pgDatabaseCreate.h"                     // pgDatabaseCreate
 #include "orionld/troe/pgDatabaseTableCreateAll.h"             // pgDatabaseTableCreateAll
 #include "orionld/troe/pgConnectionRelease.h"                  // pgConnectionRelease
+#include "orionld/troe/pgPartitionsMaintain.h"                 // pgPartitionsMaintain
 #include "orionld/troe/pgDatabasePrepare.h"                    // Own interface
 
 
@@ -66,6 +67,8 @@ bool pgDatabasePrepare(const char* dbName)
   bool r;
   if ((r = pgDatabaseTableCreateAll(connectionP->connectionP)) == false)
     LM_E(("Database Error (error creating postgres database tables)"));
+  else
+    pgPartitionsMaintain(connectionP->connectionP, troePartitionDays, troeRetention);  // The partitions of a new DB are needed right away
 
   pgConnectionRelease(connectionP);
 
@@ -23,14 +23,14 @@
 * Author: Ken Zangelin
 */
 #include <stdio.h>                                             // popen, fgets
-#include <semaphore.h>                                         // sem_init, sem_take, ...
 #include <postgresql/libpq-fe.h>                               // PGconn
 
 #include "logMsg/logMsg.h"                                     // LM_*
 #include "logMsg/traceLevels.h"                                // Lmt*
 
-#include "orionld/common/orionldState.h"                       // troePort
+#include "orionld/common/orionldState.h"                       // troePort, troePoolSize, troePoolCheck
 #include "orionld/troe/pgConnectionPoolInit.h"                 // pgConnectionPoolInit
+#include "orionld/troe/pgConnectionPoolCheck.h"                // pgConnectionPoolCheckStart
 #include "orionld/troe/pgDatabasePrepare.h"                    // pgDatabasePrepare
 #include "orionld/troe/pgInit.h"                               // Own interface
 
@@ -44,9 +44,15 @@ bool pgInit(const char* dbPrefix)
 {
   snprintf(pgPortString, sizeof(pgPortString), "%d", troePort);
 
-  if (pgConnectionPoolInit(10) == false)
+  //
+  // troePoolSize is the max number of connections of each pool, i.e. per tenant (each tenant has its own database)
+  //
+  if (pgConnectionPoolInit((troePoolSize > 0)? troePoolSize : 1) == false)
     LM_RE(false, ("error initializing the postgres connection pools"));
 
+  if ((troePoolCheck > 0) && (pgConnectionPoolCheckStart(troePoolCheck) == false))
+    LM_RE(false, ("error starting the health check of the postgres connections"));
+
   bool b = pgDatabasePrepare(dbPrefix);
   pgConnectionPoolsPresent();
   return b;
@@ -0,0 +1,63 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string.h>                                            // strlen
+#include <postgresql/libpq-fe.h>                               // PGconn, PQescapeLiteral, PQfreemem
+
+extern "C"
+{
+#include "kalloc/kaStrdup.h"                                   // kaStrdup
+}
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/common/orionldState.h"                       // orionldState
+#include "orionld/troe/pgLiteral.h"                            // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgLiteral -
+//
+// Unlike pgQuotedString, that is used for the data the broker itself writes, this function is meant for
+// strings that come from the request (URI parameters) and that are pushed down into SELECTs.
+//
+char* pgLiteral(PGconn* connectionP, const char* s)
+{
+  char* escaped = PQescapeLiteral(connectionP, s, strlen(s));
+
+  if (escaped == NULL)
+  {
+    LM_E(("Database Error (PQescapeLiteral: %s)", PQerrorMessage(connectionP)));
+    return NULL;
+  }
+
+  char* literal = kaStrdup(&orionldState.kalloc, escaped);
+
+  PQfreemem(escaped);
+
+  return literal;
+}
@@ -0,0 +1,205 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdlib.h>                                            // calloc, free
+#include <stdio.h>                                             // snprintf
+#include <time.h>                                              // clock_gettime
+#include <string.h>                                            // strerror
+#include <errno.h>                                             // ETIMEDOUT, errno
+#include <semaphore.h>                                         // sem_wait, sem_post
+#include <pthread.h>                                           // pthread_*
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/types/OrionldTenant.h"                       // OrionldTenant
+#include "orionld/common/tenantList.h"                         // tenant0, tenantList, tenantSem
+#include "orionld/troe/PgConnection.h"                         // PgConnection
+#include "orionld/troe/pgConnectionGet.h"                      // pgConnectionGet
+#include "orionld/troe/pgConnectionRelease.h"                  // pgConnectionRelease
+#include "orionld/troe/pgPartitionsMaintain.h"                 // pgPartitionsMaintain
+#include "orionld/troe/pgPartitionMaintenance.h"               // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// PARTITION_MAINTENANCE_INTERVAL - seconds between two rounds of partition maintenance
+//
+// Partitions are created two periods ahead, so, once an hour is more than enough.
+//
+#define PARTITION_MAINTENANCE_INTERVAL  3600
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Maintenance thread state
+//
+static pthread_t        maintenanceThread;
+static bool             maintenanceThreadRunning = false;
+static bool             maintenanceStop          = false;
+static int              maintenancePartitionDays = 7;
+static int              maintenanceRetentionDays = 0;
+static pthread_mutex_t  maintenanceMutex         = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   maintenanceCond;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// TroeDbName -
+//
+typedef struct TroeDbName
+{
+  char name[64];
+} TroeDbName;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPartitionMaintenanceRound - maintain the partitions of the TRoE databases of all tenants
+//
+// The database names are copied under the tenant semaphore - the partitions are maintained without it,
+// so that the creation of new tenants isn't held up.
+//
+static void pgPartitionMaintenanceRound(void)
+{
+  sem_wait(&tenantSem);
+
+  int dbs = 1;
+  for (OrionldTenant* tP = tenantList; tP != NULL; tP = tP->next)
+    ++dbs;
+
+  TroeDbName* dbV = (TroeDbName*) calloc(dbs, sizeof(TroeDbName));
+  if (dbV == NULL)
+  {
+    sem_post(&tenantSem);
+    LM_E(("Out of memory (allocating the list of TRoE databases for partition maintenance)"));
+    return;
+  }
+
+  int ix = 0;
+  snprintf(dbV[ix++].name, sizeof(dbV[0].name), "%s", tenant0.troeDbName);
+  for (OrionldTenant* tP = tenantList; tP != NULL; tP = tP->next)
+    snprintf(dbV[ix++].name, sizeof(dbV[0].name), "%s", tP->troeDbName);
+
+  sem_post(&tenantSem);
+
+  for (ix = 0; ix < dbs; ix++)
+  {
+    PgConnection* connectionP = pgConnectionGet(dbV[ix].name);
+
+    if ((connectionP == NULL) || (connectionP->connectionP == NULL))
+    {
+      LM_E(("Database Error (no connection to the TRoE database '%s' for partition maintenance)", dbV[ix].name));
+      if (connectionP != NULL)
+        pgConnectionRelease(connectionP);
+      continue;
+    }
+
+    pgPartitionsMaintain(connectionP->connectionP, maintenancePartitionDays, maintenanceRetentionDays);
+    pgConnectionRelease(connectionP);
+  }
+
+  free(dbV);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPartitionMaintenanceThread -
+//
+static void* pgPartitionMaintenanceThread(void* vP)
+{
+  pthread_mutex_lock(&maintenanceMutex);
+
+  while (maintenanceStop == false)
+  {
+    pthread_mutex_unlock(&maintenanceMutex);
+    pgPartitionMaintenanceRound();
+    pthread_mutex_lock(&maintenanceMutex);
+
+    struct timespec wakeup;
+
+    clock_gettime(CLOCK_MONOTONIC, &wakeup);
+    wakeup.tv_sec += PARTITION_MAINTENANCE_INTERVAL;
+
+    int rc = 0;
+    while ((maintenanceStop == false) && (rc != ETIMEDOUT))
+      rc = pthread_cond_timedwait(&maintenanceCond, &maintenanceMutex, &wakeup);
+  }
+
+  pthread_mutex_unlock(&maintenanceMutex);
+
+  return NULL;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPartitionMaintenanceStart -
+//
+bool pgPartitionMaintenanceStart(int partitionDays, int retentionDays)
+{
+  pthread_condattr_t condAttr;
+
+  pthread_condattr_init(&condAttr);
+  pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+  pthread_cond_init(&maintenanceCond, &condAttr);
+  pthread_condattr_destroy(&condAttr);
+
+  maintenancePartitionDays = partitionDays;
+  maintenanceRetentionDays = retentionDays;
+  maintenanceStop          = false;
+
+  if (pthread_create(&maintenanceThread, NULL, pgPartitionMaintenanceThread, NULL) != 0)
+    LM_RE(false, ("Internal Error (unable to create the TRoE partition maintenance thread: %s)", strerror(errno)));
+
+  maintenanceThreadRunning = true;
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPartitionMaintenanceStop -
+//
+void pgPartitionMaintenanceStop(void)
+{
+  if (maintenanceThreadRunning == false)
+    return;
+
+  pthread_mutex_lock(&maintenanceMutex);
+  maintenanceStop = true;
+  pthread_cond_signal(&maintenanceCond);
+  pthread_mutex_unlock(&maintenanceMutex);
+
+  pthread_join(maintenanceThread, NULL);
+  maintenanceThreadRunning = false;
+}
@@ -0,0 +1,301 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdio.h>                                             // snprintf, sscanf
+#include <string.h>                                            // strlen, strncmp, memset
+#include <time.h>                                              // time, timegm, gmtime_r, strftime
+#include <postgresql/libpq-fe.h>                               // PQexec, PQgetvalue, ...
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/troe/pgTransactionBegin.h"                   // pgTransactionBegin
+#include "orionld/troe/pgTransactionRollback.h"                // pgTransactionRollback
+#include "orionld/troe/pgTransactionCommit.h"                  // pgTransactionCommit
+#include "orionld/troe/pgPartitionsMaintain.h"                 // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// partitionedTable - the TRoE tables that are partitioned by range of 'ts'
+//
+// Lowercase, as postgres keeps the names of the relations (unquoted identifiers are case-folded)
+//
+static const char* partitionedTable[] = { "attributes", "subattributes" };
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dayFromDate - number of days since the epoch
+//
+static int dayFromDate(int year, int month, int mday)
+{
+  struct tm tm;
+
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = year - 1900;
+  tm.tm_mon  = month - 1;
+  tm.tm_mday = mday;
+
+  return timegm(&tm) / 86400;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dayToString -
+//
+static void dayToString(int day, const char* format, char* buf, int bufSize)
+{
+  time_t     t = (time_t) day * 86400;
+  struct tm  tm;
+
+  gmtime_r(&t, &tm);
+  strftime(buf, bufSize, format, &tm);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// dayAlign - first day of the partition period of 'day'
+//
+// Day 4 since the epoch (1970-01-05) is a Monday, so weekly partitions start on Mondays
+//
+static int dayAlign(int day, int width)
+{
+  return day - ((((day - 4) % width) + width) % width);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgTablePartitioned -
+//
+static bool pgTablePartitioned(PGconn* connectionP, const char* table)
+{
+  char sql[128];
+
+  snprintf(sql, sizeof(sql), "SELECT relkind FROM pg_class WHERE oid = to_regclass('%s')", table);
+
+  PGresult* res = PQexec(connectionP, sql);
+  if (res == NULL)
+    return false;
+
+  bool partitioned = (PQresultStatus(res) == PGRES_TUPLES_OK) && (PQntuples(res) == 1) && (PQgetvalue(res, 0, 0)[0] == 'p');
+
+  PQclear(res);
+  return partitioned;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPartitionDdl - execute a partition DDL command in a transaction of its own
+//
+// Creating and dropping partitions lock the parent table, so a lock timeout is used to not
+// hold up the TRoE writers for long - a command that fails is simply retried in the next round.
+//
+static bool pgPartitionDdl(PGconn* connectionP, const char* sql)
+{
+  if (pgTransactionBegin(connectionP) == false)
+    return false;
+
+  PGresult* res = PQexec(connectionP, "SET LOCAL lock_timeout = '10s'");
+  if (res != NULL)
+    PQclear(res);
+
+  res = PQexec(connectionP, sql);
+  if ((res == NULL) || (PQresultStatus(res) != PGRES_COMMAND_OK))
+  {
+    LM_W(("Database Error (%s: %s)", sql, PQerrorMessage(connectionP)));
+
+    if (res != NULL)
+      PQclear(res);
+
+    pgTransactionRollback(connectionP);
+    return false;
+  }
+  PQclear(res);
+
+  return pgTransactionCommit(connectionP);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPartitionCreate - create the partition [from, to) of 'table'
+//
+// Creating a partition fails if the default partition has rows in its range (e.g. rows written while the broker
+// was down, or before partitioning was turned on). If so, those rows are moved to the new partition, all in one
+// transaction, so they're not stuck in the default partition (and out of reach of the retention).
+//
+static bool pgPartitionCreate(PGconn* connectionP, const char* table, const char* partition, const char* from, const char* to)
+{
+  char sql[1024];
+
+  snprintf(sql, sizeof(sql), "CREATE TABLE IF NOT EXISTS %s PARTITION OF %s FOR VALUES FROM ('%s') TO ('%s')", partition, table, from, to);
+
+  if (pgPartitionDdl(connectionP, sql) == true)
+    return true;
+
+  snprintf(sql, sizeof(sql),
+           "CREATE TEMP TABLE troe_partition_rows ON COMMIT DROP AS SELECT * FROM %s_default WHERE ts >= '%s' AND ts < '%s'; "
+           "DELETE FROM %s_default WHERE ts >= '%s' AND ts < '%s'; "
+           "CREATE TABLE IF NOT EXISTS %s PARTITION OF %s FOR VALUES FROM ('%s') TO ('%s'); "
+           "INSERT INTO %s SELECT * FROM troe_partition_rows",
+           table, from, to,
+           table, from, to,
+           partition, table, from, to,
+           table);
+
+  if (pgPartitionDdl(connectionP, sql) == false)
+    return false;
+
+  LM_I(("Moved the rows of the TRoE default partition of '%s' in [%s, %s) to the new partition '%s'", table, from, to, partition));
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgTablePartitionsMaintain -
+//
+static void pgTablePartitionsMaintain(PGconn* connectionP, const char* table, int width, int retention, int today)
+{
+  if (pgTablePartitioned(connectionP, table) == false)
+    return;
+
+  char sql[512];
+  char prefix[32];
+  int  prefixLen;
+  int  maxUpper = 0;
+
+  snprintf(prefix, sizeof(prefix), "%s_p", table);
+  prefixLen = strlen(prefix);
+
+  snprintf(sql, sizeof(sql), "SELECT c.relname FROM pg_inherits i JOIN pg_class c ON c.oid = i.inhrelid WHERE i.inhparent = to_regclass('%s')", table);
+
+  PGresult* res = PQexec(connectionP, sql);
+  if ((res == NULL) || (PQresultStatus(res) != PGRES_TUPLES_OK))
+  {
+    LM_E(("Database Error (unable to list the partitions of '%s': %s)", table, PQerrorMessage(connectionP)));
+    if (res != NULL)
+      PQclear(res);
+    return;
+  }
+
+  //
+  // Drop the expired partitions and find the end of the last partition
+  //
+  for (int row = 0; row < PQntuples(res); row++)
+  {
+    const char* relname = PQgetvalue(res, row, 0);
+    int         fromYear, fromMonth, fromDay;
+    int         toYear,   toMonth,   toDay;
+
+    // The default partition, and partitions not created by the broker, are left alone
+    if (strncmp(relname, prefix, prefixLen) != 0)
+      continue;
+
+    if (sscanf(&relname[prefixLen], "%4d%2d%2d_%4d%2d%2d", &fromYear, &fromMonth, &fromDay, &toYear, &toMonth, &toDay) != 6)
+      continue;
+
+    int upper = dayFromDate(toYear, toMonth, toDay);
+
+    if ((retention > 0) && (upper <= today - retention))
+    {
+      snprintf(sql, sizeof(sql), "DROP TABLE IF EXISTS %s", relname);
+      if (pgPartitionDdl(connectionP, sql) == true)
+        LM_I(("Dropped the expired TRoE partition '%s'", relname));
+      continue;
+    }
+
+    if (upper > maxUpper)
+      maxUpper = upper;
+  }
+  PQclear(res);
+
+  //
+  // Create the partitions for the current period and the two periods that follow.
+  // If the broker has been down for a while, the gap is not filled - rows in the gap (if any) stay in the default partition.
+  //
+  int start   = dayAlign(today, width);
+  int horizon = start + 3 * width;
+
+  if (maxUpper > start)
+    start = maxUpper;
+
+  while (start < horizon)
+  {
+    int   end = dayAlign(start, width) + width;
+    char  fromName[16];
+    char  toName[16];
+    char  from[16];
+    char  to[16];
+    char  partition[64];
+
+    dayToString(start, "%Y%m%d",   fromName, sizeof(fromName));
+    dayToString(end,   "%Y%m%d",   toName,   sizeof(toName));
+    dayToString(start, "%Y-%m-%d", from,     sizeof(from));
+    dayToString(end,   "%Y-%m-%d", to,       sizeof(to));
+
+    snprintf(partition, sizeof(partition), "%s%s_%s", prefix, fromName, toName);
+
+    //
+    // A failure (lock timeout, a range that overlaps a partition that was created by hand, ...) only affects
+    // this period - the periods after it are still created, and the failing one is retried in the next round
+    //
+    if (pgPartitionCreate(connectionP, table, partition, from, to) == false)
+      LM_E(("Database Error (unable to create the TRoE partition '%s' for [%s, %s) - retried in the next round)", partition, from, to));
+
+    start = end;
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPartitionsMaintain -
+//
+void pgPartitionsMaintain(PGconn* connectionP, int partitionDays, int retentionDays)
+{
+  if (partitionDays <= 0)
+    return;
+
+  int today = time(NULL) / 86400;
+
+  for (unsigned int ix = 0; ix < sizeof(partitionedTable) / sizeof(partitionedTable[0]); ix++)
+  {
+    pgTablePartitionsMaintain(connectionP, partitionedTable[ix], partitionDays, retentionDays, today);
+  }
+}
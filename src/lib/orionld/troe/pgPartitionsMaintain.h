@@ -0,0 +1,45 @@
+#ifndef SRC_LIB_ORIONLD_TROE_PGPARTITIONSMAINTAIN_H_
+#define SRC_LIB_ORIONLD_TROE_PGPARTITIONSMAINTAIN_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <postgresql/libpq-fe.h>                                 // PGconn
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgPartitionsMaintain - maintain the time partitions of the TRoE tables of a database
+//
+// The tables 'attributes' and 'subAttributes' are partitioned by range of 'ts', in partitions
+// of 'partitionDays' days each (weekly partitions start on Mondays), named <table>_pYYYYMMDD_YYYYMMDD.
+// Partitions are created for the current period and the two periods that follow.
+// With 'retentionDays' > 0, the partitions that end 'retentionDays' days ago or earlier are dropped.
+//
+// Tables that are not partitioned (databases created by older versions of the broker) are left untouched.
+//
+extern void pgPartitionsMaintain(PGconn* connectionP, int partitionDays, int retentionDays);
+
+#endif  // SRC_LIB_ORIONLD_TROE_PGPARTITIONSMAINTAIN_H_
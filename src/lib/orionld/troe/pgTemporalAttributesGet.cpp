@@ -0,0 +1,503 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdio.h>                                             // snprintf
+#include <stdlib.h>                                            // free, strtoll, strtod
+#include <string.h>                                            // strcmp, strncmp, strpbrk
+#include <postgresql/libpq-fe.h>                               // PGconn, PQexec, ...
+
+extern "C"
+{
+#include "kalloc/kaAlloc.h"                                    // kaAlloc
+#include "kalloc/kaStrdup.h"                                   // kaStrdup
+#include "kjson/KjNode.h"                                      // KjNode
+#include "kjson/kjBuilder.h"                                   // kjObject, kjArray, kjString, kjInteger, kjFloat, kjBoolean, kjChildAdd
+#include "kjson/kjLookup.h"                                    // kjLookup
+#include "kjson/kjParse.h"                                     // kjParse
+}
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/common/orionldState.h"                       // orionldState
+#include "orionld/troe/PgAppendBuffer.h"                       // PgAppendBuffer
+#include "orionld/troe/pgAppendInit.h"                         // pgAppendInit
+#include "orionld/troe/pgAppend.h"                             // pgAppend
+#include "orionld/troe/pgLiteralListAppend.h"                  // pgLiteralListAppend
+#include "orionld/troe/pgTransactionBegin.h"                   // pgTransactionBegin
+#include "orionld/troe/pgTransactionCommit.h"                  // pgTransactionCommit
+#include "orionld/troe/pgTransactionRollback.h"                // pgTransactionRollback
+#include "orionld/troe/PgTemporalQuery.h"                      // PgTemporalQuery
+#include "orionld/troe/pgTemporalAttributesGet.h"              // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Rows are fetched from the cursor in chunks of TEMPORAL_FETCH_SIZE - only one chunk is kept in memory by libpq
+//
+#define TEMPORAL_FETCH_SIZE         500
+#define PG_ISO8601                  "'YYYY-MM-DD\"T\"HH24:MI:SS.MS\"Z\"'"
+#define PG_GEOJSON(t)               "ST_AsGeoJSON(COALESCE(" t ".geoPoint::geometry, " t ".geoMultiPoint::geometry, " t ".geoPolygon::geometry, " \
+                                    t ".geoMultiPolygon::geometry, " t ".geoLineString::geometry, " t ".geoMultiLineString::geometry))"
+#define PG_VALUE_COLUMNS(t)         t ".valueType, " t ".text, " t ".boolean, " t ".number, to_char(" t ".datetime, " PG_ISO8601 "), " \
+                                    t ".compound::text, " PG_GEOJSON(t)
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Column indices of the SELECT - the value columns (PG_VALUE_COLUMNS) start with the valueType and are always in the same order:
+//   valueType, text, boolean, number, datetime, compound, geo
+//
+#define COL_ENTITY_ID         0
+#define COL_ATTR_NAME         1
+#define COL_INSTANCE_ID       2
+#define COL_DATASET_ID        3
+#define COL_VALUE_TYPE        4
+#define COL_OBSERVED_AT      11
+#define COL_UNIT_CODE        12
+#define COL_TS               13
+#define COL_SUB_NAME         14
+#define COL_SUB_VALUE_TYPE   15
+#define COL_SUB_OBSERVED_AT  22
+#define COL_SUB_UNIT_CODE    23
+
+#define VALUE_TEXT            1
+#define VALUE_BOOLEAN         2
+#define VALUE_NUMBER          3
+#define VALUE_DATETIME        4
+#define VALUE_COMPOUND        5
+#define VALUE_GEO             6
+
+static const char* columns =
+  "a.entityId, a.id, a.instanceId, a.datasetId, "
+  PG_VALUE_COLUMNS("a") ", "
+  "to_char(a.observedAt, " PG_ISO8601 "), a.unitCode, to_char(a.ts, " PG_ISO8601 "), "
+  "s.id, "
+  PG_VALUE_COLUMNS("s") ", "
+  "to_char(s.observedAt, " PG_ISO8601 "), s.unitCode";
+
+
+
+// -----------------------------------------------------------------------------
+//
+// TemporalStream - where the rows of the cursor are currently being added
+//
+// The rows come ordered by entity, attribute, datasetId, and time, so the current attribute and instance are
+// kept, instead of looked up for every row.
+// An attribute instance with sub-attributes comes in as many rows as it has sub-attributes (LEFT JOIN).
+//
+typedef struct TemporalStream
+{
+  PgTemporalQuery*  tqP;
+  KjNode*           entityArray;
+  KjNode*           entityP;      // Current entity
+  KjNode*           attrP;        // Current attribute - array of instances
+  KjNode*           instanceP;    // Current attribute instance
+  char*             instanceId;   // instanceId of the current attribute instance
+} TemporalStream;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgString - a string column, copied to kalloc memory (the PGresult is freed after each FETCH) - NULL for SQL NULL
+//
+static char* pgString(PGresult* res, int row, int col)
+{
+  if (PQgetisnull(res, row, col))
+    return NULL;
+
+  return kaStrdup(&orionldState.kalloc, PQgetvalue(res, row, col));
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgJson - a JSON text column (compound values and GeoJSON), parsed into a KjNode tree
+//
+static KjNode* pgJson(PGresult* res, int row, int col, const char* name)
+{
+  char*   json  = pgString(res, row, col);
+  KjNode* nodeP = (json != NULL)? kjParse(orionldState.kjsonP, json) : NULL;
+
+  if (nodeP == NULL)
+  {
+    LM_E(("Database Error (unable to parse the JSON value of column %d)", col));
+    return NULL;
+  }
+
+  nodeP->name = (char*) name;
+  return nodeP;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// valueAdd - add "type" and "value" (or "object", "languageMap") to an attribute instance or a sub-attribute
+//
+static void valueAdd(KjNode* containerP, PGresult* res, int row, int vtCol)
+{
+  if (PQgetisnull(res, row, vtCol))
+    return;
+
+  const char* valueType = PQgetvalue(res, row, vtCol);
+  const char* type      = "Property";
+  KjNode*     valueP    = NULL;
+
+  if (strcmp(valueType, "Relationship") == 0)
+  {
+    type   = "Relationship";
+    valueP = kjString(orionldState.kjsonP, "object", pgString(res, row, vtCol + VALUE_TEXT));
+  }
+  else if (strcmp(valueType, "String") == 0)
+    valueP = kjString(orionldState.kjsonP, "value", pgString(res, row, vtCol + VALUE_TEXT));
+  else if (strcmp(valueType, "Boolean") == 0)
+    valueP = kjBoolean(orionldState.kjsonP, "value", PQgetvalue(res, row, vtCol + VALUE_BOOLEAN)[0] == 't');
+  else if (strcmp(valueType, "Number") == 0)
+  {
+    const char* number = PQgetvalue(res, row, vtCol + VALUE_NUMBER);
+
+    // Integers are stored as FLOAT8 - give them back as integers
+    if (strpbrk(number, ".eEnNI") == NULL)
+      valueP = kjInteger(orionldState.kjsonP, "value", strtoll(number, NULL, 10));
+    else
+      valueP = kjFloat(orionldState.kjsonP, "value", strtod(number, NULL));
+  }
+  else if (strcmp(valueType, "DateTime") == 0)
+  {
+    valueP = kjObject(orionldState.kjsonP, "value");
+    kjChildAdd(valueP, kjString(orionldState.kjsonP, "@type",  "DateTime"));
+    kjChildAdd(valueP, kjString(orionldState.kjsonP, "@value", pgString(res, row, vtCol + VALUE_DATETIME)));
+  }
+  else if (strcmp(valueType, "Compound") == 0)
+    valueP = pgJson(res, row, vtCol + VALUE_COMPOUND, "value");
+  else if (strcmp(valueType, "LanguageMap") == 0)
+  {
+    type   = "LanguageProperty";
+    valueP = pgJson(res, row, vtCol + VALUE_COMPOUND, "languageMap");
+  }
+  else if (strncmp(valueType, "Geo", 3) == 0)
+  {
+    type   = "GeoProperty";
+    valueP = pgJson(res, row, vtCol + VALUE_GEO, "value");
+  }
+
+  kjChildAdd(containerP, kjString(orionldState.kjsonP, "type", type));
+
+  if (valueP != NULL)
+    kjChildAdd(containerP, valueP);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// stringAdd - add a string column to a tree, unless it's NULL
+//
+static void stringAdd(KjNode* containerP, const char* name, PGresult* res, int row, int col)
+{
+  char* s = pgString(res, row, col);
+
+  if (s != NULL)
+    kjChildAdd(containerP, kjString(orionldState.kjsonP, name, s));
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// entityLookup - find the entity of a row
+//
+// As both the entity array and the rows are ordered by entity id, the entity is most probably the next one.
+//
+static KjNode* entityLookup(TemporalStream* streamP, const char* entityId)
+{
+  KjNode* startP = (streamP->entityP != NULL)? streamP->entityP->next : streamP->entityArray->value.firstChildP;
+
+  for (KjNode* entityP = startP; entityP != NULL; entityP = entityP->next)
+  {
+    if (strcmp(kjLookup(entityP, "id")->value.s, entityId) == 0)
+      return entityP;
+  }
+
+  for (KjNode* entityP = streamP->entityArray->value.firstChildP; entityP != startP; entityP = entityP->next)
+  {
+    if (strcmp(kjLookup(entityP, "id")->value.s, entityId) == 0)
+      return entityP;
+  }
+
+  return NULL;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// rowTreat - add a row of the cursor to the entity array
+//
+static void rowTreat(TemporalStream* streamP, PGresult* res, int row)
+{
+  const char* entityId = PQgetvalue(res, row, COL_ENTITY_ID);
+
+  if ((streamP->entityP == NULL) || (strcmp(kjLookup(streamP->entityP, "id")->value.s, entityId) != 0))
+  {
+    KjNode* entityP = entityLookup(streamP, entityId);
+
+    if (entityP == NULL)
+    {
+      LM_E(("Internal Error (attribute instance of entity '%s' that is not part of the query)", entityId));
+      return;
+    }
+
+    streamP->entityP   = entityP;
+    streamP->attrP     = NULL;
+    streamP->instanceP = NULL;
+  }
+
+  const char* attrName = PQgetvalue(res, row, COL_ATTR_NAME);
+
+  if ((streamP->attrP == NULL) || (strcmp(streamP->attrP->name, attrName) != 0))
+  {
+    streamP->attrP     = kjArray(orionldState.kjsonP, kaStrdup(&orionldState.kalloc, attrName));
+    streamP->instanceP = NULL;
+    kjChildAdd(streamP->entityP, streamP->attrP);
+  }
+
+  const char* instanceId = PQgetvalue(res, row, COL_INSTANCE_ID);
+
+  if ((streamP->instanceP == NULL) || (strcmp(streamP->instanceId, instanceId) != 0))
+  {
+    KjNode* instanceP = kjObject(orionldState.kjsonP, NULL);
+
+    valueAdd(instanceP, res, row, COL_VALUE_TYPE);
+
+    streamP->instanceId = kaStrdup(&orionldState.kalloc, instanceId);
+    kjChildAdd(instanceP, kjString(orionldState.kjsonP, "instanceId", streamP->instanceId));
+
+    const char* datasetId = PQgetvalue(res, row, COL_DATASET_ID);
+    if (strcmp(datasetId, "None") != 0)
+      kjChildAdd(instanceP, kjString(orionldState.kjsonP, "datasetId", kaStrdup(&orionldState.kalloc, datasetId)));
+
+    stringAdd(instanceP, "observedAt", res, row, COL_OBSERVED_AT);
+    stringAdd(instanceP, "unitCode",   res, row, COL_UNIT_CODE);
+
+    if (strcmp(streamP->tqP->timeColumn, "ts") == 0)
+      stringAdd(instanceP, streamP->tqP->timeProperty, res, row, COL_TS);
+
+    kjChildAdd(streamP->attrP, instanceP);
+    streamP->instanceP = instanceP;
+  }
+
+  if (PQgetisnull(res, row, COL_SUB_NAME) == false)
+  {
+    KjNode* subAttrP = kjObject(orionldState.kjsonP, kaStrdup(&orionldState.kalloc, PQgetvalue(res, row, COL_SUB_NAME)));
+
+    valueAdd(subAttrP, res, row, COL_SUB_VALUE_TYPE);
+    stringAdd(subAttrP, "observedAt", res, row, COL_SUB_OBSERVED_AT);
+    stringAdd(subAttrP, "unitCode",   res, row, COL_SUB_UNIT_CODE);
+
+    kjChildAdd(streamP->instanceP, subAttrP);
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// attributeSelectAppend - the SELECT of the matching attribute instances, with all filters pushed down
+//
+// SELECT * FROM attributes WHERE opMode != 'Delete' AND entityId IN (...) AND id IN (...) AND observedAt < to_timestamp(T) AT TIME ZONE 'UTC'
+//
+// With lastN, the instances are numbered per attribute (entityId, id, datasetId), newest first, and only the first N are kept:
+//
+// SELECT * FROM (SELECT *, ROW_NUMBER() OVER (PARTITION BY entityId, id, datasetId ORDER BY observedAt DESC NULLS LAST, ts DESC) AS rowNo
+//                FROM attributes WHERE ...) l WHERE rowNo <= N
+//
+static bool attributeSelectAppend(PgAppendBuffer* sqlP, PGconn* connectionP, PgTemporalQuery* tqP, KjNode* entityArray)
+{
+  if (tqP->lastN > 0)
+  {
+    pgAppend(sqlP, "SELECT * FROM (SELECT *, ROW_NUMBER() OVER (PARTITION BY entityId, id, datasetId ORDER BY ", 0);
+    pgAppend(sqlP, tqP->timeColumn, 0);
+    pgAppend(sqlP, " DESC NULLS LAST, ts DESC) AS rowNo FROM attributes", 0);
+  }
+  else
+    pgAppend(sqlP, "SELECT * FROM attributes", 0);
+
+  //
+  // The entities of the page
+  //
+  int     entities = 0;
+  char**  entityIdV;
+
+  for (KjNode* entityP = entityArray->value.firstChildP; entityP != NULL; entityP = entityP->next)
+    ++entities;
+
+  entityIdV = (char**) kaAlloc(&orionldState.kalloc, entities * sizeof(char*));
+  entities  = 0;
+  for (KjNode* entityP = entityArray->value.firstChildP; entityP != NULL; entityP = entityP->next)
+    entityIdV[entities++] = kjLookup(entityP, "id")->value.s;
+
+  pgAppend(sqlP, " WHERE opMode != 'Delete' AND entityId IN ", 0);
+  if (pgLiteralListAppend(sqlP, connectionP, entityIdV, entities) == false)
+    return false;
+
+  //
+  // attrs
+  //
+  if (tqP->attrV != NULL)
+  {
+    pgAppend(sqlP, " AND id IN ", 0);
+    if (pgLiteralListAppend(sqlP, connectionP, tqP->attrV, tqP->attrs) == false)
+      return false;
+  }
+
+  //
+  // timerel - the times are given to postgres as seconds since the epoch, no user input goes into the SQL
+  //
+  if (tqP->timerel != NULL)
+  {
+    char timeFilter[256];
+
+    if (strcmp(tqP->timerel, "before") == 0)
+      snprintf(timeFilter, sizeof(timeFilter), " AND %s < to_timestamp(%f) AT TIME ZONE 'UTC'", tqP->timeColumn, tqP->timeAt);
+    else if (strcmp(tqP->timerel, "after") == 0)
+      snprintf(timeFilter, sizeof(timeFilter), " AND %s > to_timestamp(%f) AT TIME ZONE 'UTC'", tqP->timeColumn, tqP->timeAt);
+    else  // between
+      snprintf(timeFilter, sizeof(timeFilter), " AND %s >= to_timestamp(%f) AT TIME ZONE 'UTC' AND %s < to_timestamp(%f) AT TIME ZONE 'UTC'",
+               tqP->timeColumn, tqP->timeAt, tqP->timeColumn, tqP->endTimeAt);
+
+    pgAppend(sqlP, timeFilter, 0);
+  }
+
+  if (tqP->lastN > 0)
+  {
+    char lastN[64];
+
+    snprintf(lastN, sizeof(lastN), ") l WHERE rowNo <= %d", tqP->lastN);
+    pgAppend(sqlP, lastN, 0);
+  }
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// cursorDeclare -
+//
+static bool cursorDeclare(PGconn* connectionP, PgTemporalQuery* tqP, KjNode* entityArray)
+{
+  PgAppendBuffer  sql;
+  bool            ok = true;
+
+  pgAppendInit(&sql, 4 * 1024);
+  pgAppend(&sql, "DECLARE temporalCursor NO SCROLL CURSOR FOR SELECT ", 0);
+  pgAppend(&sql, columns, 0);
+  pgAppend(&sql, " FROM (", 0);
+
+  if (attributeSelectAppend(&sql, connectionP, tqP, entityArray) == true)
+  {
+    pgAppend(&sql, ") a LEFT JOIN subAttributes s ON (a.subProperties = true AND s.attrInstanceId = a.instanceId AND s.attrDatasetId = a.datasetId)", 0);
+    pgAppend(&sql, " ORDER BY a.entityId, a.id, a.datasetId, a.ts, a.instanceId", 0);
+
+    PGresult* res = PQexec(connectionP, sql.buf);
+
+    if ((res == NULL) || (PQresultStatus(res) != PGRES_COMMAND_OK))
+    {
+      LM_E(("Database Error (%s: %s)", PQresStatus(PQresultStatus(res)), PQerrorMessage(connectionP)));
+      ok = false;
+    }
+
+    PQclear(res);
+  }
+  else
+    ok = false;
+
+  if (sql.allocated == true)
+    free(sql.buf);
+
+  return ok;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgTemporalAttributesGet -
+//
+// A cursor only lives inside a transaction - the transaction is read-only and simply committed at the end.
+//
+bool pgTemporalAttributesGet(PGconn* connectionP, PgTemporalQuery* tqP, KjNode* entityArray)
+{
+  if (entityArray->value.firstChildP == NULL)
+    return true;
+
+  if (pgTransactionBegin(connectionP) != true)
+  {
+    LM_E(("pgTransactionBegin failed"));
+    return false;
+  }
+
+  if (cursorDeclare(connectionP, tqP, entityArray) == false)
+  {
+    pgTransactionRollback(connectionP);
+    return false;
+  }
+
+  TemporalStream stream = { tqP, entityArray, NULL, NULL, NULL, NULL };
+  char           fetch[64];
+  int            rows;
+
+  snprintf(fetch, sizeof(fetch), "FETCH %d FROM temporalCursor", TEMPORAL_FETCH_SIZE);
+
+  do
+  {
+    PGresult* res = PQexec(connectionP, fetch);
+
+    if ((res == NULL) || (PQresultStatus(res) != PGRES_TUPLES_OK))
+    {
+      LM_E(("Database Error (%s: %s)", PQresStatus(PQresultStatus(res)), PQerrorMessage(connectionP)));
+      PQclear(res);
+      pgTransactionRollback(connectionP);
+      return false;
+    }
+
+    rows = PQntuples(res);
+    for (int row = 0; row < rows; row++)
+      rowTreat(&stream, res, row);
+
+    PQclear(res);
+  } while (rows == TEMPORAL_FETCH_SIZE);
+
+  if (pgTransactionCommit(connectionP) != true)
+    LM_E(("pgTransactionCommit failed"));
+
+  return true;
+}
@@ -0,0 +1,56 @@
+#ifndef SRC_LIB_ORIONLD_TROE_PGTEMPORALATTRIBUTESGET_H_
+#define SRC_LIB_ORIONLD_TROE_PGTEMPORALATTRIBUTESGET_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <postgresql/libpq-fe.h>                                 // PGconn
+
+extern "C"
+{
+#include "kjson/KjNode.h"                                        // KjNode
+}
+
+#include "orionld/troe/PgTemporalQuery.h"                        // PgTemporalQuery
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgTemporalAttributesGet - add the matching attribute instances to the entities of 'entityArray'
+//
+// 'entityArray' is the output of pgTemporalEntitiesGet. The attribute instances are streamed from the database
+// using a server-side cursor and each attribute is added to its entity as an array of instances (the temporal
+// representation), with the attribute names (and sub-attribute names) expanded:
+//
+//   "https://uri.etsi.org/ngsi-ld/default-context/P1": [
+//     { "type": "Property", "value": 12, "instanceId": "urn:ngsi-ld:attribute:instance:...", "observedAt": "..." },
+//     ...
+//   ]
+//
+// Returns false on database error.
+//
+extern bool pgTemporalAttributesGet(PGconn* connectionP, PgTemporalQuery* tqP, KjNode* entityArray);
+
+#endif  // SRC_LIB_ORIONLD_TROE_PGTEMPORALATTRIBUTESGET_H_
@@ -0,0 +1,176 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdio.h>                                             // snprintf
+#include <stdlib.h>                                            // free, atoi
+#include <postgresql/libpq-fe.h>                               // PGconn, PQexec, ...
+
+extern "C"
+{
+#include "kalloc/kaStrdup.h"                                   // kaStrdup
+#include "kjson/KjNode.h"                                      // KjNode
+#include "kjson/kjBuilder.h"                                   // kjArray, kjObject, kjString, kjChildAdd
+}
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/common/orionldState.h"                       // orionldState
+#include "orionld/troe/PgAppendBuffer.h"                       // PgAppendBuffer
+#include "orionld/troe/pgAppendInit.h"                         // pgAppendInit
+#include "orionld/troe/pgAppend.h"                             // pgAppend
+#include "orionld/troe/pgLiteral.h"                            // pgLiteral
+#include "orionld/troe/pgLiteralListAppend.h"                  // pgLiteralListAppend
+#include "orionld/troe/PgTemporalQuery.h"                      // PgTemporalQuery
+#include "orionld/troe/pgTemporalEntitiesGet.h"                // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// entitySelectAppend - the SELECT of the latest instance of all matching entities, with its filters
+//
+// SELECT id, type FROM (SELECT DISTINCT ON (id) id, type FROM entities WHERE opMode != 'Delete' AND id IN (...) AND id ~ '...' ORDER BY id, ts DESC) e
+//   WHERE type IN (...)
+//
+// The type filter goes outside the DISTINCT ON, so that it applies to the current type of the entity.
+//
+static bool entitySelectAppend(PgAppendBuffer* sqlP, PGconn* connectionP, PgTemporalQuery* tqP, const char* columns)
+{
+  pgAppend(sqlP, "SELECT ", 7);
+  pgAppend(sqlP, columns, 0);
+  pgAppend(sqlP, " FROM (SELECT DISTINCT ON (id) id, type FROM entities WHERE opMode != 'Delete'", 0);
+
+  if (tqP->idV != NULL)
+  {
+    pgAppend(sqlP, " AND id IN ", 0);
+    if (pgLiteralListAppend(sqlP, connectionP, tqP->idV, tqP->ids) == false)
+      return false;
+  }
+
+  if (tqP->idPattern != NULL)
+  {
+    char* pattern = pgLiteral(connectionP, tqP->idPattern);
+
+    if (pattern == NULL)
+      return false;
+
+    pgAppend(sqlP, " AND id ~ ", 0);
+    pgAppend(sqlP, pattern, 0);
+  }
+
+  pgAppend(sqlP, " ORDER BY id, ts DESC) e", 0);
+
+  if (tqP->typeV != NULL)
+  {
+    pgAppend(sqlP, " WHERE type IN ", 0);
+    if (pgLiteralListAppend(sqlP, connectionP, tqP->typeV, tqP->types) == false)
+      return false;
+  }
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// sqlSelect - execute a SELECT and make sure it worked
+//
+static PGresult* sqlSelect(PGconn* connectionP, PgAppendBuffer* sqlP)
+{
+  PGresult* res = PQexec(connectionP, sqlP->buf);
+
+  if (sqlP->allocated == true)
+    free(sqlP->buf);
+
+  if ((res == NULL) || (PQresultStatus(res) != PGRES_TUPLES_OK))
+  {
+    LM_E(("Database Error (%s: %s)", PQresStatus(PQresultStatus(res)), PQerrorMessage(connectionP)));
+    PQclear(res);
+    return NULL;
+  }
+
+  return res;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgTemporalEntitiesGet -
+//
+KjNode* pgTemporalEntitiesGet(PGconn* connectionP, PgTemporalQuery* tqP, int offset, int limit, int* countP)
+{
+  PgAppendBuffer  sql;
+  PGresult*       res;
+
+  if (countP != NULL)
+  {
+    pgAppendInit(&sql, 1024);
+
+    if (entitySelectAppend(&sql, connectionP, tqP, "count(*)") == false)
+      return NULL;
+
+    if ((res = sqlSelect(connectionP, &sql)) == NULL)
+      return NULL;
+
+    *countP = atoi(PQgetvalue(res, 0, 0));
+    PQclear(res);
+  }
+
+  KjNode* entityArray = kjArray(orionldState.kjsonP, NULL);
+
+  if (limit == 0)  // count only
+    return entityArray;
+
+  char pagination[64];
+
+  pgAppendInit(&sql, 1024);
+
+  if (entitySelectAppend(&sql, connectionP, tqP, "id, type") == false)
+    return NULL;
+
+  snprintf(pagination, sizeof(pagination), " ORDER BY id OFFSET %d LIMIT %d", offset, limit);
+  pgAppend(&sql, pagination, 0);
+
+  if ((res = sqlSelect(connectionP, &sql)) == NULL)
+    return NULL;
+
+  int rows = PQntuples(res);
+
+  for (int row = 0; row < rows; row++)
+  {
+    KjNode* entityP = kjObject(orionldState.kjsonP, NULL);
+
+    // The PGresult is freed before the tree is rendered - the strings must be copied
+    kjChildAdd(entityP, kjString(orionldState.kjsonP, "id",   kaStrdup(&orionldState.kalloc, PQgetvalue(res, row, 0))));
+    kjChildAdd(entityP, kjString(orionldState.kjsonP, "type", kaStrdup(&orionldState.kalloc, PQgetvalue(res, row, 1))));
+    kjChildAdd(entityArray, entityP);
+  }
+
+  PQclear(res);
+
+  return entityArray;
+}
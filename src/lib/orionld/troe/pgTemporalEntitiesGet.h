@@ -0,0 +1,55 @@
+#ifndef SRC_LIB_ORIONLD_TROE_PGTEMPORALENTITIESGET_H_
+#define SRC_LIB_ORIONLD_TROE_PGTEMPORALENTITIESGET_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <postgresql/libpq-fe.h>                                 // PGconn
+
+extern "C"
+{
+#include "kjson/KjNode.h"                                        // KjNode
+}
+
+#include "orionld/troe/PgTemporalQuery.h"                        // PgTemporalQuery
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgTemporalEntitiesGet - one page of the entities that match the entity filter of a temporal query
+//
+// The entities are returned as an array of objects with the fields "id" and "type" (expanded), ordered by entity id:
+// [
+//   { "id": "urn:E1", "type": "https://uri.etsi.org/ngsi-ld/default-context/T" },
+//   ...
+// ]
+// The type of an entity is the type of its latest (non-deletion) instance.
+//
+// If 'countP' is non-NULL, the total number of matching entities is returned in *countP.
+// NULL is returned on database error.
+//
+extern KjNode* pgTemporalEntitiesGet(PGconn* connectionP, PgTemporalQuery* tqP, int offset, int limit, int* countP);
+
+#endif  // SRC_LIB_ORIONLD_TROE_PGTEMPORALENTITIESGET_H_
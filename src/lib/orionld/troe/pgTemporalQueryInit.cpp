@@ -0,0 +1,191 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string.h>                                            // strcmp
+#include <strings.h>                                           // bzero
+#include <string>                                              // std::string
+
+extern "C"
+{
+#include "kalloc/kaAlloc.h"                                    // kaAlloc
+#include "kbase/kStringSplit.h"                                // kStringSplit
+}
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "common/globals.h"                                    // parse8601Time
+#include "orionld/common/orionldState.h"                       // orionldState
+#include "orionld/common/orionldErrorResponse.h"               // orionldErrorResponseCreate
+#include "orionld/context/orionldContextItemExpand.h"          // orionldContextItemExpand
+#include "orionld/context/orionldAttributeExpand.h"            // orionldAttributeExpand
+#include "orionld/troe/PgTemporalQuery.h"                      // PgTemporalQuery
+#include "orionld/troe/pgTemporalQueryInit.h"                  // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// badInput -
+//
+static bool badInput(const char* title, const char* detail)
+{
+  LM_W(("Bad Input (%s: %s)", title, detail));
+  orionldErrorResponseCreate(OrionldBadRequestData, title, detail);
+  orionldState.httpStatusCode = 400;
+
+  return false;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// listSplit - split a comma-separated URI parameter into a vector allocated with kalloc
+//
+static char** listSplit(char* list, int* itemsP)
+{
+  int items = 1;
+
+  for (char* cP = list; *cP != 0; ++cP)
+  {
+    if (*cP == ',')
+      ++items;
+  }
+
+  char** itemV = (char**) kaAlloc(&orionldState.kalloc, items * sizeof(char*));
+
+  *itemsP = kStringSplit(list, ',', itemV, items);
+
+  return itemV;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// timeParse -
+//
+static bool timeParse(const char* name, const char* value, double* timeP)
+{
+  if (value == NULL)
+    return badInput("Missing URI parameter", name);
+
+  if ((*timeP = parse8601Time(value)) == -1)
+    return badInput("Invalid ISO8601 DateTime in URI parameter", value);
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// pgTemporalQueryInit -
+//
+bool pgTemporalQueryInit(PgTemporalQuery* tqP, char* entityId)
+{
+  bzero(tqP, sizeof(PgTemporalQuery));
+
+  //
+  // timeproperty
+  //
+  const char* timeproperty = orionldState.uriParams.timeproperty;
+
+  if ((timeproperty == NULL) || (strcmp(timeproperty, "observedAt") == 0))
+    tqP->timeColumn = "observedAt";
+  else if ((strcmp(timeproperty, "modifiedAt") == 0) || (strcmp(timeproperty, "createdAt") == 0))
+    tqP->timeColumn = "ts";  // Every instance is a modification - its creation time is its modification time
+  else
+    return badInput("Invalid value for URI parameter /timeproperty/", timeproperty);
+
+  tqP->timeProperty = (timeproperty == NULL)? "observedAt" : timeproperty;
+
+  //
+  // timerel, timeAt, endTimeAt
+  //
+  const char* timerel = orionldState.uriParams.timerel;
+
+  if (timerel != NULL)
+  {
+    if ((strcmp(timerel, "before") != 0) && (strcmp(timerel, "after") != 0) && (strcmp(timerel, "between") != 0))
+      return badInput("Invalid value for URI parameter /timerel/", timerel);
+
+    if (timeParse("timeAt", orionldState.uriParams.timeAt, &tqP->timeAt) == false)
+      return false;
+
+    if (strcmp(timerel, "between") == 0)
+    {
+      if (timeParse("endTimeAt", orionldState.uriParams.endTimeAt, &tqP->endTimeAt) == false)
+        return false;
+
+      if (tqP->endTimeAt <= tqP->timeAt)
+        return badInput("Invalid time interval", "endTimeAt must be later than timeAt");
+    }
+
+    tqP->timerel = timerel;
+  }
+  else if ((orionldState.uriParams.timeAt != NULL) || (orionldState.uriParams.endTimeAt != NULL))
+    return badInput("Missing URI parameter", "timerel");
+
+  tqP->lastN = orionldState.uriParams.lastN;
+
+  //
+  // Entity filter
+  //
+  if (entityId != NULL)
+  {
+    tqP->idV    = (char**) kaAlloc(&orionldState.kalloc, sizeof(char*));
+    tqP->idV[0] = entityId;
+    tqP->ids    = 1;
+  }
+  else
+  {
+    if (orionldState.uriParams.id != NULL)
+      tqP->idV = listSplit(orionldState.uriParams.id, &tqP->ids);
+
+    if (orionldState.uriParams.type != NULL)
+    {
+      tqP->typeV = listSplit(orionldState.uriParams.type, &tqP->types);
+
+      for (int ix = 0; ix < tqP->types; ix++)
+        tqP->typeV[ix] = orionldContextItemExpand(orionldState.contextP, tqP->typeV[ix], true, NULL);
+    }
+
+    tqP->idPattern = orionldState.uriParams.idPattern;
+  }
+
+  //
+  // attrs - the attribute names are stored expanded in the TRoE database
+  //
+  if (orionldState.uriParams.attrs != NULL)
+  {
+    tqP->attrV = listSplit(orionldState.uriParams.attrs, &tqP->attrs);
+
+    for (int ix = 0; ix < tqP->attrs; ix++)
+      tqP->attrV[ix] = orionldAttributeExpand(orionldState.contextP, tqP->attrV[ix], true, NULL);
+  }
+
+  return true;
+}
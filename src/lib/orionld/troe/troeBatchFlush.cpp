@@ -0,0 +1,248 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string.h>                                            // strlen, strncmp, memcpy
+#include <stdlib.h>                                            // malloc, realloc, free
+#include <postgresql/libpq-fe.h>                               // PGconn
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/troe/PgTableDefinitions.h"                   // PG_ENTITY_INSERT_START, PG_ATTRIBUTE_INSERT_START, PG_SUB_ATTRIBUTE_INSERT_START
+#include "orionld/troe/PgConnection.h"                         // PgConnection
+#include "orionld/troe/pgConnectionGet.h"                      // pgConnectionGet
+#include "orionld/troe/pgConnectionRelease.h"                  // pgConnectionRelease
+#include "orionld/troe/pgTransactionBegin.h"                   // pgTransactionBegin
+#include "orionld/troe/pgTransactionRollback.h"                // pgTransactionRollback
+#include "orionld/troe/pgTransactionCommit.h"                  // pgTransactionCommit
+#include "orionld/troe/troeBatchFlush.h"                       // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// insertPrefixV - the INSERT statements that can be merged - in the order they're executed
+//
+static const char* insertPrefixV[3] = { PG_ENTITY_INSERT_START, PG_ATTRIBUTE_INSERT_START, PG_SUB_ATTRIBUTE_INSERT_START };
+
+
+
+// -----------------------------------------------------------------------------
+//
+// sqlExec - execute one statement, returns false on error
+//
+static bool sqlExec(PGconn* connectionP, const char* sql)
+{
+  PGresult* res = PQexec(connectionP, sql);
+
+  if (res == NULL)
+  {
+    LM_E(("Database Error (PQexec: %s)", PQerrorMessage(connectionP)));
+    return false;
+  }
+
+  ExecStatusType status = PQresultStatus(res);
+
+  if ((status != PGRES_COMMAND_OK) && (status != PGRES_TUPLES_OK))
+  {
+    LM_E(("Database Error (%s: %s)", PQresStatus(status), PQresultErrorMessage(res)));
+    PQclear(res);
+    return false;
+  }
+
+  PQclear(res);
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// mergedInsertBuild - concatenate the VALUES of all statements that start with 'prefix'
+//
+// Returns a malloced statement, or NULL if no statement starts with 'prefix'
+//
+static char* mergedInsertBuild(const char* prefix, char** sqlV, int statements, bool* mergedV)
+{
+  int    prefixLen = strlen(prefix);
+  char*  merged    = NULL;
+  int    size      = 0;
+  int    used      = 0;
+
+  for (int ix = 0; ix < statements; ix++)
+  {
+    if (strncmp(sqlV[ix], prefix, prefixLen) != 0)
+      continue;
+
+    const char* values    = &sqlV[ix][prefixLen];
+    int         valuesLen = strlen(values);
+    int         needed    = used + valuesLen + 3;  // ", " + '\0'
+
+    if (merged == NULL)
+      needed += prefixLen;
+
+    if (needed > size)
+    {
+      size   = needed * 2;
+      merged = (char*) realloc(merged, size);
+
+      if (merged == NULL)
+        LM_X(1, ("Out of memory (merging TRoE statements)"));
+    }
+
+    if (used == 0)
+    {
+      memcpy(merged, prefix, prefixLen);
+      used = prefixLen;
+    }
+    else
+    {
+      memcpy(&merged[used], ", ", 2);
+      used += 2;
+    }
+
+    memcpy(&merged[used], values, valuesLen);
+    used += valuesLen;
+    merged[used] = 0;
+
+    mergedV[ix] = true;
+  }
+
+  return merged;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// batchTransaction - all statements in one transaction, inserts merged
+//
+static bool batchTransaction(PGconn* connectionP, char** sqlV, int statements)
+{
+  bool* mergedV = (bool*) calloc(statements, sizeof(bool));
+
+  if (mergedV == NULL)
+    LM_X(1, ("Out of memory (merging TRoE statements)"));
+
+  if (pgTransactionBegin(connectionP) != true)
+  {
+    free(mergedV);
+    return false;
+  }
+
+  bool ok = true;
+
+  for (unsigned int pIx = 0; (ok == true) && (pIx < sizeof(insertPrefixV) / sizeof(insertPrefixV[0])); pIx++)
+  {
+    char* merged = mergedInsertBuild(insertPrefixV[pIx], sqlV, statements, mergedV);
+
+    if (merged != NULL)
+    {
+      ok = sqlExec(connectionP, merged);
+      free(merged);
+    }
+  }
+
+  // Statements that are not one of the known INSERTs are executed as they are
+  for (int ix = 0; (ok == true) && (ix < statements); ix++)
+  {
+    if (mergedV[ix] == false)
+      ok = sqlExec(connectionP, sqlV[ix]);
+  }
+
+  free(mergedV);
+
+  if (ok == false)
+  {
+    if (pgTransactionRollback(connectionP) == false)
+      LM_E(("Database Error (pgTransactionRollback failed too)"));
+    return false;
+  }
+
+  return pgTransactionCommit(connectionP);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeBatchFlush -
+//
+int troeBatchFlush(const char* db, char** sqlV, int* countV, int requests)
+{
+  PgConnection* connectionP = pgConnectionGet(db);
+  int           statements  = 0;
+
+  for (int rIx = 0; rIx < requests; rIx++)
+    statements += countV[rIx];
+
+  if ((connectionP == NULL) || (connectionP->connectionP == NULL))
+  {
+    if (connectionP != NULL)
+      pgConnectionRelease(connectionP);
+
+    LM_E(("Database Error (no connection to postgres for TRoE database '%s')", db));
+    return 0;
+  }
+
+  if (batchTransaction(connectionP->connectionP, sqlV, statements) == true)
+  {
+    pgConnectionRelease(connectionP);
+    return requests;
+  }
+
+  if (PQstatus(connectionP->connectionP) != CONNECTION_OK)
+  {
+    LM_E(("Database Error (bad postgres connection while flushing %d TRoE statements)", statements));
+    pgConnectionRelease(connectionP);
+    return 0;
+  }
+
+  //
+  // The connection is fine, so some row was refused - one transaction per request, to lose only the bad requests.
+  // The statements of a request are never split - a request is either written as a whole or not at all.
+  //
+  LM_W(("TRoE batch of %d requests failed - executing them one by one", requests));
+
+  int offset = 0;
+
+  for (int rIx = 0; rIx < requests; rIx++)
+  {
+    if (batchTransaction(connectionP->connectionP, &sqlV[offset], countV[rIx]) == false)
+    {
+      if (PQstatus(connectionP->connectionP) != CONNECTION_OK)
+      {
+        pgConnectionRelease(connectionP);
+        return rIx;
+      }
+
+      LM_E(("Database Error (TRoE request of %d statements refused by postgres - dropped)", countV[rIx]));
+    }
+
+    offset += countV[rIx];
+  }
+
+  pgConnectionRelease(connectionP);
+  return requests;
+}
@@ -0,0 +1,49 @@
+#ifndef SRC_LIB_ORIONLD_TROE_TROEBATCHFLUSH_H_
+#define SRC_LIB_ORIONLD_TROE_TROEBATCHFLUSH_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeBatchFlush - execute the SQL statements of many requests, in one single transaction
+//
+// The statements are TRoE INSERTs (built by pgEntityBuild, pgAttributeAppend, ...). All INSERTs into the
+// same table are merged into one multi-row INSERT.
+//
+// sqlV holds the statements of all requests, one request after the other, countV[i] is the number of
+// statements of request i.
+//
+// If the merged transaction fails while the connection is still fine (a bad row), the requests are
+// executed one by one, each in its own transaction, so that one bad request doesn't take the rest with it.
+//
+// Returns the number of requests that are done with (committed, or refused by postgres and dropped).
+// If less than 'requests', postgres is unreachable and the caller must keep the rest (spool them).
+//
+extern int troeBatchFlush(const char* db, char** sqlV, int* countV, int requests);
+
+#endif  // SRC_LIB_ORIONLD_TROE_TROEBATCHFLUSH_H_
@@ -0,0 +1,374 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string.h>                                            // strlen, memcpy
+#include <stdlib.h>                                            // malloc, free
+#include <errno.h>                                             // errno
+#include <time.h>                                              // clock_gettime
+#include <pthread.h>                                           // pthread_*
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/troe/troeBatchFlush.h"                       // troeBatchFlush
+#include "orionld/troe/troeSpool.h"                            // troeSpoolInit, troeSpoolAppend, troeSpoolPending, troeSpoolReplay
+#include "orionld/troe/troeQueue.h"                            // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// TroeQueueItem - the TRoE statements of one request, waiting to be flushed
+//
+// The statements of a request are never split over batches. sqlV, db and the statements follow the struct.
+//
+typedef struct TroeQueueItem
+{
+  char*                  db;
+  char**                 sqlV;
+  int                    statements;
+  long long              queuedAt;  // Milliseconds, CLOCK_MONOTONIC
+  struct TroeQueueItem*  next;
+} TroeQueueItem;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// SPOOL_REPLAY_RETRY - milliseconds to wait before replaying the spool file again, after postgres refused it
+//
+#define SPOOL_REPLAY_RETRY  10000
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Queue state
+//
+static pthread_mutex_t  queueMutex     = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   queueCond;
+static TroeQueueItem*   queueFirst     = NULL;
+static TroeQueueItem*   queueLast      = NULL;
+static int              queueLen       = 0;  // Statements, not requests
+static int              queueMax       = 0;
+static int              batchMax       = 0;
+static int              flushIval      = 0;
+static bool             writersStop    = false;
+static pthread_t*       writerV        = NULL;
+static int              writers        = 0;
+static long long        nextReplay     = 0;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// msNow - milliseconds, monotonic
+//
+static long long msNow(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// condWaitUntil - wait on the queue condition until 'msDeadline' (CLOCK_MONOTONIC milliseconds)
+//
+static void condWaitUntil(long long msDeadline)
+{
+  struct timespec deadline;
+
+  deadline.tv_sec  = msDeadline / 1000;
+  deadline.tv_nsec = (msDeadline % 1000) * 1000000;
+
+  pthread_cond_timedwait(&queueCond, &queueMutex, &deadline);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// itemsFlush - flush a batch of items, grouping consecutive items of the same database
+//
+// What can't be flushed (postgres down) is spooled, request by request.
+//
+static void itemsFlush(TroeQueueItem* itemP, int items, int statements)
+{
+  char** sqlV   = (char**) malloc(statements * sizeof(char*));
+  int*   countV = (int*)   malloc(items * sizeof(countV[0]));
+
+  if ((sqlV == NULL) || (countV == NULL))
+    LM_X(1, ("Out of memory (flushing TRoE statements)"));
+
+  while (itemP != NULL)
+  {
+    const char*     db       = itemP->db;
+    TroeQueueItem*  firstP   = itemP;
+    int             sqls     = 0;
+    int             requests = 0;
+
+    while ((itemP != NULL) && (strcmp(itemP->db, db) == 0))
+    {
+      memcpy(&sqlV[sqls], itemP->sqlV, itemP->statements * sizeof(sqlV[0]));
+      sqls += itemP->statements;
+      countV[requests++] = itemP->statements;
+      itemP = itemP->next;
+    }
+
+    int flushed = troeBatchFlush(db, sqlV, countV, requests);
+
+    // The requests that weren't flushed go to the spool file
+    itemP = firstP;
+    for (int rIx = 0; rIx < requests; rIx++)
+    {
+      if (rIx >= flushed)
+        troeSpoolAppend(db, itemP->sqlV, itemP->statements);
+      itemP = itemP->next;
+    }
+  }
+
+  free(countV);
+  free(sqlV);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeWriter - the writer thread
+//
+// A batch is flushed when it has 'batchMax' statements (whole requests only - a request with more than
+// 'batchMax' statements is a batch of its own), or when its first statement has waited
+// 'flushIval' milliseconds. When idle, the writer replays the spool file, if any.
+//
+static void* troeWriter(void* vP)
+{
+  pthread_mutex_lock(&queueMutex);
+
+  while (1)
+  {
+    while ((queueFirst == NULL) && (writersStop == false))
+    {
+      if ((msNow() >= nextReplay) && (troeSpoolPending() == true))
+      {
+        pthread_mutex_unlock(&queueMutex);
+        bool ok = troeSpoolReplay(batchMax);
+        pthread_mutex_lock(&queueMutex);
+
+        if (ok == false)
+          nextReplay = msNow() + SPOOL_REPLAY_RETRY;
+
+        continue;
+      }
+
+      condWaitUntil(msNow() + 1000);
+    }
+
+    if (queueFirst == NULL)  // writersStop and nothing left to flush
+      break;
+
+    // Wait for the batch to fill up - no wait when stopping
+    long long flushAt = queueFirst->queuedAt + flushIval;
+
+    while ((queueFirst != NULL) && (queueLen < batchMax) && (writersStop == false) && (msNow() < flushAt))
+      condWaitUntil(flushAt);
+
+    if (queueFirst == NULL)  // Another writer took it
+      continue;
+
+    // Take the batch - whole requests only
+    TroeQueueItem*  batchP     = queueFirst;
+    TroeQueueItem*  lastP      = queueFirst;
+    int             items      = 1;
+    int             statements = queueFirst->statements;
+
+    while ((lastP->next != NULL) && (statements + lastP->next->statements <= batchMax))
+    {
+      lastP       = lastP->next;
+      statements += lastP->statements;
+      ++items;
+    }
+
+    queueFirst  = lastP->next;
+    lastP->next = NULL;
+    queueLen   -= statements;
+
+    if (queueFirst == NULL)
+      queueLast = NULL;
+
+    pthread_mutex_unlock(&queueMutex);
+
+    itemsFlush(batchP, items, statements);
+
+    while (batchP != NULL)
+    {
+      TroeQueueItem* next = batchP->next;
+
+      free(batchP);
+      batchP = next;
+    }
+
+    pthread_mutex_lock(&queueMutex);
+  }
+
+  pthread_mutex_unlock(&queueMutex);
+
+  return NULL;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeQueueInit -
+//
+bool troeQueueInit(int _writers, int queueSize, int batchSize, int flushInterval, const char* spoolDir)
+{
+  pthread_condattr_t condAttr;
+
+  pthread_condattr_init(&condAttr);
+  pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+  pthread_cond_init(&queueCond, &condAttr);
+  pthread_condattr_destroy(&condAttr);
+
+  queueMax  = queueSize;
+  batchMax  = batchSize;
+  flushIval = flushInterval;
+
+  troeSpoolInit(spoolDir);
+
+  writerV = (pthread_t*) calloc(_writers, sizeof(pthread_t));
+  if (writerV == NULL)
+    LM_RE(false, ("Out of memory allocating %d TRoE writer threads", _writers));
+
+  for (int ix = 0; ix < _writers; ix++)
+  {
+    if (pthread_create(&writerV[ix], NULL, troeWriter, NULL) != 0)
+      LM_RE(false, ("Internal Error (pthread_create: %s)", strerror(errno)));
+
+    ++writers;
+  }
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeQueuePush -
+//
+void troeQueuePush(const char* db, char** sqlV, int statements)
+{
+  if (statements <= 0)
+    return;
+
+  int dbLen = strlen(db);
+  int size  = sizeof(TroeQueueItem) + statements * sizeof(sqlV[0]) + dbLen + 1;
+
+  for (int ix = 0; ix < statements; ix++)
+    size += strlen(sqlV[ix]) + 1;
+
+  TroeQueueItem* itemP = (TroeQueueItem*) malloc(size);
+
+  if (itemP == NULL)
+    LM_X(1, ("Out of memory (queueing TRoE statements)"));
+
+  itemP->sqlV       = (char**) &itemP[1];
+  itemP->db         = (char*) &itemP->sqlV[statements];
+  itemP->statements = statements;
+  itemP->queuedAt   = msNow();
+  itemP->next       = NULL;
+
+  memcpy(itemP->db, db, dbLen + 1);
+
+  char* sqlP = &itemP->db[dbLen + 1];
+  for (int ix = 0; ix < statements; ix++)
+  {
+    int sqlLen = strlen(sqlV[ix]);
+
+    memcpy(sqlP, sqlV[ix], sqlLen + 1);
+    itemP->sqlV[ix] = sqlP;
+    sqlP += sqlLen + 1;
+  }
+
+  pthread_mutex_lock(&queueMutex);
+
+  if (queueLen + statements > queueMax)
+  {
+    pthread_mutex_unlock(&queueMutex);
+
+    //
+    // Queue full - the overflow goes to the spool file and the writers will pick it up when idle
+    //
+    LM_W(("TRoE queue full - spooling %d statements", statements));
+    troeSpoolAppend(db, sqlV, statements);
+    free(itemP);
+
+    return;
+  }
+
+  if (queueLast == NULL)
+    queueFirst = itemP;
+  else
+    queueLast->next = itemP;
+
+  queueLast  = itemP;
+  queueLen  += statements;
+
+  if (queueLen >= batchMax)
+    pthread_cond_broadcast(&queueCond);
+  else if (queueLen == statements)  // Was empty - a writer must start the flush interval
+    pthread_cond_signal(&queueCond);
+
+  pthread_mutex_unlock(&queueMutex);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeQueueRelease -
+//
+void troeQueueRelease(void)
+{
+  if (writerV == NULL)
+    return;
+
+  pthread_mutex_lock(&queueMutex);
+  writersStop = true;
+  pthread_cond_broadcast(&queueCond);
+  pthread_mutex_unlock(&queueMutex);
+
+  for (int ix = 0; ix < writers; ix++)
+    pthread_join(writerV[ix], NULL);
+
+  free(writerV);
+  writerV = NULL;
+  writers = 0;
+}
@@ -0,0 +1,61 @@
+#ifndef SRC_LIB_ORIONLD_TROE_TROEQUEUE_H_
+#define SRC_LIB_ORIONLD_TROE_TROEQUEUE_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeQueueInit - start the TRoE writer threads
+//
+// writers:          number of writer threads
+// queueSize:        max number of statements in the queue - when full, statements go to the spool file
+// batchSize:        max number of statements flushed in one transaction
+// flushInterval:    max time (in milliseconds) a statement waits in the queue for its batch to fill up
+// spoolDir:         directory of the spool file
+//
+extern bool troeQueueInit(int writers, int queueSize, int batchSize, int flushInterval, const char* spoolDir);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeQueuePush - queue the TRoE statements of a request
+//
+// The statements are copied.
+//
+extern void troeQueuePush(const char* db, char** sqlV, int statements);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeQueueRelease - flush what's in the queue and stop the writer threads
+//
+extern void troeQueueRelease(void);
+
+#endif  // SRC_LIB_ORIONLD_TROE_TROEQUEUE_H_
@@ -0,0 +1,370 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <stdio.h>                                             // FILE, fopen, fprintf, fread, rename
+#include <stdlib.h>                                            // malloc, free
+#include <string.h>                                            // strcmp, strerror, memmove
+#include <errno.h>                                             // errno
+#include <unistd.h>                                            // access, unlink, fsync
+#include <pthread.h>                                           // pthread_mutex_t
+
+#include "logMsg/logMsg.h"                                     // LM_*
+#include "logMsg/traceLevels.h"                                // Lmt*
+
+#include "orionld/troe/troeBatchFlush.h"                       // troeBatchFlush
+#include "orionld/troe/troeSpool.h"                            // Own interface
+
+
+
+// -----------------------------------------------------------------------------
+//
+// Spool file state
+//
+// File format - one record per request, as the statements of a request are never split:
+//   <db>\n<number of statements>\n
+//   <length of statement 1>\n<statement 1>\n
+//   ...
+//
+// The length is needed as statements may contain newlines (inside string values).
+//
+static pthread_mutex_t  spoolMutex                 = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t  replayMutex                = PTHREAD_MUTEX_INITIALIZER;
+static char             spoolPath[512]             = { 0 };
+static char             replayPath[512]            = { 0 };
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeSpoolInit -
+//
+void troeSpoolInit(const char* dir)
+{
+  snprintf(spoolPath,  sizeof(spoolPath),  "%s/orionld-troe.spool", dir);
+  snprintf(replayPath, sizeof(replayPath), "%s/orionld-troe.spool.replay", dir);
+
+  if (troeSpoolPending() == true)
+    LM_W(("TRoE spool file found - its statements will be written to postgres"));
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeSpoolAppend -
+//
+// The file is synced to disk before it is closed - the statements are gone from memory once this function returns.
+//
+bool troeSpoolAppend(const char* db, char** sqlV, int statements)
+{
+  pthread_mutex_lock(&spoolMutex);
+
+  FILE* fP = fopen(spoolPath, "a");
+
+  if (fP == NULL)
+  {
+    pthread_mutex_unlock(&spoolMutex);
+    LM_E(("Internal Error (unable to open TRoE spool file '%s': %s) - %d TRoE statements are lost", spoolPath, strerror(errno), statements));
+    return false;
+  }
+
+  fprintf(fP, "%s\n%d\n", db, statements);
+
+  for (int ix = 0; ix < statements; ix++)
+    fprintf(fP, "%d\n%s\n", (int) strlen(sqlV[ix]), sqlV[ix]);
+
+  bool ok = (fflush(fP) == 0) && (fsync(fileno(fP)) == 0);
+
+  if (fclose(fP) != 0)
+    ok = false;
+
+  pthread_mutex_unlock(&spoolMutex);
+
+  if (ok == false)
+    LM_E(("Internal Error (unable to write to TRoE spool file '%s': %s)", spoolPath, strerror(errno)));
+
+  return ok;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeSpoolPending -
+//
+bool troeSpoolPending(void)
+{
+  if (spoolPath[0] == 0)
+    return false;
+
+  return (access(spoolPath, F_OK) == 0) || (access(replayPath, F_OK) == 0);
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// SqlVector - the statements read from the spool file, grows as needed
+//
+typedef struct SqlVector
+{
+  char**  sqlV;
+  int     statements;
+  int     size;
+} SqlVector;
+
+
+
+// -----------------------------------------------------------------------------
+//
+// sqlVectorFree - free the statements (not the vector itself)
+//
+static void sqlVectorFree(SqlVector* vecP, int from)
+{
+  for (int ix = from; ix < vecP->statements; ix++)
+    free(vecP->sqlV[ix]);
+
+  vecP->statements = from;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// statementRead - read one statement of the spool file, 'sql' is malloced
+//
+static bool statementRead(FILE* fP, char** sqlP)
+{
+  int len;
+
+  if (fscanf(fP, "%d\n", &len) != 1)
+    return false;
+
+  *sqlP = (char*) malloc(len + 1);
+  if (*sqlP == NULL)
+    LM_RE(false, ("Out of memory (reading the TRoE spool file)"));
+
+  if ((int) fread(*sqlP, 1, len, fP) != len)
+  {
+    free(*sqlP);
+    return false;
+  }
+
+  (*sqlP)[len] = 0;
+  fgetc(fP);  // The newline after the statement
+
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// requestRead - read one record (the statements of one request) of the spool file, appending them to 'vecP'
+//
+// An incomplete record (the broker died while writing it) is discarded.
+//
+static bool requestRead(FILE* fP, char* db, int dbSize, SqlVector* vecP, int* statementsP)
+{
+  int statements;
+
+  if (fgets(db, dbSize, fP) == NULL)
+    return false;
+
+  db[strcspn(db, "\n")] = 0;
+
+  if ((fscanf(fP, "%d\n", &statements) != 1) || (statements <= 0))
+    return false;
+
+  if (vecP->statements + statements > vecP->size)
+  {
+    int     size = (vecP->statements + statements) * 2;
+    char**  sqlV = (char**) realloc(vecP->sqlV, size * sizeof(char*));
+
+    if (sqlV == NULL)
+      LM_RE(false, ("Out of memory (reading the TRoE spool file)"));
+
+    vecP->sqlV = sqlV;
+    vecP->size = size;
+  }
+
+  int first = vecP->statements;
+
+  for (int ix = 0; ix < statements; ix++)
+  {
+    if (statementRead(fP, &vecP->sqlV[vecP->statements]) == false)
+    {
+      sqlVectorFree(vecP, first);
+      return false;
+    }
+
+    ++vecP->statements;
+  }
+
+  *statementsP = statements;
+  return true;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// batchFlush - flush a batch read from the spool file - what can't be flushed goes back to the spool file
+//
+// The batch is the first 'requests' requests of the vector. They are removed from the vector, whatever
+// follows them (the request that didn't fit in the batch) is moved to the start of the vector.
+//
+static bool batchFlush(const char* db, SqlVector* vecP, int* countV, int requests)
+{
+  int flushed = troeBatchFlush(db, vecP->sqlV, countV, requests);
+  int offset  = 0;
+
+  for (int rIx = 0; rIx < requests; rIx++)
+  {
+    if (rIx >= flushed)
+      troeSpoolAppend(db, &vecP->sqlV[offset], countV[rIx]);
+
+    for (int ix = offset; ix < offset + countV[rIx]; ix++)
+      free(vecP->sqlV[ix]);
+
+    offset += countV[rIx];
+  }
+
+  vecP->statements -= offset;
+  memmove(vecP->sqlV, &vecP->sqlV[offset], vecP->statements * sizeof(vecP->sqlV[0]));
+
+  return flushed == requests;
+}
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeSpoolReplay -
+//
+// The spool file is renamed before it is read, so that new statements can be spooled meanwhile.
+// Only one thread at a time replays.
+//
+bool troeSpoolReplay(int batchSize)
+{
+  if (pthread_mutex_trylock(&replayMutex) != 0)
+    return true;
+
+  if (access(replayPath, F_OK) != 0)  // A replay file left behind (by a crash) is replayed first
+  {
+    pthread_mutex_lock(&spoolMutex);
+    int r = rename(spoolPath, replayPath);
+    pthread_mutex_unlock(&spoolMutex);
+
+    if (r != 0)
+    {
+      pthread_mutex_unlock(&replayMutex);
+      return (errno == ENOENT);  // Nothing to replay is not an error
+    }
+  }
+
+  FILE* fP = fopen(replayPath, "r");
+
+  if (fP == NULL)
+  {
+    LM_E(("Internal Error (unable to open TRoE spool file '%s': %s)", replayPath, strerror(errno)));
+    pthread_mutex_unlock(&replayMutex);
+    return false;
+  }
+
+  //
+  // A batch is made of whole requests - at most 'batchSize' statements, unless one single request has more
+  //
+  SqlVector  vec        = { NULL, 0, 0 };
+  int*       countV     = (int*) malloc(batchSize * sizeof(countV[0]));
+  int        requests   = 0;
+  char       batchDb[256];
+  char       db[256];
+  bool       ok         = true;
+  int        replayed   = 0;
+  int        statements;
+
+  if (countV == NULL)
+  {
+    LM_E(("Out of memory (replaying the TRoE spool file)"));
+    fclose(fP);
+    pthread_mutex_unlock(&replayMutex);
+    return false;
+  }
+
+  while ((ok == true) && (requestRead(fP, db, sizeof(db), &vec, &statements) == true))
+  {
+    int before = vec.statements - statements;
+
+    // A batch is for one single database
+    if ((requests > 0) && ((before + statements > batchSize) || (requests == batchSize) || (strcmp(db, batchDb) != 0)))
+    {
+      ok          = batchFlush(batchDb, &vec, countV, requests);  // The request just read stays in 'vec'
+      replayed   += before;
+      requests    = 0;
+    }
+
+    if (requests == 0)
+      strncpy(batchDb, db, sizeof(batchDb));
+
+    countV[requests++] = statements;
+  }
+
+  if (ok == false)
+  {
+    // Postgres is down - the rest goes back to the spool file, unread records included
+    int offset = 0;
+
+    for (int rIx = 0; rIx < requests; rIx++)
+    {
+      troeSpoolAppend(batchDb, &vec.sqlV[offset], countV[rIx]);
+      offset += countV[rIx];
+    }
+
+    sqlVectorFree(&vec, 0);
+
+    while (requestRead(fP, db, sizeof(db), &vec, &statements) == true)
+    {
+      troeSpoolAppend(db, vec.sqlV, vec.statements);
+      sqlVectorFree(&vec, 0);
+    }
+  }
+  else if (requests > 0)
+  {
+    replayed += vec.statements;
+    ok        = batchFlush(batchDb, &vec, countV, requests);
+  }
+
+  free(vec.sqlV);
+  free(countV);
+  fclose(fP);
+  unlink(replayPath);
+
+  if (ok == true)
+    LM_I(("Replayed %d spooled TRoE statements", replayed));
+
+  pthread_mutex_unlock(&replayMutex);
+
+  return ok;
+}
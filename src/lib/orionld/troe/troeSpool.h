@@ -0,0 +1,66 @@
+#ifndef SRC_LIB_ORIONLD_TROE_TROESPOOL_H_
+#define SRC_LIB_ORIONLD_TROE_TROESPOOL_H_
+
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeSpoolInit - set the directory of the TRoE spool file
+//
+// The spool file keeps the TRoE statements that couldn't be queued (queue full) or flushed (postgres down),
+// until they can be written to postgres. It survives a restart of the broker.
+//
+extern void troeSpoolInit(const char* dir);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeSpoolAppend - save the statements of one request in the spool file (synced to disk)
+//
+extern bool troeSpoolAppend(const char* db, char** sqlV, int statements);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeSpoolPending - are there statements in the spool file?
+//
+extern bool troeSpoolPending(void);
+
+
+
+// -----------------------------------------------------------------------------
+//
+// troeSpoolReplay - flush the statements in the spool file to postgres, 'batchSize' statements at a time
+//
+// Returns false if postgres refused to take them (they are back in the spool file then)
+//
+extern bool troeSpoolReplay(int batchSize);
+
+#endif  // SRC_LIB_ORIONLD_TROE_TROESPOOL_H_
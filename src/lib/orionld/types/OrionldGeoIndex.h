@@ -25,6 +25,23 @@
 *
 * Author: Ken Zangelin
 */
+#include <time.h>                                                // time_t
+
+#include "orionld/types/OrionldTenant.h"                         // OrionldTenant
+
+
+
+// -----------------------------------------------------------------------------
+//
+// OrionldGeoIndexState - build status of a geo-index
+//
+typedef enum OrionldGeoIndexState
+{
+  GeoIndexQueued,      // Waiting for the index builder thread
+  GeoIndexBuilding,    // Being built by the index builder thread
+  GeoIndexReady,       // Exists in the database
+  GeoIndexFailed       // The build failed - queued again by the next request that needs it (after a while)
+} OrionldGeoIndexState;
 
 
 
@@ -32,11 +49,19 @@
 //
 // OrionldGeoIndex -
 //
+// Items are never removed from the geo-index registry, so a reader that has found an item can keep using it.
+// 'state' and 'failedAt' are modified by other threads - always accessed with atomic operations.
+//
 typedef struct OrionldGeoIndex
 {
   char*                    tenant;
-  char*                    attrName;
-  struct OrionldGeoIndex*  next;
+  char*                    attrName;       // Expanded, with dots replaced by '=' (as in the database)
+  OrionldTenant*           tenantP;        // For the index builder - NULL for indexes found in the database
+  OrionldGeoIndexState     state;
+  time_t                   failedAt;       // When the last build failed
+  struct OrionldGeoIndex*  hashNext;       // Next in the bucket of the registry
+  struct OrionldGeoIndex*  queueNext;      // Next in the queue of the index builder
+  struct OrionldGeoIndex*  next;           // Next in geoIndexList (all geo-indexes)
 } OrionldGeoIndex;
 
 #endif  // SRC_LIB_ORIONLD_TYPES_ORIONLDGEOINDEX_H_
@@ -24,6 +24,7 @@
 */
 #include <string>
 #include <vector>
+#include <stdlib.h>                                         // malloc, free
 
 extern "C"
 {
@@ -60,7 +61,7 @@ using namespace mongo;
 *
 * StringFilterItem::StringFilterItem -
 */
-StringFilterItem::StringFilterItem() : compiledPattern(false)
+StringFilterItem::StringFilterItem() : patternP(NULL), leftType(SflAttribute), refCount(1)
 {
   numberList.clear();
   stringList.clear();
@@ -70,43 +71,27 @@ StringFilterItem::StringFilterItem() : compiledPattern(false)
 
 /* ****************************************************************************
 *
-* StringFilterItem::fill -
+* StringFilterItem::patternCompile -
 */
-bool StringFilterItem::fill(StringFilterItem* sfiP, std::string* errorStringP)
+bool StringFilterItem::patternCompile(std::string* errorStringP)
 {
-  left                  = sfiP->left;
-  op                    = sfiP->op;
-  valueType             = sfiP->valueType;
-  numberValue           = sfiP->numberValue;
-  stringValue           = sfiP->stringValue;
-  boolValue             = sfiP->boolValue;
-  stringList            = sfiP->stringList;
-  numberList            = sfiP->numberList;
-  numberRangeFrom       = sfiP->numberRangeFrom;
-  numberRangeTo         = sfiP->numberRangeTo;
-  stringRangeFrom       = sfiP->stringRangeFrom;
-  stringRangeTo         = sfiP->stringRangeTo;
-  attributeName         = sfiP->attributeName;
-  metadataName          = sfiP->metadataName;
-  compiledPattern       = sfiP->compiledPattern;
-  type                  = sfiP->type;
-  compoundPath          = sfiP->compoundPath;
-
-  if (compiledPattern)
+  StringFilterPattern* sfpP = (StringFilterPattern*) malloc(sizeof(StringFilterPattern));
+
+  if (sfpP == NULL)
   {
-    //
-    // FIXME P4: not very optimized to recalculate the regex.
-    //
-    // We don't know of a better way to copy the regex from sfiP, and have a question out on SOF:
-    // http://stackoverflow.com/questions/36846426/best-way-of-cloning-compiled-regex-t-struct-in-c
-    //
-    if (regcomp(&patternValue, stringValue.c_str(), REG_EXTENDED) != 0)
-    {
-      *errorStringP = std::string("error compiling filter regex: '") + stringValue + "'";
-      return false;
-    }
+    *errorStringP = "out of memory compiling filter regex";
+    return false;
+  }
+
+  if (regcomp(&sfpP->regex, stringValue.c_str(), REG_EXTENDED) != 0)
+  {
+    free(sfpP);  // If regcomp fails it frees up itself (see glibc sources for details)
+    *errorStringP = std::string("error compiling filter regex: '") + stringValue + "'";
+    return false;
   }
 
+  patternP = sfpP;
+
   return true;
 }
 
@@ -121,10 +106,11 @@ StringFilterItem::~StringFilterItem()
   stringList.clear();
   numberList.clear();
 
-  if (compiledPattern == true)
+  if (patternP != NULL)
   {
-    regfree(&patternValue);  // If regcomp fails it frees up itself (see glibc sources for details)
-    compiledPattern = false;
+    regfree(&patternP->regex);
+    free(patternP);
+    patternP = NULL;
   }
 }
 
@@ -165,12 +151,7 @@ bool StringFilterItem::valueParse(char* s, std::string* errorStringP)
 
   if (op == SfopMatchPattern)
   {
-    if (regcomp(&patternValue, stringValue.c_str(), REG_EXTENDED) != 0)
-    {
-      *errorStringP = std::string("error compiling filter regex: '") + stringValue + "'";
-      return false;
-    }
-    compiledPattern = true;
+    return patternCompile(errorStringP);
   }
 
   return true;
@@ -681,6 +662,22 @@ bool StringFilterItem::parse(char* qItem, std::string* errorStringP, StringFilte
 
 #endif
 
+  //
+  // Builtin dates in LHS - dateCreated/dateModified of the entity (q) or of the attribute (mq)
+  //
+  if (type == SftQ)
+  {
+    if      (left == DATE_CREATED)   leftType = SflDateCreated;
+    else if (left == DATE_MODIFIED)  leftType = SflDateModified;
+    else                             leftType = SflAttribute;
+  }
+  else
+  {
+    if      (metadataName == NGSI_MD_DATECREATED)   leftType = SflDateCreated;
+    else if (metadataName == NGSI_MD_DATEMODIFIED)  leftType = SflDateModified;
+    else                                            leftType = SflAttribute;
+  }
+
   //
   // Check for empty RHS
   //
@@ -735,12 +732,11 @@ bool StringFilterItem::parse(char* qItem, std::string* errorStringP, StringFilte
     // Can't call valueParse here, as the forced valueType 'SfvtString' will be knocked back to its 'default'.
     // So, instead we just perform the part of SfopMatchPattern of valueParse
     //
-    if (regcomp(&patternValue, stringValue.c_str(), REG_EXTENDED) != 0)
+    if (patternCompile(errorStringP) == false)
     {
-      *errorStringP = std::string("error compiling filter regex: '") + stringValue + "'";
+      free(toFree);
       return false;
     }
-    compiledPattern = true;
   }
   else
   {
@@ -1440,7 +1436,7 @@ MatchResult StringFilterItem::matchPattern(ContextAttribute* caP)
     return MrIncompatibleType;
   }
 
-  return (regexec(&patternValue, caP->stringValue.c_str(), 0, NULL, 0) == 0)? MrMatch : MrNoMatch;
+  return (regexec(&patternP->regex, caP->stringValue.c_str(), 0, NULL, 0) == 0)? MrMatch : MrNoMatch;
 }
 
 
@@ -1457,7 +1453,7 @@ MatchResult StringFilterItem::matchPattern(orion::CompoundValueNode* cvP)
     return MrIncompatibleType;
   }
 
-  return (regexec(&patternValue, cvP->stringValue.c_str(), 0, NULL, 0) == 0)? MrMatch : MrNoMatch;
+  return (regexec(&patternP->regex, cvP->stringValue.c_str(), 0, NULL, 0) == 0)? MrMatch : MrNoMatch;
 }
 
 
@@ -1492,7 +1488,7 @@ MatchResult StringFilterItem::matchPattern(Metadata* mdP)
     return MrIncompatibleType;
   }
 
-  return (regexec(&patternValue, mdP->stringValue.c_str(), 0, NULL, 0) == 0)? MrMatch : MrNoMatch;
+  return (regexec(&patternP->regex, mdP->stringValue.c_str(), 0, NULL, 0) == 0)? MrMatch : MrNoMatch;
 }
 
 
@@ -1829,9 +1825,16 @@ StringFilter::~StringFilter()
 {
   mongoFilters.clear();
 
+  //
+  // The filter-items may be shared with clones of this StringFilter - and the clones may be destroyed by
+  // other threads (a triggered subscription vs a refresh of the subscription cache)
+  //
   for (unsigned int ix = 0; ix < filters.size(); ++ix)
   {
-    delete filters[ix];
+    if (__atomic_sub_fetch(&filters[ix]->refCount, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+      delete filters[ix];
+    }
   }
 
   filters.clear();
@@ -2353,11 +2356,11 @@ bool StringFilter::mqMatch(ContextElementResponse* cerP)
     Metadata*  mdP = NULL;
     Metadata   md;
 
-    if ((itemP->metadataName == NGSI_MD_DATECREATED) || (itemP->metadataName == NGSI_MD_DATEMODIFIED))
+    if (itemP->leftType != SflAttribute)
     {
       mdP            = &md;
       md.valueType   = orion::ValueTypeNumber;
-      md.numberValue = (itemP->metadataName == NGSI_MD_DATECREATED)? caP->creDate : caP->modDate;
+      md.numberValue = (itemP->leftType == SflDateCreated)? caP->creDate : caP->modDate;
     }
     else if (itemP->op != SfopNotExists)
     {
@@ -2462,11 +2465,11 @@ bool StringFilter::qMatch(ContextElementResponse* cerP)
     ContextAttribute*  caP = NULL;
     ContextAttribute   ca;
 
-    if ((itemP->left == DATE_CREATED) || (itemP->left == DATE_MODIFIED))
+    if (itemP->leftType != SflAttribute)
     {
       caP            = &ca;
       ca.valueType   = orion::ValueTypeNumber;
-      ca.numberValue = (itemP->left == DATE_CREATED)? cerP->contextElement.entityId.creDate : cerP->contextElement.entityId.modDate;
+      ca.numberValue = (itemP->leftType == SflDateCreated)? cerP->contextElement.entityId.creDate : cerP->contextElement.entityId.modDate;
     }
     else if (itemP->op != SfopNotExists)
     {
@@ -2553,27 +2556,14 @@ bool StringFilter::qMatch(ContextElementResponse* cerP)
 /* ****************************************************************************
 *
 * StringFilter::clone -
+*
+* The filter-items are shared with the clone, not copied (see StringFilter::fill)
 */
 StringFilter* StringFilter::clone(std::string* errorStringP)
 {
   StringFilter* sfP = new StringFilter(type);
 
-  for (unsigned int ix = 0; ix < filters.size(); ++ix)
-  {
-    StringFilterItem*  sfi = new StringFilterItem();
-
-    if (!sfi->fill(filters[ix], errorStringP))
-    {
-      delete sfi;
-      delete sfP;
-      return NULL;
-    }
-
-    sfP->filters.push_back(sfi);
-  }
-
-  // Object copy
-  sfP->mongoFilters = mongoFilters;
+  sfP->fill(this, errorStringP);
 
   return sfP;
 }
@@ -2583,20 +2573,17 @@ StringFilter* StringFilter::clone(std::string* errorStringP)
 /* ****************************************************************************
 *
 * StringFilter::fill -
+*
+* A parsed StringFilterItem is never modified, so, instead of a deep copy of each item,
+* the items of 'sfP' are shared, with their reference counter incremented.
 */
 bool StringFilter::fill(StringFilter* sfP, std::string* errorStringP)
 {
   for (unsigned int ix = 0; ix < sfP->filters.size(); ++ix)
   {
-    StringFilterItem*  sfi = new StringFilterItem();
-
-    if (!sfi->fill(sfP->filters[ix], errorStringP))
-    {
-      delete sfi;
-      LM_E(("Runtime Error (error filling StringFilterItem: %s)", errorStringP->c_str()));
-      return false;
-    }
+    StringFilterItem* sfi = sfP->filters[ix];
 
+    __atomic_add_fetch(&sfi->refCount, 1, __ATOMIC_RELAXED);
     filters.push_back(sfi);
   }
 
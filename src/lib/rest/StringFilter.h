@@ -75,6 +75,36 @@ typedef enum StringFilterOp
 
 
 
+/* ****************************************************************************
+*
+* StringFilterLhs - what the left-hand-side of a filter-item refers to
+*
+* Decided once, when the filter-item is parsed, so that match() doesn't need to compare
+* the left-hand-side with the names of the builtins for each entity it is matched against.
+*/
+typedef enum StringFilterLhs
+{
+  SflAttribute,            // the value of an attribute (q) or of a metadata (mq)
+  SflDateCreated,          // dateCreated of the entity (q) or of the attribute (mq)
+  SflDateModified          // dateModified of the entity (q) or of the attribute (mq)
+} StringFilterLhs;
+
+
+
+/* ****************************************************************************
+*
+* StringFilterPattern - the compiled regex of a '~=' filter-item
+*
+* regexec() doesn't modify the compiled regex, so the same regex_t can be used by any number
+* of threads at the same time - as a filter-item is shared by all clones of its StringFilter.
+*/
+typedef struct StringFilterPattern
+{
+  regex_t  regex;
+} StringFilterPattern;
+
+
+
 /* ****************************************************************************
 *
 * StringFilterValueType - 
@@ -129,9 +159,13 @@ typedef enum MatchResult
 *   stringRangeTo        upper limit for string ranges
 *   attributeName        The name of the attribute, used for unary operators and for mq filters
 *   metadataName         The name of the metadata, used for mqfilters
+*   leftType             What the left-hand-side refers to (attribute/metadata or a builtin date)
+*   patternP             The compiled regex of '~='
+*   refCount             Number of StringFilters that use the filter-item (see StringFilter::clone)
 *
 * METHODS
 *   parse                parse a string, like 'a>14' into a StringFilterItem
+*   patternCompile       compile the regex of '~=' (stringValue)
 *   opName               help method to translate the 'op' field into a string
 *   valueTypeName        help method to translate the 'valueType' field into a string
 *   valueGet             extract the value of RHS (right hand side), including type, etc.
@@ -154,7 +188,7 @@ public:
   StringFilterValueType     valueType;
   double                    numberValue;
   std::string               stringValue;
-  regex_t                   patternValue;
+  StringFilterPattern*      patternP;
   bool                      boolValue;
   std::vector<std::string>  stringList;
   std::vector<double>       numberList;
@@ -165,8 +199,9 @@ public:
   std::string               attributeName;  // Used for unary operators and for metadata filters
   std::string               metadataName;   // Used for metadata filters
   std::string               compoundPath;
-  bool                      compiledPattern;
+  StringFilterLhs           leftType;
   StringFilterType          type;
+  int                       refCount;
 
   StringFilterItem();
   ~StringFilterItem();
@@ -177,6 +212,7 @@ public:
   void                      valueAsString(char* buf, int bufLen);
 #endif
   void                      lhsParse(void);
+  bool                      patternCompile(std::string* errorStringP);
   const char*               opName(void);
   const char*               valueTypeName(void);
 
@@ -203,7 +239,6 @@ public:
   MatchResult               matchLessThan(ContextAttribute* caP);
   MatchResult               matchLessThan(Metadata* mdP);
   MatchResult               matchLessThan(orion::CompoundValueNode* cvP);
-  bool                      fill(StringFilterItem* sfiP, std::string* errorStringP);
 
 private:
   bool                      compatibleType(ContextAttribute* caP);
@@ -237,6 +272,9 @@ class ContextElementResponse;
 *                         It is an 'AND-match', so ALL StringFilterItems in 'filters' must match the ContextElementResponse
 *                         in order for 'match' to return TRUE.
 *                         Also here, parse() must be called before match() can be used.
+*   clone/fill            A parsed filter is never modified, so its filter-items are shared (reference counted),
+*                         not copied. A clone is made for every cached subscription that an update triggers, and
+*                         it stays valid after the subscription cache has been refreshed.
 */
 class StringFilter
 {
@@ -79,22 +79,14 @@ void httpRequestInit(long defaultTimeoutInMilliseconds)
 
 /* ****************************************************************************
 *
-* See [1] for a discussion on how curl_multi is to be used. Libcurl does not seem
-* to provide a way to do asynchronous HTTP transactions in the way we intended
-* with the previous version of httpRequestSend. To enable the old behavior of asynchronous
-* HTTP requests uncomment the following #define line.
+* See [1] for a discussion on how curl_multi is to be used.
+* httpRequestSendWithCurl is synchronous (curl_easy_perform). The 'multi' notification mode
+* (see ngsiNotify/MultiWorkers.cpp) keeps many requests in flight using curl_multi, preparing
+* and finishing each transfer with httpRequestPrepare and httpRequestDone.
 *
 * [1] http://stackoverflow.com/questions/24288513/how-to-do-curl-multi-perform-asynchronously-in-c
 */
 
-struct MemoryStruct
-{
-  char*   memory;
-  size_t  size;
-};
-
-
-
 /* ****************************************************************************
 *
 * writeMemoryCallback -
@@ -217,18 +209,17 @@ static int contentLenParse(char* s)
 
 /* ****************************************************************************
 *
-* httpRequestSendWithCurl -
+* httpRequestPrepare -
 *
-* The waitForResponse arguments specifies if the method has to wait for response
-* before return. If this argument is false, the return string is ""
+* Checks the input and prepares the curl easy handle for the request - all but performing it.
+* The state that must survive until the transfer is done (the list of HTTP headers, the response buffer, ...)
+* is kept in *transferP, and it is released by httpRequestDone.
 *
 * NOTE
-* We are using a hybrid approach, consisting of a static thread-local buffer of a
-* small size that copes with most notifications to avoid expensive
-* calloc/free syscalls if the notification payload is not very large.
+*   The content is not copied (CURLOPT_POSTFIELDS), so, it must stay untouched until the transfer is done.
 *
 * RETURN VALUES
-*   httpRequestSendWithCurl returns 0 on success and a negative number on failure:
+*   httpRequestPrepare returns 0 on success and a negative number on failure:
 *     -1: Invalid port
 *     -2: Invalid IP
 *     -3: Invalid verb
@@ -236,9 +227,8 @@ static int contentLenParse(char* s)
 *     -5: No Content-Type BUT content present
 *     -6: Content-Type present but there is no content
 *     -7: Total outgoing message size is too big
-*     -9: Error making HTTP request
 */
-int httpRequestSendWithCurl
+int httpRequestPrepare
 (
    CURL*                                      curl,
    const std::string&                         _ip,
@@ -253,29 +243,30 @@ int httpRequestSendWithCurl
    const std::string&                         content,
    const std::string&                         fiwareCorrelation,
    const std::string&                         ngsiv2AttrFormat,
-   bool                                       waitForResponse,
-   std::string*                               outP,
    const std::map<std::string, std::string>&  extraHeaders,
    const std::string&                         acceptFormat,
-   long                                       timeoutInMilliseconds
+   long                                       timeoutInMilliseconds,
+   HttpRequestTransfer*                       transferP
 )
 {
   char                            portAsString[STRING_SIZE_FOR_INT];
   static unsigned long long       callNo             = 0;
   std::string                     ip                 = _ip;
   struct curl_slist*              headers            = NULL;
-  MemoryStruct*                   httpResponse       = NULL;
-  CURLcode                        res;
   int                             outgoingMsgSize    = 0;
   std::string                     content_type(orig_content_type);
   std::map<std::string, bool>     usedExtraHeaders;
-  char                            servicePath0[SERVICE_PATH_MAX_COMPONENT_LEN + 1];  // +1 for zero termination
+  char*                           servicePath0       = transferP->servicePath0;
+
+  transferP->headers      = NULL;
+  transferP->httpResponse = NULL;
+  transferP->tenant       = (tenant != NULL)? tenant : "";
 
-  firstServicePath(servicePath.c_str(), servicePath0, sizeof(servicePath0));
+  firstServicePath(servicePath.c_str(), servicePath0, sizeof(transferP->servicePath0));
   if (metricsMgr.isOn())
     metricsMgr.add(tenant, servicePath0, METRIC_TRANS_OUT, 1);
 
-  ++callNo;
+  transferP->callNo = ++callNo;
 
   // For content-type application/json we add charset=utf-8
   if ((orig_content_type == "application/json") || (orig_content_type == "text/plain"))
@@ -289,7 +280,6 @@ int httpRequestSendWithCurl
   }
 
   std::string protocol = _protocol + "//";
-  lmTransactionStart("to", protocol.c_str(), + ip.c_str(), port, resource.c_str());
 
   // Preconditions check
   if (port == 0)
@@ -297,9 +287,6 @@ int httpRequestSendWithCurl
     if (metricsMgr.isOn())
       metricsMgr.add(tenant, servicePath0, METRIC_TRANS_OUT_ERRORS, 1);
     LM_E(("Runtime Error (port is ZERO)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -1;
   }
 
@@ -308,9 +295,6 @@ int httpRequestSendWithCurl
     if (metricsMgr.isOn())
       metricsMgr.add(tenant, servicePath0, METRIC_TRANS_OUT_ERRORS, 1);
     LM_E(("Runtime Error (ip is empty)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -2;
   }
 
@@ -319,9 +303,6 @@ int httpRequestSendWithCurl
     if (metricsMgr.isOn())
       metricsMgr.add(tenant, servicePath0, METRIC_TRANS_OUT_ERRORS, 1);
     LM_E(("Runtime Error (verb is empty)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -3;
   }
 
@@ -330,9 +311,6 @@ int httpRequestSendWithCurl
     if (metricsMgr.isOn())
       metricsMgr.add(tenant, servicePath0, METRIC_TRANS_OUT_ERRORS, 1);
     LM_E(("Runtime Error (resource is empty)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -4;
   }
 
@@ -341,9 +319,6 @@ int httpRequestSendWithCurl
     if (metricsMgr.isOn())
       metricsMgr.add(tenant, servicePath0, METRIC_TRANS_OUT_ERRORS, 1);
     LM_E(("Runtime Error (Content-Type is empty but there is actual content)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -5;
   }
 
@@ -352,19 +327,9 @@ int httpRequestSendWithCurl
     if (metricsMgr.isOn())
       metricsMgr.add(tenant, servicePath0, METRIC_TRANS_OUT_ERRORS, 1);
     LM_E(("Runtime Error (Content-Type non-empty but there is no content)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -6;
   }
 
-
-
-  // Allocate to hold HTTP response
-  httpResponse         = new MemoryStruct;
-  httpResponse->memory = (char*) malloc(1); // will grow as needed
-  httpResponse->size   = 0; // no data at this point
-
   snprintf(portAsString, sizeof(portAsString), "%u", port);
 
   // ----- User Agent
@@ -479,15 +444,14 @@ int httpRequestSendWithCurl
     LM_E(("Runtime Error (HTTP request to send is too large: %d bytes)", outgoingMsgSize));
 
     curl_slist_free_all(headers);
-
-    free(httpResponse->memory);
-    delete httpResponse;
-
-    lmTransactionEnd();
-    *outP = "error";
     return -7;
   }
 
+  // Allocate to hold HTTP response
+  MemoryStruct* httpResponse = new MemoryStruct;
+  httpResponse->memory = (char*) malloc(1); // will grow as needed
+  httpResponse->size   = 0; // no data at this point
+
   // Contents
   const char* payload = content.c_str();
   curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (u_int8_t*) payload);
@@ -537,16 +501,29 @@ int httpRequestSendWithCurl
     curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeoutInMilliseconds);
   }
 
+  transferP->headers         = headers;
+  transferP->httpResponse    = httpResponse;
+  transferP->url             = url;
+  transferP->payloadSize     = payloadSize;
+  transferP->outgoingMsgSize = outgoingMsgSize;
 
-  //
-  // Synchronous HTTP request
-  //
-  // This was previously an LM_T trace, but we have "promoted" it to INFO due to it is needed
-  // to check logs in a .test case (case 000 notification_different_sizes.test)
-  //
-  LM_I(("Sending message %lu to HTTP server: sending message of %d bytes to HTTP server", callNo, outgoingMsgSize));
+  return 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* httpRequestDone - treat the result of a transfer prepared by httpRequestPrepare and release its state
+*
+* RETURN VALUES
+*   0 on success, -9 if the HTTP request failed
+*/
+int httpRequestDone(HttpRequestTransfer* transferP, CURLcode res, std::string* outP)
+{
+  const char* tenant       = transferP->tenant.c_str();
+  const char* servicePath0 = transferP->servicePath0;
 
-  res = curl_easy_perform(curl);
   if (res != CURLE_OK)
   {
     //
@@ -554,7 +531,7 @@ int httpRequestSendWithCurl
     //       So, this line should not be removed/altered, at least not without also modifying the functests.
     //
     LM_E(("curl_easy_perform failed: %d", res));
-    alarmMgr.notificationError(url, "(curl_easy_perform failed: " + std::string(curl_easy_strerror(res)) + ")");
+    alarmMgr.notificationError(transferP->url, "(curl_easy_perform failed: " + std::string(curl_easy_strerror(res)) + ")");
     *outP = "notification failure";
 
     if (metricsMgr.isOn())
@@ -565,31 +542,121 @@ int httpRequestSendWithCurl
     //
     // The Response is here
     //
-    int   payloadLen  = contentLenParse(httpResponse->memory);
+    int   payloadLen  = contentLenParse(transferP->httpResponse->memory);
 
-    LM_I(("Notification Successfully Sent to %s", url.c_str()));
-    outP->assign(httpResponse->memory, httpResponse->size);
+    LM_I(("Notification Successfully Sent to %s", transferP->url.c_str()));
+    outP->assign(transferP->httpResponse->memory, transferP->httpResponse->size);
 
     if (metricsMgr.isOn())
       metricsMgr.add(tenant, servicePath0, METRIC_TRANS_OUT_RESP_SIZE, payloadLen);
   }
 
-  if (payloadSize > 0)
+  if (transferP->payloadSize > 0)
   {
     if (metricsMgr.isOn())
-      metricsMgr.add(tenant, servicePath0, METRIC_TRANS_OUT_REQ_SIZE, payloadSize);
+      metricsMgr.add(tenant, servicePath0, METRIC_TRANS_OUT_REQ_SIZE, transferP->payloadSize);
   }
 
   // Cleanup curl environment
 
-  curl_slist_free_all(headers);
+  curl_slist_free_all(transferP->headers);
+  transferP->headers = NULL;
+
+  free(transferP->httpResponse->memory);
+  delete transferP->httpResponse;
+  transferP->httpResponse = NULL;
+
+  return res == CURLE_OK ? 0 : -9;
+}
+
 
-  free(httpResponse->memory);
-  delete httpResponse;
+
+/* ****************************************************************************
+*
+* httpRequestSendWithCurl -
+*
+* The waitForResponse arguments specifies if the method has to wait for response
+* before return. If this argument is false, the return string is ""
+*
+* RETURN VALUES
+*   httpRequestSendWithCurl returns 0 on success and a negative number on failure:
+*     -1: Invalid port
+*     -2: Invalid IP
+*     -3: Invalid verb
+*     -4: Invalid resource
+*     -5: No Content-Type BUT content present
+*     -6: Content-Type present but there is no content
+*     -7: Total outgoing message size is too big
+*     -9: Error making HTTP request
+*/
+int httpRequestSendWithCurl
+(
+   CURL*                                      curl,
+   const std::string&                         _ip,
+   unsigned short                             port,
+   const std::string&                         _protocol,
+   const std::string&                         verb,
+   const char*                                tenant,
+   const std::string&                         servicePath,
+   const std::string&                         xauthToken,
+   const std::string&                         resource,
+   const std::string&                         orig_content_type,
+   const std::string&                         content,
+   const std::string&                         fiwareCorrelation,
+   const std::string&                         ngsiv2AttrFormat,
+   bool                                       waitForResponse,
+   std::string*                               outP,
+   const std::map<std::string, std::string>&  extraHeaders,
+   const std::string&                         acceptFormat,
+   long                                       timeoutInMilliseconds
+)
+{
+  HttpRequestTransfer  transfer;
+  std::string          protocol = _protocol + "//";
+  int                  r;
+
+  lmTransactionStart("to", protocol.c_str(), _ip.c_str(), port, resource.c_str());
+
+  r = httpRequestPrepare(curl,
+                         _ip,
+                         port,
+                         _protocol,
+                         verb,
+                         tenant,
+                         servicePath,
+                         xauthToken,
+                         resource,
+                         orig_content_type,
+                         content,
+                         fiwareCorrelation,
+                         ngsiv2AttrFormat,
+                         extraHeaders,
+                         acceptFormat,
+                         timeoutInMilliseconds,
+                         &transfer);
+
+  if (r != 0)
+  {
+    lmTransactionEnd();
+    *outP = "error";
+    return r;
+  }
+
+  //
+  // Synchronous HTTP request
+  //
+  // This was previously an LM_T trace, but we have "promoted" it to INFO due to it is needed
+  // to check logs in a .test case (case 000 notification_different_sizes.test)
+  //
+  LM_I(("Sending message %lu to HTTP server: sending message of %d bytes to HTTP server", transfer.callNo, transfer.outgoingMsgSize));
+
+  CURLcode res = curl_easy_perform(curl);
+
+  r = httpRequestDone(&transfer, res, outP);
 
   lmTransactionEnd();
 
-  return res == CURLE_OK ? 0 : -9;
+  return r;
 }
 
 
@@ -25,9 +25,12 @@
 *
 * Author: developer
 */
+#include <curl/curl.h>
 #include <string>
 #include <vector>
+#include <map>
 
+#include "common/limits.h"
 #include "ConnectionInfo.h"
 
 #define URI_BUF          (256)
@@ -78,6 +81,71 @@ extern int httpRequestSend
 
 
 
+/* ****************************************************************************
+*
+* MemoryStruct - buffer for the HTTP response
+*/
+struct MemoryStruct
+{
+  char*   memory;
+  size_t  size;
+};
+
+
+
+/* ****************************************************************************
+*
+* HttpRequestTransfer - state of a request from httpRequestPrepare until httpRequestDone
+*/
+typedef struct HttpRequestTransfer
+{
+  struct curl_slist*   headers;
+  MemoryStruct*        httpResponse;
+  std::string          url;
+  std::string          tenant;
+  char                 servicePath0[SERVICE_PATH_MAX_COMPONENT_LEN + 1];  // +1 for zero termination
+  unsigned long long   payloadSize;
+  int                  outgoingMsgSize;
+  unsigned long long   callNo;
+} HttpRequestTransfer;
+
+
+
+/* ****************************************************************************
+*
+* httpRequestPrepare -
+*/
+extern int httpRequestPrepare
+(
+  CURL*                                      curl,
+  const std::string&                         ip,
+  unsigned short                             port,
+  const std::string&                         protocol,
+  const std::string&                         verb,
+  const char*                                tenant,
+  const std::string&                         servicePath,
+  const std::string&                         xauthToken,
+  const std::string&                         resource,
+  const std::string&                         content_type,
+  const std::string&                         content,
+  const std::string&                         fiwareCorrelation,
+  const std::string&                         ngisv2AttrFormat,
+  const std::map<std::string, std::string>&  extraHeaders,
+  const std::string&                         acceptFormat,
+  long                                       timeoutInMilliseconds,
+  HttpRequestTransfer*                       transferP
+);
+
+
+
+/* ****************************************************************************
+*
+* httpRequestDone -
+*/
+extern int httpRequestDone(HttpRequestTransfer* transferP, CURLcode res, std::string* outP);
+
+
+
 /* ****************************************************************************
 *
 * httpRequestSendWithCurl -
@@ -65,6 +65,7 @@ extern "C"
 #include "orionld/rest/orionldMhdConnectionInit.h"               // orionldMhdConnectionInit
 #include "orionld/rest/orionldMhdConnectionPayloadRead.h"        // orionldMhdConnectionPayloadRead
 #include "orionld/rest/orionldMhdConnectionTreat.h"              // orionldMhdConnectionTreat
+#include "orionld/rest/latencyMetrics.h"                         // latencyMetricsRecord
 #include "orionld/serviceRoutines/orionldNotify.h"               // orionldNotify
 
 #include "rest/Verb.h"
@@ -712,25 +713,20 @@ static void requestCompleted
   MHD_RequestTerminationCode  toe
 )
 {
-#ifdef REQUEST_PERFORMANCE
-  kTimeGet(&timestamps.requestCompletedStart);
-#endif
+  PERFORMANCE(requestCompletedStart);
 
-  ConnectionInfo*  ciP      = (ConnectionInfo*) *con_cls;
-  const char*      spath    = (ciP->servicePathV.size() > 0)? ciP->servicePathV[0].c_str() : "";
+  ConnectionInfo*  ciP           = (ConnectionInfo*) *con_cls;
+  const char*      spath         = (ciP->servicePathV.size() > 0)? ciP->servicePathV[0].c_str() : "";
+  bool             ngsildRequest = (ciP->apiVersion == NGSI_LD_V1);
   struct timespec  reqEndTime;
 
   if (orionldState.notify == true)
   {
-#ifdef REQUEST_PERFORMANCE
-    kTimeGet(&timestamps.notifStart);
-#endif
+    PERFORMANCE(notifStart);
 
     orionldNotify();
 
-#ifdef REQUEST_PERFORMANCE
-    kTimeGet(&timestamps.notifEnd);
-#endif
+    PERFORMANCE(notifEnd);
   }
 
   if ((ciP->payload != NULL) && (ciP->payload != static_buffer))
@@ -830,6 +826,15 @@ static void requestCompleted
 
   *con_cls = NULL;
 
+  //
+  // Latency metrics - only for NGSI-LD requests that found their service
+  //
+  if ((latencyMetrics == true) && (ngsildRequest == true) && (orionldState.serviceP != NULL))
+  {
+    kTimeGet(&timestamps.reqEnd);
+    latencyMetricsRecord(orionldState.serviceP, &timestamps);
+  }
+
 #ifdef REQUEST_PERFORMANCE
   kTimeGet(&timestamps.reqEnd);
 
@@ -1713,10 +1718,13 @@ static MHD_Result connectionTreat
 
       if (*con_cls == NULL)
       {
-#ifdef REQUEST_PERFORMANCE
-        bzero(&timestamps, sizeof(timestamps));
-        kTimeGet(&timestamps.reqStart);
+#ifndef REQUEST_PERFORMANCE
+        if (latencyMetrics == true)
 #endif
+        {
+          bzero(&timestamps, sizeof(timestamps));
+          kTimeGet(&timestamps.reqStart);
+        }
         return orionldMhdConnectionInit(connection, url, method, version, con_cls);
       }
       else if (*upload_data_size != 0)
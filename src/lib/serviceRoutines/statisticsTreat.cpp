@@ -29,6 +29,11 @@
 #include "logMsg/traceLevels.h"
 
 #include "orionld/common/orionldState.h"        // orionldState
+#include "orionld/context/orionldContextFromUrl.h"  // orionldContextDownloadStatisticsGet, orionldContextDownloadStatisticsReset
+#include "orionld/contextCache/orionldInlineContextCache.h"  // orionldInlineContextCacheStatisticsGet, orionldInlineContextCacheStatisticsReset
+#include "orionld/common/orionldRequestSendMulti.h"  // orionldRequestSendMultiStatisticsGet, orionldRequestSendMultiStatisticsReset
+#include "orionld/notifications/orionldNotificationQueue.h"  // orionldNotificationQueueStatisticsGet, orionldNotificationQueueStatisticsReset
+#include "orionld/troe/pgConnectionPoolStatistics.h"  // pgConnectionPoolStatisticsGet, pgConnectionPoolStatisticsReset
 #include "common/string.h"
 #include "common/globals.h"
 #include "common/tag.h"
@@ -135,6 +140,12 @@ static void resetStatistics(void)
   noOfRegistrationsRequest                        = -1;
 
   QueueStatistics::reset();
+  orionldContextDownloadStatisticsReset();
+  orionldInlineContextCacheStatisticsReset();
+  orionldRequestSendMultiStatisticsReset();
+  orionldNotificationQueueStatisticsReset();
+  pgConnectionPoolStatisticsReset();
+  lmAsyncStatisticsReset();
 
   semTimeReqReset();
   semTimeTransReset();
@@ -262,6 +273,58 @@ std::string renderSemWaitStats(void)
 
 
 
+/* ****************************************************************************
+*
+* TROE_POOLS_MAX - max number of TRoE connection pools (one per tenant) in the statistics
+*/
+#define TROE_POOLS_MAX 100
+
+
+
+/* ****************************************************************************
+*
+* renderTroePoolStats - statistics of the TRoE postgres connection pools, one per database (tenant)
+*
+* Returns an empty string if no connection has been requested from any pool.
+*/
+std::string renderTroePoolStats(void)
+{
+  PgConnectionPoolStatistics  statsV[TROE_POOLS_MAX];
+  int                         pools = pgConnectionPoolStatisticsGet(statsV, TROE_POOLS_MAX);
+  JsonHelper                  js;
+  long long                   gets  = 0;
+
+  for (int ix = 0; ix < pools; ix++)
+  {
+    PgConnectionPoolStatistics* statsP = &statsV[ix];
+    JsonHelper                  jh;
+    JsonHelper                  histogram;
+
+    gets += statsP->gets;
+
+    for (int bucket = 0; bucket < PG_POOL_WAIT_BUCKETS; bucket++)
+      histogram.addNumber(pgPoolWaitBucketName[bucket], (long long) statsP->waitHistogram[bucket]);
+
+    jh.addNumber("max",           (long long) statsP->items);
+    jh.addNumber("connections",   (long long) statsP->connections);
+    jh.addNumber("idle",          (long long) statsP->idle);
+    jh.addNumber("waiters",       (long long) statsP->waiters);
+    jh.addNumber("gets",          (long long) statsP->gets);
+    jh.addNumber("timeouts",      (long long) statsP->timeouts);
+    jh.addNumber("connects",      (long long) statsP->connects);
+    jh.addNumber("connectErrors", (long long) statsP->connectErrors);
+    jh.addNumber("broken",        (long long) statsP->checkErrors);
+    jh.addNumber("waitTime",      statsP->waitTime);
+    jh.addRaw("waitHistogram",    histogram.str());
+
+    js.addRaw(statsP->db, jh.str());
+  }
+
+  return (gets == 0)? "" : js.str();
+}
+
+
+
 /* ****************************************************************************
 *
 * renderNotifQueueStats -
@@ -286,6 +349,128 @@ std::string renderNotifQueueStats(void)
 
 
 
+/* ****************************************************************************
+*
+* renderLdNotifQueueStats - statistics of the queue of the NGSI-LD notification sender threads
+*/
+std::string renderLdNotifQueueStats(const OrionldNotificationQueueStatistics* statsP)
+{
+  JsonHelper jh;
+
+  jh.addNumber("in",             statsP->in);
+  jh.addNumber("out",            statsP->out);
+  jh.addNumber("reject",         statsP->rejected);
+  jh.addNumber("evicted",        statsP->evicted);
+  jh.addNumber("sentOk",         statsP->sentOk);
+  jh.addNumber("sentError",      statsP->sentError);
+  jh.addNumber("timeInQueue",    statsP->timeInQueue);
+  jh.addNumber("avgTimeInQueue", (statsP->out == 0)? 0.0 : (statsP->timeInQueue / statsP->out));
+  jh.addNumber("size",           (long long) statsP->size);
+  jh.addNumber("highWater",      (long long) statsP->highWater);
+
+  return jh.str();
+}
+
+
+
+/* ****************************************************************************
+*
+* renderContextDownloadStats -
+*
+* coalescedWaiters: number of requests that needed a context that was being downloaded by another
+* request and got the result of that download instead of downloading the context themselves
+*/
+std::string renderContextDownloadStats(void)
+{
+  JsonHelper jh;
+  int        downloads;
+  int        failures;
+  int        coalescedWaiters;
+
+  orionldContextDownloadStatisticsGet(&downloads, &failures, &coalescedWaiters);
+
+  jh.addNumber("downloads",        (long long) downloads);
+  jh.addNumber("failures",         (long long) failures);
+  jh.addNumber("coalescedWaiters", (long long) coalescedWaiters);
+
+  return jh.str();
+}
+
+
+
+/* ****************************************************************************
+*
+* renderInlineContextCacheStats - statistics of the cache of inline @contexts (-inlineContextCache)
+*/
+std::string renderInlineContextCacheStats(int64_t hits, int64_t misses, int64_t evictions, int entries)
+{
+  JsonHelper jh;
+
+  jh.addNumber("hits",      (long long) hits);
+  jh.addNumber("misses",    (long long) misses);
+  jh.addNumber("evictions", (long long) evictions);
+  jh.addNumber("entries",   (long long) entries);
+
+  return jh.str();
+}
+
+
+
+/* ****************************************************************************
+*
+* FORWARD_SOURCES_MAX - max number of context sources in the forwarding statistics
+*/
+#define FORWARD_SOURCES_MAX 100
+
+
+
+/* ****************************************************************************
+*
+* renderForwardingStats - statistics of the requests forwarded to context sources, one per source
+*
+* Returns an empty string if no request has been forwarded.
+*/
+std::string renderForwardingStats(void)
+{
+  OrionldSourceStatistics  statsV[FORWARD_SOURCES_MAX];
+  int                      sources = orionldRequestSendMultiStatisticsGet(statsV, FORWARD_SOURCES_MAX);
+  JsonHelper               js;
+
+  for (int ix = 0; ix < sources; ix++)
+  {
+    OrionldSourceStatistics* statsP = &statsV[ix];
+    JsonHelper               jh;
+
+    jh.addNumber("requests",   (long long) statsP->requests);
+    jh.addNumber("failures",   (long long) statsP->failures);
+    jh.addNumber("timeouts",   (long long) statsP->timeouts);
+    jh.addNumber("avgLatency", (statsP->requests == 0)? 0.0 : ((double) statsP->latencySum / statsP->requests / 1000));
+    jh.addNumber("maxLatency", (double) statsP->latencyMax / 1000);
+
+    js.addRaw(statsP->source, jh.str());
+  }
+
+  return (sources == 0)? "" : js.str();
+}
+
+
+
+/* ****************************************************************************
+*
+* renderLogBufferStats - statistics of the ring buffer for asynchronous logging (-logBuffer)
+*/
+std::string renderLogBufferStats(int64_t lines, int64_t overflows)
+{
+  JsonHelper jh;
+
+  jh.addNumber("lines",     (long long) lines);
+  jh.addNumber("overflows", (long long) overflows);
+
+  return jh.str();
+}
+
+
+
 /* ****************************************************************************
 *
 * statisticsTreat -
@@ -313,19 +498,75 @@ std::string statisticsTreat
   if (countersStatistics)
   {
     js.addRaw("counters", renderCounterStats());
+
+    // Only present once at least one context has been downloaded (or awaited)
+    int downloads;
+    int failures;
+    int coalescedWaiters;
+
+    orionldContextDownloadStatisticsGet(&downloads, &failures, &coalescedWaiters);
+    if (downloads + failures + coalescedWaiters > 0)
+    {
+      js.addRaw("contextDownloads", renderContextDownloadStats());
+    }
+
+    // Only present if the cache of inline contexts is on (-inlineContextCache) and has been used
+    int64_t ctxHits;
+    int64_t ctxMisses;
+    int64_t ctxEvictions;
+    int     ctxEntries;
+
+    if ((orionldInlineContextCacheStatisticsGet(&ctxHits, &ctxMisses, &ctxEvictions, &ctxEntries) == true) && (ctxHits + ctxMisses > 0))
+    {
+      js.addRaw("inlineContextCache", renderInlineContextCacheStats(ctxHits, ctxMisses, ctxEvictions, ctxEntries));
+    }
+
+    // Only present once a request has been forwarded to a context source
+    std::string forwarding = renderForwardingStats();
+    if (forwarding != "")
+    {
+      js.addRaw("forwarding", forwarding);
+    }
+
+    // Only present with asynchronous logging (-logBuffer)
+    int64_t logLines;
+    int64_t logOverflows;
+
+    if (lmAsyncStatisticsGet(&logLines, &logOverflows) == true)
+    {
+      js.addRaw("logBuffer", renderLogBufferStats(logLines, logOverflows));
+    }
   }
   if (semWaitStatistics)
   {
     js.addRaw("semWait", renderSemWaitStats());
+
+    // Only present with TRoE enabled and once a postgres connection has been requested
+    std::string troePools = renderTroePoolStats();
+    if (troePools != "")
+    {
+      js.addRaw("troePools", troePools);
+    }
   }
   if (timingStatistics)
   {
     js.addRaw("timing", renderTimingStatistics());
   }
-  if ((notifQueueStatistics) && (strcmp(notificationMode, "threadpool") == 0))
+  if ((notifQueueStatistics) && ((strcmp(notificationMode, "threadpool") == 0) || (strcmp(notificationMode, "multi") == 0)))
   {
     js.addRaw("notifQueue", renderNotifQueueStats());
   }
+  if ((notifQueueStatistics) && (notifWorkers > 0))
+  {
+    // Only present once an NGSI-LD notification has been queued (or dropped)
+    OrionldNotificationQueueStatistics ldNotifQueueStats;
+
+    orionldNotificationQueueStatisticsGet(&ldNotifQueueStats);
+    if (ldNotifQueueStats.in + ldNotifQueueStats.rejected > 0)
+    {
+      js.addRaw("ldNotifQueue", renderLdNotifQueueStats(&ldNotifQueueStats));
+    }
+  }
 
   // Unconditional stats
   int now = orionldState.requestTime;
@@ -0,0 +1,68 @@
+/*
+*
+* Copyright 2021 FIWARE Foundation e.V.
+*
+* This file is part of Orion-LD Context Broker.
+*
+* Orion-LD Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion-LD Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion-LD Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* orionld at fiware dot org
+*
+* Author: Ken Zangelin
+*/
+#include <string>
+#include <vector>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "ngsi/ParseData.h"
+#include "rest/ConnectionInfo.h"
+#include "rest/OrionError.h"
+#include "rest/rest.h"
+#include "orionld/common/orionldState.h"
+#include "orionld/rest/latencyMetrics.h"
+#include "serviceRoutinesV2/deleteLatencyMetrics.h"
+
+
+
+/* ****************************************************************************
+*
+* deleteLatencyMetrics -
+*
+* DELETE /admin/metrics/latency
+*/
+std::string deleteLatencyMetrics
+(
+  ConnectionInfo*            ciP,
+  int                        components,
+  std::vector<std::string>&  compV,
+  ParseData*                 parseDataP
+)
+{
+  if (latencyMetrics == false)
+  {
+    OrionError oe(SccBadRequest, "latency metrics desactivated (start the broker with -latencyMetrics)");
+
+    ciP->httpStatusCode = SccBadRequest;
+
+    return oe.toJson();
+  }
+
+  latencyMetricsReset();
+
+  ciP->httpStatusCode = SccNoContent;
+  return "";
+}